@@ -19,7 +19,9 @@
 #include "utils/gzstream.h"
 #include "utils/timeutil.h" //for getRealTime()
 #include "utils/progress.h" //for progress_display
+#include "utils/mappedfile.h"
 #include "alignmentsummary.h"
+#include "utils/distancematrix.h"
 
 #include <Eigen/LU>
 #ifdef USE_BOOST
@@ -529,12 +531,13 @@ Alignment::Alignment(char *filename, char *sequence_type, InputType &intype, str
             readNexus(filename);
         } else if (intype == IN_FASTA) {
             cout << "Fasta format detected" << endl;
-            readFasta(filename, sequence_type);
+            if (!Params::getInstance().mmap_alignment || !readMappedAlignment(filename, sequence_type, true))
+                readFasta(filename, sequence_type);
         } else if (intype == IN_PHYLIP) {
             cout << "Phylip format detected" << endl;
             if (Params::getInstance().phylip_sequential_format)
                 readPhylipSequential(filename, sequence_type);
-            else
+            else if (!Params::getInstance().mmap_alignment || !readMappedAlignment(filename, sequence_type, false))
                 readPhylip(filename, sequence_type);
         } else if (intype == IN_COUNTS) {
             cout << "Counts format (PoMo) detected" << endl;
@@ -1250,45 +1253,69 @@ void Alignment::regroupSitePattern(int groups, IntVector& site_group)
 	@return the data type of the input sequences
 */
 SeqType Alignment::detectSequenceType(StrVector &sequences) {
-    size_t num_nuc   = 0;
-    size_t num_ungap = 0;
-    size_t num_bin   = 0;
-    size_t num_alpha = 0;
-    size_t num_digit = 0;
+    size_t char_count[NUM_CHAR] = {0};
     double detectStart = getRealTime();
     size_t sequenceCount = sequences.size();
 #ifdef _OPENMP
-#pragma omp parallel for reduction(+:num_nuc,num_ungap,num_bin,num_alpha,num_digit)
+#pragma omp parallel
 #endif
-    for (size_t seqNum = 0; seqNum < sequenceCount; ++seqNum) {
-        auto start = sequences.at(seqNum).data();
-        auto stop  = start + sequences.at(seqNum).size();
-        for (auto i = start; i!=stop; ++i) {
-            if ((*i) == 'A' || (*i) == 'C' || (*i) == 'G' || (*i) == 'T' || (*i) == 'U') {
-                ++num_nuc;
-                ++num_ungap;
-                continue;
-            }
-            if ((*i)=='?' || (*i)=='-' || (*i) == '.' ) {
-                continue;
-            }
-            if (*i != 'N' && *i != 'X' &&  (*i) != '~') {
-                num_ungap++;
-                if (isdigit(*i)) {
-                    num_digit++;
-                    if ((*i) == '0' || (*i) == '1') {
-                        num_bin++;
-                    }
-                }
-            }
-            if (isalpha(*i)) {
-                num_alpha++;
+    {
+        size_t local_count[NUM_CHAR] = {0};
+#ifdef _OPENMP
+#pragma omp for
+#endif
+        for (size_t seqNum = 0; seqNum < sequenceCount; ++seqNum) {
+            auto start = sequences.at(seqNum).data();
+            auto stop  = start + sequences.at(seqNum).size();
+            for (auto i = start; i!=stop; ++i) {
+                local_count[(unsigned char)(*i)]++;
             }
         }
+#ifdef _OPENMP
+#pragma omp critical
+#endif
+        for (int c = 0; c < NUM_CHAR; c++) {
+            char_count[c] += local_count[c];
+        }
     }
     if (verbose_mode >= VB_MED) {
         cout << "Sequence Type detection took " << (getRealTime()-detectStart) << " seconds." << endl;
     }
+    return detectSequenceType(char_count);
+}
+
+SeqType Alignment::detectSequenceType(const size_t *char_count) {
+    size_t num_nuc   = 0;
+    size_t num_ungap = 0;
+    size_t num_bin   = 0;
+    size_t num_alpha = 0;
+    size_t num_digit = 0;
+    for (int c = 0; c < NUM_CHAR; c++) {
+        size_t count = char_count[c];
+        if (count == 0) {
+            continue;
+        }
+        if (c == 'A' || c == 'C' || c == 'G' || c == 'T' || c == 'U') {
+            num_nuc   += count;
+            num_ungap += count;
+            continue;
+        }
+        if (c == '?' || c == '-' || c == '.' ) {
+            continue;
+        }
+        if (c != 'N' && c != 'X' && c != '~') {
+            num_ungap += count;
+            if (isdigit(c)) {
+                num_digit += count;
+                if (c == '0' || c == '1') {
+                    num_bin += count;
+                }
+            }
+        }
+        if (isalpha(c)) {
+            num_alpha += count;
+        }
+    }
     if (((double)num_nuc) / num_ungap > 0.9)
         return SEQ_DNA;
     if (((double)num_bin) / num_ungap > 0.9)
@@ -1635,6 +1662,16 @@ int getMorphStates(StrVector &sequences) {
 	return 0;
 }
 
+/** same as above, from a character histogram (see Alignment::detectSequenceType) */
+int getMorphStates(const size_t *char_count) {
+	int maxstate = 0;
+	for (int c = 1; c < 128; c++)
+		if (char_count[c] && isalnum(c)) maxstate = c;
+	if (maxstate >= '0' && maxstate <= '9') return (maxstate - '0' + 1);
+	if (maxstate >= 'A' && maxstate <= 'V') return (maxstate - 'A' + 11);
+	return 0;
+}
+
 SeqType Alignment::getSeqType(const char *sequence_type) {
     SeqType user_seq_type = SEQ_UNKNOWN;
     if (strcmp(sequence_type, "BIN") == 0) {
@@ -1655,20 +1692,71 @@ SeqType Alignment::getSeqType(const char *sequence_type) {
     return user_seq_type;
 }
 
+/**
+    supplies the characters of all sequences in consecutive blocks of sites,
+    so that building patterns does not require the whole alignment as strings
+*/
+class SiteChunkReader {
+public:
+    virtual ~SiteChunkReader() {}
+
+    /**
+        @return the next block of sites, one string per sequence (all of the same length,
+        a multiple of 3 unless it is the last block)
+    */
+    virtual StrVector &nextChunk() = 0;
+};
+
+/** the whole alignment held in memory as one block */
+class StrVectorChunkReader : public SiteChunkReader {
+public:
+    StrVectorChunkReader(StrVector &seqs) : sequences(seqs) {}
+    virtual StrVector &nextChunk() { return sequences; }
+protected:
+    StrVector &sequences;
+};
+
 int Alignment::buildPattern(StrVector &sequences, char *sequence_type, int nseq, int nsite) {
-    int seq_id;
     ostringstream err_str;
-    codon_table = NULL;
-    genetic_code = NULL;
-    non_stop_codon = NULL;
-
     if (nseq != seq_names.size()) {
         throw "Different number of sequences than specified";
     }
+    checkDuplicateSeqNames(nseq);
+
+    /* now check that all sequences have the same length */
+    for (int seq_id = 0; seq_id < nseq; seq_id ++) {
+        if (sequences[seq_id].length() != nsite) {
+            err_str << "Sequence " << seq_names[seq_id] << " contains ";
+            if (sequences[seq_id].length() < nsite)
+                err_str << "not enough";
+            else
+                err_str << "too many";
+
+            err_str << " characters (" << sequences[seq_id].length() << ")\n";
+        }
+    }
+
+    if (err_str.str() != "")
+        throw err_str.str();
+
+    /* now check data type */
+    SeqType detected_type = detectSequenceType(sequences);
+    int morph_states = 0;
+    if (detected_type == SEQ_MORPH || (sequence_type &&
+        (strcmp(sequence_type, "NUM") == 0 || strcmp(sequence_type, "MORPH") == 0)))
+        morph_states = getMorphStates(sequences);
+    bool nt2aa = initSequenceType(detected_type, morph_states, sequence_type);
+
+    StrVectorChunkReader reader(sequences);
+    return buildPatternFromChunks(reader, nt2aa, nseq, nsite);
+}
+
+void Alignment::checkDuplicateSeqNames(int nseq) {
+    ostringstream err_str;
     unordered_set<string> namesSeen;
     double seqCheckStart = getRealTime();
     /* now check that all sequence names are correct */
-    for (seq_id = 0; seq_id < nseq; seq_id ++) {
+    for (int seq_id = 0; seq_id < nseq; seq_id ++) {
         ostringstream err_str;
         if (seq_names[seq_id] == "")
             err_str << "Sequence number " << seq_id+1 << " has no names\n";
@@ -1685,24 +1773,13 @@ int Alignment::buildPattern(StrVector &sequences, char *sequence_type, int nseq,
         cout.precision(6);
         cout << "Duplicate sequence name check took " << (getRealTime()-seqCheckStart) << " seconds." << endl;
     }
-    /* now check that all sequences have the same length */
-    for (seq_id = 0; seq_id < nseq; seq_id ++) {
-        if (sequences[seq_id].length() != nsite) {
-            err_str << "Sequence " << seq_names[seq_id] << " contains ";
-            if (sequences[seq_id].length() < nsite)
-                err_str << "not enough";
-            else
-                err_str << "too many";
-
-            err_str << " characters (" << sequences[seq_id].length() << ")\n";
-        }
-    }
-
-    if (err_str.str() != "")
-        throw err_str.str();
+}
 
-    /* now check data type */
-    seq_type = detectSequenceType(sequences);
+bool Alignment::initSequenceType(SeqType detected_type, int morph_states, char *sequence_type) {
+    codon_table = NULL;
+    genetic_code = NULL;
+    non_stop_codon = NULL;
+    seq_type = detected_type;
     switch (seq_type) {
     case SEQ_BINARY:
         num_states = 2;
@@ -1717,7 +1794,7 @@ int Alignment::buildPattern(StrVector &sequences, char *sequence_type, int nseq,
         cout << "Alignment most likely contains protein sequences" << endl;
         break;
     case SEQ_MORPH:
-        num_states = getMorphStates(sequences);
+        num_states = morph_states;
         if (num_states < 2 || num_states > 32) throw "Invalid number of states.";
         cout << "Alignment most likely contains " << num_states << "-state morphological data" << endl;
         break;
@@ -1749,7 +1826,7 @@ int Alignment::buildPattern(StrVector &sequences, char *sequence_type, int nseq,
             nt2aa = true;
             cout << "Translating to amino-acid sequences with genetic code " << &sequence_type[5] << " ..." << endl;
         } else if (strcmp(sequence_type, "NUM") == 0 || strcmp(sequence_type, "MORPH") == 0) {
-            num_states = getMorphStates(sequences);
+            num_states = morph_states;
             if (num_states < 2 || num_states > 32) throw "Invalid number of states";
             user_seq_type = SEQ_MORPH;
         } else if (strcmp(sequence_type, "TINA") == 0 || strcmp(sequence_type, "MULTI") == 0) {
@@ -1767,10 +1844,14 @@ int Alignment::buildPattern(StrVector &sequences, char *sequence_type, int nseq,
             outWarning("Your specified sequence type is different from the detected one");
         seq_type = user_seq_type;
     }
+    return nt2aa;
+}
 
+int Alignment::buildPatternFromChunks(SiteChunkReader &reader, bool nt2aa, int nseq, int nsite) {
     //initStateSpace(seq_type);
     
     // now convert to patterns
+    ostringstream err_str;
     int site, seq, num_gaps_only = 0;
 
     char char_to_state[NUM_CHAR];
@@ -1793,60 +1874,67 @@ int Alignment::buildPattern(StrVector &sequences, char *sequence_type, int nseq,
     int num_error = 0;
     
     progress_display progress(nsite, "Constructing alignment", "examined", "site");
-    for (site = 0; site < nsite; site+=step) {
-        for (seq = 0; seq < nseq; seq++) {
-            //char state = convertState(sequences[seq][site], seq_type);
-            char state = char_to_state[(int)(sequences[seq][site])];
-            if (seq_type == SEQ_CODON || nt2aa) {
-            	// special treatment for codon
-            	char state2 = char_to_state[(int)(sequences[seq][site+1])];
-            	char state3 = char_to_state[(int)(sequences[seq][site+2])];
-            	if (state < 4 && state2 < 4 && state3 < 4) {
+    for (int first_site = 0; first_site < nsite; ) {
+        StrVector &sequences = reader.nextChunk();
+        int chunk_len = sequences[0].length();
+        ASSERT(chunk_len > 0 && chunk_len % step == 0);
+        for (int pos = 0; pos < chunk_len; pos += step) {
+            site = first_site + pos;
+            for (seq = 0; seq < nseq; seq++) {
+                //char state = convertState(sequences[seq][pos], seq_type);
+                char state = char_to_state[(int)(sequences[seq][pos])];
+                if (seq_type == SEQ_CODON || nt2aa) {
+                	// special treatment for codon
+                	char state2 = char_to_state[(int)(sequences[seq][pos+1])];
+                	char state3 = char_to_state[(int)(sequences[seq][pos+2])];
+                	if (state < 4 && state2 < 4 && state3 < 4) {
 //            		state = non_stop_codon[state*16 + state2*4 + state3];
-            		state = state*16 + state2*4 + state3;
-            		if (genetic_code[(int)state] == '*') {
-                        err_str << "Sequence " << seq_names[seq] << " has stop codon " <<
-                        		sequences[seq][site] << sequences[seq][site+1] << sequences[seq][site+2] <<
-                        		" at site " << site+1 << endl;
-                        num_error++;
-                        state = STATE_UNKNOWN;
-            		} else if (nt2aa) {
-                        state = AA_to_state[(int)genetic_code[(int)state]];
-                    } else {
-                        state = non_stop_codon[(int)state];
-                    }
-            	} else if (state == STATE_INVALID || state2 == STATE_INVALID || state3 == STATE_INVALID) {
-            		state = STATE_INVALID;
-            	} else {
-            		if (state != STATE_UNKNOWN || state2 != STATE_UNKNOWN || state3 != STATE_UNKNOWN) {
-            			ostringstream warn_str;
-                        warn_str << "Sequence " << seq_names[seq] << " has ambiguous character " <<
-                        		sequences[seq][site] << sequences[seq][site+1] << sequences[seq][site+2] <<
-                        		" at site " << site+1;
-                        outWarning(warn_str.str());
-            		}
-            		state = STATE_UNKNOWN;
-            	}
+                		state = state*16 + state2*4 + state3;
+                		if (genetic_code[(int)state] == '*') {
+                            err_str << "Sequence " << seq_names[seq] << " has stop codon " <<
+                            		sequences[seq][pos] << sequences[seq][pos+1] << sequences[seq][pos+2] <<
+                            		" at site " << site+1 << endl;
+                            num_error++;
+                            state = STATE_UNKNOWN;
+                		} else if (nt2aa) {
+                            state = AA_to_state[(int)genetic_code[(int)state]];
+                        } else {
+                            state = non_stop_codon[(int)state];
+                        }
+                	} else if (state == STATE_INVALID || state2 == STATE_INVALID || state3 == STATE_INVALID) {
+                		state = STATE_INVALID;
+                	} else {
+                		if (state != STATE_UNKNOWN || state2 != STATE_UNKNOWN || state3 != STATE_UNKNOWN) {
+                			ostringstream warn_str;
+                            warn_str << "Sequence " << seq_names[seq] << " has ambiguous character " <<
+                            		sequences[seq][pos] << sequences[seq][pos+1] << sequences[seq][pos+2] <<
+                            		" at site " << site+1;
+                            outWarning(warn_str.str());
+                		}
+                		state = STATE_UNKNOWN;
+                	}
+                }
+                if (state == STATE_INVALID) {
+                    if (num_error < 100) {
+                        err_str << "Sequence " << seq_names[seq] << " has invalid character " << sequences[seq][pos];
+                        if (seq_type == SEQ_CODON)
+                            err_str << sequences[seq][pos+1] << sequences[seq][pos+2];
+                        err_str << " at site " << site+1 << endl;
+                    } else if (num_error == 100)
+                        err_str << "...many more..." << endl;
+                    num_error++;
+                }
+                pat[seq] = state;
             }
-            if (state == STATE_INVALID) {
-                if (num_error < 100) {
-                    err_str << "Sequence " << seq_names[seq] << " has invalid character " << sequences[seq][site];
-                    if (seq_type == SEQ_CODON)
-                        err_str << sequences[seq][site+1] << sequences[seq][site+2];
-                    err_str << " at site " << site+1 << endl;
-                } else if (num_error == 100)
-                    err_str << "...many more..." << endl;
-                num_error++;
+            if (!num_error)
+            {
+                bool gaps_only;
+                addPatternLazy(pat, site/step, 1, gaps_only);
+                num_gaps_only += gaps_only ? 1 : 0;
             }
-            pat[seq] = state;
+            progress += step;
         }
-        if (!num_error)
-        {
-            bool gaps_only;
-            addPatternLazy(pat, site/step, 1, gaps_only);
-            num_gaps_only += gaps_only ? 1 : 0;
-        }
-        progress += step;
+        first_site += chunk_len;
     }
     progress.done();
     updatePatterns(0);
@@ -2066,7 +2154,13 @@ int Alignment::readFasta(char *filename, char *sequence_type) {
     in.exceptions(ios::failbit | ios::badbit);
     in.close();
 
-    // now try to cut down sequence name if possible
+    shortenSeqNames();
+
+    return buildPattern(sequences, sequence_type, seq_names.size(), sequences.front().length());
+}
+
+void Alignment::shortenSeqNames() {
+    // cut down sequence names if possible
     int i, step = 0;
     StrVector new_seq_names, remain_seq_names;
     new_seq_names.resize(seq_names.size());
@@ -2108,8 +2202,330 @@ int Alignment::readFasta(char *filename, char *sequence_type) {
     }
 
     seq_names = new_seq_names;
+}
 
-    return buildPattern(sequences, sequence_type, seq_names.size(), sequences.front().length());
+/** characters of one sequence in a memory-mapped alignment file */
+struct MappedSegment {
+    /** byte range [start, end) in the file */
+    size_t start, end;
+    /** line number of start */
+    int line_num;
+};
+
+/** a note or an error found while scanning a memory-mapped alignment file */
+struct MappedMessage {
+    /** byte offset in the file, messages are reported in file order */
+    size_t pos;
+    string text;
+};
+
+/** position while scanning the segments of one sequence */
+struct MappedCursor {
+    size_t seg, pos;
+    int line_num;
+
+    MappedCursor(const vector<MappedSegment> &segments) : seg(0), pos(0), line_num(0) {
+        if (!segments.empty()) {
+            pos = segments[0].start;
+            line_num = segments[0].line_num;
+        }
+    }
+
+    /**
+        extract sequence characters with the same rules as processSeq()
+        @param data mapped file
+        @param segments segments of the sequence
+        @param max_chars stop after this many characters
+        @param out if not NULL, characters are appended here
+        @param char_count if not NULL, histogram of the characters (NUM_CHAR entries)
+        @param seg_chars if not NULL, number of characters per segment
+        @param notes if not NULL, notes on bracketed characters are appended here
+        @return number of characters extracted
+        @throw string on invalid characters, pos is then the offset of the error
+    */
+    size_t scan(const char *data, const vector<MappedSegment> &segments, size_t max_chars,
+                string *out, size_t *char_count, size_t *seg_chars, vector<MappedMessage> *notes) {
+        size_t count = 0;
+        while (count < max_chars && seg < segments.size()) {
+            const char *p   = data + pos;
+            const char *end = data + segments[seg].end;
+            for (; p != end && count < max_chars; ++p) {
+                char c = *p;
+                if (c <= ' ') {
+                    if (c == '\n' || (c == '\r' && (p+1 == end || p[1] != '\n'))) {
+                        line_num++;
+                    }
+                    continue;
+                }
+                if (isalnum(c) || c == '-' || c == '?'|| c == '.' || c == '*' || c == '~') {
+                    c = toupper(c);
+                } else if (c == '(' || c == '{') {
+                    const char *close = p;
+                    while (close != end && *close != ')' && *close != '}' && *close != '\n' && *close != '\r')
+                        close++;
+                    if (close == end || *close == '\n' || *close == '\r') {
+                        pos = p - data;
+                        throw "Line " + convertIntToString(line_num) + ": No matching close-bracket ) or } found";
+                    }
+                    if (notes) {
+                        notes->push_back({(size_t)(p - data), "NOTE: Line " + convertIntToString(line_num) + ": " +
+                            string(p, close+1) + " is treated as unknown character"});
+                    }
+                    p = close;
+                    c = '?';
+                } else {
+                    pos = p - data;
+                    throw "Line " + convertIntToString(line_num) + ": Unrecognized character " + c;
+                }
+                if (out) {
+                    out->push_back(c);
+                }
+                if (char_count) {
+                    char_count[(unsigned char)c]++;
+                }
+                if (seg_chars) {
+                    seg_chars[seg]++;
+                }
+                count++;
+            }
+            pos = p - data;
+            if (p == end && ++seg < segments.size()) {
+                pos = segments[seg].start;
+                line_num = segments[seg].line_num;
+            }
+        }
+        return count;
+    }
+};
+
+/** sites of a memory-mapped alignment, extracted block by block in parallel over sequences */
+class MappedChunkReader : public SiteChunkReader {
+public:
+    MappedChunkReader(const char *data, const vector<vector<MappedSegment> > &segments,
+                      int nsite, int chunk_size)
+        : data(data), segments(segments), remaining(nsite), chunk_size(chunk_size) {
+        for (auto &seg : segments) {
+            cursors.push_back(MappedCursor(seg));
+        }
+        rows.resize(segments.size());
+    }
+
+    virtual StrVector &nextChunk() {
+        int len = min(chunk_size, remaining);
+        intptr_t nseq = rows.size();
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+        for (intptr_t seq = 0; seq < nseq; seq++) {
+            rows[seq].clear();
+            rows[seq].reserve(len);
+            cursors[seq].scan(data, segments[seq], len, &rows[seq], NULL, NULL, NULL);
+        }
+        remaining -= len;
+        return rows;
+    }
+
+protected:
+    const char *data;
+    const vector<vector<MappedSegment> > &segments;
+    vector<MappedCursor> cursors;
+    StrVector rows;
+    int remaining;
+    int chunk_size;
+};
+
+void Alignment::replayMappedLines(const vector<vector<MappedSegment> > &segments,
+                                  const vector<vector<size_t> > &seg_chars,
+                                  vector<vector<MappedMessage> > &notes,
+                                  const vector<MappedMessage> &errors, bool fasta) {
+    // lines (or, for FASTA, sequences) in file order
+    vector<pair<int, int> > lines;
+    for (int seq = 0; seq < segments.size(); seq++)
+        for (int k = 0; k < segments[seq].size(); k++)
+            lines.push_back(make_pair(seq, k));
+    sort(lines.begin(), lines.end(), [&segments](const pair<int, int> &a, const pair<int, int> &b) {
+        return segments[a.first][a.second].start < segments[b.first][b.second].start;
+    });
+    vector<MappedMessage> all_notes;
+    for (auto &seq_notes : notes) {
+        all_notes.insert(all_notes.end(), seq_notes.begin(), seq_notes.end());
+        vector<MappedMessage>().swap(seq_notes);
+    }
+    sort(all_notes.begin(), all_notes.end(), [](const MappedMessage &a, const MappedMessage &b) {
+        return a.pos < b.pos;
+    });
+    const MappedMessage *error = NULL;
+    for (auto &err : errors)
+        if (err.pos != SIZE_MAX && (!error || err.pos < error->pos))
+            error = &err;
+
+    // report as readPhylip() and readFasta() would while reading line by line
+    vector<size_t> seq_len(segments.size(), 0);
+    auto note = all_notes.begin();
+    for (auto &line : lines) {
+        const MappedSegment &seg = segments[line.first][line.second];
+        size_t line_end = (error && error->pos < seg.end) ? error->pos : seg.end;
+        for (; note != all_notes.end() && note->pos < line_end; note++)
+            cout << note->text << endl;
+        if (line_end != seg.end)
+            throw error->text;
+        if (fasta) continue;
+        seq_len[line.first] += seg_chars[line.first][line.second];
+        if (seq_len[line.first] != seq_len[0]) {
+            ostringstream err_str;
+            err_str << "Line " << seg.line_num << ": Sequence " << seq_names[line.first]
+                    << " has wrong sequence length " << seq_len[line.first] << endl;
+            throw err_str.str();
+        }
+    }
+    for (; note != all_notes.end(); note++)
+        cout << note->text << endl;
+}
+
+int Alignment::readMappedAlignment(char *filename, char *sequence_type, bool fasta) {
+    if (sequence_type && (strcmp(sequence_type,"TINA") == 0 || strcmp(sequence_type,"MULTI") == 0))
+        return 0;
+    MappedFile file;
+    if (!file.open(filename))
+        return 0;
+    double readStart = getRealTime();
+    const char *data = file.data();
+    size_t size = file.size();
+    vector<vector<MappedSegment> > segments;
+    int nseq = 0, nsite = 0;
+    int seq_id = 0;
+    int line_num = 1;
+
+    // serial pass: locate names and the byte ranges of every sequence
+    for (size_t pos = 0; pos < size; line_num++) {
+        size_t line_end = pos;
+        while (line_end < size && data[line_end] != '\n' && data[line_end] != '\r')
+            line_end++;
+        size_t line_start = pos;
+        pos = line_end + 1;
+        if (line_end + 1 < size && data[line_end] == '\r' && data[line_end+1] == '\n')
+            pos++;
+        if (line_end == line_start) continue;
+
+        if (fasta) {
+            if (data[line_start] == '>') { // next sequence
+                seq_names.push_back(string(data + line_start + 1, line_end - line_start - 1));
+                trimString(seq_names.back());
+                segments.push_back(vector<MappedSegment>());
+                continue;
+            }
+            if (segments.empty()) {
+                throw "First line must begin with '>' to define sequence name";
+            }
+            // lines of one sequence are contiguous: keep a single segment
+            if (segments.back().empty())
+                segments.back().push_back({line_start, line_end, line_num});
+            else
+                segments.back().back().end = line_end;
+        } else if (nseq == 0) { // read number of sequences and sites
+            istringstream line_in(string(data + line_start, line_end - line_start));
+            if (!(line_in >> nseq >> nsite))
+                throw "Invalid PHYLIP format. First line must contain number of sequences and sites";
+            if (nseq < 3)
+                throw "There must be at least 3 sequences";
+            if (nsite < 1)
+                throw "No alignment columns";
+            seq_names.resize(nseq, "");
+            segments.resize(nseq);
+        } else { // sequence contents
+            size_t seq_start = line_start;
+            if (seq_names[seq_id] == "") { // cut out the sequence name
+                size_t name_end = line_start;
+                while (name_end < line_end && data[name_end] != ' ' && data[name_end] != '\t')
+                    name_end++;
+                if (name_end == line_end) //  assume standard phylip
+                    name_end = min(line_start + 10, line_end);
+                seq_names[seq_id] = string(data + line_start, name_end - line_start);
+                seq_start = name_end;
+            }
+            segments[seq_id].push_back({seq_start, line_end, line_num});
+            bool has_chars = false;
+            for (size_t i = seq_start; i < line_end && !has_chars; i++)
+                has_chars = (data[i] > ' ');
+            if (has_chars && ++seq_id == nseq)
+                seq_id = 0;
+        }
+    }
+    if (fasta) {
+        nseq = seq_names.size();
+        if (nseq == 0)
+            throw "No sequence found in alignment file";
+    }
+
+    // parallel pass over sequences: validate characters, count them per line, collect a histogram
+    vector<size_t> seq_len(nseq, 0);
+    vector<vector<size_t> > seg_chars(nseq);
+    vector<vector<MappedMessage> > notes(nseq);
+    vector<MappedMessage> errors(nseq, {SIZE_MAX, ""});
+    size_t char_count[NUM_CHAR] = {0};
+#ifdef _OPENMP
+#pragma omp parallel
+#endif
+    {
+        size_t local_count[NUM_CHAR] = {0};
+#ifdef _OPENMP
+#pragma omp for schedule(dynamic)
+#endif
+        for (int seq = 0; seq < nseq; seq++) {
+            seg_chars[seq].resize(segments[seq].size(), 0);
+            MappedCursor cursor(segments[seq]);
+            try {
+                seq_len[seq] = cursor.scan(data, segments[seq], SIZE_MAX, NULL, local_count,
+                                           seg_chars[seq].data(), &notes[seq]);
+            } catch (string str) {
+                errors[seq] = {cursor.pos, str};
+            }
+        }
+#ifdef _OPENMP
+#pragma omp critical
+#endif
+        for (int c = 0; c < NUM_CHAR; c++) {
+            char_count[c] += local_count[c];
+        }
+    }
+    replayMappedLines(segments, seg_chars, notes, errors, fasta);
+
+    if (fasta) {
+        nsite = seq_len[0];
+        shortenSeqNames();
+    }
+    if (nseq != seq_names.size()) {
+        throw "Different number of sequences than specified";
+    }
+    checkDuplicateSeqNames(nseq);
+
+    /* now check that all sequences have the same length */
+    ostringstream err_str;
+    for (seq_id = 0; seq_id < nseq; seq_id ++) {
+        if (seq_len[seq_id] != nsite) {
+            err_str << "Sequence " << seq_names[seq_id] << " contains ";
+            if (seq_len[seq_id] < nsite)
+                err_str << "not enough";
+            else
+                err_str << "too many";
+
+            err_str << " characters (" << seq_len[seq_id] << ")\n";
+        }
+    }
+    if (err_str.str() != "")
+        throw err_str.str();
+    if (verbose_mode >= VB_MED) {
+        cout << "Time to scan mapped alignment was " << (getRealTime() - readStart) << " sec." << endl;
+    }
+
+    /* now check data type */
+    bool nt2aa = initSequenceType(detectSequenceType(char_count), getMorphStates(char_count), sequence_type);
+
+    // blocks of sites as large as about 64 MB of characters, whole codons
+    int chunk_size = max((int64_t)1, min((int64_t)nsite, ((int64_t)64 << 20) / nseq));
+    chunk_size = max(3, chunk_size - chunk_size % 3);
+    MappedChunkReader reader(data, segments, nsite, chunk_size);
+    return buildPatternFromChunks(reader, nt2aa, nseq, nsite);
 }
 
 int Alignment::readClustal(char *filename, char *sequence_type) {
@@ -3132,6 +3548,13 @@ void Alignment::extractPatternFreqs(Alignment *aln, IntVector &ptn_freq) {
     site_pattern.resize(accumulate(ptn_freq.begin(), ptn_freq.end(), 0), -1);
     clear();
     pattern_index.clear();
+
+    // copy variables for PoMo, as createBootstrapAlignment does
+    pomo_sampled_states = aln->pomo_sampled_states;
+    pomo_sampled_states_index = aln->pomo_sampled_states_index;
+    pomo_sampling_method = aln->pomo_sampling_method;
+    virtual_pop_size = aln->virtual_pop_size;
+
     int site = 0;
     VerboseMode save_mode = verbose_mode;
     verbose_mode = min(verbose_mode, VB_MIN); // to avoid printing gappy sites in addPattern
@@ -3140,10 +3563,20 @@ void Alignment::extractPatternFreqs(Alignment *aln, IntVector &ptn_freq) {
             ASSERT(ptn_freq[i] > 0);
             Pattern pat = aln->at(i);
             addPattern(pat, site, ptn_freq[i]);
+            if (!aln->site_state_freq.empty()) {
+                // patterns of aln are distinct, so each one adds a pattern
+                double *state_freq = new double[num_states];
+                memcpy(state_freq, aln->site_state_freq[i], num_states*sizeof(double));
+                site_state_freq.push_back(state_freq);
+            }
             for (int j = 0; j < ptn_freq[i]; j++)
                 site_pattern[site++] = size()-1;
         }
     site_pattern.resize(site);
+    if (!aln->site_state_freq.empty()) {
+        site_model = site_pattern;
+        ASSERT(site_state_freq.size() == getNPattern());
+    }
     verbose_mode = save_mode;
     countConstSite();
     ASSERT(size() <= aln->size());
@@ -4110,26 +4543,25 @@ double Alignment::computeJCDist(int seq1, int seq2) {
     return computeJCDistanceFromObservedDistance(obs_dist);
 }
 
-void Alignment::printDist(ostream &out, double *dist_mat) {
+void Alignment::printDist(ostream &out, const DistanceMatrix &dist_mat) {
     size_t nseqs = getNSeq();
     int max_len = getMaxSeqNameLength();
     if (max_len < 10) max_len = 10;
     out << nseqs << endl;
     out.precision(max((int)ceil(-log10(Params::getInstance().min_branch_length))+1, 6));
     out << fixed;
-    size_t pos = 0;
     for (size_t seq1 = 0; seq1 < nseqs; ++seq1)  {
         out.width(max_len);
         out << left << getSeqName(seq1) << " ";
         for (size_t seq2 = 0; seq2 < nseqs; ++seq2) {
-            out << dist_mat[pos++];
+            out << dist_mat.get(seq1, seq2);
             out << " ";
         }
         out << endl;
     }
 }
 
-void Alignment::printDist(const char *file_name, double *dist_mat) {
+void Alignment::printDist(const char *file_name, const DistanceMatrix &dist_mat) {
     try {
         ofstream out;
         out.exceptions(ios::failbit | ios::badbit);
@@ -4142,79 +4574,56 @@ void Alignment::printDist(const char *file_name, double *dist_mat) {
     }
 }
 
-double Alignment::readDist(istream &in, double *dist_mat) {
+double Alignment::readDist(istream &in, DistanceMatrix &dist_mat) {
     double longest_dist = 0.0;
     size_t nseqs;
     in >> nseqs;
     if (nseqs != getNSeq())
         throw "Distance file has different number of taxa";
-    double *tmp_dist_mat = new double[nseqs * nseqs];
+    // distances in the order of the file: an upper-triangle entry is stored when it is read,
+    // and compared with the matching lower-triangle entry of a later row
+    DistanceMatrix tmp_dist_mat(nseqs, dist_mat.isSinglePrecision());
     std::map< string, int > map_seqName_ID;
-    int pos = 0, seq1, seq2, id = 0;
-    // read in distances to a temporary array
-    for (seq1 = 0; seq1 < nseqs; seq1++)  {
+    StrVector seq_names;
+    for (size_t seq1 = 0; seq1 < nseqs; seq1++)  {
         string seq_name;
         in >> seq_name;
         // assign taxa name to integer id
-        map_seqName_ID[seq_name] = id++;
-        /*
-        if (seq_name != getSeqName(seq1))
-            throw "Sequence name " + seq_name + " is different from " + getSeqName(seq1);
-        for (seq2 = 0; seq2 < nseqs; seq2++) {
-            in >> dist_mat[pos++];
-            if (dist_mat[pos-1] > longest_dist)
-                longest_dist = dist_mat[pos-1];
-        }
-         */
-        for (seq2 = 0; seq2 < nseqs; seq2++) {
-            in >> tmp_dist_mat[pos++];
-            //cout << tmp_dist_mat[pos - 1] << "  ";
-            if (tmp_dist_mat[pos - 1] > longest_dist)
-                longest_dist = tmp_dist_mat[pos - 1];
+        map_seqName_ID[seq_name] = seq1;
+        seq_names.push_back(seq_name);
+        for (size_t seq2 = 0; seq2 < nseqs; seq2++) {
+            double dist;
+            in >> dist;
+            if (dist > longest_dist)
+                longest_dist = dist;
+            if (seq2 == seq1) {
+                if (dist != 0.0)
+                    throw "Diagonal elements of distance matrix is not ZERO";
+            } else if (seq2 > seq1) {
+                tmp_dist_mat.set(seq1, seq2, dist);
+            } else {
+                double stored = tmp_dist_mat.get(seq1, seq2);
+                bool symmetric = (tmp_dist_mat.isSinglePrecision()) ? ((float)dist == (float)stored) : (dist == stored);
+                if (!symmetric)
+                    throw "Distance between " + seq_names[seq2] + " and " + seq_name + " is not symmetric";
+            }
         }
-        //cout << endl;
     }
-    //cout << "Internal distance matrix: " << endl;
     // Now initialize the internal distance matrix, in which the sequence order is the same
     // as in the alignment
-    for (seq1 = 0; seq1 < nseqs; seq1++) {
-        for (seq2 = 0; seq2 < nseqs; seq2++) {
-            string seq1Name = getSeqName(seq1);
-            string seq2Name = getSeqName(seq2);
-            if (map_seqName_ID.count(seq1Name) == 0) {
-                throw "Could not find taxa name " + seq1Name;
-            }
-            if (map_seqName_ID.count(seq2Name) == 0) {
-                throw "Could not find taxa name " + seq2Name;
-            }
-            int seq1_tmp_id = map_seqName_ID[seq1Name];
-            int seq2_tmp_id = map_seqName_ID[seq2Name];
-            dist_mat[seq1 * nseqs + seq2] = tmp_dist_mat[seq1_tmp_id * nseqs + seq2_tmp_id];
-            //cout << dist_mat[seq1 * nseqs + seq2] << "  ";
+    IntVector tmp_id(nseqs);
+    for (size_t seq = 0; seq < nseqs; seq++) {
+        string seq_name = getSeqName(seq);
+        if (map_seqName_ID.count(seq_name) == 0) {
+            throw "Could not find taxa name " + seq_name;
         }
-        //cout << endl;
-    }
-
-    // check for symmetric matrix
-    for (seq1 = 0; seq1 < nseqs-1; seq1++) {
-        if (dist_mat[seq1*nseqs+seq1] != 0.0)
-            throw "Diagonal elements of distance matrix is not ZERO";
-        for (seq2 = seq1+1; seq2 < nseqs; seq2++)
-            if (dist_mat[seq1*nseqs+seq2] != dist_mat[seq2*nseqs+seq1])
-                throw "Distance between " + getSeqName(seq1) + " and " + getSeqName(seq2) + " is not symmetric";
+        tmp_id[seq] = map_seqName_ID[seq_name];
     }
-
-    /*
-    string dist_file = params.out_prefix;
-    dist_file += ".userdist";
-    printDist(dist_file.c_str(), dist_mat);*/
-
-    delete [] tmp_dist_mat;
-
+    dist_mat.extractSubMatrix(tmp_dist_mat, tmp_id);
     return longest_dist;
 }
 
-double Alignment::readDist(const char *file_name, double *dist_mat) {
+double Alignment::readDist(const char *file_name, DistanceMatrix &dist_mat) {
     double longest_dist = 0.0;
 
     try {
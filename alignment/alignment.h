@@ -89,6 +89,11 @@ constexpr int EXCLUDE_GAP   = 1; // exclude gaps
 constexpr int EXCLUDE_INVAR = 2; // exclude invariant sites
 constexpr int EXCLUDE_UNINF = 4; // exclude uninformative sites
 
+class SiteChunkReader;
+struct MappedSegment;
+struct MappedMessage;
+class DistanceMatrix;
+
 /**
 Multiple Sequence Alignment. Stored by a vector of site-patterns
 
@@ -198,6 +203,63 @@ public:
 
     int buildPattern(StrVector &sequences, char *sequence_type, int nseq, int nsite);
 
+    /**
+            convert the sites delivered block by block into site patterns,
+            seq_type and num_states must be set (see initSequenceType)
+            @param reader supplies the sequence characters
+            @param nt2aa true to translate codons into amino acids
+            @param nseq number of sequences
+            @param nsite number of sites
+            @return 1 on success
+     */
+    int buildPatternFromChunks(SiteChunkReader &reader, bool nt2aa, int nseq, int nsite);
+
+    /**
+            check that the first nseq sequence names are non-empty and distinct
+            @param nseq number of sequences
+     */
+    void checkDuplicateSeqNames(int nseq);
+
+    /**
+            set seq_type and num_states from the detected and the user-specified sequence type
+            @param detected_type sequence type detected from the characters
+            @param morph_states number of states if the data are morphological
+            @param sequence_type user-specified sequence type or NULL
+            @return true if nucleotides are to be translated into amino acids (NT2AA)
+     */
+    bool initSequenceType(SeqType detected_type, int morph_states, char *sequence_type);
+
+    /**
+            read a FASTA or interleaved PHYLIP alignment through a read-only memory map,
+            validating the sequences in parallel and building patterns from blocks of sites
+            without holding all sequences as strings
+            @param filename file name
+            @param sequence_type type of the sequence, either "BIN", "DNA", "AA", or NULL
+            @param fasta true for FASTA, false for PHYLIP
+            @return 1 on success, 0 if the file cannot be mapped (e.g. gzip-compressed)
+     */
+    int readMappedAlignment(char *filename, char *sequence_type, bool fasta);
+
+    /**
+            after the parallel scan of a memory-mapped alignment, print the notes and
+            throw the first error in file order, with the per-line sequence length check
+            of readPhylip()
+            @param segments segments (lines) of every sequence
+            @param seg_chars number of characters in every segment
+            @param notes notes of every sequence, freed here
+            @param errors first error of every sequence (pos is SIZE_MAX if none)
+            @param fasta true for FASTA, false for PHYLIP
+     */
+    void replayMappedLines(const vector<vector<MappedSegment> > &segments,
+                           const vector<vector<size_t> > &seg_chars,
+                           vector<vector<MappedMessage> > &notes,
+                           const vector<MappedMessage> &errors, bool fasta);
+
+    /**
+            cut FASTA sequence names at blanks as long as they remain unique
+     */
+    void shortenSeqNames();
+
     /**
             read the alignment in PHYLIP format (interleaved)
             @param filename file name
@@ -285,6 +347,12 @@ public:
      ****************************************************************************/
     SeqType detectSequenceType(StrVector &sequences);
 
+    /**
+            detect the sequence type
+            @param char_count number of occurrences of each character (NUM_CHAR entries)
+     */
+    SeqType detectSequenceType(const size_t *char_count);
+
     void computeUnknownState();
 
     void buildStateMap(char *map, SeqType seq_type);
@@ -504,7 +572,7 @@ public:
             @param aln original input alignment
             @param ptn_freq pattern frequency to extract from
      */
-    void extractPatternFreqs(Alignment *aln, IntVector &ptn_freq);
+    virtual void extractPatternFreqs(Alignment *aln, IntVector &ptn_freq);
 
     /**
             create a non-parametric bootstrap alignment from an input alignment
@@ -643,29 +711,30 @@ public:
             @param file_name distance file name
             @param dist_mat distance matrix
      */
-    void printDist(const char *file_name, double *dist_mat);
+    void printDist(const char *file_name, const DistanceMatrix &dist_mat);
 
     /**
             write distance matrix into a stream in PHYLIP distance format
             @param out output stream
             @param dist_mat distance matrix
      */
-    void printDist(ostream &out, double *dist_mat);
+    void printDist(ostream &out, const DistanceMatrix &dist_mat);
 
     /**
             read distance matrix from a file in PHYLIP distance format
             @param file_name distance file name
-            @param dist_mat distance matrix
+            @param dist_mat (OUT) distance matrix, resized to the number of sequences
             @return the longest distance
      */
-    double readDist(const char *file_name, double *dist_mat);
+    double readDist(const char *file_name, DistanceMatrix &dist_mat);
 
     /**
             read distance matrix from a stream in PHYLIP distance format
             @param in input stream
-            @param dist_mat distance matrix
+            @param dist_mat (OUT) distance matrix, resized to the number of sequences
+            @return the longest distance
      */
-    double readDist(istream &in, double *dist_mat);
+    double readDist(istream &in, DistanceMatrix &dist_mat);
 
 
     /****************************************************************************
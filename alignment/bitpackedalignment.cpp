@@ -0,0 +1,165 @@
+//
+//  bitpackedalignment.cpp
+//  alignment
+//
+//  Sequences packed into bit planes for fast pairwise distances.
+//
+
+#include "bitpackedalignment.h"
+#include "alignment.h"
+#include "utils/hammingdistance.h"
+#include "utils/distancematrix.h"
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+BitPackedAlignment::BitPackedAlignment(Alignment *aln) : aln(aln) {
+    ASSERT(isSupported(aln));
+    nseq = aln->getNSeq();
+    nbits = 1;
+    while ((1 << nbits) < aln->num_states)
+        nbits++;
+    is_dna = (aln->seq_type == SEQ_DNA && aln->num_states == 4);
+
+    // as in Alignment::computeObsDist: constant patterns are skipped
+    // and counted as known sites for every pair
+    const_sites = aln->getNSite() - aln->num_variant_sites;
+    IntVector ptns;
+    for (size_t ptn = 0; ptn < aln->getNPattern(); ptn++)
+        if (!aln->at(ptn).isConst())
+            ptns.push_back(ptn);
+    // ordered by frequency, words of rare patterns need few frequency planes
+    stable_sort(ptns.begin(), ptns.end(), [aln](int a, int b) {
+        return aln->at(a).frequency < aln->at(b).frequency;
+    });
+
+    nword = (ptns.size() + 63) / 64;
+    plane_offset.resize(nword + 1);
+    plane_offset[0] = 0;
+    for (size_t w = 0; w < nword; w++) {
+        int max_freq = 0;
+        for (size_t i = w*64; i < ptns.size() && i < (w+1)*64; i++)
+            max_freq = max(max_freq, aln->at(ptns[i]).frequency);
+        int nplanes = 1;
+        while ((max_freq >> nplanes) != 0)
+            nplanes++;
+        plane_offset[w+1] = plane_offset[w] + nplanes;
+    }
+    weight_planes.resize(plane_offset[nword], 0);
+    for (size_t i = 0; i < ptns.size(); i++) {
+        size_t w = i / 64;
+        uint64_t bit = ((uint64_t)1) << (i % 64);
+        int freq = aln->at(ptns[i]).frequency;
+        for (int plane = 0; plane < plane_offset[w+1] - plane_offset[w]; plane++)
+            if ((freq >> plane) & 1)
+                weight_planes[plane_offset[w] + plane] |= bit;
+    }
+
+    int stride = nbits + 1;
+    packed.resize((size_t)nseq * nword * stride, 0);
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+    for (int seq = 0; seq < nseq; seq++) {
+        uint64_t *words = &packed[(size_t)seq * nword * stride];
+        for (size_t i = 0; i < ptns.size(); i++) {
+            int state = aln->at(ptns[i])[seq];
+            if (state >= aln->num_states)
+                continue;
+            uint64_t *word = words + (i / 64) * stride;
+            uint64_t bit = ((uint64_t)1) << (i % 64);
+            word[0] |= bit;
+            for (int b = 0; b < nbits; b++)
+                if ((state >> b) & 1)
+                    word[b+1] |= bit;
+        }
+    }
+}
+
+bool BitPackedAlignment::isSupported(Alignment *aln) {
+    return !aln->isSuperAlignment() && aln->seq_type != SEQ_POMO && aln->num_states <= 64;
+}
+
+void BitPackedAlignment::countDifferences(int seq1, int seq2, uint64_t &total, uint64_t &diff, uint64_t &transitions) const {
+    size_t seq_words = nword * (nbits + 1);
+    const uint64_t *a = packed.data() + seq1 * seq_words;
+    const uint64_t *b = packed.data() + seq2 * seq_words;
+    const uint64_t *w = weight_planes.data();
+    const int *offset = plane_offset.data();
+    total = diff = transitions = 0;
+    switch (nbits) {
+    case 1:
+        countPackedDifferences<1, false>(a, b, nword, w, offset, total, diff, transitions);
+        break;
+    case 2:
+        if (is_dna)
+            countPackedDifferences<2, true>(a, b, nword, w, offset, total, diff, transitions);
+        else
+            countPackedDifferences<2, false>(a, b, nword, w, offset, total, diff, transitions);
+        break;
+    case 3:
+        countPackedDifferences<3, false>(a, b, nword, w, offset, total, diff, transitions);
+        break;
+    case 4:
+        countPackedDifferences<4, false>(a, b, nword, w, offset, total, diff, transitions);
+        break;
+    case 5:
+        countPackedDifferences<5, false>(a, b, nword, w, offset, total, diff, transitions);
+        break;
+    default:
+        countPackedDifferences<6, false>(a, b, nword, w, offset, total, diff, transitions);
+        break;
+    }
+    total += const_sites;
+}
+
+double BitPackedAlignment::computeDist(int seq1, int seq2, PackedDistanceType type) const {
+    uint64_t total, diff, transitions;
+    countDifferences(seq1, seq2, total, diff, transitions);
+    if (!total)
+        return MAX_GENETIC_DIST; // no overlap between two sequences
+    double obs_dist = ((double)diff) / total;
+    if (type == PACKED_OBS_DIST)
+        return obs_dist;
+    if (type == PACKED_K2P_DIST && is_dna) {
+        double P = ((double)transitions) / total;
+        double Q = ((double)(diff - transitions)) / total;
+        double x1 = 1.0 - 2.0*P - Q;
+        double x2 = 1.0 - 2.0*Q;
+        if (x1 <= 0 || x2 <= 0)
+            return MAX_GENETIC_DIST;
+        return -0.5*log(x1) - 0.25*log(x2);
+    }
+    return aln->computeJCDistanceFromObservedDistance(obs_dist);
+}
+
+double BitPackedAlignment::computeDistMatrix(PackedDistanceType type, DistanceMatrix &dist_mat) const {
+    // two tiles of packed sequences should stay in a 256 KB cache
+    size_t seq_bytes = max((size_t)1, nword * (nbits + 1) * sizeof(uint64_t));
+    int tile = (int)max((size_t)1, min((size_t)256, (((size_t)1) << 17) / seq_bytes));
+    int ntiles = (nseq + tile - 1) / tile;
+    vector<pair<int,int> > tile_pairs;
+    for (int t1 = 0; t1 < ntiles; t1++)
+        for (int t2 = t1; t2 < ntiles; t2++)
+            tile_pairs.push_back(make_pair(t1, t2));
+
+    double longest_dist = 0.0;
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic) reduction(max: longest_dist)
+#endif
+    for (size_t i = 0; i < tile_pairs.size(); i++) {
+        int start1 = tile_pairs[i].first * tile, end1 = min(nseq, start1 + tile);
+        int start2 = tile_pairs[i].second * tile, end2 = min(nseq, start2 + tile);
+        for (int seq1 = start1; seq1 < end1; seq1++) {
+            for (int seq2 = max(start2, seq1 + 1); seq2 < end2; seq2++) {
+                double dist = dist_mat.get(seq1, seq2);
+                if (dist == 0.0) {
+                    dist = computeDist(seq1, seq2, type);
+                    dist_mat.set(seq1, seq2, dist);
+                }
+                longest_dist = max(longest_dist, dist);
+            }
+        }
+    }
+    return longest_dist;
+}
@@ -0,0 +1,99 @@
+//
+//  bitpackedalignment.h
+//  alignment
+//
+//  Sequences packed into bit planes for fast pairwise distances.
+//
+
+#ifndef bitpackedalignment_h
+#define bitpackedalignment_h
+
+#include "utils/tools.h"
+#include <stdint.h>
+
+class Alignment;
+class DistanceMatrix;
+
+/** kinds of model-free distances computed by BitPackedAlignment */
+enum PackedDistanceType {PACKED_OBS_DIST, PACKED_JC_DIST, PACKED_K2P_DIST};
+
+/**
+ * The non-constant patterns of an alignment, with every sequence packed into
+ * 64-pattern words: one mask of known states plus ceil(log2(num_states)) bit planes
+ * (2 for DNA, 5 for protein). Mismatches, and transitions for DNA, between two
+ * sequences are counted with popcounts, weighted by the pattern frequencies
+ * (see countPackedDifferences in utils/hammingdistance.h).
+ * Distances agree with Alignment::computeObsDist and Alignment::computeJCDist.
+ */
+class BitPackedAlignment {
+public:
+    /**
+     * pack the sequences of aln
+     * @param aln the alignment, see isSupported()
+     */
+    BitPackedAlignment(Alignment *aln);
+
+    /**
+     * @return TRUE if aln can be packed: not for super alignments, PoMo, or more than 64 states
+     */
+    static bool isSupported(Alignment *aln);
+
+    /**
+     * count sites of two sequences
+     * @param seq1 ID of the first sequence
+     * @param seq2 ID of the second sequence
+     * @param[out] total number of sites where both states are known, including constant sites
+     * @param[out] diff number of sites with different states
+     * @param[out] transitions number of transitions among diff, only for DNA
+     */
+    void countDifferences(int seq1, int seq2, uint64_t &total, uint64_t &diff, uint64_t &transitions) const;
+
+    /**
+     * @param seq1 ID of the first sequence
+     * @param seq2 ID of the second sequence
+     * @param type distance type, K2P only for DNA
+     * @return distance between seq1 and seq2, MAX_GENETIC_DIST if they do not overlap or are saturated
+     */
+    double computeDist(int seq1, int seq2, PackedDistanceType type) const;
+
+    /**
+     * compute all pairwise distances, in tiles of sequences that share the cache
+     * @param type distance type, K2P only for DNA
+     * @param[in,out] dist_mat distance matrix, only its zero entries are computed
+     * @return the longest distance
+     */
+    double computeDistMatrix(PackedDistanceType type, DistanceMatrix &dist_mat) const;
+
+    /** @return number of 64-pattern words per sequence */
+    size_t getNWord() const { return nword; }
+
+protected:
+    /** the alignment */
+    Alignment *aln;
+
+    /** number of sequences */
+    int nseq;
+
+    /** number of state bit planes */
+    int nbits;
+
+    /** TRUE for DNA with states A, C, G, T, to count transitions */
+    bool is_dna;
+
+    /** number of 64-pattern words per sequence */
+    size_t nword;
+
+    /** sites not packed (constant sites), counted as known for every pair */
+    uint64_t const_sites;
+
+    /** packed sequences, nword*(nbits+1) words per sequence */
+    vector<uint64_t> packed;
+
+    /** frequency bit planes of every word, those of word w start at weight_planes[plane_offset[w]] */
+    vector<uint64_t> weight_planes;
+
+    /** offset of the frequency planes of every word, nword+1 entries */
+    IntVector plane_offset;
+};
+
+#endif /* bitpackedalignment_h */
@@ -19,6 +19,7 @@
  ***************************************************************************/
 
 #include <stdarg.h>
+#include <numeric>
 #include "superalignment.h"
 #include "nclextra/msetsblock.h"
 #include "nclextra/myreader.h"
@@ -845,6 +846,39 @@ void SuperAlignment::extractSubAlignment(Alignment *aln, IntVector &seq_id, int
 	buildPattern();
 }
 
+void SuperAlignment::extractPatternFreqs(Alignment *aln, IntVector &ptn_freq) {
+    ASSERT(aln->isSuperAlignment());
+    SuperAlignment *saln = (SuperAlignment*)aln;
+    ASSERT(partitions.empty());
+    name = aln->name;
+    model_name = aln->model_name;
+    sequence_type = aln->sequence_type;
+    position_spec = aln->position_spec;
+    aln_file = aln->aln_file;
+
+    size_t offset = 0;
+    for (auto it = saln->partitions.begin(); it != saln->partitions.end(); it++) {
+        size_t nptn = (*it)->getNPattern();
+        ASSERT(offset + nptn <= ptn_freq.size());
+        IntVector part_ptn_freq(ptn_freq.begin() + offset, ptn_freq.begin() + offset + nptn);
+        offset += nptn;
+        // a partition not resampled at all, e.g. by gene resampling
+        if (accumulate(part_ptn_freq.begin(), part_ptn_freq.end(), 0) == 0)
+            continue;
+        Alignment *part_aln = new Alignment;
+        part_aln->extractPatternFreqs(*it, part_ptn_freq);
+        partitions.push_back(part_aln);
+    }
+
+    if (partitions.size() == saln->partitions.size()) {
+        // same partitions, as createBootstrapAlignment resampling sites within genes
+        Alignment::copyAlignment(aln);
+        taxa_index = saln->taxa_index;
+        countConstSite();
+    } else
+        init();
+}
+
 SuperAlignment *SuperAlignment::extractPartitions(IntVector &part_id) {
     SuperAlignment *newaln = new SuperAlignment;
     newaln->name = name;
@@ -146,6 +146,14 @@ public:
      */
     virtual void extractSubAlignment(Alignment *aln, IntVector &seq_id, int min_true_char, int min_taxa = 0, IntVector *kept_partitions = NULL);
 
+    /**
+            extract a sub-set of patterns of every partition
+            @param aln original input super alignment
+            @param ptn_freq pattern frequency to extract from, the partitions one after another
+                   as in SuperAlignment::getPatternFreq; partitions with zero frequencies are left out
+     */
+    virtual void extractPatternFreqs(Alignment *aln, IntVector &ptn_freq);
+
     /**
         extract a subset of partitions to form a new SuperAlignment object
         @param part_id vector of partition IDs
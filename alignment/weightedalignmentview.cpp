@@ -0,0 +1,65 @@
+//
+//  weightedalignmentview.cpp
+//  alignment
+//
+//  Pattern weights over a shared alignment, e.g. for bootstrap replicates.
+//
+
+#include "weightedalignmentview.h"
+#include "alignment.h"
+
+WeightedAlignmentView::WeightedAlignmentView(Alignment *aln) : aln(aln) {
+    ASSERT(isSupported(aln));
+    weights.resize(aln->getNPattern());
+    for (size_t ptn = 0; ptn < weights.size(); ptn++)
+        weights[ptn] = aln->at(ptn).frequency;
+}
+
+bool WeightedAlignmentView::isSupported(Alignment *aln) {
+    return !aln->isSuperAlignment() && aln->seq_type != SEQ_POMO && aln->site_state_freq.empty();
+}
+
+void WeightedAlignmentView::createBootstrapWeights(const char *spec, int *rstream) {
+    weights.resize(aln->getNPattern());
+    aln->createBootstrapAlignment(weights.data(), spec, rstream);
+}
+
+void WeightedAlignmentView::setWeights(const IntVector &new_weights) {
+    ASSERT(new_weights.size() >= aln->getNPattern());
+    weights.assign(new_weights.begin(), new_weights.begin() + aln->getNPattern());
+}
+
+size_t WeightedAlignmentView::getNSite() const {
+    size_t nsite = 0;
+    for (auto w : weights)
+        nsite += w;
+    return nsite;
+}
+
+size_t WeightedAlignmentView::getNZeroWeight() const {
+    return count(weights.begin(), weights.end(), 0);
+}
+
+bool WeightedAlignmentView::isDense() const {
+    return getNZeroWeight() <= MAX_VIEW_ZERO_WEIGHTS * weights.size();
+}
+
+Alignment *WeightedAlignmentView::createAlignment() const {
+    Alignment *new_aln = new Alignment;
+    IntVector ptn_freq = weights;
+    new_aln->extractPatternFreqs(aln, ptn_freq);
+    return new_aln;
+}
+
+double WeightedAlignmentView::multinomialProb() const {
+    size_t nsite = getNSite();
+    ASSERT(nsite == aln->getNSite());
+    double sum_fac = 0.0, sum_prob = 0.0;
+    for (size_t ptn = 0; ptn < weights.size(); ptn++) {
+        if (weights[ptn] == 0)
+            continue;
+        sum_fac += logFac(weights[ptn]);
+        sum_prob += (double)weights[ptn] * log((double)aln->at(ptn).frequency / (double)nsite);
+    }
+    return logFac(nsite) - sum_fac + sum_prob;
+}
@@ -0,0 +1,92 @@
+//
+//  weightedalignmentview.h
+//  alignment
+//
+//  Pattern weights over a shared alignment, e.g. for bootstrap replicates.
+//
+
+#ifndef weightedalignmentview_h
+#define weightedalignmentview_h
+
+#include "utils/tools.h"
+
+class Alignment;
+
+/**
+ * largest fraction of zero-weight patterns for which a tree should run on the view
+ * rather than on a compacted copy: likelihood kernels process SIMD blocks of the
+ * shared pattern table, so zero-weight patterns are computed along with the others.
+ * A pattern of frequency f is left out of a resample with probability about exp(-f),
+ * so views are used for alignments whose patterns mostly occur several times.
+ * Resamples of mostly unique patterns (about 37% zero weights) are compacted.
+ */
+const double MAX_VIEW_ZERO_WEIGHTS = 0.1;
+
+/**
+ * Integer pattern weights over a parent alignment. The view owns only the weight
+ * vector; sequences and patterns stay with the parent. A PhyloTree on the parent
+ * uses the weights as ptn_freq (see PhyloTree::setAlignmentView), so a bootstrap
+ * replicate needs no Alignment of its own.
+ */
+class WeightedAlignmentView {
+public:
+    /**
+     * @param aln parent alignment, weights are initialized to its pattern frequencies
+     */
+    WeightedAlignmentView(Alignment *aln);
+
+    /**
+     * @return TRUE if views can be made of aln; not for super alignments, PoMo, or
+     * site-specific state frequencies, which createAlignment() cannot copy
+     */
+    static bool isSupported(Alignment *aln);
+
+    /**
+     * resample weights by a non-parametric bootstrap of the parent
+     * @param spec bootstrap specification, see Alignment::createBootstrapAlignment
+     * @param rstream random generator stream, NULL to use the global randstream
+     */
+    void createBootstrapWeights(const char *spec = NULL, int *rstream = NULL);
+
+    /**
+     * @param new_weights one weight per pattern of the parent
+     */
+    void setWeights(const IntVector &new_weights);
+
+    /** @return parent alignment */
+    Alignment *getAlignment() const { return aln; }
+
+    /** @return weight per pattern of the parent */
+    const IntVector &getWeights() const { return weights; }
+
+    /** @return number of sites, i.e. sum of weights */
+    size_t getNSite() const;
+
+    /** @return number of patterns with zero weight */
+    size_t getNZeroWeight() const;
+
+    /**
+     * @return TRUE if at most MAX_VIEW_ZERO_WEIGHTS of the patterns have zero weight,
+     * i.e. a tree can run on the view without wasting much kernel time
+     */
+    bool isDense() const;
+
+    /**
+     * @return a new alignment with only the patterns of non-zero weight,
+     * e.g. to print the replicate or when the view is not dense
+     */
+    Alignment *createAlignment() const;
+
+    /**
+     * @return log-probability of the weights given the multinomial distribution
+     * of the parent pattern frequencies, see Alignment::multinomialProb
+     */
+    double multinomialProb() const;
+
+private:
+    Alignment *aln;
+
+    IntVector weights;
+};
+
+#endif /* weightedalignmentview_h */
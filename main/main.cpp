@@ -2354,8 +2354,19 @@ int main(int argc, char *argv[]) {
 
     // 2015-12-05
     Checkpoint *checkpoint = new Checkpoint;
-    string filename = (string)Params::getInstance().out_prefix +".ckp.gz";
+    string filename = (string)Params::getInstance().out_prefix +
+        (Params::getInstance().checkpoint_binary ? ".ckp.bin" : ".ckp.gz");
+    string other_filename = (string)Params::getInstance().out_prefix +
+        (Params::getInstance().checkpoint_binary ? ".ckp.gz" : ".ckp.bin");
+    // resume from the checkpoint file of a previous run with or without --ckp-binary
+    if (!Params::getInstance().ignore_checkpoint && !fileExists(filename) && fileExists(other_filename)) {
+        filename = other_filename;
+        Params::getInstance().checkpoint_binary = !Params::getInstance().checkpoint_binary;
+        if (MPIHelper::getInstance().isMaster())
+            cout << "NOTE: Resume from checkpoint file " << filename << endl;
+    }
     checkpoint->setFileName(filename);
+    checkpoint->setBinary(Params::getInstance().checkpoint_binary);
     
     bool append_log = false;
     
@@ -2492,6 +2503,10 @@ int main(int argc, char *argv[]) {
         cout << "Safe ";
     }
 
+    if (Params::getInstance().lk_float_storage) {
+        cout << "Float ";
+    }
+
     if (Params::getInstance().pll) {
 #ifdef __AVX__
         cout << "PLL-AVX";
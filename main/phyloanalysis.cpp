@@ -1639,30 +1639,26 @@ void computeMLDist ( Params& params, IQTree& iqtree
                    , double begin_wallclock_time, double begin_cpu_time) {
     double longest_dist;
     cout << "Computing ML distances based on estimated model parameters..." << endl;
-    double *ml_dist = nullptr;
-    double *ml_var  = nullptr;
+    DistanceMatrix *ml_dist = nullptr;
+    DistanceMatrix *ml_var  = nullptr;
     iqtree.decideDistanceFilePath(params);
     longest_dist = iqtree.computeDist(params, iqtree.aln, ml_dist, ml_var);
     cout << "Computing ML distances took "
         << (getRealTime() - begin_wallclock_time) << " sec (of wall-clock time) "
         << (getCPUTime() - begin_cpu_time) << " sec (of CPU time)" << endl;
-    size_t n = iqtree.aln->getNSeq();
-    size_t nSquared = n*n;
     if ( iqtree.dist_matrix == nullptr ) {
         iqtree.dist_matrix = ml_dist;
         ml_dist = nullptr;
     } else {
-        memmove(iqtree.dist_matrix, ml_dist,
-                sizeof(double) * nSquared);
-        delete[] ml_dist;
+        iqtree.dist_matrix->swap(*ml_dist);
+        delete ml_dist;
     }
     if ( iqtree.var_matrix == nullptr ) {
         iqtree.var_matrix = ml_var;
         ml_var = nullptr;
-    } else {
-        memmove(iqtree.var_matrix, ml_var,
-                sizeof(double) * nSquared);
-        delete[] ml_var;
+    } else if ( ml_var != nullptr ) {
+        iqtree.var_matrix->swap(*ml_var);
+        delete ml_var;
     }
     if (!params.dist_file)
     {
@@ -1682,6 +1678,8 @@ void computeInitialDist(Params &params, IQTree &iqtree) {
     double longest_dist;
     if (params.dist_file) {
         cout << "Reading distance matrix file " << params.dist_file << " ..." << endl;
+    } else if (params.compute_k2p_dist && params.packed_dist && !params.compute_obs_dist && iqtree.aln->seq_type == SEQ_DNA) {
+        cout << "Computing Kimura 2-parameter distances..." << endl;
     } else if (params.compute_jc_dist) {
         cout << "Computing Jukes-Cantor distances..." << endl;
     } else if (params.compute_obs_dist) {
@@ -1775,11 +1773,11 @@ void pruneTaxa(Params &params, IQTree &iqtree, double *pattern_lh, NodeVector &p
 
 }
 
-void restoreTaxa(IQTree &iqtree, double *saved_dist_mat, NodeVector &pruned_taxa, StrVector &linked_name) {
+void restoreTaxa(IQTree &iqtree, DistanceMatrix *saved_dist_mat, NodeVector &pruned_taxa, StrVector &linked_name) {
     if (!pruned_taxa.empty()) {
         cout << "Restoring full tree..." << endl;
         iqtree.restoreStableClade(iqtree.aln, pruned_taxa, linked_name);
-        delete[] iqtree.dist_matrix;
+        delete iqtree.dist_matrix;
         iqtree.dist_matrix = saved_dist_mat;
         iqtree.initializeAllPartialLh();
         iqtree.clearAllPartialLH();
@@ -2496,7 +2494,7 @@ void runTreeReconstruction(Params &params, IQTree* &iqtree) {
     }
     NodeVector pruned_taxa;
     StrVector linked_name;
-    double *saved_dist_mat = iqtree->dist_matrix;
+    DistanceMatrix *saved_dist_mat = iqtree->dist_matrix;
     double *pattern_lh = new double[iqtree->getAlnNPattern()];
 
     // prune stable taxa
@@ -3073,6 +3071,364 @@ void exhaustiveSearchGAMMAInvar(Params &params, IQTree &iqtree) {
 /**********************************************************
  * STANDARD NON-PARAMETRIC BOOTSTRAP
  ***********************************************************/
+
+/** steps of a bootstrap replicate run by runParallelBootstrap */
+enum BootStep {BOOT_INIT, BOOT_SEARCH, BOOT_FINAL};
+
+/**
+    one standard bootstrap replicate run concurrently with others: a tree on the
+    original alignment holding only the resampled pattern frequencies
+ */
+struct BootReplicate {
+    int sample;
+    IQTree *tree;
+    /** resampled pattern weights, or NULL if the replicate has its own alignment */
+    WeightedAlignmentView *view;
+    /** the resampled sites of view for the parsimony kernel, which ignores ptn_freq;
+        NULL once the initial trees are built or if there is no view */
+    Alignment *pars_aln;
+    Checkpoint *checkpoint;
+    /** random stream of this replicate, so that its trees do not depend on the others */
+    int *rstream;
+    BootStep step;
+    string tree_string;
+    double score;
+    double best_score;
+    /** trees and log-likelihoods of the NNI searches from the initial candidate trees */
+    StrVector init_trees;
+    DoubleVector init_scores;
+};
+
+/**
+    @return TRUE if runStandardBootstrap can run replicates concurrently with the given options
+ */
+bool isParallelBootstrapSupported(Params &params, Alignment *alignment) {
+#ifdef _OPENMP
+    return WeightedAlignmentView::isSupported(alignment) && params.num_mixlen == 1 &&
+        posRateHeterotachy(alignment->model_name) == string::npos &&
+        !params.pll && params.lh_mem_save != LM_MEM_SAVE && params.snni && !params.iqp &&
+        !params.fixStableSplits && !params.adaptPertubation && !params.tabu &&
+        params.iqp_assess_quartet != IQP_BOOTSTRAP &&
+        !params.print_bootaln && !params.print_boot_site_freq && !params.print_tree_lh &&
+        !params.write_intermediate_trees && !params.writeDistImdTrees &&
+        params.num_bootstrap_samples > 1 && MPIHelper::getInstance().getNumProcesses() == 1;
+#else
+    return false;
+#endif
+}
+
+/**
+    build a parsimony tree of the resampled sites of a bootstrap replicate
+    @param pars_tree tree set up for parsimony, reused between calls
+    @param rstream random stream of the replicate
+    @return tree string
+ */
+string computeBootParsimonyTree(PhyloTree &pars_tree, BootReplicate &rep, int *rstream) {
+    Alignment *pars_aln = rep.pars_aln ? rep.pars_aln : rep.tree->aln;
+    if (pars_aln->ordered_pattern.empty())
+        pars_aln->orderPatternByNumChars(PAT_VARIANT);
+    pars_tree.computeParsimonyTree(NULL, pars_aln, rstream);
+    return pars_tree.getTreeString();
+}
+
+/**
+    set up a tree to build parsimony trees for a bootstrap replicate, as IQTree::initCandidateTreeSet does
+ */
+void initBootParsimonyTree(Params &params, IQTree *boot_tree, PhyloTree &pars_tree) {
+    if (!boot_tree->constraintTree.empty()) {
+        pars_tree.constraintTree.readConstraint(boot_tree->constraintTree);
+    }
+    pars_tree.setParams(&params);
+    pars_tree.setParsimonyKernel(params.SSE);
+    pars_tree.rooted = boot_tree->rooted;
+}
+
+/**
+    create a bootstrap replicate: resample pattern weights and build a parsimony starting
+    tree of the resampled sites with the random seed of the sample, then initialize the model.
+    The replicate runs on a view of alignment unless many patterns are not sampled, see
+    WeightedAlignmentView::isDense; parsimony then runs on a copy of the resampled sites
+ */
+void initBootReplicate(Params &params, Alignment *alignment, IQTree *tree, ModelsBlock *models_block,
+                       int num_threads, BootReplicate &rep)
+{
+    cout << "Creating " << RESAMPLE_NAME << " replicate " << rep.sample + 1
+         << " (seed: " << params.ran_seed + rep.sample << ")..." << endl;
+    init_random(params.ran_seed + rep.sample, false, &rep.rstream);
+    int *saved_randstream = randstream;
+    randstream = rep.rstream;
+
+    rep.view = new WeightedAlignmentView(alignment);
+    rep.view->createBootstrapWeights(params.bootstrap_spec);
+    Alignment *boot_aln = alignment;
+    rep.pars_aln = NULL;
+    if (!rep.view->isDense()) {
+        boot_aln = rep.view->createAlignment();
+        delete rep.view;
+        rep.view = NULL;
+    } else {
+        rep.pars_aln = rep.view->createAlignment();
+    }
+
+    IQTree *boot_tree = new IQTree(boot_aln);
+    rep.tree = boot_tree;
+    rep.checkpoint = new Checkpoint;
+    boot_tree->setCheckpoint(rep.checkpoint);
+    boot_tree->setParams(&params);
+    if (!tree->constraintTree.empty()) {
+        boot_tree->constraintTree.readConstraint(tree->constraintTree);
+    }
+    boot_tree->num_precision = tree->num_precision;
+
+    if (params.user_file) {
+        bool myrooted = params.is_rooted;
+        boot_tree->readTree(params.user_file, myrooted);
+        boot_tree->setAlignment(boot_aln);
+        boot_tree->wrapperFixNegativeBranch(false);
+    } else {
+        PhyloTree pars_tree;
+        initBootParsimonyTree(params, boot_tree, pars_tree);
+        boot_tree->PhyloTree::readTreeString(computeBootParsimonyTree(pars_tree, rep, randstream));
+    }
+    randstream = saved_randstream;
+
+    boot_tree->initSettings(params);
+    boot_tree->setNumThreads(num_threads);
+    boot_tree->setAlignmentView(rep.view);
+    boot_tree->initializeModel(params, boot_aln->model_name, models_block);
+    boot_tree->initializeAllPartialLh();
+    rep.step = BOOT_INIT;
+    rep.score = rep.best_score = -DBL_MAX;
+}
+
+/**
+    free a bootstrap replicate created by initBootReplicate
+ */
+void deleteBootReplicate(Alignment *alignment, BootReplicate &rep) {
+    Alignment *boot_aln = rep.tree->aln;
+    delete rep.tree;
+    if (boot_aln != alignment)
+        delete boot_aln;
+    delete rep.pars_aln;
+    delete rep.view;
+    delete rep.checkpoint;
+    finish_random(rep.rstream);
+    rep.tree = NULL;
+}
+
+/**
+    build the initial candidate trees of a bootstrap replicate as IQTree::initCandidateTreeSet
+    does: parsimony trees of the resampled sites up to params.numInitTrees, their branch
+    lengths optimized, then an NNI search from the params.numNNITrees best ones. Duplicated
+    parsimony trees are dropped rather than randomized, as this runs concurrently with other
+    replicates and cannot use the global random stream. The NNI trees are left in
+    rep.init_trees, for the caller to add to the candidate set.
+ */
+void initBootCandidateSet(Params &params, BootReplicate &rep) {
+    IQTree *boot_tree = rep.tree;
+    CandidateSet &candidates = boot_tree->candidateTrees;
+    candidates.update(boot_tree->getTreeString(), boot_tree->getCurScore());
+    int init_size = candidates.size();
+    int num_pars_trees = params.numInitTrees - init_size;
+    if (num_pars_trees > 0) {
+        PhyloTree pars_tree;
+        initBootParsimonyTree(params, boot_tree, pars_tree);
+        for (int i = 0; i < num_pars_trees; i++)
+            candidates.update(computeBootParsimonyTree(pars_tree, rep, rep.rstream), -DBL_MAX);
+    }
+    delete rep.pars_aln;
+    rep.pars_aln = NULL;
+
+    // log-likelihoods of all initial trees
+    StrVector init_trees = candidates.getBestTreeStrings();
+    candidates.clear();
+    for (int i = 0; i < init_trees.size(); i++) {
+        boot_tree->readTreeString(init_trees[i]);
+        string tree_string;
+        if (i < init_size) {
+            boot_tree->computeLogL();
+            tree_string = boot_tree->getTreeString();
+        } else
+            tree_string = boot_tree->optimizeBranches(params.brlen_num_traversal);
+        candidates.update(tree_string, boot_tree->getCurScore());
+    }
+
+    // NNI search from the best initial trees
+    rep.best_score = candidates.getBestScore();
+    init_trees = candidates.getBestTreeStrings(params.numNNITrees);
+    if (candidates.size() > params.numSupportTrees)
+        candidates.clear();
+    candidates.setMaxSize(params.numSupportTrees);
+    for (auto it = init_trees.begin(); it != init_trees.end(); it++) {
+        boot_tree->readTreeString(*it);
+        boot_tree->computeLogL();
+        boot_tree->optimizeNNIAndLazySPR();
+        // re-optimize the model on a better tree, as doNNISearch does
+        if (boot_tree->getCurScore() > rep.best_score + params.modelEps)
+            boot_tree->optimizeModelParameters(false, params.modelEps * 10);
+        rep.best_score = max(rep.best_score, boot_tree->getCurScore());
+        rep.init_trees.push_back(boot_tree->getTreeString());
+        rep.init_scores.push_back(boot_tree->getCurScore());
+    }
+}
+
+/**
+    run the next step of a bootstrap replicate in the calling thread, see runParallelBootstrap
+ */
+void runBootReplicateStep(Params &params, BootReplicate &rep) {
+    IQTree *boot_tree = rep.tree;
+    if (rep.step == BOOT_FINAL)
+        boot_tree->readTreeString(boot_tree->getBestTrees()[0]);
+    boot_tree->initializeAllPartialLh();
+    boot_tree->clearAllPartialLH();
+    switch (rep.step) {
+    case BOOT_INIT:
+        boot_tree->optimizeModelParameters(false, params.min_iterations == 0 ? params.modelEps : (params.modelEps*10));
+        if (params.min_iterations > 0)
+            initBootCandidateSet(params, rep);
+        break;
+    case BOOT_SEARCH:
+        boot_tree->computeLogL();
+        boot_tree->optimizeNNIAndLazySPR();
+        // re-optimize the model on a better tree, as doNNISearch does
+        if (boot_tree->getCurScore() > rep.best_score + params.modelEps)
+            boot_tree->optimizeModelParameters(false, params.modelEps * 10);
+        break;
+    case BOOT_FINAL:
+        if (params.final_model_opt && params.min_iterations)
+            boot_tree->optimizeModelParameters(false);
+        else
+            boot_tree->setCurScore(boot_tree->computeLikelihood());
+        break;
+    }
+    rep.tree_string = boot_tree->getTreeString();
+    rep.score = boot_tree->getCurScore();
+}
+
+/**
+    run the remaining standard bootstrap replicates, up to params.num_parallel_boot at a time.
+    Replicates share the original alignment and each holds only its pattern weights.
+    They advance in rounds: random perturbations are done on the main thread with the random
+    stream of each replicate, then one NNI search per replicate runs in parallel with a slice
+    of the threads. Each finished tree is checkpointed as it comes; the .boottrees file
+    receives the trees in sample order.
+    @param first_replicate first replicate created by the caller to check the model, or NULL
+    @param[in,out] bootSample number of replicates written to boottrees_name
+ */
+void runParallelBootstrap(Params &params, Alignment *alignment, IQTree *tree, ModelsBlock *models_block,
+                          BootReplicate *first_replicate, int num_parallel, int num_threads,
+                          string &boottrees_name, int &bootSample)
+{
+#ifdef _OPENMP
+    Checkpoint *checkpoint = tree->getCheckpoint();
+    int rep_threads = max(1, num_threads / num_parallel);
+    cout << "Running " << num_parallel << " " << RESAMPLE_NAME << " replicates concurrently with "
+         << rep_threads << " thread(s) each" << endl;
+
+    vector<BootReplicate> reps;
+    if (first_replicate)
+        reps.push_back(*first_replicate);
+    map<int, string> done_trees;
+    int next_sample = first_replicate ? first_replicate->sample + 1 : bootSample;
+
+    while (true) {
+        // fill free slots with new replicates unless already checkpointed
+        while (reps.size() < num_parallel && next_sample < params.num_bootstrap_samples) {
+            string boot_tree;
+            if (checkpoint->getString("bootTree" + convertIntToString(next_sample), boot_tree)) {
+                cout << "CHECKPOINT: " << RESAMPLE_NAME << " replicate " << next_sample + 1 << " restored" << endl;
+                done_trees[next_sample++] = boot_tree;
+                continue;
+            }
+            BootReplicate rep;
+            rep.sample = next_sample++;
+            initBootReplicate(params, alignment, tree, models_block, rep_threads, rep);
+            reps.push_back(rep);
+        }
+        if (reps.empty())
+            break;
+
+        // perturbation uses the global random stream, so it is done sequentially
+        int *saved_randstream = randstream;
+        for (auto rep = reps.begin(); rep != reps.end(); rep++) {
+            if (rep->step != BOOT_SEARCH)
+                continue;
+            randstream = rep->rstream;
+            rep->best_score = rep->tree->candidateTrees.getBestScore();
+            rep->tree->readTreeString(rep->tree->candidateTrees.getRandTopTree(params.popSize));
+            rep->tree->doRandomNNIs();
+        }
+        randstream = saved_randstream;
+
+        bool nested = rep_threads > 1 && reps.size() > 1;
+        if (nested)
+            omp_set_nested(true);
+#pragma omp parallel for schedule(dynamic) num_threads(reps.size())
+        for (int i = 0; i < reps.size(); i++)
+            runBootReplicateStep(params, reps[i]);
+        if (nested)
+            omp_set_nested(false);
+
+        bool finished_reps = false;
+        for (auto rep = reps.begin(); rep != reps.end(); rep++) {
+            IQTree *boot_tree = rep->tree;
+            switch (rep->step) {
+            case BOOT_INIT:
+                if (rep->init_trees.empty())
+                    boot_tree->addTreeToCandidateSet(rep->tree_string, rep->score, false, MPIHelper::getInstance().getProcessID());
+                for (int i = 0; i < rep->init_trees.size(); i++)
+                    boot_tree->addTreeToCandidateSet(rep->init_trees[i], rep->init_scores[i], true, MPIHelper::getInstance().getProcessID());
+                rep->init_trees.clear();
+                rep->init_scores.clear();
+                rep->step = BOOT_SEARCH;
+                break;
+            case BOOT_SEARCH:
+                boot_tree->addTreeToCandidateSet(rep->tree_string, rep->score, true, MPIHelper::getInstance().getProcessID());
+                break;
+            case BOOT_FINAL: {
+                boot_tree->setRootNode(params.root);
+                stringstream ss;
+                boot_tree->printTree(ss);
+                done_trees[rep->sample] = ss.str();
+                checkpoint->put("bootTree" + convertIntToString(rep->sample), ss.str());
+                cout << RESAMPLE_NAME_I << " replicate " << rep->sample + 1 << " finished, log-likelihood: "
+                     << rep->score << endl;
+                deleteBootReplicate(alignment, *rep);
+                finished_reps = true;
+                break;
+            }
+            }
+            if (rep->step == BOOT_SEARCH &&
+                (params.min_iterations == 0 || boot_tree->stop_rule.meetStopCondition(boot_tree->stop_rule.getCurIt(), 0.0)))
+                rep->step = BOOT_FINAL;
+        }
+        if (!finished_reps)
+            continue;
+        reps.erase(remove_if(reps.begin(), reps.end(), [](BootReplicate &rep) {return rep.tree == NULL;}), reps.end());
+
+        // write trees of consecutive finished replicates
+        try {
+            ofstream tree_out;
+            tree_out.exceptions(ios::failbit | ios::badbit);
+            tree_out.open(boottrees_name.c_str(), ios_base::out | ios_base::app);
+            for (auto it = done_trees.find(bootSample); it != done_trees.end(); it = done_trees.find(bootSample)) {
+                tree_out << it->second << endl;
+                checkpoint->erase("bootTree" + convertIntToString(bootSample));
+                done_trees.erase(it);
+                bootSample++;
+            }
+            tree_out.close();
+        } catch (ios::failure) {
+            outError(ERR_WRITE_OUTPUT, boottrees_name);
+        }
+        checkpoint->put("bootSample", bootSample);
+        checkpoint->putBool("finished", false);
+        checkpoint->dump(true);
+    }
+    ASSERT(bootSample == params.num_bootstrap_samples);
+#endif
+}
+
 void runStandardBootstrap(Params &params, Alignment *alignment, IQTree *tree) {
     ModelCheckpoint *model_info = new ModelCheckpoint;
     StrVector removed_seqs, twin_seqs;
@@ -3131,6 +3487,32 @@ void runStandardBootstrap(Params &params, Alignment *alignment, IQTree *tree) {
     // 2018-06-21: bug fix: alignment might be changed by -m ...MERGE
     alignment = tree->aln;
     
+    // concurrent replicates, if the model of the first one allows per-thread trees
+    if (params.num_parallel_boot > 1 && bootSample < params.num_bootstrap_samples) {
+        int num_threads = max(tree->num_threads, params.num_threads);
+        if (num_threads < 1)
+            num_threads = countPhysicalCPUCores();
+        int num_parallel = min(params.num_parallel_boot, num_threads);
+        if (!isParallelBootstrapSupported(params, alignment)) {
+            outWarning("Concurrent " + string(RESAMPLE_NAME) + " replicates are not supported with the given options, running one at a time");
+        } else if (num_parallel < 2) {
+            outWarning("Concurrent " + string(RESAMPLE_NAME) + " replicates need more than one thread (option -nt)");
+        } else {
+            ModelsBlock *models_block = readModelsDefinition(params);
+            BootReplicate first_rep;
+            first_rep.sample = bootSample;
+            initBootReplicate(params, alignment, tree, models_block, max(1, num_threads / num_parallel), first_rep);
+            if (first_rep.tree->isThreadTreeSupported() && !first_rep.tree->rooted) {
+                runParallelBootstrap(params, alignment, tree, models_block, &first_rep,
+                                     num_parallel, num_threads, boottrees_name, bootSample);
+            } else {
+                outWarning("Concurrent " + string(RESAMPLE_NAME) + " replicates are not supported with this model, running one at a time");
+                deleteBootReplicate(alignment, first_rep);
+            }
+            delete models_block;
+        }
+    }
+
     // do bootstrap analysis
     for (int sample = bootSample; sample < params.num_bootstrap_samples; sample++) {
         cout << endl << "===> START " << RESAMPLE_NAME_UPPER << " REPLICATE NUMBER "
@@ -3142,13 +3524,28 @@ void runStandardBootstrap(Params &params, Alignment *alignment, IQTree *tree) {
         init_random(params.ran_seed + sample);
 
         Alignment* bootstrap_alignment;
+        WeightedAlignmentView *bootstrap_view = NULL;
         cout << "Creating " << RESAMPLE_NAME << " alignment (seed: " << params.ran_seed+sample << ")..." << endl;
 
-        if (alignment->isSuperAlignment())
+        if (alignment->isSuperAlignment()) {
             bootstrap_alignment = new SuperAlignment;
-        else
+            bootstrap_alignment->createBootstrapAlignment(alignment, NULL, params.bootstrap_spec);
+        } else if (WeightedAlignmentView::isSupported(alignment)) {
+            // the replicate runs on the original alignment if few patterns are left out
+            bootstrap_view = new WeightedAlignmentView(alignment);
+            bootstrap_view->createBootstrapWeights(params.bootstrap_spec);
+            if (bootstrap_view->isDense() && !params.pll && !params.iqp && !params.leastSquareBranch &&
+                !params.print_bootaln && !params.print_boot_site_freq && params.num_bootstrap_samples > 1) {
+                bootstrap_alignment = alignment;
+            } else {
+                bootstrap_alignment = bootstrap_view->createAlignment();
+                delete bootstrap_view;
+                bootstrap_view = NULL;
+            }
+        } else {
             bootstrap_alignment = new Alignment;
-        bootstrap_alignment->createBootstrapAlignment(alignment, NULL, params.bootstrap_spec);
+            bootstrap_alignment->createBootstrapAlignment(alignment, NULL, params.bootstrap_spec);
+        }
 
         // restore randstream
         finish_random();
@@ -3156,7 +3553,10 @@ void runStandardBootstrap(Params &params, Alignment *alignment, IQTree *tree) {
 
         if (params.print_tree_lh && MPIHelper::getInstance().isMaster()) {
             double prob;
-            bootstrap_alignment->multinomialProb(*alignment, prob);
+            if (bootstrap_view)
+                prob = bootstrap_view->multinomialProb();
+            else
+                bootstrap_alignment->multinomialProb(*alignment, prob);
             ofstream boot_lh;
             if (sample == 0)
                 boot_lh.open(bootlh_name.c_str());
@@ -3182,6 +3582,7 @@ void runStandardBootstrap(Params &params, Alignment *alignment, IQTree *tree) {
                 boot_tree = new PhyloTreeMixlen(bootstrap_alignment, 0);
             } else
                 boot_tree = new IQTree(bootstrap_alignment);
+            boot_tree->setAlignmentView(bootstrap_view);
         }
         if (params.print_bootaln && MPIHelper::getInstance().isMaster()) {
             bootstrap_alignment->printAlignment(params.aln_output_format, bootaln_name.c_str(), true);
@@ -3235,7 +3636,9 @@ void runStandardBootstrap(Params &params, Alignment *alignment, IQTree *tree) {
         bootstrap_alignment = boot_tree->aln;
         delete boot_tree;
         // fix bug: bootstrap_alignment might be changed
-        delete bootstrap_alignment;
+        if (bootstrap_alignment != alignment)
+            delete bootstrap_alignment;
+        delete bootstrap_view;
 
         // clear all checkpointed information
         tree->getCheckpoint()->keepKeyPrefix("iqtree");
@@ -582,7 +582,7 @@ string computeFastMLTree(Params &params, Alignment *aln,
     }
 
     iqtree->getModelFactory()->restoreCheckpoint();
-    iqtree->ensureNumberOfThreadsIsSet(nullptr);
+    num_threads = iqtree->ensureNumberOfThreadsIsSet(nullptr);
     iqtree->initializeAllPartialLh();
     double saved_modelEps = params.modelEps;
     params.modelEps = params.modelfinder_eps;
@@ -740,8 +740,8 @@ void runModelFinder(Params &params, IQTree &iqtree, ModelCheckpoint &model_info)
     // Model already specifed, nothing to do here
     if (!empty_model_found && params.model_name.substr(0, 4) != "TEST" && params.model_name.substr(0, 2) != "MF")
         return;
-    if (MPIHelper::getInstance().getNumProcesses() > 1)
-        outError("Please use only 1 MPI process! We are currently working on the MPI parallelization of model selection.");
+    if (MPIHelper::getInstance().getNumProcesses() > 1 && params.model_test_and_tree)
+        outError("Please use only 1 MPI process! Model selection with tree search per model is not MPI-parallelized.");
     // TODO: check if necessary
     //        if (iqtree.isSuperTree())
     //            ((PhyloSuperTree*) &iqtree)->mapTrees();
@@ -760,6 +760,8 @@ void runModelFinder(Params &params, IQTree &iqtree, ModelCheckpoint &model_info)
     ok_model_file &= model_info.size() > 0;
     if (ok_model_file)
         cout << "NOTE: Restoring information from model checkpoint file " << model_info.getFileName() << endl;
+    if (MPIHelper::getInstance().isWorker())
+        model_info.setFileName(""); // only master writes the model checkpoint
     
     
     Checkpoint *orig_checkpoint = iqtree.getCheckpoint();
@@ -799,6 +801,14 @@ void runModelFinder(Params &params, IQTree &iqtree, ModelCheckpoint &model_info)
         }
     }
     
+#ifdef _IQTREE_MPI
+    if (MPIHelper::getInstance().getNumProcesses() > 1) {
+        // all processes evaluate models on the initial tree of the master
+        MPIHelper::getInstance().broadcastCheckpoint(&model_info);
+        iqtree.restoreCheckpoint();
+    }
+#endif
+
     // also save initial tree to the original .ckp.gz checkpoint
     //        string initTree = iqtree.getTreeString();
     //        CKP_SAVE(initTree);
@@ -834,12 +844,8 @@ void runModelFinder(Params &params, IQTree &iqtree, ModelCheckpoint &model_info)
     } else {
         // single model selection
         CandidateModel best_model;
-        if (params.openmp_by_model)
-            best_model = CandidateModelSet().evaluateAll(params, &iqtree,
-                model_info, models_block, params.num_threads, BRLEN_OPTIMIZE);
-        else
-            best_model = CandidateModelSet().test(params, &iqtree,
-                model_info, models_block, params.num_threads, BRLEN_OPTIMIZE);
+        best_model = CandidateModelSet().test(params, &iqtree,
+            model_info, models_block, params.num_threads, BRLEN_OPTIMIZE);
         iqtree.aln->model_name = best_model.getName();
         
         Checkpoint *checkpoint = &model_info;
@@ -1494,7 +1500,7 @@ void fixPartitions(PhyloSuperTree* super_tree) {
 string CandidateModel::evaluate(Params &params,
     ModelCheckpoint &in_model_info, ModelCheckpoint &out_model_info,
     ModelsBlock *models_block,
-    int &num_threads, int brlen_type)
+    int &num_threads, int brlen_type, ModelCheckpoint *warm_start)
 {
     //string model_name = name;
     Alignment *in_aln = aln;
@@ -1534,7 +1540,12 @@ string CandidateModel::evaluate(Params &params,
     }
 
 
-    if (restoreCheckpoint(&in_model_info)) {
+    bool model_done;
+#ifdef _OPENMP
+#pragma omp critical
+#endif
+    model_done = restoreCheckpoint(&in_model_info);
+    if (model_done) {
         delete iqtree;
         return "";
     }
@@ -1543,6 +1554,13 @@ string CandidateModel::evaluate(Params &params,
 #pragma omp critical
 #endif
     iqtree->getModelFactory()->restoreCheckpoint();
+
+    if (warm_start && !warm_start->empty()) {
+        iqtree->getModelFactory()->setCheckpoint(warm_start);
+        iqtree->getModelFactory()->restoreCheckpoint();
+        if (warm_start->getBool("split_rate_cat"))
+            iqtree->getRate()->initFromCatMinusOne();
+    }
     
     // now switch to the output checkpoint
     iqtree->getModelFactory()->setCheckpoint(&out_model_info);
@@ -1573,7 +1591,7 @@ string CandidateModel::evaluate(Params &params,
             iqtree->saveCheckpoint();
         }
 
-        iqtree->ensureNumberOfThreadsIsSet(nullptr);
+        num_threads = iqtree->ensureNumberOfThreadsIsSet(nullptr);
 
         runTreeReconstruction(params, iqtree);
         new_logl = iqtree->computeLikelihood();
@@ -1596,7 +1614,7 @@ string CandidateModel::evaluate(Params &params,
         if (verbose_mode >= VB_MED)
             cout << "Optimizing model " << getName() << endl;
 
-        iqtree->ensureNumberOfThreadsIsSet(nullptr);
+        num_threads = iqtree->ensureNumberOfThreadsIsSet(nullptr);
         iqtree->initializeAllPartialLh();
 
         for (int step = 0; step < 2; step++) {
@@ -1608,7 +1626,12 @@ string CandidateModel::evaluate(Params &params,
 
             // check if logl(+R[k]) is worse than logl(+R[k-1])
             CandidateModel prev_info;
-            if (!prev_info.restoreCheckpointRminus1(&in_model_info, this)) break;
+            bool prev_done;
+#ifdef _OPENMP
+#pragma omp critical
+#endif
+            prev_done = prev_info.restoreCheckpointRminus1(&in_model_info, this);
+            if (!prev_done) break;
             if (prev_info.logl < new_logl + params.modelfinder_eps) break;
             if (step == 0) {
                 iqtree->getRate()->initFromCatMinusOne();
@@ -1658,6 +1681,23 @@ struct ModelPair {
     string set_name;
     /* best model name */
     string model_name;
+
+    /**
+     set the best model of the merged subset and the score of the partition scheme after merging
+     @param best_model best model of the merged subset
+     @param lhsum, dfsum log-likelihood and number of parameters of the current scheme
+     @param lhvec, dfvec log-likelihood and number of parameters per subset of the current scheme
+     @param ssize sample size
+     */
+    void setModel(CandidateModel &best_model, double lhsum, int dfsum, DoubleVector &lhvec, DoubleVector &dfvec, size_t ssize) {
+        logl = best_model.logl;
+        df = best_model.df;
+        model_name = best_model.getName();
+        tree_len = best_model.tree_len;
+        double lhnew = lhsum - lhvec[part1] - lhvec[part2] + best_model.logl;
+        int dfnew = dfsum - dfvec[part1] - dfvec[part2] + best_model.df;
+        score = computeInformationScore(lhnew, dfnew, ssize, Params::getInstance().model_test_criterion);
+    }
 };
 
 class ModelPairSet : public multimap<double, ModelPair> {
@@ -1881,6 +1921,107 @@ void mergePairs(vector<SubsetPair> &dest, vector<SubsetPair> &src) {
             dest.push_back(s);
 }
 
+/**
+ restore the best model of a subset of partitions examined before,
+ also in previous merging steps or runs (.model.gz)
+ @param model_info all model information
+ @param set_name subset name (see getSubsetName)
+ @param[out] best_model best model of the subset
+ @return true if the subset was examined before
+ */
+bool restoreSubsetModel(ModelCheckpoint &model_info, string &set_name, CandidateModel &best_model) {
+    bool done_before = false;
+    model_info.startStruct(set_name);
+    if (model_info.getBestModel(best_model.subst_name)) {
+        best_model.restoreCheckpoint(&model_info);
+        done_before = true;
+    }
+    model_info.endStruct();
+    return done_before;
+}
+
+/**
+ @return computational cost of a subset of partitions, proportional to #sequences, #patterns, and #states
+ */
+double getSubsetCost(PhyloSuperTree *super_tree, set<int> &subset) {
+    double cost = 0.0;
+    for (auto i : subset) {
+        Alignment *aln = super_tree->at(i)->aln;
+        cost += ((double)aln->getNSeq())*aln->getNPattern()*aln->num_states;
+    }
+    return cost;
+}
+
+/**
+ print the best model of a merged partition pair
+ @param num_model number of models selected so far
+ @param total_num_model estimated total number of models to select
+ @param start_time starting time of model selection
+ */
+void printMergedPair(ModelPair &cur_pair, int64_t num_model, int64_t total_num_model, double start_time) {
+    cout.width(4);
+    cout << right << num_model << " ";
+    cout.width(12);
+    cout << left << cur_pair.model_name << " ";
+    cout.width(11);
+    cout << cur_pair.score << " ";
+    cout.width(11);
+    cout << cur_pair.tree_len << " " << cur_pair.set_name;
+    if (num_model >= 10) {
+        double remain_time = max(total_num_model-num_model, (int64_t)0)*(getRealTime()-start_time)/num_model;
+        cout << "\t" << convert_time(getRealTime()-start_time) << " ("
+            << convert_time(remain_time) << " left)";
+    }
+    cout << endl;
+}
+
+/**
+ select the best model for the merged subset of a partition pair
+ @param in_tree partition tree
+ @param model_info all model information, only read
+ @param cur_pair partition pair
+ @param gene_sets current partition scheme
+ @param lenvec tree length per subset
+ @param num_threads number of threads for this pair
+ @param[out] part_model_info model information of the merged subset
+ @return best model of the merged subset
+ */
+CandidateModel evaluateMergedPair(Params &params, PhyloSuperTree *in_tree, ModelCheckpoint &model_info,
+    ModelPair &cur_pair, vector<set<int> > &gene_sets, DoubleVector &lenvec,
+    ModelsBlock *models_block, int num_threads, ModelCheckpoint &part_model_info)
+{
+    SuperAlignment *super_aln = (SuperAlignment*)in_tree->aln;
+    Alignment *aln = super_aln->concatenateAlignments(cur_pair.merged_set);
+    PhyloTree *tree = in_tree->extractSubtree(cur_pair.merged_set);
+    //tree->scaleLength((weight1*lenvec[cur_pair.part1] + weight2*lenvec[cur_pair.part2])/tree->treeLength());
+    tree->scaleLength(sqrt(lenvec[cur_pair.part1]*lenvec[cur_pair.part2])/tree->treeLength());
+    tree->setAlignment(aln);
+#ifdef _OPENMP
+#pragma omp critical
+#endif
+    {
+        extractModelInfo(cur_pair.set_name, model_info, part_model_info);
+        transferModelParameters(in_tree, model_info, part_model_info, gene_sets[cur_pair.part1], gene_sets[cur_pair.part2]);
+    }
+    tree->num_precision = in_tree->num_precision;
+    tree->setParams(&params);
+    tree->sse = params.SSE;
+    tree->optimize_by_newton = params.optimize_by_newton;
+    tree->setNumThreads(num_threads);
+    {
+        tree->setCheckpoint(&part_model_info);
+        // trick to restore checkpoint
+        tree->restoreCheckpoint();
+        tree->saveCheckpoint();
+    }
+    CandidateModel best_model = CandidateModelSet().test(params, tree, part_model_info, models_block,
+        num_threads, params.partition_type, cur_pair.set_name, "", true);
+    best_model.restoreCheckpoint(&part_model_info);
+    delete tree;
+    delete aln;
+    return best_model;
+}
+
 /**
  * select models for all partitions
  * @param[in,out] model_info (IN/OUT) all model information
@@ -2083,113 +2224,94 @@ void testPartitionModel(Params &params, PhyloSuperTree* in_tree, ModelCheckpoint
             findClosestPairs(super_aln, lenvec, gene_sets, true, log_closest_pairs);
             mergePairs(closest_pairs, log_closest_pairs);
         }
-        // sort partition by computational cost for OpenMP effciency
-        for (i = 0; i < closest_pairs.size(); i++) {
-            // computation cost is proportional to #sequences, #patterns, and #states
-            Alignment *this_aln = in_tree->at(closest_pairs[i].first)->aln;
-            closest_pairs[i].distance = -((double)this_aln->getNSeq())*this_aln->getNPattern()*this_aln->num_states;
-            this_aln = in_tree->at(closest_pairs[i].second)->aln;
-            closest_pairs[i].distance -= ((double)this_aln->getNSeq())*this_aln->getNPattern()*this_aln->num_states;
-        }
-        if (num_threads > 1) {
-            std::sort(closest_pairs.begin(), closest_pairs.end(), comparePairs);
-        }
         size_t num_pairs = closest_pairs.size();
-        
-#ifdef _OPENMP
-#pragma omp parallel for private(i) schedule(dynamic) if(!params.model_test_and_tree)
-#endif
+        vector<ModelPair> pairs(num_pairs);
+        IntVector todo_pairs;
         for (size_t pair = 0; pair < num_pairs; pair++) {
             // information of current partitions pair
-            ModelPair cur_pair;
+            ModelPair &cur_pair = pairs[pair];
             cur_pair.part1 = closest_pairs[pair].first;
             cur_pair.part2 = closest_pairs[pair].second;
             ASSERT(cur_pair.part1 < cur_pair.part2);
             cur_pair.merged_set.insert(gene_sets[cur_pair.part1].begin(), gene_sets[cur_pair.part1].end());
             cur_pair.merged_set.insert(gene_sets[cur_pair.part2].begin(), gene_sets[cur_pair.part2].end());
             cur_pair.set_name = getSubsetName(in_tree, cur_pair.merged_set);
-            double weight1 = getSubsetAlnLength(in_tree, gene_sets[cur_pair.part1]);
-            double weight2 = getSubsetAlnLength(in_tree, gene_sets[cur_pair.part2]);
-            double sum = 1.0 / (weight1 + weight2);
-            weight1 *= sum;
-            weight2 *= sum;
+            // if pairs previously examined, reuse the information
             CandidateModel best_model;
-            bool done_before = false;
+            if (restoreSubsetModel(model_info, cur_pair.set_name, best_model))
+                cur_pair.setModel(best_model, lhsum, dfsum, lhvec, dfvec, ssize);
+            else
+                todo_pairs.push_back(pair);
+        }
+
+        // most expensive pairs first for load balancing, then round-robin over MPI processes
+        // and dynamic scheduling over the threads of each process
+        vector<pair<double,int> > pair_costs;
+        for (auto pair : todo_pairs)
+            pair_costs.push_back({-getSubsetCost(in_tree, pairs[pair].merged_set), pair});
+        std::sort(pair_costs.begin(), pair_costs.end());
+        for (i = 0; i < pair_costs.size(); i++)
+            todo_pairs[i] = pair_costs[i].second;
+        int num_procs = params.model_test_and_tree ? 1 : MPIHelper::getInstance().getNumProcesses();
+        int proc_id = (num_procs > 1) ? MPIHelper::getInstance().getProcessID() : 0;
+        IntVector proc_pairs;
+        for (i = proc_id; i < todo_pairs.size(); i += num_procs)
+            proc_pairs.push_back(todo_pairs[i]);
+        // few pairs left: give each pair several threads
+        int pair_threads = params.model_test_and_tree ? num_threads : max(1, num_threads / max((int)proc_pairs.size(), 1));
+
+#ifdef _OPENMP
+        bool nested = pair_threads > 1 && proc_pairs.size() > 1;
+        if (nested)
+            omp_set_nested(true);
+#pragma omp parallel for schedule(dynamic) num_threads(max(1, min(num_threads, (int)proc_pairs.size()))) if(!params.model_test_and_tree)
+#endif
+        for (int k = 0; k < proc_pairs.size(); k++) {
+            ModelPair &cur_pair = pairs[proc_pairs[k]];
+            ModelCheckpoint part_model_info;
+            CandidateModel best_model = evaluateMergedPair(params, in_tree, model_info, cur_pair,
+                gene_sets, lenvec, models_block, pair_threads, part_model_info);
+            cur_pair.setModel(best_model, lhsum, dfsum, lhvec, dfvec, ssize);
 #ifdef _OPENMP
 #pragma omp critical
 #endif
             {
-                // if pairs previously examined, reuse the information
-                model_info.startStruct(cur_pair.set_name);
-                if (model_info.getBestModel(best_model.subst_name)) {
-                    best_model.restoreCheckpoint(&model_info);
-                    done_before = true;
-                }
-                model_info.endStruct();
-            }
-            ModelCheckpoint part_model_info;
-            double cur_tree_len = 0.0;
-            if (!done_before) {
-                Alignment *aln = super_aln->concatenateAlignments(cur_pair.merged_set);
-                PhyloTree *tree = in_tree->extractSubtree(cur_pair.merged_set);
-                //tree->scaleLength((weight1*lenvec[cur_pair.part1] + weight2*lenvec[cur_pair.part2])/tree->treeLength());
-                tree->scaleLength(sqrt(lenvec[cur_pair.part1]*lenvec[cur_pair.part2])/tree->treeLength());
-                cur_tree_len = tree->treeLength();
-                tree->setAlignment(aln);
-                extractModelInfo(cur_pair.set_name, model_info, part_model_info);
-                transferModelParameters(in_tree, model_info, part_model_info, gene_sets[cur_pair.part1], gene_sets[cur_pair.part2]);
-                tree->num_precision = in_tree->num_precision;
-                tree->setParams(&params);
-                tree->sse = params.SSE;
-                tree->optimize_by_newton = params.optimize_by_newton;
-                tree->setNumThreads(params.model_test_and_tree ? num_threads : 1);
-                {
-                    tree->setCheckpoint(&part_model_info);
-                    // trick to restore checkpoint
-                    tree->restoreCheckpoint();
-                    tree->saveCheckpoint();
-                }
-                best_model = CandidateModelSet().test(params, tree, part_model_info, models_block,
-                    params.model_test_and_tree ? num_threads : 1, params.partition_type, cur_pair.set_name, "", true);
-                best_model.restoreCheckpoint(&part_model_info);
-                delete tree;
-                delete aln;
+                replaceModelInfo(cur_pair.set_name, model_info, part_model_info);
+                model_info.dump();
+                printMergedPair(cur_pair, ++num_model, total_num_model, start_time);
             }
-            cur_pair.logl = best_model.logl;
-            cur_pair.df = best_model.df;
-            cur_pair.model_name = best_model.getName();
-            cur_pair.tree_len = best_model.tree_len;
-            double lhnew = lhsum - lhvec[cur_pair.part1] - lhvec[cur_pair.part2] + best_model.logl;
-            int dfnew = dfsum - dfvec[cur_pair.part1] - dfvec[cur_pair.part2] + best_model.df;
-            cur_pair.score = computeInformationScore(lhnew, dfnew, ssize, params.model_test_criterion);
+        }
 #ifdef _OPENMP
-#pragma omp critical
+        if (nested)
+            omp_set_nested(false);
 #endif
-			{
-				if (!done_before) {
-					replaceModelInfo(cur_pair.set_name, model_info, part_model_info);
-                    model_info.dump();
-                    num_model++;
-					cout.width(4);
-					cout << right << num_model << " ";
-					cout.width(12);
-					cout << left << best_model.getName() << " ";
-					cout.width(11);
-                    cout << cur_pair.score << " ";
-                    cout.width(11);
-                    cout << cur_pair.tree_len << " " << cur_pair.set_name;
-                    if (num_model >= 10) {
-                        double remain_time = max(total_num_model-num_model, (int64_t)0)*(getRealTime()-start_time)/num_model;
-                        cout << "\t" << convert_time(getRealTime()-start_time) << " (" 
-                            << convert_time(remain_time) << " left)";
-                    }
-                    cout << endl;
-				}
-                if (cur_pair.score < inf_score)
-                    better_pairs.insertPair(cur_pair);
-			}
 
+#ifdef _IQTREE_MPI
+        if (num_procs > 1) {
+            // exchange subsets evaluated by other processes
+            Checkpoint subset_info;
+            for (auto pair : proc_pairs)
+                model_info.transferSubCheckpoint(&subset_info, pairs[pair].set_name + CKP_SEP);
+            MPIHelper::getInstance().gatherCheckpoint(&subset_info);
+            MPIHelper::getInstance().broadcastCheckpoint(&subset_info);
+            model_info.putSubCheckpoint(&subset_info, "");
+            model_info.dump();
+            for (i = 0; i < todo_pairs.size(); i++) {
+                if (i % num_procs == proc_id)
+                    continue;
+                ModelPair &cur_pair = pairs[todo_pairs[i]];
+                CandidateModel best_model;
+                bool found = restoreSubsetModel(model_info, cur_pair.set_name, best_model);
+                ASSERT(found);
+                cur_pair.setModel(best_model, lhsum, dfsum, lhvec, dfvec, ssize);
+                printMergedPair(cur_pair, ++num_model, total_num_model, start_time);
+            }
         }
+#endif
+
+        for (auto &cur_pair : pairs)
+            if (cur_pair.score < inf_score)
+                better_pairs.insertPair(cur_pair);
 		if (better_pairs.empty()) break;
         ModelPairSet compatible_pairs;
 
@@ -2403,6 +2525,117 @@ void CandidateModelSet::filterSubst(int finished_model) {
             at(model).setFlag(MF_IGNORED);
 }
 
+/** pattern work (patterns x states^2) worth one thread when evaluating a model */
+const double MF_WORK_PER_THREAD = 16000.0;
+
+int CandidateModelSet::getModelThreads(Params &params, Alignment *aln, int num_threads) {
+    if (params.openmp_by_model)
+        return 1;
+    double work = (double)aln->getNPattern() * aln->num_states * aln->num_states;
+    return max(1, min(num_threads, (int)(work / MF_WORK_PER_THREAD)));
+}
+
+void CandidateModelSet::getWarmStart(int model, vector<ModelCheckpoint> &model_params, ModelCheckpoint &warm_start) {
+    CandidateModel &info = at(model);
+    string subst = info.orig_subst_name.empty() ? info.subst_name : info.orig_subst_name;
+    string rate = info.orig_rate_name;
+    // free rate model with one category less, e.g. +I+R3 for +I+R4
+    string rate_minus_one;
+    size_t posR = rate.find("+R");
+    if (posR != string::npos) {
+        int cat = convert_int(rate.substr(posR+2).c_str());
+        if (cat > 2)
+            rate_minus_one = rate.substr(0, posR+2) + convertIntToString(cat-1);
+    }
+    int subst_source = -1, rate_source = -1, rate_minus_one_source = -1;
+    int invar_source = -1, gamma_source = -1;
+    for (int i = model-1; i >= 0; i--) {
+        if (!at(i).hasFlag(MF_DONE) || at(i).aln != info.aln || model_params[i].empty())
+            continue;
+        string this_subst = at(i).orig_subst_name.empty() ? at(i).subst_name : at(i).orig_subst_name;
+        string &this_rate = at(i).orig_rate_name;
+        if (this_rate == rate && rate_source < 0)
+            rate_source = i;
+        if (this_subst != subst)
+            continue;
+        if (subst_source < 0)
+            subst_source = i;
+        if (!rate_minus_one.empty() && this_rate == rate_minus_one && rate_minus_one_source < 0)
+            rate_minus_one_source = i;
+        if (this_rate == "+I" && invar_source < 0)
+            invar_source = i;
+        if (this_rate.substr(0, 2) == "+G" && gamma_source < 0)
+            gamma_source = i;
+    }
+
+    if (subst_source >= 0)
+        model_params[subst_source].transferSubCheckpoint(&warm_start, "Model");
+    if (rate_source >= 0) {
+        model_params[rate_source].transferSubCheckpoint(&warm_start, "Rate");
+    } else if (rate_minus_one_source >= 0) {
+        // +R[k] splits a category of +R[k-1]
+        model_params[rate_minus_one_source].transferSubCheckpoint(&warm_start, "Rate");
+        warm_start.putBool("split_rate_cat", true);
+    } else if (rate.substr(0, 4) == "+I+G") {
+        double p_invar, gamma_shape;
+        if (invar_source >= 0 && model_params[invar_source].get("RateInvar" + string(1, CKP_SEP) + "p_invar", p_invar))
+            warm_start.put("RateGammaInvar" + string(1, CKP_SEP) + "p_invar", p_invar);
+        if (gamma_source >= 0 && model_params[gamma_source].get("RateGamma" + string(1, CKP_SEP) + "gamma_shape", gamma_shape))
+            warm_start.put("RateGammaInvar" + string(1, CKP_SEP) + "gamma_shape", gamma_shape);
+    }
+}
+
+#ifdef _IQTREE_MPI
+/**
+ exchange the results of models evaluated by different MPI processes,
+ such that all processes continue with the same candidate set
+ @param models candidate models
+ @param wave models evaluated in this round, model wave[i] by process i % #processes
+ @param model_info (IN/OUT) checkpoint to save the results of all models
+ @param out_model_infos (IN/OUT) model parameters per model
+ @param tree_strings (IN/OUT) tree per model
+ */
+static void exchangeModelResults(CandidateModelSet &models, IntVector &wave, ModelCheckpoint &model_info,
+    vector<ModelCheckpoint> &out_model_infos, StrVector &tree_strings)
+{
+    MPIHelper &mpi = MPIHelper::getInstance();
+    Checkpoint wave_info;
+    int i;
+    for (i = mpi.getProcessID(); i < wave.size(); i += mpi.getNumProcesses()) {
+        int m = wave[i];
+        stringstream key;
+        key << "Model" << setfill('0') << setw(6) << m;
+        wave_info.startStruct(key.str());
+        wave_info.put("subst_name", models[m].subst_name);
+        wave_info.put("rate_name", models[m].rate_name);
+        wave_info.put("tree_string", tree_strings[m]);
+        models[m].saveCheckpoint(&wave_info);
+        wave_info.putSubCheckpoint(&out_model_infos[m], "info");
+        wave_info.endStruct();
+    }
+    mpi.gatherCheckpoint(&wave_info);
+    mpi.broadcastCheckpoint(&wave_info);
+
+    // all processes, including the one that evaluated it, restore a model
+    // from the same text so that they agree on the scores
+    for (i = 0; i < wave.size(); i++) {
+        int m = wave[i];
+        stringstream key;
+        key << "Model" << setfill('0') << setw(6) << m;
+        wave_info.startStruct(key.str());
+        bool found = wave_info.getString("subst_name", models[m].subst_name);
+        ASSERT(found);
+        wave_info.getString("rate_name", models[m].rate_name);
+        wave_info.getString("tree_string", tree_strings[m]);
+        models[m].restoreCheckpoint(&wave_info);
+        wave_info.endStruct();
+        out_model_infos[m].clear();
+        wave_info.getSubCheckpoint(&out_model_infos[m], key.str() + CKP_SEP + "info");
+        models[m].saveCheckpoint(&model_info);
+    }
+}
+#endif
+
 CandidateModel CandidateModelSet::test(Params &params, PhyloTree* in_tree, ModelCheckpoint &model_info,
     ModelsBlock *models_block, int num_threads, int brlen_type,
     string set_name, string in_model_name, bool merge_phase)
@@ -2501,168 +2734,265 @@ CandidateModel CandidateModelSet::test(Params &params, PhyloTree* in_tree, Model
     }
     
     
-    //------------- MAIN FOR LOOP GOING THROUGH ALL MODELS TO BE TESTED ---------//
-
-	for (model = 0; model < size(); model++) {
-        if (model == rate_block+1)
-            filterRates(rate_block); // auto filter rate models
-        if (model == subst_block+1)
-            filterSubst(subst_block); // auto filter substitution model
-        if (at(model).hasFlag(MF_IGNORED)) {
-            model_scores.push_back(DBL_MAX);
-            continue;
-        }
-		//cout << model_names[model] << endl;
-        if (at(model).subst_name == "") {
-            // now switching to test rate heterogeneity
-            if (best_model == -1)
-                switch (params.model_test_criterion) {
-                case MTC_AIC:
-                    best_model = best_model_AIC;
-                    break;
-                case MTC_AICC:
-                    best_model = best_model_AICc;
-                    break;
-                case MTC_BIC:
-                    best_model = best_model_BIC;
-                    break;
-                default: ASSERT(0);
-                }
-            at(model).subst_name = at(best_model).subst_name;
-        }
-
-		// optimize model parameters
-        string orig_model_name = at(model).getName();
-        // keep separate output model_info to only update model_info if better model found
-        ModelCheckpoint out_model_info;
-		//CandidateModel info;
-		//info.set_name = set_name;
-        at(model).set_name = set_name;
-        string tree_string;
-
-        /***** main call to estimate model parameters ******/
-        tree_string = at(model).evaluate(params,
-            model_info, out_model_info, models_block, num_threads, brlen_type);
-
-        at(model).computeICScores(ssize);
-        at(model).setFlag(MF_DONE);
-
-        CandidateModel prev_info;
-
-        bool skip_model = false;
-
-        if (prev_info.restoreCheckpointRminus1(checkpoint, &at(model))) {
-            // check stop criterion for +R
-            prev_info.computeICScores(ssize);
-            switch (params.model_test_criterion) {
-            case MTC_ALL:
-                if (at(model).AIC_score > prev_info.AIC_score &&
-                    at(model).AICc_score > prev_info.AICc_score &&
-                    at(model).BIC_score > prev_info.BIC_score) {
-                    // skip remaining model
-                    skip_model = true;
-                }
+    //------------- MAIN LOOP GOING THROUGH ALL MODELS TO BE TESTED ---------//
+
+    // models are evaluated in waves of those whose dependencies are resolved:
+    // filterRates/filterSubst need the whole block, a model without substitution
+    // name takes the best one so far, and +R[k] starts from +R[k-1].
+    // Finished models are committed in list order, so that the best model,
+    // the output and the pruning are the same as when testing one by one.
+    // With -T AUTO in_tree has no model to measure the thread count, so the
+    // first model evaluated measures it and the waves hold one model until then.
+    int model_threads = 1, model_slots = 1, wave_size = 1, num_procs = 1;
+    bool threads_known = false;
+
+    vector<ModelCheckpoint> out_model_infos(size());
+    vector<ModelCheckpoint> model_params(size()), warm_starts(size());
+    StrVector tree_strings(size());
+    StrVector orig_model_names(size());
+    model_scores.resize(size(), DBL_MAX);
+    int next_commit = 0; // all models before it are committed
+    bool rates_filtered = false, subst_filtered = false;
+
+    while (true) {
+        // commit finished models in the order of the candidate list
+        for (; next_commit < size(); next_commit++) {
+            model = next_commit;
+            if (model == rate_block+1 && !rates_filtered) {
+                filterRates(rate_block); // auto filter rate models
+                rates_filtered = true;
+            }
+            if (model == subst_block+1 && !subst_filtered) {
+                filterSubst(subst_block); // auto filter substitution model
+                subst_filtered = true;
+            }
+            if (at(model).hasFlag(MF_IGNORED))
+                continue;
+            if (!at(model).hasFlag(MF_DONE))
                 break;
-            case MTC_AIC:
-                if (at(model).AIC_score > prev_info.AIC_score) {
-                    // skip remaining model
-                    skip_model = true;
+
+            ModelCheckpoint &out_model_info = out_model_infos[model];
+            string &tree_string = tree_strings[model];
+
+            if (at(model).AIC_score < best_score_AIC) {
+                best_model_AIC = model;
+                best_score_AIC = at(model).AIC_score;
+                if (!tree_string.empty())
+                    best_tree_AIC = tree_string;
+                // only update model_info with better model
+                if (params.model_test_criterion == MTC_AIC) {
+                    model_info.putSubCheckpoint(&out_model_info, "");
+                    best_aln = at(model).aln;
                 }
-                break;
-            case MTC_AICC:
-                if (at(model).AICc_score > prev_info.AICc_score) {
-                    // skip remaining model
-                    skip_model = true;
+            }
+            if (at(model).AICc_score < best_score_AICc) {
+                best_model_AICc = model;
+                best_score_AICc = at(model).AICc_score;
+                if (!tree_string.empty())
+                    best_tree_AICc = tree_string;
+                // only update model_info with better model
+                if (params.model_test_criterion == MTC_AICC) {
+                    model_info.putSubCheckpoint(&out_model_info, "");
+                    best_aln = at(model).aln;
                 }
-                break;
-            case MTC_BIC:
-                if (at(model).BIC_score > prev_info.BIC_score) {
-                    // skip remaining model
-                    skip_model = true;
+            }
+
+            if (at(model).BIC_score < best_score_BIC) {
+                best_model_BIC = model;
+                best_score_BIC = at(model).BIC_score;
+                if (!tree_string.empty())
+                    best_tree_BIC = tree_string;
+                // only update model_info with better model
+                if (params.model_test_criterion == MTC_BIC) {
+                    model_info.putSubCheckpoint(&out_model_info, "");
+                    best_aln = at(model).aln;
                 }
-                break;
             }
-        }
 
-		if (at(model).AIC_score < best_score_AIC) {
-            best_model_AIC = model;
-            best_score_AIC = at(model).AIC_score;
-            if (!tree_string.empty())
-                best_tree_AIC = tree_string;
-            // only update model_info with better model
-            if (params.model_test_criterion == MTC_AIC) {
-                model_info.putSubCheckpoint(&out_model_info, "");
-                best_aln = at(model).aln;
+            switch (params.model_test_criterion) {
+                case MTC_AIC: model_scores[model] = at(model).AIC_score; break;
+                case MTC_AICC: model_scores[model] = at(model).AICc_score; break;
+                default: model_scores[model] = at(model).BIC_score; break;
             }
-        }
-		if (at(model).AICc_score < best_score_AICc) {
-            best_model_AICc = model;
-            best_score_AICc = at(model).AICc_score;
-            if (!tree_string.empty())
-                best_tree_AICc = tree_string;
-            // only update model_info with better model
-            if (params.model_test_criterion == MTC_AICC) {
-                model_info.putSubCheckpoint(&out_model_info, "");
-                best_aln = at(model).aln;
+            out_model_info.clear();
+            tree_string.clear();
+
+            CKP_SAVE(best_tree_AIC);
+            CKP_SAVE(best_tree_AICc);
+            CKP_SAVE(best_tree_BIC);
+            checkpoint->dump();
+
+            if (set_name == "") {
+                cout.width(3);
+                cout << right << model+1 << "  ";
+                cout.width(13);
+                cout << left << at(model).getName() << " ";
+
+                cout.precision(3);
+                cout << fixed;
+                cout.width(12);
+                cout << -at(model).logl << " ";
+                cout.width(3);
+                cout << at(model).df << " ";
+                cout.width(12);
+                cout << at(model).AIC_score << " ";
+                cout.width(12);
+                cout << at(model).AICc_score << " " << at(model).BIC_score;
+                cout << endl;
             }
         }
+        if (next_commit == size())
+            break;
 
-		if (at(model).BIC_score < best_score_BIC) {
-			best_model_BIC = model;
-            best_score_BIC = at(model).BIC_score;
-            if (!tree_string.empty())
-                best_tree_BIC = tree_string;
-            // only update model_info with better model
-            if (params.model_test_criterion == MTC_BIC) {
-                model_info.putSubCheckpoint(&out_model_info, "");
-                best_aln = at(model).aln;
+        if (!threads_known && num_threads > 0) {
+            threads_known = true;
+            model_threads = num_threads;
+            if (!params.model_test_and_tree) {
+                model_threads = getModelThreads(params, in_tree->aln, num_threads);
+                if (set_name == "")
+                    num_procs = MPIHelper::getInstance().getNumProcesses();
             }
+            model_slots = max(num_threads / model_threads, 1);
+            wave_size = model_slots * num_procs;
+            if (set_name == "" && wave_size > 1)
+                cout << "Evaluating up to " << wave_size << " models at a time using "
+                     << model_threads << " thread(s) per model" << endl;
         }
 
-        switch (params.model_test_criterion) {
-            case MTC_AIC: model_scores.push_back(at(model).AIC_score); break;
-            case MTC_AICC: model_scores.push_back(at(model).AICc_score); break;
-            default: model_scores.push_back(at(model).BIC_score); break;
+        // collect the next wave of models that can be evaluated now
+        IntVector wave;
+        for (model = next_commit; model < size() && wave.size() < wave_size; model++) {
+            if ((model > rate_block && !rates_filtered) || (model > subst_block && !subst_filtered))
+                break;
+            if (at(model).hasFlag(MF_IGNORED + MF_DONE))
+                continue;
+            if (at(model).subst_name == "") {
+                // now switching to test rate heterogeneity, the best substitution
+                // model is fixed once all models before the first such model are committed
+                if (best_model == -1) {
+                    if (model != next_commit)
+                        break;
+                    switch (params.model_test_criterion) {
+                    case MTC_AIC:
+                        best_model = best_model_AIC;
+                        break;
+                    case MTC_AICC:
+                        best_model = best_model_AICc;
+                        break;
+                    case MTC_BIC:
+                        best_model = best_model_BIC;
+                        break;
+                    default: ASSERT(0);
+                    }
+                }
+                at(model).subst_name = at(best_model).subst_name;
+            }
+            // +R[k] is initialized from +R[k-1]
+            if (model > 0 && getHigherKModel(model-1) == model && !at(model-1).hasFlag(MF_IGNORED + MF_DONE))
+                continue;
+            wave.push_back(model);
+        }
+        ASSERT(!wave.empty());
+
+        // models of this process, threads left over by a short wave go to the models
+        int proc_id = (num_procs > 1) ? MPIHelper::getInstance().getProcessID() : 0;
+        IntVector proc_models;
+        for (int i = proc_id; i < wave.size(); i += num_procs)
+            proc_models.push_back(wave[i]);
+        for (int m : wave) {
+            at(m).set_name = set_name;
+            orig_model_names[m] = at(m).getName();
+        }
+        for (int m : proc_models)
+            getWarmStart(m, model_params, warm_starts[m]);
+        int wave_threads = threads_known ? max(model_threads, num_threads / max((int)proc_models.size(), 1)) : num_threads;
+
+#ifdef _OPENMP
+        bool nested = proc_models.size() > 1 && wave_threads > 1;
+        if (nested)
+            omp_set_nested(true);
+#pragma omp parallel for schedule(dynamic) num_threads(min((int)proc_models.size(), model_slots)) if (proc_models.size() > 1)
+#endif
+        for (int i = 0; i < proc_models.size(); i++) {
+            int m = proc_models[i];
+            int threads = wave_threads;
+            /***** main call to estimate model parameters ******/
+            tree_strings[m] = at(m).evaluate(params,
+                model_info, out_model_infos[m], models_block, threads, brlen_type, &warm_starts[m]);
+            warm_starts[m].clear();
+            // the wave holds only this model while the thread count is unknown
+            if (!threads_known)
+                num_threads = threads;
         }
+#ifdef _OPENMP
+        if (nested)
+            omp_set_nested(false);
+#endif
 
-        CKP_SAVE(best_tree_AIC);
-        CKP_SAVE(best_tree_AICc);
-        CKP_SAVE(best_tree_BIC);
-        checkpoint->dump();
+#ifdef _IQTREE_MPI
+        if (num_procs > 1)
+            exchangeModelResults(*this, wave, model_info, out_model_infos, tree_strings);
+#endif
 
+        for (int m : wave) {
+            at(m).computeICScores(ssize);
+            at(m).setFlag(MF_DONE);
+            // keep parameters to warm-start related models
+            out_model_infos[m].transferSubCheckpoint(&model_params[m], "Model");
+            out_model_infos[m].transferSubCheckpoint(&model_params[m], "Rate");
 
-		if (set_name == "") {
-            cout.width(3);
-            cout << right << model+1 << "  ";
-            cout.width(13);
-            cout << left << at(model).getName() << " ";
-            
-            cout.precision(3);
-            cout << fixed;
-            cout.width(12);
-            cout << -at(model).logl << " ";
-            cout.width(3);
-            cout << at(model).df << " ";
-            cout.width(12);
-            cout << at(model).AIC_score << " ";
-            cout.width(12);
-            cout << at(model).AICc_score << " " << at(model).BIC_score;
-            cout << endl;
-        }
+            CandidateModel prev_info;
+
+            bool skip_model = false;
 
-        if (skip_model) {
-            // skip over all +R model of higher categories
-            const char *rates[] = {"+R", "*R", "+H", "*H"};
-            size_t posR;
-            for (int i = 0; i < sizeof(rates)/sizeof(char*); i++)
-                if ((posR = orig_model_name.find(rates[i])) != string::npos)
+            if (prev_info.restoreCheckpointRminus1(checkpoint, &at(m))) {
+                // check stop criterion for +R
+                prev_info.computeICScores(ssize);
+                switch (params.model_test_criterion) {
+                case MTC_ALL:
+                    if (at(m).AIC_score > prev_info.AIC_score &&
+                        at(m).AICc_score > prev_info.AICc_score &&
+                        at(m).BIC_score > prev_info.BIC_score) {
+                        // skip remaining model
+                        skip_model = true;
+                    }
+                    break;
+                case MTC_AIC:
+                    if (at(m).AIC_score > prev_info.AIC_score) {
+                        // skip remaining model
+                        skip_model = true;
+                    }
+                    break;
+                case MTC_AICC:
+                    if (at(m).AICc_score > prev_info.AICc_score) {
+                        // skip remaining model
+                        skip_model = true;
+                    }
                     break;
-            string first_part = orig_model_name.substr(0, posR+2);
-            for (int next = model+1; next < size() && at(next).getName().substr(0, posR+2) == first_part; next++) {
-                at(next).setFlag(MF_IGNORED);
+                case MTC_BIC:
+                    if (at(m).BIC_score > prev_info.BIC_score) {
+                        // skip remaining model
+                        skip_model = true;
+                    }
+                    break;
+                }
+            }
+
+            if (skip_model) {
+                // skip over all +R model of higher categories
+                string &orig_model_name = orig_model_names[m];
+                const char *rates[] = {"+R", "*R", "+H", "*H"};
+                size_t posR;
+                for (int i = 0; i < sizeof(rates)/sizeof(char*); i++)
+                    if ((posR = orig_model_name.find(rates[i])) != string::npos)
+                        break;
+                string first_part = orig_model_name.substr(0, posR+2);
+                for (int next = m+1; next < size() && at(next).getName().substr(0, posR+2) == first_part; next++) {
+                    at(next).setFlag(MF_IGNORED);
+                }
             }
         }
-	}
+    }
 
     ASSERT(model_scores.size() == size());
 
@@ -2738,222 +3068,4 @@ CandidateModel CandidateModelSet::test(Params &params, PhyloTree* in_tree, Model
 	return at(best_model);
 }
 
-int64_t CandidateModelSet::getNextModel() {
-    int64_t next_model;
-#pragma omp critical
-    {
-    if (size() == 0)
-        next_model = -1;
-    else if (current_model == -1)
-        next_model = 0;
-    else {
-        for (next_model = current_model+1; next_model != current_model; next_model++) {
-            if (next_model == size())
-                next_model = 0;
-            if (!at(next_model).hasFlag(MF_IGNORED + MF_WAITING + MF_RUNNING)) {
-                break;
-            }
-        }
-    }
-    }
-    if (next_model != current_model) {
-        current_model = next_model;
-        at(next_model).setFlag(MF_RUNNING);
-        return next_model;
-    } else
-        return -1;
-}
-
-CandidateModel CandidateModelSet::evaluateAll(Params &params, PhyloTree* in_tree, ModelCheckpoint &model_info,
-                                    ModelsBlock *models_block, int num_threads, int brlen_type,
-                                    string in_model_name, bool merge_phase, bool write_info)
-{
-    //ModelCheckpoint *checkpoint = &model_info;
-
-    in_tree->params = &params;
-    
-    Alignment *prot_aln = NULL;
-    Alignment *dna_aln = NULL;
-    bool do_modelomatic = params.modelomatic && in_tree->aln->seq_type == SEQ_CODON;
-    
-    
-    
-    if (in_model_name.empty()) {
-        generate(params, in_tree->aln, params.model_test_separate_rate, merge_phase);
-        if (do_modelomatic) {
-            // generate models for protein
-            // adapter coefficient according to Whelan et al. 2015
-            prot_aln = in_tree->aln->convertCodonToAA();
-            int adjusted_df;
-            double adjusted_logl = computeAdapter(in_tree->aln, prot_aln, adjusted_df);
-            if (write_info)
-                cout << "Adjusted LnL: " << adjusted_logl << "  df: " << adjusted_df << endl;
-            size_t start = size();
-            generate(params, prot_aln, params.model_test_separate_rate, merge_phase);
-            size_t i;
-            for (i = start; i < size(); i++) {
-                at(i).logl = adjusted_logl;
-                at(i).df = adjusted_df;
-            }
-            
-            // generate models for DNA
-            dna_aln = in_tree->aln->convertCodonToDNA();
-            start = size();
-            generate(params, dna_aln, params.model_test_separate_rate, merge_phase);
-            for (i = start; i < size(); i++) {
-                at(i).setFlag(MF_SAMPLE_SIZE_TRIPLE);
-            }
-        }
-    } else {
-        push_back(CandidateModel(in_model_name, "", in_tree->aln));
-    }
-
-    if (write_info) {
-        cout << "ModelFinder will test " << size() << " ";
-        if (do_modelomatic)
-            cout << "codon/AA/DNA";
-        else
-            cout << getSeqTypeName(in_tree->aln->seq_type);
-        cout << " models (sample size: " << in_tree->aln->getNSite() << ") ..." << endl;
-        cout << " No. Model         -LnL         df  AIC          AICc         BIC" << endl;
-    }
-
-    double best_score = DBL_MAX;
-
-    // detect rate hetegeneity automatically or not
-    bool auto_rate = merge_phase ? iEquals(params.merge_rates, "AUTO") : iEquals(params.ratehet_set, "AUTO");
-    bool auto_subst = merge_phase ? iEquals(params.merge_models, "AUTO") : iEquals(params.model_set, "AUTO");
-    int rate_block = size();
-    if (auto_rate) {
-        for (rate_block = 0; rate_block < size(); rate_block++)
-            if (rate_block+1 < size() && at(rate_block+1).subst_name != at(rate_block).subst_name)
-                break;
-    }
-    
-    int subst_block = size();
-    if (auto_subst) {
-        for (subst_block = size()-1; subst_block >= 0; subst_block--)
-            if (at(subst_block).rate_name == at(0).rate_name)
-                break;
-    }
-
-    int64_t num_models = size();
-#ifdef _OPENMP
-#pragma omp parallel num_threads(num_threads)
-#endif
-    {
-    int64_t model;
-    do {
-        model = getNextModel();
-        if (model == -1)
-            break;
-
-        // optimize model parameters
-        string orig_model_name = at(model).getName();
-        // keep separate output model_info to only update model_info if better model found
-        ModelCheckpoint out_model_info;
-        at(model).set_name = at(model).aln->name;
-        string tree_string;
-        
-        // main call to estimate model parameters
-        tree_string = at(model).evaluate(params, model_info, out_model_info,
-                                         models_block, num_threads, brlen_type);
-        at(model).computeICScores();
-        at(model).setFlag(MF_DONE);
-        
-        int lower_model = getLowerKModel(model);
-        if (lower_model >= 0 && at(lower_model).getScore() < at(model).getScore()) {
-            // ignore all +R_k model with higher category
-            for (int higher_model = model; higher_model != -1;
-                higher_model = getHigherKModel(higher_model)) {
-                at(higher_model).setFlag(MF_IGNORED);
-            }
-            
-        }
-#ifdef _OPENMP
-#pragma omp critical
-        {
-#endif
-        if (best_score > at(model).getScore()) {
-            best_score = at(model).getScore();
-            if (!tree_string.empty()) {
-                //model_info.put("best_tree_" + criterionName(params.model_test_criterion), tree_string);
-            }
-            // only update model_info with better model
-            model_info.putSubCheckpoint(&out_model_info, "");
-        }
-        model_info.dump();
-        if (write_info) {
-            cout.width(3);
-            cout << right << model+1 << "  ";
-            cout.width(13);
-            cout << left << at(model).getName() << " ";
-            
-            cout.precision(3);
-            cout << fixed;
-            cout.width(12);
-            cout << -at(model).logl << " ";
-            cout.width(3);
-            cout << at(model).df << " ";
-            cout.width(12);
-            cout << at(model).AIC_score << " ";
-            cout.width(12);
-            cout << at(model).AICc_score << " " << at(model).BIC_score;
-            cout << endl;
-
-        }
-        if (model >= rate_block)
-            filterRates(model); // auto filter rate models
-        if (model >= subst_block)
-            filterSubst(model); // auto filter substitution model
-#ifdef _OPENMP
-        }
-#endif
-    } while (model != -1);
-    }
-    
-    // store the best model
-    ModelTestCriterion criteria[] = {MTC_AIC, MTC_AICC, MTC_BIC};
-    for (auto mtc : criteria) {
-        int best_model = getBestModelID(mtc);
-        model_info.put("best_score_" + criterionName(mtc), at(best_model).getScore(mtc));
-        model_info.put("best_model_" + criterionName(mtc), at(best_model).getName());
-    }
-    
-    
-    /* sort models by their scores */
-    multimap<double,int> model_sorted;
-    for (int64_t model = 0; model < num_models; model++)
-        if (at(model).hasFlag(MF_DONE)) {
-            model_sorted.insert(multimap<double,int>::value_type(at(model).getScore(), model));
-        }
-    string model_list;
-    for (auto it = model_sorted.begin(); it != model_sorted.end(); it++) {
-        if (it != model_sorted.begin())
-            model_list += " ";
-        model_list += at(it->second).getName();
-    }
-    
-    model_info.putBestModelList(model_list);
-    model_info.dump();
-
-    // update alignment if best data type changed
-    int best_model = getBestModelID(params.model_test_criterion);
-    if (at(best_model).aln != in_tree->aln) {
-        delete in_tree->aln;
-        in_tree->aln = at(best_model).aln;
-        if (in_tree->aln == prot_aln)
-            prot_aln = NULL;
-        else
-            dna_aln = NULL;
-    }
-    
-    if (dna_aln)
-        delete dna_aln;
-    if (prot_aln)
-        delete prot_aln;
-
-    return at(best_model);
-}
-
 
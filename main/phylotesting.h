@@ -73,11 +73,13 @@ public:
      @param models_block models block
      @param num_thread number of threads
      @param brlen_type BRLEN_OPTIMIZE | BRLEN_FIX | BRLEN_SCALE | TOPO_UNLINKED
+     @param warm_start initial model parameters from a related model (see CandidateModelSet::getWarmStart)
      @return tree string
      */
     string evaluate(Params &params,
                     ModelCheckpoint &in_model_info, ModelCheckpoint &out_model_info,
-                    ModelsBlock *models_block, int &num_threads, int brlen_type);
+                    ModelsBlock *models_block, int &num_threads, int brlen_type,
+                    ModelCheckpoint *warm_start = NULL);
     
     /**
      evaluate concatenated alignment
@@ -181,7 +183,6 @@ class CandidateModelSet : public vector<CandidateModel> {
 public:
 
     CandidateModelSet() : vector<CandidateModel>() {
-        current_model = -1;
     }
     
     /** get ID of the best model */
@@ -208,7 +209,8 @@ public:
     void filterSubst(int finished_model);
 
     /**
-     testing the best-fit model
+     testing the best-fit model, evaluating several models at the same time across
+     threads and MPI processes when the alignment is short
      return in params.freq_type and params.rate_type
      @param params global program parameters
      @param in_tree phylogenetic tree
@@ -271,20 +273,26 @@ public:
         return -1;
     }
 
-    /** get the next model to evaluate in parallel */
-    int64_t getNextModel();
+    /**
+     number of threads for evaluating one model, the remaining threads evaluate other models
+     at the same time: small alignments give each model few threads
+     @param params program parameters (--thread-model for one thread per model)
+     @param aln alignment
+     @param num_threads total number of threads
+     @return number of threads per model
+     */
+    static int getModelThreads(Params &params, Alignment *aln, int num_threads);
 
     /**
-     evaluate all models in parallel
+     collect initial parameters for a model from the nearest evaluated models of the same
+     alignment: substitution parameters from the same substitution model, rate parameters
+     from the same rate model, or else from the nested ones (+I and +G for +I+G, +R[k-1] for +R[k])
+     @param model model ID
+     @param model_params parameters of evaluated models
+     @param[out] warm_start initial parameters, empty if no related model was evaluated
      */
-    CandidateModel evaluateAll(Params &params, PhyloTree* in_tree, ModelCheckpoint &model_info,
-                     ModelsBlock *models_block, int num_threads, int brlen_type,
-                     string in_model_name = "", bool merge_phase = false, bool write_info = true);
-    
-private:
-    
-    /** current model */
-    int64_t current_model;
+    void getWarmStart(int model, vector<ModelCheckpoint> &model_params, ModelCheckpoint &warm_start);
+
 };
 
 //typedef vector<ModelInfo> ModelCheckpoint;
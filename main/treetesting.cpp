@@ -15,6 +15,9 @@
 #include "treetesting.h"
 #include "tree/phylotree.h"
 #include "tree/phylosupertree.h"
+#include "tree/mtreeset.h"
+#include "pda/splitgraph.h"
+#include "pda/hashsplitset.h"
 #include "gsl/mygsl.h"
 #include "utils/timeutil.h"
 
@@ -749,133 +752,159 @@ int mlecoef(double *cnts, double *rr, double bb, int kk,
 /**
  @param tree_lhs RELL score matrix of size #trees x #replicates
  */
-void performAUTest(Params &params, PhyloTree *tree, double *pattern_lhs, vector<TreeInfo> &info) {
-    
-    if (params.topotest_replicates < 10000)
-        outWarning("Too few replicates for AU test. At least -zb 10000 for reliable results!");
-    
-    /* STEP 1: specify scale factors */
-    size_t nscales = 10;
-    double r[] = {0.5, 0.6, 0.7, 0.8, 0.9, 1.0, 1.1, 1.2, 1.3, 1.4};
-    double rr[] = {sqrt(0.5), sqrt(0.6), sqrt(0.7), sqrt(0.8), sqrt(0.9), 1.0,
-        sqrt(1.1), sqrt(1.2), sqrt(1.3), sqrt(1.4)};
-    double rr_inv[] = {sqrt(1/0.5), sqrt(1/0.6), sqrt(1/0.7), sqrt(1/0.8), sqrt(1/0.9), 1.0,
-        sqrt(1/1.1), sqrt(1/1.2), sqrt(1/1.3), sqrt(1/1.4)};
-    
-    /* STEP 2: compute bootstrap proportion */
-    size_t ntrees = info.size();
-    size_t nboot = params.topotest_replicates;
-    //    double nboot_inv = 1.0 / nboot;
-    
+/** number of patterns per block when scoring all trees on one replicate */
+const size_t AU_PTN_BLOCK = 1024;
+
+/** number of replicates drawn from one random seed */
+const size_t AU_BOOT_CHUNK = 500;
+
+/**
+    log-likelihoods of trees [tree_start, tree_end) on all multiscale bootstrap replicates.
+    Every chunk of replicates of a scale draws from its own random seed,
+    so that repeated calls (and any number of threads) see the same replicates.
+    @param r scale factors
+    @param[out] treelhs if not NULL, lh of tree tid on replicate boot of scale k, scaled by 1/r[k],
+        is stored in treelhs[((tid-tree_start)*nscales+k)*nboot + boot]
+    @param[out] max_lhs if not NULL, best lh over the trees for every replicate (index k*nboot+boot),
+        second_lhs and max_tids receive the second best lh and the ID of the best tree
+*/
+static void computeMultiscaleBootLh(Params &params, PhyloTree *tree, double *pattern_lhs,
+                                    size_t tree_start, size_t tree_end, size_t nscales, double *r, size_t nboot,
+                                    double *treelhs, double *max_lhs, double *second_lhs, int *max_tids)
+{
     size_t nptn = tree->getAlnNPattern();
     size_t maxnptn = get_safe_upper_limit(nptn);
-    
-    //    double *bp = new double[ntrees*nscales];
-    //    memset(bp, 0, sizeof(double)*ntrees*nscales);
-    
-    double *treelhs;
-    cout << (ntrees*nscales*nboot*sizeof(double) >> 20) << " MB required for AU test" << endl;
-    treelhs = new double[ntrees*nscales*nboot];
-    if (!treelhs)
-        outError("Not enough memory to perform AU test!");
-    
-    size_t k, tid, ptn;
-    
-    double start_time = getRealTime();
-    
-    cout << "Generating " << nscales << " x " << nboot << " multiscale bootstrap replicates... ";
-    
+    size_t ntrees = tree_end - tree_start;
+    size_t nchunks = (nboot + AU_BOOT_CHUNK - 1) / AU_BOOT_CHUNK;
+    int64_t ntasks = nscales*nchunks;
 #ifdef _OPENMP
-#pragma omp parallel private(k, tid, ptn)
-    {
-    int *rstream;
-    init_random(params.ran_seed + omp_get_thread_num(), false, &rstream);
-#else
-    int *rstream = randstream;
+#pragma omp parallel
 #endif
-    size_t boot;
+    {
     int *boot_sample = aligned_alloc<int>(maxnptn);
     memset(boot_sample, 0, maxnptn*sizeof(int));
-    
     double *boot_sample_dbl = aligned_alloc<double>(maxnptn);
-    
+    double *tree_lhs = new double[ntrees];
+
 #ifdef _OPENMP
 #pragma omp for schedule(dynamic)
 #endif
-    for (int k = 0; k < nscales; ++k) {
+    for (int64_t task = 0; task < ntasks; task++) {
+        size_t k = task / nchunks;
+        size_t boot_start = (task % nchunks) * AU_BOOT_CHUNK;
+        size_t boot_end = min(nboot, boot_start + AU_BOOT_CHUNK);
+        int *rstream;
+        init_random(params.ran_seed + task, false, &rstream);
         string str = "SCALE=" + convertDoubleToString(r[k]);
-        for (boot = 0; boot < nboot; boot++) {
+        for (size_t boot = boot_start; boot < boot_end; boot++) {
             if (r[k] == 1.0 && boot == 0)
                 // 2018-10-23: get one of the bootstrap sample as the original alignment
                 tree->aln->getPatternFreq(boot_sample);
             else
                 tree->aln->createBootstrapAlignment(boot_sample, str.c_str(), rstream);
-            for (ptn = 0; ptn < maxnptn; ptn++)
+            for (size_t ptn = 0; ptn < maxnptn; ptn++)
                 boot_sample_dbl[ptn] = boot_sample[ptn];
+
+            // score all trees on this replicate, one block of patterns at a time
+            memset(tree_lhs, 0, sizeof(double)*ntrees);
+            for (size_t ptn_start = 0; ptn_start < nptn; ptn_start += AU_PTN_BLOCK) {
+                size_t block_size = min(AU_PTN_BLOCK, nptn - ptn_start);
+                double *sample_block = boot_sample_dbl + ptn_start;
+                for (size_t i = 0; i < ntrees; i++) {
+                    double *pattern_lh = pattern_lhs + (tree_start+i)*maxnptn + ptn_start;
+                    if (params.SSE == LK_386) {
+                        double lh = 0.0;
+                        for (size_t ptn = 0; ptn < block_size; ptn++)
+                            lh += pattern_lh[ptn] * sample_block[ptn];
+                        tree_lhs[i] += lh;
+                    } else {
+                        tree_lhs[i] += tree->dotProductDoubleCall(pattern_lh, sample_block, block_size);
+                    }
+                }
+            }
+
             double max_lh = -DBL_MAX, second_max_lh = -DBL_MAX;
             int max_tid = -1;
-            for (tid = 0; tid < ntrees; tid++) {
-                double *pattern_lh = pattern_lhs + (tid*maxnptn);
-                double tree_lh;
-                if (params.SSE == LK_386) {
-                    tree_lh = 0.0;
-                    for (ptn = 0; ptn < nptn; ptn++)
-                        tree_lh += pattern_lh[ptn] * boot_sample_dbl[ptn];
-                } else {
-                    tree_lh = tree->dotProductDoubleCall(pattern_lh, boot_sample_dbl, nptn);
-                }
+            for (size_t i = 0; i < ntrees; i++) {
                 // rescale lh
-                tree_lh /= r[k];
-                
+                double tree_lh = tree_lhs[i] / r[k];
                 // find the max and second max
                 if (tree_lh > max_lh) {
                     second_max_lh = max_lh;
                     max_lh = tree_lh;
-                    max_tid = tid;
+                    max_tid = tree_start + i;
                 } else if (tree_lh > second_max_lh)
                     second_max_lh = tree_lh;
-                
-                treelhs[(tid*nscales+k)*nboot + boot] = tree_lh;
+                if (treelhs)
+                    treelhs[(i*nscales+k)*nboot + boot] = tree_lh;
+            }
+            if (max_lhs) {
+                max_lhs[k*nboot + boot] = max_lh;
+                second_lhs[k*nboot + boot] = second_max_lh;
+                max_tids[k*nboot + boot] = max_tid;
             }
-            
-            // compute difference from max_lh
-            for (tid = 0; tid < ntrees; tid++)
-                if (tid != max_tid)
-                    treelhs[(tid*nscales+k)*nboot + boot] = max_lh - treelhs[(tid*nscales+k)*nboot + boot];
-                else
-                    treelhs[(tid*nscales+k)*nboot + boot] = second_max_lh - max_lh;
-            //            bp[k*ntrees+max_tid] += nboot_inv;
         } // for boot
-        
-        // sort the replicates
-        for (tid = 0; tid < ntrees; tid++) {
-            quicksort<double,int>(treelhs + (tid*nscales+k)*nboot, 0, nboot-1);
-        }
-        
-    } // for scale
-    
+        finish_random(rstream);
+    } // for task
+
+    delete [] tree_lhs;
     aligned_free(boot_sample_dbl);
     aligned_free(boot_sample);
-    
-#ifdef _OPENMP
-    finish_random(rstream);
     }
-#endif
+}
+
+void performAUTest(Params &params, PhyloTree *tree, double *pattern_lhs, vector<TreeInfo> &info) {
     
-    //    if (verbose_mode >= VB_MED) {
-    //        cout << "scale";
-    //        for (k = 0; k < nscales; k++)
-    //            cout << "\t" << r[k];
-    //        cout << endl;
-    //        for (tid = 0; tid < ntrees; tid++) {
-    //            cout << tid;
-    //            for (k = 0; k < nscales; k++) {
-    //                cout << "\t" << bp[tid+k*ntrees];
-    //            }
-    //            cout << endl;
-    //        }
-    //    }
+    if (params.topotest_replicates < 10000)
+        outWarning("Too few replicates for AU test. At least -zb 10000 for reliable results!");
     
+    /* STEP 1: specify scale factors */
+    size_t nscales = 10;
+    double r[] = {0.5, 0.6, 0.7, 0.8, 0.9, 1.0, 1.1, 1.2, 1.3, 1.4};
+    double rr[] = {sqrt(0.5), sqrt(0.6), sqrt(0.7), sqrt(0.8), sqrt(0.9), 1.0,
+        sqrt(1.1), sqrt(1.2), sqrt(1.3), sqrt(1.4)};
+    double rr_inv[] = {sqrt(1/0.5), sqrt(1/0.6), sqrt(1/0.7), sqrt(1/0.8), sqrt(1/0.9), 1.0,
+        sqrt(1/1.1), sqrt(1/1.2), sqrt(1/1.3), sqrt(1/1.4)};
+    
+    /* STEP 2: compute bootstrap proportion */
+    size_t ntrees = info.size();
+    size_t nboot = params.topotest_replicates;
+    //    double nboot_inv = 1.0 / nboot;
+    
+    //    double *bp = new double[ntrees*nscales];
+    //    memset(bp, 0, sizeof(double)*ntrees*nscales);
+    
+    // the statistics of all replicates are kept for one block of trees at a time;
+    // if they do not fit into a quarter of the RAM, the replicates are regenerated for every block
+    size_t stat_size = nscales*nboot*sizeof(double);
+    size_t block_trees = ntrees;
+    uint64_t mem_budget = getMemorySize() / 4;
+    if (ntrees*stat_size > mem_budget)
+        block_trees = max((uint64_t)1, mem_budget / stat_size);
+    size_t nblocks = (ntrees + block_trees - 1) / block_trees;
+    cout << ((block_trees*stat_size) >> 20) << " MB required for AU test";
+    if (nblocks > 1)
+        cout << " (" << nblocks << " blocks of " << block_trees << " trees)";
+    cout << endl;
+
+    double *treelhs = new double[block_trees*nscales*nboot];
+    double *max_lhs = new double[nscales*nboot];
+    double *second_lhs = new double[nscales*nboot];
+    int *max_tids = new int[nscales*nboot];
+    
+    size_t k, tid;
+    
+    double start_time = getRealTime();
+    
+    cout << "Generating " << nscales << " x " << nboot << " multiscale bootstrap replicates... ";
+    
+    if (nblocks == 1)
+        computeMultiscaleBootLh(params, tree, pattern_lhs, 0, ntrees, nscales, r, nboot,
+                                treelhs, max_lhs, second_lhs, max_tids);
+    else
+        computeMultiscaleBootLh(params, tree, pattern_lhs, 0, ntrees, nscales, r, nboot,
+                                NULL, max_lhs, second_lhs, max_tids);
+
     cout << getRealTime() - start_time << " seconds" << endl;
     
     /* STEP 3: weighted least square fit */
@@ -884,140 +913,443 @@ void performAUTest(Params &params, PhyloTree *tree, double *pattern_lhs, vector<
     double *w = new double[nscales];
     double *this_bp = new double[nscales];
     cout << "TreeID\tAU\tRSS\td\tc" << endl;
-    for (tid = 0; tid < ntrees; tid++) {
-        double *this_stat = treelhs + tid*nscales*nboot;
-        double xn = this_stat[(nscales/2)*nboot + nboot/2], x;
-        double c, d; // c, d in original paper
-        int idf0 = -2;
-        double z = 0.0, z0 = 0.0, thp = 0.0, th = 0.0, ze = 0.0, ze0 = 0.0;
-        double pval, se;
-        int df;
-        double rss = 0.0;
-        int step;
-        const int max_step = 30;
-        bool failed = false;
-        for (step = 0; step < max_step; step++) {
-            x = xn;
-            int num_k = 0;
-            for (k = 0; k < nscales; k++) {
-                this_bp[k] = cntdist3(this_stat + k*nboot, nboot, x) / nboot;
-                if (this_bp[k] <= 0 || this_bp[k] >= 1) {
-                    cc[k] = w[k] = 0.0;
-                } else {
-                    double bp_val = this_bp[k];
-                    cc[k] = -gsl_cdf_ugaussian_Pinv(bp_val);
-                    double bp_pdf = gsl_ran_ugaussian_pdf(cc[k]);
-                    w[k] = bp_pdf*bp_pdf*nboot / (bp_val*(1.0-bp_val));
-                    num_k++;
-                }
+    for (size_t tree_start = 0; tree_start < ntrees; tree_start += block_trees) {
+        size_t tree_end = min(ntrees, tree_start + block_trees);
+        if (nblocks > 1)
+            computeMultiscaleBootLh(params, tree, pattern_lhs, tree_start, tree_end, nscales, r, nboot,
+                                    treelhs, NULL, NULL, NULL);
+
+        // compute difference from max_lh and sort the replicates
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+        for (int64_t stat_id = 0; stat_id < (int64_t)((tree_end-tree_start)*nscales); stat_id++) {
+            size_t this_tid = tree_start + stat_id / nscales;
+            size_t this_k = stat_id % nscales;
+            double *this_stat = treelhs + stat_id*nboot;
+            for (size_t boot = 0; boot < nboot; boot++) {
+                size_t rep = this_k*nboot + boot;
+                if ((int)this_tid != max_tids[rep])
+                    this_stat[boot] = max_lhs[rep] - this_stat[boot];
+                else
+                    this_stat[boot] = second_lhs[rep] - max_lhs[rep];
             }
-            df = num_k-2;
-            if (num_k >= 2) {
-                // first obtain d and c by weighted least square
-                doWeightedLeastSquare(nscales, w, rr, rr_inv, cc, d, c, se);
+            quicksort<double,int>(this_stat, 0, nboot-1);
+        }
+
+        for (tid = tree_start; tid < tree_end; tid++) {
+            double *this_stat = treelhs + (tid-tree_start)*nscales*nboot;
+            double xn = this_stat[(nscales/2)*nboot + nboot/2], x;
+            double c, d; // c, d in original paper
+            int idf0 = -2;
+            double z = 0.0, z0 = 0.0, thp = 0.0, th = 0.0, ze = 0.0, ze0 = 0.0;
+            double pval, se;
+            int df;
+            double rss = 0.0;
+            int step;
+            const int max_step = 30;
+            bool failed = false;
+            for (step = 0; step < max_step; step++) {
+                x = xn;
+                int num_k = 0;
+                for (k = 0; k < nscales; k++) {
+                    this_bp[k] = cntdist3(this_stat + k*nboot, nboot, x) / nboot;
+                    if (this_bp[k] <= 0 || this_bp[k] >= 1) {
+                        cc[k] = w[k] = 0.0;
+                    } else {
+                        double bp_val = this_bp[k];
+                        cc[k] = -gsl_cdf_ugaussian_Pinv(bp_val);
+                        double bp_pdf = gsl_ran_ugaussian_pdf(cc[k]);
+                        w[k] = bp_pdf*bp_pdf*nboot / (bp_val*(1.0-bp_val));
+                        num_k++;
+                    }
+                }
+                df = num_k-2;
+                if (num_k >= 2) {
+                    // first obtain d and c by weighted least square
+                    doWeightedLeastSquare(nscales, w, rr, rr_inv, cc, d, c, se);
                 
-                // maximum likelhood fit
-                double coef0[2] = {d, c};
-                int mlefail = mlecoef(this_bp, r, nboot, nscales, coef0, &rss, &df, &se);
+                    // maximum likelhood fit
+                    double coef0[2] = {d, c};
+                    int mlefail = mlecoef(this_bp, r, nboot, nscales, coef0, &rss, &df, &se);
                 
-                if (!mlefail) {
-                    d = coef0[0];
-                    c = coef0[1];
-                }
+                    if (!mlefail) {
+                        d = coef0[0];
+                        c = coef0[1];
+                    }
                 
-                se = gsl_ran_ugaussian_pdf(d-c)*sqrt(se);
+                    se = gsl_ran_ugaussian_pdf(d-c)*sqrt(se);
                 
-                // second, perform MLE estimate of d and c
-                //            OptimizationAUTest mle(d, c, nscales, this_bp, rr, rr_inv);
-                //            mle.optimizeDC();
-                //            d = mle.d;
-                //            c = mle.c;
+                    // second, perform MLE estimate of d and c
+                    //            OptimizationAUTest mle(d, c, nscales, this_bp, rr, rr_inv);
+                    //            mle.optimizeDC();
+                    //            d = mle.d;
+                    //            c = mle.c;
                 
-                /* STEP 4: compute p-value according to Eq. 11 */
-                pval = gsl_cdf_ugaussian_Q(d-c);
-                z = -pval;
-                ze = se;
-                // compute sum of squared difference
-                rss = 0.0;
-                for (k = 0; k < nscales; k++) {
-                    double diff = cc[k] - (rr[k]*d + rr_inv[k]*c);
-                    rss += w[k] * diff * diff;
-                }
+                    /* STEP 4: compute p-value according to Eq. 11 */
+                    pval = gsl_cdf_ugaussian_Q(d-c);
+                    z = -pval;
+                    ze = se;
+                    // compute sum of squared difference
+                    rss = 0.0;
+                    for (k = 0; k < nscales; k++) {
+                        double diff = cc[k] - (rr[k]*d + rr_inv[k]*c);
+                        rss += w[k] * diff * diff;
+                    }
                 
-            } else {
-                // not enough data for WLS
-                int num0 = 0;
-                for (k = 0; k < nscales; k++)
-                    if (this_bp[k] <= 0.0) num0++;
-                if (num0 > nscales/2)
-                    pval = 0.0;
-                else
-                    pval = 1.0;
-                se = 0.0;
-                d = c = 0.0;
-                rss = 0.0;
-                if (verbose_mode >= VB_MED)
-                    cout << "   error in wls" << endl;
-                //info[tid].au_pvalue = pval;
-                //break;
-            }
+                } else {
+                    // not enough data for WLS
+                    int num0 = 0;
+                    for (k = 0; k < nscales; k++)
+                        if (this_bp[k] <= 0.0) num0++;
+                    if (num0 > nscales/2)
+                        pval = 0.0;
+                    else
+                        pval = 1.0;
+                    se = 0.0;
+                    d = c = 0.0;
+                    rss = 0.0;
+                    if (verbose_mode >= VB_MED)
+                        cout << "   error in wls" << endl;
+                    //info[tid].au_pvalue = pval;
+                    //break;
+                }
             
             
-            if (verbose_mode >= VB_MED) {
-                cout.unsetf(ios::fixed);
-                cout << "\t" << step << "\t" << th << "\t" << x << "\t" << pval << "\t" << se << "\t" << nscales-2 << "\t" << d << "\t" << c << "\t" << z << "\t" << ze << "\t" << rss << endl;
-            }
+                if (verbose_mode >= VB_MED) {
+                    cout.unsetf(ios::fixed);
+                    cout << "\t" << step << "\t" << th << "\t" << x << "\t" << pval << "\t" << se << "\t" << nscales-2 << "\t" << d << "\t" << c << "\t" << z << "\t" << ze << "\t" << rss << endl;
+                }
             
-            if(df < 0 && idf0 < 0) { failed = true; break;} /* degenerated */
+                if(df < 0 && idf0 < 0) { failed = true; break;} /* degenerated */
             
-            if ((df < 0) || (idf0 >= 0 && (z-z0)*(x-thp) > 0.0 && fabs(z-z0)>0.1*ze0)) {
+                if ((df < 0) || (idf0 >= 0 && (z-z0)*(x-thp) > 0.0 && fabs(z-z0)>0.1*ze0)) {
+                    if (verbose_mode >= VB_MED)
+                        cout << "   non-monotone" << endl;
+                    th=x;
+                    xn=0.5*x+0.5*thp;
+                    continue;
+                }
+                if(idf0 >= 0 && (fabs(z-z0)<0.01*ze0)) {
+                    if(fabs(th)<1e-10)
+                        xn=th;
+                    else th=x;
+                } else
+                    xn=0.5*th+0.5*x;
+                info[tid].au_pvalue = pval;
+                thp=x;
+                z0=z;
+                ze0=ze;
+                idf0 = df;
+                if(fabs(x-th)<1e-10) break;
+            } // for step
+        
+            if (failed && verbose_mode >= VB_MED)
+                cout << "   degenerated" << endl;
+        
+            if (step == max_step) {
                 if (verbose_mode >= VB_MED)
-                    cout << "   non-monotone" << endl;
-                th=x;
-                xn=0.5*x+0.5*thp;
-                continue;
+                    cout << "   non-convergence" << endl;
+                failed = true;
             }
-            if(idf0 >= 0 && (fabs(z-z0)<0.01*ze0)) {
-                if(fabs(th)<1e-10)
-                    xn=th;
-                else th=x;
-            } else
-                xn=0.5*th+0.5*x;
-            info[tid].au_pvalue = pval;
-            thp=x;
-            z0=z;
-            ze0=ze;
-            idf0 = df;
-            if(fabs(x-th)<1e-10) break;
-        } // for step
         
-        if (failed && verbose_mode >= VB_MED)
-            cout << "   degenerated" << endl;
+            double pchi2 = (failed) ? 0.0 : computePValueChiSquare(rss, df);
+            cout << tid+1 << "\t" << info[tid].au_pvalue << "\t" << rss << "\t" << d << "\t" << c;
         
-        if (step == max_step) {
-            if (verbose_mode >= VB_MED)
-                cout << "   non-convergence" << endl;
-            failed = true;
+            // warning if p-value of chi-square < 0.01 (rss too high)
+            if (pchi2 < 0.01)
+                cout << " !!!";
+            cout << endl;
         }
-        
-        double pchi2 = (failed) ? 0.0 : computePValueChiSquare(rss, df);
-        cout << tid+1 << "\t" << info[tid].au_pvalue << "\t" << rss << "\t" << d << "\t" << c;
-        
-        // warning if p-value of chi-square < 0.01 (rss too high)
-        if (pchi2 < 0.01)
-            cout << " !!!";
-        cout << endl;
     }
     
     delete [] this_bp;
     delete [] w;
     delete [] cc;
+    delete [] max_tids;
+    delete [] second_lhs;
+    delete [] max_lhs;
+    delete [] treelhs;
     
     cout << "Time for AU test: " << getRealTime() - start_time << " seconds" << endl;
     //    delete [] bp;
 }
 
 
+/**
+    collect the split below every branch of the subtree rooted at node, see MTree::convertSplits
+    @param tree the tree
+    @param[out] resp taxa below node
+    @param[out] sg splits with the branch lengths as weights
+    @param[out] branches neighbor of the upper end of each branch, in the order of sg
+    @param[out] dads upper end of each branch
+*/
+static void getBranchSplits(PhyloTree *tree, Node *node, Node *dad, Split &resp, SplitGraph &sg,
+                            vector<Neighbor*> &branches, NodeVector &dads) {
+    bool has_child = false;
+    FOR_NEIGHBOR_IT(node, dad, it) {
+        Split *sp = new Split(tree->leafNum, (*it)->length);
+        getBranchSplits(tree, (*it)->node, node, *sp, sg, branches, dads);
+        resp += *sp;
+        if (sp->shouldInvert())
+            sp->invert();
+        sg.push_back(sp);
+        branches.push_back(*it);
+        dads.push_back(node);
+        has_child = true;
+    }
+    if (!has_child)
+        resp.addTaxon(node->id);
+}
+
+/**
+    set branch lengths of tree from those of a similar tree
+    @param split_lengths splits of the similar tree with branch lengths as weights
+    @return number of branches whose split is found
+*/
+static int copySplitLengths(PhyloTree *tree, SplitIntMap &split_lengths) {
+    SplitGraph sg;
+    vector<Neighbor*> branches;
+    NodeVector dads;
+    Split resp(tree->leafNum);
+    getBranchSplits(tree, tree->root, NULL, resp, sg, branches, dads);
+    int found = 0;
+    for (size_t i = 0; i < sg.size(); i++) {
+        Split *sp = split_lengths.findSplit(sg[i]);
+        if (!sp)
+            continue;
+        branches[i]->length = sp->getWeight();
+        branches[i]->node->findNeighbor(dads[i])->length = sp->getWeight();
+        found++;
+    }
+    return found;
+}
+
+/**
+    read the next tree from in and compute its log-likelihood, see evaluateTrees
+    @param tree tree with the model used for all trees
+    @param in input stream of trees
+    @param params program parameters
+    @param split_lengths branch lengths of a similar tree to start the optimization from,
+        NULL to start from the branch lengths read
+*/
+static void evaluateUserTree(PhyloTree *tree, istream &in, Params &params, SplitIntMap *split_lengths) {
+    tree->freeNode();
+    tree->readTree(in, tree->rooted);
+    if (!tree->findNodeName(tree->aln->getSeqName(0))) {
+        outError("Taxon " + tree->aln->getSeqName(0) + " not found in tree");
+    }
+
+    if (tree->rooted && tree->getModel()->isReversible()) {
+        if (tree->leafNum != tree->aln->getNSeq()+1)
+            outError("Tree does not have same number of taxa as alignment");
+        tree->convertToUnrooted();
+    } else if (!tree->rooted && !tree->getModel()->isReversible()) {
+        if (tree->leafNum != tree->aln->getNSeq())
+            outError("Tree does not have same number of taxa as alignment");
+        tree->convertToRooted();
+    }
+    tree->setAlignment(tree->aln);
+    tree->setRootNode(params.root);
+    if (tree->isSuperTree())
+        ((PhyloSuperTree*) tree)->mapTrees();
+    else if (split_lengths)
+        copySplitLengths(tree, *split_lengths);
+
+    tree->initializeAllPartialLh();
+    tree->fixNegativeBranch(false);
+    if (params.fixed_branch_length) {
+        tree->setCurScore(tree->computeLikelihood());
+    } else if (params.topotest_optimize_model) {
+        tree->getModelFactory()->optimizeParameters(BRLEN_OPTIMIZE, false, params.modelEps);
+        tree->setCurScore(tree->computeLikelihood());
+    } else {
+        tree->setCurScore(tree->optimizeAllBranches(100, 0.001));
+    }
+}
+
+/**
+    read and check all trees before the parallel evaluation, so that an invalid tree
+    is reported by the master thread
+    @param tree tree with the alignment and the model used for all trees
+    @param tree_strs NEWICK strings of the trees
+    @param[out] split_graphs splits of every tree, taxa numbered as in the alignment
+    @param[out] tree_splits hashed splits of every tree, pointing into split_graphs
+*/
+static void readBatchTrees(IQTree *tree, StrVector &tree_strs, vector<SplitGraph*> &split_graphs,
+                           vector<SplitIntMap*> &tree_splits) {
+    bool reversible = tree->getModel()->isReversible();
+    for (auto tree_str : tree_strs) {
+        MTree mtree;
+        stringstream ss(tree_str);
+        bool is_rooted = tree->rooted;
+        mtree.readTree(ss, is_rooted);
+        if (!mtree.findNodeName(tree->aln->getSeqName(0)))
+            outError("Taxon " + tree->aln->getSeqName(0) + " not found in tree");
+        if (mtree.rooted && reversible && mtree.leafNum != tree->aln->getNSeq()+1)
+            outError("Tree does not have same number of taxa as alignment");
+        if (!mtree.rooted && !reversible && mtree.leafNum != tree->aln->getNSeq())
+            outError("Tree does not have same number of taxa as alignment");
+        // number the taxa as in the alignment so that splits of all trees match
+        NodeVector taxa;
+        mtree.getTaxa(taxa);
+        for (auto taxon : taxa) {
+            if (taxon->name == ROOT_NAME)
+                taxon->id = tree->aln->getNSeq();
+            else
+                taxon->id = tree->aln->getSeqID(taxon->name);
+            if (taxon->id < 0)
+                outError("Taxon " + taxon->name + " does not appear in the alignment");
+        }
+        SplitGraph *sg = new SplitGraph;
+        Split sp(mtree.leafNum);
+        mtree.convertSplits(*sg, &sp);
+        SplitIntMap *hs = new SplitIntMap;
+        for (auto sit = sg->begin(); sit != sg->end(); sit++) {
+            // make sure that taxon 0 is included
+            if (!(*sit)->containTaxon(0))
+                (*sit)->invert();
+            hs->insertSplit(*sit, 1);
+        }
+        split_graphs.push_back(sg);
+        tree_splits.push_back(hs);
+    }
+}
+
+/**
+    @return Robinson-Foulds distance between two trees given by their splits
+*/
+static int computeRFDist(SplitIntMap *splits1, SplitIntMap *splits2) {
+    int diff_splits = 0;
+    for (auto spit = splits1->begin(); spit != splits1->end(); spit++)
+        if (!splits2->findSplit(spit->first))
+            diff_splits++;
+    for (auto spit = splits2->begin(); spit != splits2->end(); spit++)
+        if (!splits1->findSplit(spit->first))
+            diff_splits++;
+    return diff_splits;
+}
+
+/**
+    order trees greedily so that consecutive trees have small Robinson-Foulds distance,
+    distances are computed on demand instead of as a full matrix
+    @param tree_splits splits of every tree
+    @param[out] order tree IDs in the new order
+*/
+static void orderTreesBySimilarity(vector<SplitIntMap*> &tree_splits, IntVector &order) {
+    int ntrees = tree_splits.size();
+    order.clear();
+    if (ntrees < 3) {
+        for (int i = 0; i < ntrees; i++)
+            order.push_back(i);
+        return;
+    }
+    BoolVector done(ntrees, false);
+    int cur = 0;
+    for (int i = 0; i < ntrees; i++) {
+        order.push_back(cur);
+        done[cur] = true;
+        int next = -1, next_dist = 0;
+        for (int j = 0; j < ntrees; j++) {
+            if (done[j])
+                continue;
+            int dist = computeRFDist(tree_splits[cur], tree_splits[j]);
+            if (next < 0 || dist < next_dist) {
+                next = j;
+                next_dist = dist;
+            }
+        }
+        cur = next;
+    }
+}
+
+/**
+    evaluate trees in order of RF similarity (--test-batch): every tree warm-starts
+    from the branch lengths of the previous, similar tree, and runs of similar trees
+    are evaluated in parallel on thread copies of tree
+    @param tree tree with the model used for all trees
+    @param params program parameters
+    @param tree_strs NEWICK strings of the trees
+    @param[out] out_trees trees with optimized branch lengths
+    @param[out] logl log-likelihood of every tree
+    @param[out] pattern_lhs pattern log-likelihoods of tree i start at pattern_lhs + i*lh_stride
+*/
+static void evaluateTreesBatch(IQTree *tree, Params &params, StrVector &tree_strs, StrVector &out_trees,
+                               DoubleVector &logl, double *pattern_lhs, size_t lh_stride) {
+    int ntrees = tree_strs.size();
+    vector<SplitGraph*> split_graphs;
+    vector<SplitIntMap*> tree_splits;
+    readBatchTrees(tree, tree_strs, split_graphs, tree_splits);
+    IntVector order;
+    orderTreesBySimilarity(tree_splits, order);
+    for (int i = 0; i < ntrees; i++) {
+        delete tree_splits[i];
+        delete split_graphs[i];
+    }
+    out_trees.resize(ntrees);
+    logl.resize(ntrees);
+
+    int num_workers = 1;
+#ifdef _OPENMP
+    // optimizing the model changes it for all following trees
+    if (tree->root && !params.topotest_optimize_model && tree->isThreadTreeSupported())
+        num_workers = max(1, min(tree->num_threads, ntrees));
+#endif
+    vector<PhyloTree*> workers(num_workers, tree);
+    if (num_workers > 1) {
+        for (int t = 0; t < num_workers; t++) {
+            NodeVector nodes;
+            workers[t] = tree->newThreadTree(nodes);
+        }
+    }
+    bool warm_start = !params.fixed_branch_length && !tree->isSuperTree() && !tree->isMixlen();
+
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static, 1) num_threads(num_workers) if (num_workers > 1)
+#endif
+    for (int t = 0; t < num_workers; t++) {
+        // a contiguous run of the order, so that similar trees stay on one thread
+        PhyloTree *wtree = workers[t];
+        SplitGraph *prev_splits = NULL;
+        SplitIntMap *prev_lengths = NULL;
+        int first = (int)((size_t)ntrees*t/num_workers);
+        int last = (int)((size_t)ntrees*(t+1)/num_workers);
+        for (int k = first; k < last; k++) {
+            int tid = order[k];
+            istringstream in(tree_strs[tid]);
+            evaluateUserTree(wtree, in, params, prev_lengths);
+            ostringstream ostr;
+            wtree->printTree(ostr);
+            out_trees[tid] = ostr.str();
+            logl[tid] = wtree->getCurScore();
+            double *pattern_lh = pattern_lhs + tid*lh_stride;
+            memset(pattern_lh, 0, lh_stride*sizeof(double));
+            wtree->computePatternLikelihood(pattern_lh, &logl[tid]);
+            if (!warm_start)
+                continue;
+            delete prev_lengths;
+            delete prev_splits;
+            prev_splits = new SplitGraph;
+            prev_lengths = new SplitIntMap;
+            vector<Neighbor*> branches;
+            NodeVector dads;
+            Split resp(wtree->leafNum);
+            getBranchSplits(wtree, wtree->root, NULL, resp, *prev_splits, branches, dads);
+            for (size_t i = 0; i < prev_splits->size(); i++)
+                prev_lengths->insertSplit((*prev_splits)[i], i);
+        }
+        delete prev_lengths;
+        delete prev_splits;
+    }
+
+    if (num_workers > 1) {
+        for (int t = 0; t < num_workers; t++) {
+            workers[t]->setModelFactory(NULL);
+            delete workers[t];
+        }
+    }
+}
+
 void evaluateTrees(string treeset_file, Params &params, IQTree *tree, vector<TreeInfo> &info, IntVector &distinct_ids)
 {
     if (treeset_file.empty())
@@ -1130,6 +1462,24 @@ void evaluateTrees(string treeset_file, Params &params, IQTree *tree, vector<Tre
         if (!(max_lh = new double[params.topotest_replicates]))
             outError(ERR_NO_MEMORY);
     }
+    // --test-batch: evaluate all trees first, then report them in input order;
+    // pattern log-likelihoods are written directly into pattern_lhs
+    StrVector batch_trees;
+    DoubleVector batch_logl;
+    bool batch = false;
+    if (params.topotest_batch && ntrees > 1) {
+        StrVector tree_strs;
+        for (size_t i = 0; i < distinct_ids.size(); i++) {
+            string tree_str;
+            getline(in, tree_str, ';');
+            if (distinct_ids[i] < 0)
+                tree_strs.push_back(tree_str + ";");
+        }
+        if (!pattern_lhs)
+            pattern_lhs = aligned_alloc<double>(ntrees*maxnptn);
+        evaluateTreesBatch(tree, params, tree_strs, batch_trees, batch_logl, pattern_lhs, maxnptn);
+        batch = true;
+    }
     int tree_index, tid, tid2;
     info.resize(ntrees);
     //for (MTreeSet::iterator it = trees.begin(); it != trees.end(); it++, tree_index++) {
@@ -1145,45 +1495,25 @@ void evaluateTrees(string treeset_file, Params &params, IQTree *tree, vector<Tre
             } while (!in.eof() && ch != ';');
             continue;
         }
-        tree->freeNode();
-        tree->readTree(in, tree->rooted);
-        if (!tree->findNodeName(tree->aln->getSeqName(0))) {
-            outError("Taxon " + tree->aln->getSeqName(0) + " not found in tree");
-        }
-        
-        if (tree->rooted && tree->getModel()->isReversible()) {
-            if (tree->leafNum != tree->aln->getNSeq()+1)
-                outError("Tree does not have same number of taxa as alignment");
-            tree->convertToUnrooted();
-        } else if (!tree->rooted && !tree->getModel()->isReversible()) {
-            if (tree->leafNum != tree->aln->getNSeq())
-                outError("Tree does not have same number of taxa as alignment");
-            tree->convertToRooted();
-        }
-        tree->setAlignment(tree->aln);
-        tree->setRootNode(params.root);
-        if (tree->isSuperTree())
-            ((PhyloSuperTree*) tree)->mapTrees();
-        
-        tree->initializeAllPartialLh();
-        tree->fixNegativeBranch(false);
-        if (params.fixed_branch_length) {
-            tree->setCurScore(tree->computeLikelihood());
-        } else if (params.topotest_optimize_model) {
-            tree->getModelFactory()->optimizeParameters(BRLEN_OPTIMIZE, false, params.modelEps);
-            tree->setCurScore(tree->computeLikelihood());
+        if (batch) {
+            tree->setCurScore(batch_logl[tid]);
+            treeout << "[ tree " << tree_index+1 << " lh=" << tree->getCurScore() << " ]";
+            treeout << batch_trees[tid];
         } else {
-            tree->setCurScore(tree->optimizeAllBranches(100, 0.001));
+            evaluateUserTree(tree, in, params, NULL);
+            treeout << "[ tree " << tree_index+1 << " lh=" << tree->getCurScore() << " ]";
+            tree->printTree(treeout);
         }
-        treeout << "[ tree " << tree_index+1 << " lh=" << tree->getCurScore() << " ]";
-        tree->printTree(treeout);
         treeout << endl;
         if (params.print_tree_lh)
             scoreout << tree->getCurScore() << endl;
         
         cout << " / LogL: " << tree->getCurScore() << endl;
         
-        if (pattern_lh) {
+        double *tree_pattern_lh = pattern_lh;
+        if (batch) {
+            tree_pattern_lh = pattern_lhs + tid*maxnptn;
+        } else if (pattern_lh) {
             double curScore = tree->getCurScore();
             memset(pattern_lh, 0, maxnptn*sizeof(double));
             tree->computePatternLikelihood(pattern_lh, &curScore);
@@ -1192,11 +1522,11 @@ void evaluateTrees(string treeset_file, Params &params, IQTree *tree, vector<Tre
         }
         if (params.print_site_lh) {
             string tree_name = "Tree" + convertIntToString(tree_index+1);
-            printSiteLh(site_lh_file.c_str(), tree, pattern_lh, true, tree_name.c_str());
+            printSiteLh(site_lh_file.c_str(), tree, tree_pattern_lh, true, tree_name.c_str());
         }
         if (params.print_partition_lh) {
             string tree_name = "Tree" + convertIntToString(tree_index+1);
-            printPartitionLh(part_lh_file.c_str(), tree, pattern_lh, true, tree_name.c_str());
+            printPartitionLh(part_lh_file.c_str(), tree, tree_pattern_lh, true, tree_name.c_str());
         }
         info[tid].logl = tree->getCurScore();
         
@@ -1211,7 +1541,7 @@ void evaluateTrees(string treeset_file, Params &params, IQTree *tree, vector<Tre
             double lh = 0.0;
             int *this_boot_sample = boot_samples + (boot*nptn);
             for (size_t ptn = 0; ptn < nptn; ptn++)
-                lh += pattern_lh[ptn] * this_boot_sample[ptn];
+                lh += tree_pattern_lh[ptn] * this_boot_sample[ptn];
             tree_lhs_offset[boot] = lh;
         }
         tid++;
@@ -0,0 +1,76 @@
+#!/bin/bash -
+#===============================================================================
+#
+#          FILE: alignment_reader.sh
+#
+#         USAGE: ./alignment_reader.sh <iqtree_binary>
+#
+#   DESCRIPTION: read PHYLIP (one line per sequence and interleaved) and FASTA
+#                alignments, well-formed and malformed, through the stream
+#                readers and through the memory map (--mmap), and compare the
+#                notes, errors, alignment summary and log-likelihood
+#
+#===============================================================================
+
+set -o nounset
+set -o errexit
+
+iqtree=$1
+data=$(dirname "$0")/../test_data
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+
+# example.phy has one line per sequence, names of at most 10 characters
+phy=$data/example.phy
+
+# interleaved PHYLIP: names and the first 200 sites, then the remaining sites
+awk 'NR == 1 { print; next }
+     { name[NR] = $1; seq[NR] = $2; n = NR }
+     END { for (i = 2; i <= n; i++) print name[i], substr(seq[i], 1, 200)
+           print ""
+           for (i = 2; i <= n; i++) print substr(seq[i], 201) }' "$phy" > "$work/inter.phy"
+
+# FASTA with 60 sites per line
+awk 'NR > 1 && NF == 2 { print ">" $1; for (i = 1; i <= length($2); i += 60) print substr($2, i, 60) }' \
+    "$phy" > "$work/wrapped.fa"
+
+# bracketed characters are unknown, notes must come out in input order
+awk 'NR == 3 { $2 = substr($2, 1, 9) "(AG)" substr($2, 11) }
+     NR == 12 { $2 = substr($2, 1, 99) "{CT}" substr($2, 101) }
+     NR == 50 { $0 = substr($0, 1, 9) "(AG)" substr($0, 11) } { print }' \
+    "$work/inter.phy" > "$work/notes.phy"
+awk '/^>/ { n++ } n == 40 && !/^>/ && !done { $0 = "{AG}" substr($0, 2); done = 1 }
+     n == 2 && !/^>/ && !done2 { $0 = substr($0, 1, 5) "(CT)" substr($0, 7); done2 = 1 } { print }' \
+    "$work/wrapped.fa" > "$work/notes.fa"
+
+# malformed: invalid characters after a note (the first one in the file is reported),
+# a line too short, an open bracket, a sequence too short
+awk 'NR == 5 { $2 = substr($2, 1, 9) "(AG)" substr($2, 11) }
+     NR == 40 { $2 = substr($2, 1, 149) "!" substr($2, 151) }
+     NR == 20 { $2 = substr($2, 1, 9) "%" substr($2, 11) } { print }' \
+    "$work/inter.phy" > "$work/bad_char.phy"
+awk 'NR == 50 { $0 = substr($0, 1, length($0) - 1) } { print }' "$work/inter.phy" > "$work/short_line.phy"
+awk '/^>/ { n++ } n == 7 && !/^>/ && !done { $0 = substr($0, 1, 20) "(AG" substr($0, 24); done = 1 } { print }' \
+    "$work/wrapped.fa" > "$work/open_bracket.fa"
+awk '/^>/ { n++ } !(n == 3 && !/^>/ && !done) { print; next } { done = 1 }' \
+    "$work/wrapped.fa" > "$work/short_seq.fa"
+
+read_aln() {
+    local out=$work/$(basename "$1").$2
+    "$iqtree" -s "$1" -m JC -n 0 -seed 1 -nt 1 -redo -pre "$out" ${3:-} 2>&1 \
+        | grep -E "^(NOTE|ERROR|Alignment has|Alignment most|Line [0-9]|Sequence |The sequence)" || true
+    grep "^Log-likelihood of the tree:" "$out.iqtree" 2>/dev/null | awk '{print $5}' || true
+}
+
+status=0
+for aln in "$phy" "$work/inter.phy" "$work/wrapped.fa" "$work/notes.phy" "$work/notes.fa" \
+           "$work/bad_char.phy" "$work/short_line.phy" "$work/open_bracket.fa" "$work/short_seq.fa"; do
+    read_aln "$aln" stream > "$work/stream.txt"
+    read_aln "$aln" mmap --mmap > "$work/mmap.txt"
+    echo "$(basename "$aln"): $(grep -c . "$work/stream.txt") lines, $(grep -m 1 "^ERROR" "$work/stream.txt" || echo ok)"
+    if [ ! -s "$work/stream.txt" ] || ! diff "$work/stream.txt" "$work/mmap.txt"; then
+        echo "ERROR: --mmap reads $(basename "$aln") differently"
+        status=1
+    fi
+done
+exit $status
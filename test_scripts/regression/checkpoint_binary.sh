@@ -0,0 +1,162 @@
+#!/bin/bash -
+#===============================================================================
+#
+#          FILE: checkpoint_binary.sh
+#
+#         USAGE: ./checkpoint_binary.sh <iqtree_binary>
+#
+#   DESCRIPTION: check the binary checkpoint file (--ckp-binary): a bootstrap
+#                run must end with the same keys as with the text checkpoint,
+#                and resuming from hand-made logs must drop erased keys
+#                (tombstones), compact a log grown beyond twice its live size
+#                and discard a last dump cut off at any byte
+#
+#===============================================================================
+
+set -o nounset
+set -o errexit
+
+iqtree=$1
+data=$(dirname "$0")/../test_data
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+
+# ckp keys <file>: print the keys of a binary checkpoint file, fail if it ends
+#                  with an incomplete dump or is larger than twice its live size
+# ckp craft <in> <out> [cut]: write a log from the keys of <in> with finished set
+#                  to false: a full dump with an extra key, a full dump again
+#                  erasing that key, then, if cut is given, a dump setting
+#                  finished to true with its last cut bytes removed
+ckp() {
+    python3 - "$@" <<'EOF'
+import struct, sys
+
+MAGIC = b'IQCKPBIN'
+
+def record(key, value):
+    key = key.encode()
+    rec = (b'P' if value is not None else b'E') + struct.pack('=I', len(key)) + key
+    if value is not None:
+        rec += struct.pack('=Q', len(value)) + value
+    return rec
+
+def dump(records):
+    return b''.join(record(k, v) for k, v in records) + b'C' + struct.pack('=Q', len(records))
+
+def read(name):
+    data = open(name, 'rb').read()
+    if data[:len(MAGIC)] != MAGIC:
+        sys.exit(name + ': not a binary checkpoint file')
+    pos = len(MAGIC)
+    (header_len,) = struct.unpack_from('=I', data, pos)
+    pos += 4
+    header = data[pos:pos + header_len]
+    pos += header_len
+    keys, records = {}, []
+    while pos < len(data):
+        kind = data[pos:pos + 1]
+        pos += 1
+        if kind == b'C':
+            (num,) = struct.unpack_from('=Q', data, pos)
+            pos += 8
+            if num != len(records):
+                sys.exit(name + ': wrong number of records in a commit')
+            for k, v in records:
+                if v is None:
+                    keys.pop(k, None)
+                else:
+                    keys[k] = v
+            records = []
+            continue
+        (key_len,) = struct.unpack_from('=I', data, pos)
+        pos += 4
+        key = data[pos:pos + key_len].decode()
+        pos += key_len
+        value = None
+        if kind == b'P':
+            (value_len,) = struct.unpack_from('=Q', data, pos)
+            pos += 8
+            value = data[pos:pos + value_len]
+            pos += value_len
+        elif kind != b'E':
+            sys.exit(name + ': invalid record')
+        records.append((key, value))
+    if records or pos != len(data):
+        sys.exit(name + ': incomplete last dump')
+    return data, header, keys
+
+if sys.argv[1] == 'keys':
+    data, header, keys = read(sys.argv[2])
+    live = len(MAGIC) + 4 + len(header) + len(dump(sorted(keys.items())))
+    if len(data) > 2 * live:
+        sys.exit('%s: %d bytes, more than twice the live size %d' % (sys.argv[2], len(data), live))
+    for k in sorted(keys):
+        print(k)
+else:
+    data, header, keys = read(sys.argv[2])
+    keys['finished'] = b'false'
+    out = MAGIC + struct.pack('=I', len(header)) + header
+    out += dump(sorted(keys.items()) + [('stale!key', b'1')])
+    out += dump(sorted(keys.items()) + [('stale!key', None)])
+    if len(sys.argv) > 4:
+        last = dump([('finished', b'true')])
+        out += last[:len(last) - int(sys.argv[4])]
+    open(sys.argv[3], 'wb').write(out)
+EOF
+}
+
+# the keys of a text checkpoint file, struct names joined to their keys by '!'
+text_keys() {
+    gzip -dc "$1" | awk 'NR == 1 { next }
+        /^ / { print s "!" substr($0, 2, index($0, ": ") - 2); next }
+        /:$/ { s = substr($0, 1, length($0) - 1); next }
+        { print substr($0, 1, index($0, ": ") - 1) }' | sort
+}
+
+run() {
+    "$iqtree" -s "$data/example.phy" -m JC -fast -seed 1 -nt 1 -cptime 0 "$@"
+}
+
+status=0
+check() {
+    if [ -e "$1.tmp" ] || ! ckp keys "$1" > "$work/keys.txt" || ! diff "$2" "$work/keys.txt"; then
+        echo "ERROR: $3"
+        status=1
+    fi
+}
+
+# bootstrap replicates erase all but the iqtree keys and dump at the end of each replicate
+run -b 2 -pre "$work/text" > /dev/null 2>&1
+run -b 2 -pre "$work/boot" --ckp-binary > /dev/null 2>&1
+text_keys "$work/text.ckp.gz" > "$work/text.keys"
+echo "bootstrap: $(wc -l < "$work/text.keys") keys"
+check "$work/boot.ckp.bin" "$work/text.keys" "binary checkpoint of the bootstrap run differs from the text one"
+
+run -pre "$work/base" --ckp-binary > /dev/null 2>&1
+ckp keys "$work/base.ckp.bin" > "$work/base.keys"
+
+# resume without --ckp-binary: the log is found, the erased key is dropped,
+# the first dump compacts the log of two full dumps
+ckp craft "$work/base.ckp.bin" "$work/resume.ckp.bin"
+run -pre "$work/resume" > "$work/resume.out" 2>&1 || true
+echo "resume: $(grep -c "^NOTE: Resume from checkpoint file" "$work/resume.out") notes, $(grep -c "^WARNING: Discard" "$work/resume.out") warnings"
+if ! grep -q "^NOTE: Resume from checkpoint file" "$work/resume.out" || grep -q "^WARNING: Discard" "$work/resume.out" \
+    || [ -e "$work/resume.ckp.gz" ]; then
+    echo "ERROR: run did not resume from the binary checkpoint file"
+    status=1
+fi
+check "$work/resume.ckp.bin" "$work/base.keys" "resumed binary checkpoint has wrong keys"
+
+# a last dump cut in the commit record, before it, in the value length, in the key length
+# and after its first byte
+for cut in 1 9 20 30 33; do
+    ckp craft "$work/base.ckp.bin" "$work/cut$cut.ckp.bin" $cut
+    run -pre "$work/cut$cut" --ckp-binary > "$work/cut$cut.out" 2>&1 || true
+    echo "cut $cut bytes: $(grep -c "^WARNING: Discard incomplete last dump" "$work/cut$cut.out") warnings"
+    if ! grep -q "^WARNING: Discard incomplete last dump" "$work/cut$cut.out"; then
+        echo "ERROR: incomplete last dump was not discarded"
+        status=1
+    fi
+    check "$work/cut$cut.ckp.bin" "$work/base.keys" "binary checkpoint resumed after cutting $cut bytes has wrong keys"
+done
+exit $status
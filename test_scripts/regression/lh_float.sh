@@ -0,0 +1,72 @@
+#!/bin/bash -
+#===============================================================================
+#
+#          FILE: lh_float.sh
+#
+#         USAGE: ./lh_float.sh <iqtree_binary>
+#
+#   DESCRIPTION: compare the log-likelihood of a fixed tree computed with
+#                single-precision partial likelihoods (--lh-float) against
+#                double precision, on random alignments whose partial
+#                likelihoods underflow the float range (300 taxa) and whose
+#                float scale counts run over the limit (6000 taxa)
+#
+#===============================================================================
+
+set -o nounset
+set -o errexit
+
+iqtree=$1
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+
+# random DNA alignment and balanced tree with long branches
+make_data() {
+    awk -v ntaxa=$1 -v nsite=$2 'BEGIN {
+        srand(12345); split("ACGT", nt, "");
+        print ntaxa, nsite;
+        for (i = 1; i <= ntaxa; i++) {
+            seq = "";
+            for (j = 1; j <= nsite; j++) seq = seq nt[int(rand()*4)+1];
+            printf "T%d %s\n", i, seq;
+        }
+    }' > "$work/aln$1.phy"
+    awk -v ntaxa=$1 'BEGIN {
+        n = 0;
+        for (i = 1; i <= ntaxa; i++) node[n++] = "T" i ":1.5";
+        while (n > 3) {
+            m = 0;
+            for (i = 0; i+1 < n; i += 2) next_node[m++] = "(" node[i] "," node[i+1] "):0.5";
+            if (n % 2) next_node[m++] = node[n-1];
+            n = m;
+            for (i = 0; i < n; i++) node[i] = next_node[i];
+        }
+        s = node[0];
+        for (i = 1; i < n; i++) s = s "," node[i];
+        print "(" s ");";
+    }' > "$work/tree$1.nwk"
+}
+
+tree_lh() {
+    "$iqtree" -s "$work/aln$1.phy" -te "$work/tree$1.nwk" -m JC -blfix -nt 1 -quiet -redo \
+        -pre "$work/$2$1" ${3:-} > /dev/null
+    grep "^Log-likelihood of the tree:" "$work/$2$1.iqtree" | awk '{print $5}'
+}
+
+status=0
+for ntaxa in 300 6000; do
+    make_data $ntaxa 20
+    lh_double=$(tree_lh $ntaxa double)
+    lh_float=$(tree_lh $ntaxa float --lh-float)
+    echo "$ntaxa taxa: double $lh_double float $lh_float"
+    if ! awk -v a="$lh_double" -v b="$lh_float" 'BEGIN { d = a-b; if (d < 0) d = -d; exit !(a != "" && d <= 1e-4*(-a)) }'; then
+        echo "ERROR: --lh-float log-likelihood differs from double precision"
+        status=1
+    fi
+done
+
+if ! grep -q "switching to double precision" "$work/float6000.log"; then
+    echo "ERROR: --lh-float did not fall back to double precision on 6000 taxa"
+    status=1
+fi
+exit $status
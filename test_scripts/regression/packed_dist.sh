@@ -0,0 +1,65 @@
+#!/bin/bash -
+#===============================================================================
+#
+#          FILE: packed_dist.sh
+#
+#         USAGE: ./packed_dist.sh <iqtree_binary>
+#
+#   DESCRIPTION: compare observed and Jukes-Cantor distances from bit-packed
+#                sequences with those of Alignment::computeObsDist and
+#                Alignment::computeJCDist (--no-packed-dist --no-experimental),
+#                on DNA and protein alignments with gaps and ambiguous states
+#
+#===============================================================================
+
+set -o nounset
+set -o errexit
+
+iqtree=$1
+data=$(dirname "$0")/../test_data
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+
+# DNA: gaps, N and ambiguous states (unknown for distances), a gappy sequence
+awk 'NR == 3 { $2 = substr($2, 1, 9) "-----" substr($2, 15) }
+     NR == 5 { $2 = substr($2, 1, 49) "NRY" substr($2, 53) }
+     NR == 8 { $2 = substr($2, 1, 199) "RYKMSW" substr($2, 206) }
+     NR == 12 { s = $2; gsub(/./, "-", s); $2 = substr(s, 1, 300) substr($2, 301) }
+     NR == 20 { $2 = "NNNN" substr($2, 5, 100) "????" substr($2, 109) } { print }' \
+    "$data/example.phy" > "$work/dna.phy"
+
+# protein: gaps, X and the ambiguous states B, Z, J
+awk 'NR == 2 { $2 = substr($2, 1, 19) "---" substr($2, 23) }
+     NR == 4 { $2 = substr($2, 1, 99) "XBZJ" substr($2, 104) }
+     NR == 9 { s = $2; gsub(/./, "X", s); $2 = substr(s, 1, 150) substr($2, 151) }
+     NR == 15 { $2 = "BBB" substr($2, 4) } { print }' \
+    "$data/prot_M126_27_269.phy" > "$work/prot.phy"
+
+# print the distance matrix that the BIONJ starting tree is built from
+write_dist() {
+    local out=$work/$(basename "$1").$2.$3 model=JC
+    if [ "$(basename "$1")" = prot.phy ]; then
+        model="Poisson -st AA"
+    fi
+    "$iqtree" -s "$1" -m $model -n 0 -t BIONJ "-d$2" -seed 1 -nt 1 -redo -pre "$out" ${4:-} > "$out.log" 2>&1
+    if [ "$2" = obs ]; then
+        cat "$out.obsdist"
+    else
+        cat "$out.mldist"
+    fi
+}
+
+status=0
+for aln in "$work/dna.phy" "$work/prot.phy"; do
+    for dist in obs jc; do
+        write_dist "$aln" $dist packed > "$work/packed.txt"
+        write_dist "$aln" $dist reference "--no-packed-dist --no-experimental" > "$work/reference.txt"
+        echo "$(basename "$aln") -d$dist: $(head -n 1 "$work/packed.txt") sequences"
+        if [ ! -s "$work/packed.txt" ] || ! diff -q "$work/packed.txt" "$work/reference.txt" > /dev/null; then
+            echo "ERROR: packed $dist distances of $(basename "$aln") differ from the reference"
+            diff "$work/packed.txt" "$work/reference.txt" | head -n 10 || true
+            status=1
+        fi
+    done
+done
+exit $status
@@ -0,0 +1,50 @@
+#!/bin/bash -
+#===============================================================================
+#
+#          FILE: streamed_nj.sh
+#
+#         USAGE: ./streamed_nj.sh <iqtree_binary>
+#
+#   DESCRIPTION: build starting trees with the out-of-core NJ-S and BIONJ-S
+#                and with the in-memory NJ and BIONJ, from the same distances,
+#                and compare topologies (RF distance) and, for NJ, branch
+#                lengths. With four clusters left, both ways of pairing them
+#                have the same Q value; BIONJ branch lengths depend on which
+#                one is joined, NJ ones do not.
+#
+#===============================================================================
+
+set -o nounset
+set -o errexit
+
+iqtree=$1
+data=$(dirname "$0")/../test_data
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+
+# sorted branch lengths of a tree file
+branch_lengths() {
+    grep -o ':[-0-9.e]*' "$1" | tr -d ':' | sort -g
+}
+
+status=0
+for aln in example.phy d59_8.phy; do
+    for builder in NJ BIONJ; do
+        for variant in $builder $builder-S; do
+            "$iqtree" -s "$data/$aln" -m JC -n 0 -djc -t $variant -seed 1 -nt 1 -redo \
+                -pre "$work/$aln.$variant" > "$work/$aln.$variant.log" 2>&1
+        done
+        "$iqtree" -t "$work/$aln.$builder.bionj" -rf "$work/$aln.$builder-S.bionj" \
+            -pre "$work/$aln.$builder.rf" > /dev/null 2>&1
+        rf=$(tail -n 1 "$work/$aln.$builder.rf.rfdist" | awk '{print $2}')
+        # rows of the streamed matrix are stored in single precision, as are the in-memory ones
+        max_diff=$(paste <(branch_lengths "$work/$aln.$builder.bionj") <(branch_lengths "$work/$aln.$builder-S.bionj") \
+            | awk '{ d = $1 - $2; if (d < 0) d = -d; if (d > m) m = d } END { printf "%g", m }')
+        echo "$aln $builder vs $builder-S: RF distance $rf, largest branch length difference $max_diff"
+        if [ "$rf" != 0 ] || { [ $builder = NJ ] && awk -v d="$max_diff" 'BEGIN { exit !(d > 1e-5) }'; }; then
+            echo "ERROR: $builder-S tree of $aln differs from the $builder tree"
+            status=1
+        fi
+    done
+done
+exit $status
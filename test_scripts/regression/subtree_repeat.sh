@@ -0,0 +1,39 @@
+#!/bin/bash -
+#===============================================================================
+#
+#          FILE: subtree_repeat.sh
+#
+#         USAGE: ./subtree_repeat.sh <iqtree_binary>
+#
+#   DESCRIPTION: compare the log-likelihoods of a short tree search with and
+#                without subtree repeats (--subtree-repeat), with all partial
+#                likelihood vectors in memory and with a few memory slots
+#                (-mem) that are reused between branches
+#
+#===============================================================================
+
+set -o nounset
+set -o errexit
+
+iqtree=$1
+data=$(dirname "$0")/../test_data
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+
+search_lh() {
+    "$iqtree" -s "$data/example.phy" -m GTR+I+G -n 3 -seed 1 -nt 1 -quiet -redo \
+        -pre "$work/$1" ${2:-} > /dev/null
+    grep "^Log-likelihood of the tree:" "$work/$1.iqtree" | awk '{print $5}'
+}
+
+status=0
+for mem in "" "-mem 1M"; do
+    lh=$(search_lh plain${mem// /} "$mem")
+    lh_repeat=$(search_lh repeat${mem// /} "$mem --subtree-repeat")
+    echo "${mem:-all in memory}: without repeats $lh with repeats $lh_repeat"
+    if ! awk -v a="$lh" -v b="$lh_repeat" 'BEGIN { d = a-b; if (d < 0) d = -d; exit !(a != "" && b != "" && d <= 1e-3) }'; then
+        echo "ERROR: --subtree-repeat changes the log-likelihood"
+        status=1
+    fi
+done
+exit $status
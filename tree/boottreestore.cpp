@@ -0,0 +1,96 @@
+/*
+ * boottreestore.cpp
+ *
+ * UFBoot trees of all replicates with each distinct tree stored once
+ */
+
+#include "boottreestore.h"
+
+void BootTreeStore::resize(size_t num_samples) {
+    for (size_t sample = num_samples; sample < sample_tree.size(); sample++)
+        setTreeID(sample, -1);
+    sample_tree.resize(num_samples, -1);
+}
+
+void BootTreeStore::clear() {
+    sample_tree.clear();
+    trees.clear();
+    ref_counts.clear();
+    free_ids.clear();
+    tree_index.clear();
+}
+
+const string &BootTreeStore::operator[](int sample) const {
+    static const string no_tree;
+    int tree_id = sample_tree[sample];
+    return (tree_id < 0) ? no_tree : *trees[tree_id];
+}
+
+int BootTreeStore::addTree(const string &tree) {
+    auto it = tree_index.find(tree);
+    if (it != tree_index.end())
+        return it->second;
+    int tree_id;
+    if (free_ids.empty()) {
+        tree_id = trees.size();
+        trees.push_back(NULL);
+        ref_counts.push_back(0);
+    } else {
+        tree_id = free_ids.back();
+        free_ids.pop_back();
+    }
+    it = tree_index.insert(make_pair(tree, tree_id)).first;
+    trees[tree_id] = &it->first;
+    ref_counts[tree_id] = 0;
+    return tree_id;
+}
+
+void BootTreeStore::setTreeID(int sample, int tree_id) {
+    int old_id = sample_tree[sample];
+    if (old_id == tree_id)
+        return;
+    sample_tree[sample] = tree_id;
+    if (tree_id >= 0)
+        ref_counts[tree_id]++;
+    if (old_id >= 0) {
+        ref_counts[old_id]--;
+        releaseTree(old_id);
+    }
+}
+
+void BootTreeStore::setTree(int sample, const string &tree) {
+    if (tree.empty()) {
+        setTreeID(sample, -1);
+        return;
+    }
+    int tree_id = addTree(tree);
+    setTreeID(sample, tree_id);
+    // tree was interned but sample already referred to an equal tree
+    releaseTree(tree_id);
+}
+
+void BootTreeStore::releaseTree(int tree_id) {
+    if (ref_counts[tree_id] > 0 || !trees[tree_id])
+        return;
+    const string *tree = trees[tree_id];
+    trees[tree_id] = NULL;
+    tree_index.erase(*tree);
+    free_ids.push_back(tree_id);
+}
+
+void BootTreeStore::getDistinctTrees(StrVector &distinct_trees, IntVector &counts, IntVector *sample_trees) const {
+    IntVector tree_pos(trees.size(), -1);
+    distinct_trees.clear();
+    counts.clear();
+    for (int tree_id = 0; tree_id < trees.size(); tree_id++)
+        if (trees[tree_id] && ref_counts[tree_id] > 0) {
+            tree_pos[tree_id] = distinct_trees.size();
+            distinct_trees.push_back(*trees[tree_id]);
+            counts.push_back(ref_counts[tree_id]);
+        }
+    if (sample_trees) {
+        sample_trees->resize(sample_tree.size());
+        for (size_t sample = 0; sample < sample_tree.size(); sample++)
+            (*sample_trees)[sample] = (sample_tree[sample] < 0) ? -1 : tree_pos[sample_tree[sample]];
+    }
+}
@@ -0,0 +1,105 @@
+/***************************************************************************
+ *   Copyright (C) 2009-2024 by                                            *
+ *   BUI Quang Minh <minh.bui@univie.ac.at>                                *
+ *   Lam-Tung Nguyen <nltung@gmail.com>                                    *
+ *                                                                         *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+#ifndef BOOTTREESTORE_H_
+#define BOOTTREESTORE_H_
+
+#include "utils/tools.h"
+
+/**
+    UFBoot trees of all replicates, each distinct tree stored once.
+    Trees are keyed by their NEWICK string printed with sorted taxon IDs
+    (WT_TAXON_ID | WT_SORT_TAXA), which is a canonical encoding of the topology.
+    Every replicate refers to a tree ID, trees are reference counted and
+    dropped once no replicate refers to them.
+*/
+class BootTreeStore {
+public:
+    BootTreeStore() {}
+
+    /** @return number of replicates */
+    size_t size() const { return sample_tree.size(); }
+
+    /** @return true if there are no replicates */
+    bool empty() const { return sample_tree.empty(); }
+
+    /**
+        set the number of replicates, new replicates have no tree
+        @param num_samples number of replicates
+    */
+    void resize(size_t num_samples);
+
+    /** remove all replicates and trees */
+    void clear();
+
+    /** @return tree of replicate sample, empty string if none */
+    const string &operator[](int sample) const;
+
+    /**
+        intern a tree, without assigning it to any replicate
+        @param tree NEWICK string
+        @return tree ID
+    */
+    int addTree(const string &tree);
+
+    /**
+        let replicate sample refer to tree tree_id
+        @param sample replicate
+        @param tree_id ID returned by addTree(), -1 for no tree
+    */
+    void setTreeID(int sample, int tree_id);
+
+    /** same as setTreeID(sample, addTree(tree)), an empty tree clears the replicate */
+    void setTree(int sample, const string &tree);
+
+    /** @return number of distinct trees */
+    size_t getNumTrees() const { return tree_index.size(); }
+
+    /**
+        list the distinct trees referred to by replicates
+        @param[out] trees distinct trees
+        @param[out] counts number of replicates of each tree
+        @param[out] sample_trees if not NULL, index into trees of each replicate (-1 if none)
+    */
+    void getDistinctTrees(StrVector &trees, IntVector &counts, IntVector *sample_trees = NULL) const;
+
+protected:
+    /** drop tree_id if no replicate refers to it any more */
+    void releaseTree(int tree_id);
+
+    /** tree ID of each replicate, -1 if none */
+    IntVector sample_tree;
+
+    /** tree string of each ID, points to the key in tree_index (NULL for free IDs) */
+    vector<const string*> trees;
+
+    /** number of replicates referring to each ID */
+    IntVector ref_counts;
+
+    /** IDs available for reuse */
+    IntVector free_ids;
+
+    /** map from tree string to ID */
+    unordered_map<string, int> tree_index;
+};
+
+#endif /* BOOTTREESTORE_H_ */
@@ -61,6 +61,8 @@ void IQTree::init() {
 //    write_intermediate_trees = 0;
 //    max_candidate_trees = 0;
     logl_cutoff = 0.0;
+    saved_trees_pattern_lh = NULL;
+    saved_trees_maxnptn = 0;
     len_scale = 10000;
 //    save_all_br_lens = false;
     duplication_counter = 0;
@@ -100,6 +102,7 @@ void IQTree::setCheckpoint(Checkpoint *checkpoint) {
 }
 
 void IQTree::saveUFBoot(Checkpoint *checkpoint) {
+    flushSavedTrees();
     checkpoint->startStruct("UFBoot");
     if (MPIHelper::getInstance().isWorker()) {
         CKP_SAVE(sample_start);
@@ -135,7 +138,7 @@ void IQTree::saveCheckpoint() {
     stop_rule.saveCheckpoint();
     candidateTrees.saveCheckpoint();
     
-    if (boot_samples.size() > 0 && !boot_trees.front().empty()) {
+    if (boot_samples.size() > 0 && !boot_trees[0].empty()) {
         saveUFBoot(checkpoint);
         // boot_splits
         int id = 0;
@@ -166,7 +169,9 @@ void IQTree::restoreUFBoot(Checkpoint *checkpoint) {
         checkpoint->getString("", str);
         ASSERT(!str.empty());
         stringstream ss(str);
-        ss >> boot_counts[id] >> boot_logl[id] >> boot_orig_logl[id] >> boot_trees[id];
+        string tree;
+        ss >> boot_counts[id] >> boot_logl[id] >> boot_orig_logl[id] >> tree;
+        boot_trees.setTree(id, tree);
     }
     checkpoint->endList();
     checkpoint->endStruct();
@@ -193,7 +198,9 @@ void IQTree::restoreCheckpoint() {
             string str;
             checkpoint->getString("", str);
             stringstream ss(str);
-            ss >> boot_counts[id] >> boot_logl[id] >> boot_orig_logl[id] >> boot_trees[id];
+            string tree;
+            ss >> boot_counts[id] >> boot_logl[id] >> boot_orig_logl[id] >> tree;
+            boot_trees.setTree(id, tree);
         }
         checkpoint->endList();
         int boot_splits_size = 0;
@@ -345,7 +352,7 @@ void IQTree::initSettings(Params &params) {
 //        cout << "Generating " << params.gbo_replicates << " samples for ultrafast "
 //             << RESAMPLE_NAME << " (seed: " << params.ran_seed << ")..." << endl;
         // allocate memory for boot_samples
-        boot_samples.resize(params.gbo_replicates);
+        boot_samples.init(params.gbo_replicates, getAlnNPattern());
         sample_start = 0;
         sample_end = boot_samples.size();
 
@@ -366,15 +373,11 @@ void IQTree::initSettings(Params &params) {
 #else
         size_t nptn = get_safe_upper_limit(orig_nptn);
 #endif
-        BootValType *mem = aligned_alloc<BootValType>(nptn * (size_t)(params.gbo_replicates));
-        memset(mem, 0, nptn * (size_t)(params.gbo_replicates) * sizeof(BootValType));
-        for (i = 0; i < params.gbo_replicates; i++)
-            boot_samples[i] = mem + i*nptn;
 
         if (boot_trees.empty()) {
             boot_logl.resize(params.gbo_replicates, -DBL_MAX);
             boot_orig_logl.resize(params.gbo_replicates, -DBL_MAX);
-            boot_trees.resize(params.gbo_replicates, "");
+            boot_trees.resize(params.gbo_replicates);
             boot_counts.resize(params.gbo_replicates, 0);
         } else {
             cout << "CHECKPOINT: " << boot_trees.size() << " UFBoot trees and " << boot_splits.size() << " UFBootSplits restored" << endl;
@@ -390,15 +393,13 @@ void IQTree::initSettings(Params &params) {
                     bootstrap_alignment = new Alignment;
                 IntVector this_sample;
                 bootstrap_alignment->createBootstrapAlignment(aln, &this_sample, params.bootstrap_spec);
-                for (size_t j = 0; j < orig_nptn; j++)
-                    boot_samples[i][j] = this_sample[j];
+                boot_samples.setWeights(i, this_sample);
                 bootstrap_alignment->printAlignment(params.aln_output_format, bootaln_name.c_str(), true);
                 delete bootstrap_alignment;
             } else {
                 IntVector this_sample;
                 aln->createBootstrapAlignment(this_sample, params.bootstrap_spec);
-                for (size_t j = 0; j < orig_nptn; j++)
-                    boot_samples[i][j] = this_sample[j];
+                boot_samples.setWeights(i, this_sample);
             }
         }
         verbose_mode = saved_mode;
@@ -418,10 +419,9 @@ void IQTree::initSettings(Params &params) {
         if(params.ufboot2corr){
             boot_samples_int.resize(params.gbo_replicates);
             for (size_t i = 0; i < params.gbo_replicates; i++) {
+                boot_samples.getWeights(i, boot_samples_int[i]);
                 boot_samples_int[i].resize(nptn, 0);
-                for (size_t j = 0; j < orig_nptn; j++)
-                    boot_samples_int[i][j] = boot_samples[i][j];
-               }
+            }
         }
 
     }
@@ -445,10 +445,10 @@ IQTree::~IQTree() {
     boot_splits.clear();
     //if (boot_splits) delete boot_splits;
 
-    if (!boot_samples.empty()) {
-        aligned_free(boot_samples[0]); // free memory
-        boot_samples.clear();
-    }
+    boot_samples.clear();
+    if (saved_trees_pattern_lh)
+        aligned_free(saved_trees_pattern_lh);
+    deleteNNIThreadTrees();
 }
 
 extern const char *aa_model_names_rax[];
@@ -793,6 +793,11 @@ void IQTree::initCandidateTreeSet(int nParTrees, int nNNITrees) {
         cout << "Computing log-likelihood of " << initTreeStrings.size() - init_size << " initial trees ... ";
     startTime = getRealTime();
 
+#ifdef _OPENMP
+    if (num_threads > 1 && (int)initTreeStrings.size() - init_size > 1 && isThreadTreeSupported())
+        optimizeInitialTreesParallel(initTreeStrings, init_size);
+    else
+#endif
     for (vector<string>::iterator it = initTreeStrings.begin(); it != initTreeStrings.end(); ++it) {
         string treeString;
         double score;
@@ -868,6 +873,40 @@ void IQTree::initCandidateTreeSet(int nParTrees, int nNNITrees) {
 
 }
 
+void IQTree::optimizeInitialTreesParallel(vector<string> &trees, int init_size) {
+#ifdef _OPENMP
+    for (int i = 0; i < init_size && i < trees.size(); i++) {
+        readTreeString(trees[i]);
+        computeLogL();
+        candidateTrees.update(getTreeString(), getCurScore());
+    }
+
+    // trees are handed out one at a time to per-thread copies sharing the model
+    int num_workers = num_threads;
+    vector<PhyloTree*> workers(num_workers, NULL);
+    vector<NodeVector> worker_nodes(num_workers);
+    for (int t = 0; t < num_workers; t++)
+        workers[t] = newThreadTree(worker_nodes[t]);
+
+#pragma omp parallel for schedule(dynamic) num_threads(num_workers)
+    for (int i = init_size; i < trees.size(); i++) {
+        PhyloTree *worker = workers[omp_get_thread_num()];
+        worker->readTreeString(trees[i]);
+        worker->initializeAllPartialLh();
+        worker->clearAllPartialLH();
+        double score = worker->optimizeAllBranches(params->brlen_num_traversal, params->loglh_epsilon, PLL_NEWZPERCYCLE);
+        string treeString = worker->getTreeString();
+#pragma omp critical
+        candidateTrees.update(treeString, score);
+    }
+
+    for (int t = 0; t < num_workers; t++) {
+        workers[t]->setModelFactory(NULL);
+        delete workers[t];
+    }
+#endif
+}
+
 string IQTree::generateParsimonyTree(int randomSeed) {
     string parsimonyTreeString;
     if (params->start_tree == STT_PLL_PARSIMONY) {
@@ -1190,11 +1229,10 @@ void IQTree::deleteLeaves(PhyloNodeVector &del_leaves) {
 
 int IQTree::assessQuartet(Node *leaf0, Node *leaf1, Node *leaf2, Node *del_leaf) {
     ASSERT(dist_matrix);
-    size_t nseq = aln->getNSeq();
     //int id0 = leaf0->id, id1 = leaf1->id, id2 = leaf2->id;
-    double dist0 = dist_matrix[leaf0->id * nseq + del_leaf->id] + dist_matrix[leaf1->id * nseq + leaf2->id];
-    double dist1 = dist_matrix[leaf1->id * nseq + del_leaf->id] + dist_matrix[leaf0->id * nseq + leaf2->id];
-    double dist2 = dist_matrix[leaf2->id * nseq + del_leaf->id] + dist_matrix[leaf0->id * nseq + leaf1->id];
+    double dist0 = dist_matrix->get(leaf0->id, del_leaf->id) + dist_matrix->get(leaf1->id, leaf2->id);
+    double dist1 = dist_matrix->get(leaf1->id, del_leaf->id) + dist_matrix->get(leaf0->id, leaf2->id);
+    double dist2 = dist_matrix->get(leaf2->id, del_leaf->id) + dist_matrix->get(leaf0->id, leaf1->id);
     if (dist0 < dist1 && dist0 < dist2)
         return 0;
     if (dist1 < dist2)
@@ -2178,7 +2216,10 @@ string IQTree::optimizeBranches(int maxTraversal) {
 }
 
 double IQTree::doTreeSearch() {
-    
+
+    // slot statistics reported at the end cover the tree search only
+    mem_slots.resetStats();
+
     if (params->numInitTrees > 1) {
         cout << "--------------------------------------------------------------------" << endl;
         cout << "|             INITIALIZING CANDIDATE TREE SET                      |" << endl;
@@ -2271,10 +2312,30 @@ double IQTree::doTreeSearch() {
     int ufboot_count, ufboot_count_check;
     stop_rule.getUFBootCountCheck(ufboot_count, ufboot_count_check);
 
+    // shared-memory hill-climbers, each with its own copy of the tree
+    vector<IQTree*> climbers;
+    if (params->num_climbers > 1) {
+        if (isClimberSearchSupported()) {
+            cout << "Running " << params->num_climbers << " hill-climbers in parallel" << endl;
+            for (int i = 0; i < params->num_climbers; i++) {
+                IQTree *climber = new IQTree(aln);
+                NodeVector nodes;
+                initThreadTree(climber, nodes);
+                // only this tree reports the progress of the climbers
+                climber->progressDisabled = true;
+                climber->candidateTrees.init(aln, 1);
+                climbers.push_back(climber);
+            }
+        } else {
+            outWarning("Parallel hill-climbers are not supported with the given options, using one");
+        }
+    }
+
     while (!stop_rule.meetStopCondition(stop_rule.getCurIt(), cur_correlation)) {
 
         searchinfo.curIter = stop_rule.getCurIt();
         // estimate logl_cutoff for bootstrap
+        flushSavedTrees();
         if (!boot_orig_logl.empty())
             logl_cutoff = *min_element(boot_orig_logl.begin(), boot_orig_logl.end());
 
@@ -2284,25 +2345,30 @@ double IQTree::doTreeSearch() {
         }
 
         Alignment *saved_aln = aln;
+        WeightedAlignmentView *saved_view = aln_view;
 
-        string curTree;
-        /*----------------------------------------
-         * Perturb the tree
-         *---------------------------------------*/
-        doTreePerturbation();
-
-        /*----------------------------------------
-         * Optimize tree with NNI
-         *----------------------------------------*/
-        pair<int, int> nniInfos; // <num_NNIs, num_steps>
-        nniInfos = doNNISearch();
-        curTree = getTreeString();
-        int pos = addTreeToCandidateSet(curTree, curScore, true, MPIHelper::getInstance().getProcessID());
-        if (pos != -2 && pos != -1 && (Params::getInstance().fixStableSplits || Params::getInstance().adaptPertubation))
-            candidateTrees.computeSplitOccurences(Params::getInstance().stableSplitThreshold);
-
-        if (MPIHelper::getInstance().isWorker() || MPIHelper::getInstance().gotMessage())
-            syncCurrentTree();
+        if (!climbers.empty()) {
+            doClimberIterations(climbers);
+        } else {
+            string curTree;
+            /*----------------------------------------
+             * Perturb the tree
+             *---------------------------------------*/
+            doTreePerturbation();
+
+            /*----------------------------------------
+             * Optimize tree with NNI
+             *----------------------------------------*/
+            pair<int, int> nniInfos; // <num_NNIs, num_steps>
+            nniInfos = doNNISearch();
+            curTree = getTreeString();
+            int pos = addTreeToCandidateSet(curTree, curScore, true, MPIHelper::getInstance().getProcessID());
+            if (pos != -2 && pos != -1 && (Params::getInstance().fixStableSplits || Params::getInstance().adaptPertubation))
+                candidateTrees.computeSplitOccurences(Params::getInstance().stableSplitThreshold);
+
+            if (MPIHelper::getInstance().isWorker() || MPIHelper::getInstance().gotMessage())
+                syncCurrentTree();
+        }
 
 
         // TODO: cannot check yet, need to somehow return treechanged
@@ -2312,9 +2378,13 @@ double IQTree::doTreeSearch() {
 //
         if (iqp_assess_quartet == IQP_BOOTSTRAP) {
             // restore alignment
-            delete aln;
-            setAlignment(saved_aln);
-            initializeAllPartialLh();
+            if (aln != saved_aln) {
+                delete aln;
+                setAlignment(saved_aln);
+                initializeAllPartialLh();
+            } else if (aln_view != saved_view)
+                delete aln_view;
+            setAlignmentView(saved_view);
             clearAllPartialLH();
         }
 
@@ -2396,6 +2466,11 @@ double IQTree::doTreeSearch() {
         
     }
     
+    for (auto climber : climbers) {
+        climber->setModelFactory(NULL);
+        delete climber;
+    }
+
     if(params->ufboot2corr) refineBootTrees();
 
     if (!early_stop)
@@ -2424,6 +2499,9 @@ double IQTree::doTreeSearch() {
     MPIHelper::getInstance().resetNumbers();
 #endif
 
+    deleteNNIThreadTrees();
+    mem_slots.reportStats(cout);
+
     cout << "TREE SEARCH COMPLETED AFTER " << stop_rule.getCurIt() << " ITERATIONS"
     << " / Time: " << convert_time(getRealTime() - params->start_real_time) << endl << endl;
 
@@ -2434,6 +2512,7 @@ double IQTree::doTreeSearch() {
 
 /*
 void IQTree::refineBootTrees(){
+    flushSavedTrees();
     on_refine_btree = true;
     int num_boot_rep = params->gbo_replicates;
     params->gbo_replicates = 0;
@@ -2575,7 +2654,7 @@ void IQTree::refineBootTrees(){
         stringstream ostr;
         printTree(ostr, WT_TAXON_ID | WT_SORT_TAXA);
         tree = ostr.str();
-        boot_trees[sample] = getTreeString();
+        boot_trees.setTree(sample, getTreeString());
         boot_logl[sample] = curScore;
 
         printTree(btreea, WT_NEWLINE | WT_SORT_TAXA);
@@ -2633,6 +2712,7 @@ void IQTree::refineBootTrees(){
  ***********************************************************/
 void IQTree::refineBootTrees() {
 
+    flushSavedTrees();
     int *saved_randstream = randstream;
     init_random(params->ran_seed);
 
@@ -2671,13 +2751,29 @@ void IQTree::refineBootTrees() {
     
 	// do bootstrap analysis
 	for (int sample = refined_samples; sample < boot_trees.size(); sample++) {
-        // create bootstrap alignment
+        // create bootstrap alignment of the UFBoot sample of this tree
         Alignment* bootstrap_alignment;
-        if (aln->isSuperAlignment())
+        WeightedAlignmentView *bootstrap_view = NULL;
+        IntVector weights;
+        boot_samples.getWeights(sample, weights);
+        if (aln->isSuperAlignment()) {
             bootstrap_alignment = new SuperAlignment;
-        else
+            bootstrap_alignment->extractPatternFreqs(aln, weights);
+        } else if (WeightedAlignmentView::isSupported(aln) && !params->pll) {
+            // on the original alignment if few patterns are left out
+            bootstrap_view = new WeightedAlignmentView(aln);
+            bootstrap_view->setWeights(weights);
+            if (bootstrap_view->isDense()) {
+                bootstrap_alignment = aln;
+            } else {
+                bootstrap_alignment = bootstrap_view->createAlignment();
+                delete bootstrap_view;
+                bootstrap_view = NULL;
+            }
+        } else {
             bootstrap_alignment = new Alignment;
-        bootstrap_alignment->createBootstrapAlignment(aln, NULL, params->bootstrap_spec);
+            bootstrap_alignment->extractPatternFreqs(aln, weights);
+        }
 
         // create bootstrap tree
         IQTree *boot_tree;
@@ -2697,6 +2793,7 @@ void IQTree::refineBootTrees() {
                 boot_tree = new PhyloTreeMixlen(bootstrap_alignment, 0);
             } else
                 boot_tree = new IQTree(bootstrap_alignment);
+            boot_tree->setAlignmentView(bootstrap_view);
         }
 
         boot_tree->on_refine_btree = true;
@@ -2767,7 +2864,7 @@ void IQTree::refineBootTrees() {
             boot_tree->printTree(ostr, WT_TAXON_ID | WT_SORT_TAXA | WT_BR_LEN | WT_BR_LEN_SHORT);
         else
             boot_tree->printTree(ostr, WT_TAXON_ID | WT_SORT_TAXA);
-        boot_trees[sample] = ostr.str();
+        boot_trees.setTree(sample, ostr.str());
         boot_logl[sample] = boot_tree->curScore;
 
 
@@ -2778,7 +2875,9 @@ void IQTree::refineBootTrees() {
         bootstrap_alignment = boot_tree->aln;
         delete boot_tree;
         // fix bug: bootstrap_alignment might be changed
-        delete bootstrap_alignment;
+        if (bootstrap_alignment != aln)
+            delete bootstrap_alignment;
+        delete bootstrap_view;
 
 
         if ((sample+1) % 100 == 0)
@@ -2871,17 +2970,94 @@ void IQTree::printIterationInfo(int sourceProcID) {
 //}
 
 
+bool IQTree::isClimberSearchSupported() {
+#ifdef _OPENMP
+    // climbers neither collect UFBoot trees nor share tabu or stable splits
+    return isThreadTreeSupported() && !rooted && params->snni && !params->iqp &&
+        !params->gbo_replicates && save_all_trees != 2 && iqp_assess_quartet != IQP_BOOTSTRAP &&
+        !params->fixStableSplits && !params->adaptPertubation && !params->tabu &&
+        !params->write_intermediate_trees && !params->writeDistImdTrees && !params->print_tree_lh &&
+        MPIHelper::getInstance().getNumProcesses() == 1;
+#else
+    return false;
+#endif
+}
+
+void IQTree::doClimberIterations(vector<IQTree*> &climbers) {
+#ifdef _OPENMP
+    int num_climbers = climbers.size();
+    double curBestScore = getBestScore();
+
+    // perturbation uses the global random stream, so it is done sequentially
+    StrVector trees(num_climbers);
+    DoubleVector scores(num_climbers);
+    for (int i = 0; i < num_climbers; i++) {
+        doTreePerturbation();
+        trees[i] = getTreeString();
+    }
+
+    // every climber runs single-threaded, more climbers than threads take turns
+    int num_workers = min(num_climbers, max(num_threads, 1));
+    initProgress(num_climbers, "Running hill-climbers", "finished", "climber");
+#pragma omp parallel for schedule(dynamic) num_threads(num_workers)
+    for (int i = 0; i < num_climbers; i++) {
+        IQTree *climber = climbers[i];
+        climber->readTreeString(trees[i]);
+        climber->initializeAllPartialLh();
+        climber->clearAllPartialLH();
+        climber->computeLogL();
+        climber->optimizeNNIAndLazySPR();
+        trees[i] = climber->getTreeString();
+        scores[i] = climber->getCurScore();
+#pragma omp critical
+        trackProgress(1);
+    }
+    doneProgress();
+
+    // continue from the best climber's tree, with the model re-optimized on it
+    int best = max_element(scores.begin(), scores.end()) - scores.begin();
+    readTreeString(trees[best]);
+    computeLogL();
+    optimizeModelParameters(false, params->modelEps * 10);
+    if (getCurScore() > curBestScore + params->modelEps) {
+        getModelFactory()->saveCheckpoint();
+    }
+    trees[best] = getTreeString();
+    scores[best] = getCurScore();
+
+    for (int i = 0; i < num_climbers; i++) {
+        addTreeToCandidateSet(trees[i], scores[i], true, MPIHelper::getInstance().getProcessID());
+    }
+    MPIHelper::getInstance().setNumNNISearch(MPIHelper::getInstance().getNumNNISearch() + num_climbers);
+#endif
+}
+
 double IQTree::doTreePerturbation() {
     if (iqp_assess_quartet == IQP_BOOTSTRAP) {
         // create bootstrap sample
-        Alignment *bootstrap_alignment;
-        if (aln->isSuperAlignment())
-            bootstrap_alignment = new SuperAlignment;
-        else
-            bootstrap_alignment = new Alignment;
-        bootstrap_alignment->createBootstrapAlignment(aln, NULL, params->bootstrap_spec);
-        setAlignment(bootstrap_alignment);
-        initializeAllPartialLh();
+        WeightedAlignmentView *bootstrap_view = NULL;
+        if (!aln->isSuperAlignment() && WeightedAlignmentView::isSupported(aln)) {
+            bootstrap_view = new WeightedAlignmentView(aln);
+            bootstrap_view->createBootstrapWeights(params->bootstrap_spec);
+        }
+        if (bootstrap_view && bootstrap_view->isDense()) {
+            // only reweight the patterns, restored in doTreeSearch
+            setAlignmentView(bootstrap_view);
+        } else {
+            Alignment *bootstrap_alignment;
+            if (bootstrap_view) {
+                bootstrap_alignment = bootstrap_view->createAlignment();
+                delete bootstrap_view;
+            } else {
+                if (aln->isSuperAlignment())
+                    bootstrap_alignment = new SuperAlignment;
+                else
+                    bootstrap_alignment = new Alignment;
+                bootstrap_alignment->createBootstrapAlignment(aln, NULL, params->bootstrap_spec);
+            }
+            setAlignment(bootstrap_alignment);
+            initializeAllPartialLh();
+        }
         clearAllPartialLH();
         curScore = optimizeAllBranches();
     } else {
@@ -2941,7 +3117,7 @@ pair<int, int> IQTree::doNNISearch(bool write_info) {
         readTreeString(string(pllInst->tree_string));
     } else {
         prepareToComputeDistances();
-        nniInfos = optimizeNNI(Params::getInstance().speednni);
+        nniInfos = optimizeNNIAndLazySPR();
         doneComputingDistances();
         if (isSuperTree()) {
             ((PhyloSuperTree*) this)->computeBranchLengths();
@@ -2970,6 +3146,22 @@ pair<int, int> IQTree::doNNISearch(bool write_info) {
     return nniInfos;
 }
 
+pair<int, int> IQTree::optimizeNNIAndLazySPR() {
+    if (params->lazy_spr_only && isLazySPRSupported())
+        return optimizeLazySPR();
+    pair<int, int> nniInfos = optimizeNNI(Params::getInstance().speednni);
+    if (params->lazy_spr_radius > 0 && isLazySPRSupported()) {
+        // SPR moves beyond the NNI neighbourhood, then NNIs around the new positions
+        pair<int, int> sprInfos = optimizeLazySPR();
+        if (sprInfos.second > 0) {
+            pair<int, int> moreInfos = optimizeNNI(Params::getInstance().speednni);
+            nniInfos.first += sprInfos.first + moreInfos.first;
+            nniInfos.second += sprInfos.second + moreInfos.second;
+        }
+    }
+    return nniInfos;
+}
+
 pair<int, int> IQTree::optimizeNNI(bool speedNNI) {
     unsigned int totalNNIApplied = 0;
     unsigned int numSteps = 0;
@@ -3132,6 +3324,10 @@ pair<int, int> IQTree::optimizeNNI(bool speedNNI) {
         cout << "NOTE: Input tree is already NNI-optimal" << endl;
     }
 
+    // counted since the start of the tree search
+    if (verbose_mode >= VB_MED)
+        mem_slots.reportStats(cout);
+
     if (numSteps == MAXSTEPS) {
         cout << "WARNING: NNI search needs unusual large number of steps (" << numSteps << ") to converge!" << endl;
     }
@@ -3143,6 +3339,175 @@ pair<int, int> IQTree::optimizeNNI(bool speedNNI) {
     return make_pair(numSteps, totalNNIApplied);
 }
 
+bool IQTree::isLazySPRSupported() {
+    return !isSuperTree() && !isMixlen() && !rooted && params->lh_mem_save == LM_PER_NODE &&
+        !params->pll && leafNum >= 5 && constraintTree.empty();
+}
+
+/** set the length of branch (node1, node2) in both directions */
+static void setBranchLength(Node *node1, Node *node2, double len) {
+    node1->findNeighbor(node2)->length = len;
+    node2->findNeighbor(node1)->length = len;
+}
+
+bool IQTree::applySPRMove(SPRMove &spr) {
+    PhyloNode *node = spr.prune_node;
+    PhyloNode *dad = spr.prune_dad;
+    double oldScore = curScore;
+    double node_len = node->findNeighbor(dad)->length;
+
+    PruningInfo info;
+    doSPR(spr, info);
+    optimizeOneBranch(dad, node, true, NNI_MAX_NR_STEP);
+    optimizeOneBranch(dad, spr.regraft_node, true, NNI_MAX_NR_STEP);
+    optimizeOneBranch(dad, spr.regraft_dad, true, NNI_MAX_NR_STEP);
+    optimizeOneBranch((PhyloNode*) info.left_node, (PhyloNode*) info.right_node, true, NNI_MAX_NR_STEP);
+    curScore = computeLikelihoodFromBuffer();
+    if (curScore > oldScore + params->loglh_epsilon)
+        return true;
+
+    // move back onto the joined branch and restore the old branch lengths
+    SPRMove undo = spr;
+    undo.regraft_node = (PhyloNode*) info.left_node;
+    undo.regraft_dad = (PhyloNode*) info.right_node;
+    PruningInfo undo_info;
+    doSPR(undo, undo_info);
+    setBranchLength(dad, info.left_node, info.left_len);
+    setBranchLength(dad, info.right_node, info.right_len);
+    setBranchLength(spr.regraft_node, spr.regraft_dad, info.in_len);
+    setBranchLength(dad, node, node_len);
+    clearAllPartialLH();
+    curScore = computeLikelihood();
+    return false;
+}
+
+pair<int, int> IQTree::optimizeLazySPR() {
+    int numRounds = 0;
+    int totalSPRApplied = 0;
+    const int MAXROUNDS = leafNum;
+    int radius = params->lazy_spr_radius;
+    bool parallel = false;
+#ifdef _OPENMP
+    parallel = (num_threads > 1 && save_all_trees != 2 && isThreadTreeSupported());
+#endif
+
+    for (numRounds = 1; numRounds <= MAXROUNDS; numRounds++) {
+        double oldScore = curScore;
+        if (save_all_trees == 2) {
+            saveCurrentTree(curScore); // BQM: for new bootstrap
+        }
+
+        NodeVector nodes;
+        getAllNodes(nodes);
+        NodeVector node_by_id(nodeNum, NULL);
+        for (auto node : nodes)
+            node_by_id[node->id] = node;
+
+        // prune points: every node attached to an internal node of degree 3
+        vector<pair<int,int> > candidates;
+        for (auto dad : nodes) {
+            if (dad->isLeaf() || dad->degree() != 3)
+                continue;
+            FOR_NEIGHBOR_DECLARE(dad, NULL, it)
+                candidates.push_back(make_pair((*it)->node->id, dad->id));
+        }
+
+        int numApplied = 0;
+        if (!parallel) {
+            for (auto cand : candidates) {
+                PhyloNode *node = (PhyloNode*) node_by_id[cand.first];
+                PhyloNode *dad = (PhyloNode*) node_by_id[cand.second];
+                // an earlier move in this round may have changed the prune point
+                if (!node->isNeighbor(dad) || dad->degree() != 3)
+                    continue;
+                SPRMove spr = getBestSPRForSubtree(node, dad, radius);
+                if (spr.regraft_node && spr.score > curScore + params->loglh_epsilon && applySPRMove(spr))
+                    numApplied++;
+            }
+        }
+#ifdef _OPENMP
+        else {
+            // score all prune points on per-thread copies of the current tree
+            int num_workers = num_threads;
+            vector<PhyloTree*> workers(num_workers, NULL);
+            vector<NodeVector> worker_nodes(num_workers);
+            for (int t = 0; t < num_workers; t++)
+                workers[t] = newThreadTree(worker_nodes[t]);
+
+            vector<SPRMove> bestSPRs(candidates.size());
+#pragma omp parallel for schedule(dynamic) num_threads(num_workers)
+            for (int i = 0; i < candidates.size(); i++) {
+                int t = omp_get_thread_num();
+                bestSPRs[i] = workers[t]->getBestSPRForSubtree(
+                    (PhyloNode*) worker_nodes[t][candidates[i].first],
+                    (PhyloNode*) worker_nodes[t][candidates[i].second], radius);
+            }
+
+            vector<SPRMove> positiveSPRs;
+            for (auto spr : bestSPRs) {
+                if (!spr.regraft_node || spr.score <= curScore + params->loglh_epsilon)
+                    continue;
+                spr.prune_node = (PhyloNode*) node_by_id[spr.prune_node->id];
+                spr.prune_dad = (PhyloNode*) node_by_id[spr.prune_dad->id];
+                spr.regraft_node = (PhyloNode*) node_by_id[spr.regraft_node->id];
+                spr.regraft_dad = (PhyloNode*) node_by_id[spr.regraft_dad->id];
+                positiveSPRs.push_back(spr);
+            }
+            for (int t = 0; t < num_workers; t++) {
+                workers[t]->setModelFactory(NULL);
+                delete workers[t];
+            }
+            sort(positiveSPRs.begin(), positiveSPRs.end(), SPR_compare());
+
+            // apply the best moves first, skipping those around an earlier move
+            vector<bool> touched(nodeNum, false);
+            for (auto spr : positiveSPRs) {
+                PhyloNode *node = spr.prune_node;
+                PhyloNode *dad = spr.prune_dad;
+                if (touched[node->id] || touched[dad->id] ||
+                    touched[spr.regraft_node->id] || touched[spr.regraft_dad->id])
+                    continue;
+                if (!node->isNeighbor(dad) || dad->degree() != 3 ||
+                    !spr.regraft_node->isNeighbor(spr.regraft_dad))
+                    continue;
+                bool conflict = false;
+                FOR_NEIGHBOR_IT(dad, node, it)
+                    if (touched[(*it)->node->id])
+                        conflict = true;
+                if (conflict)
+                    continue;
+                // the regraft branch may have been moved into the pruned subtree
+                NodeVector subtree;
+                getAllNodesInSubtree(node, dad, subtree);
+                if (find(subtree.begin(), subtree.end(), spr.regraft_dad) != subtree.end())
+                    continue;
+                FOR_NEIGHBOR_IT(dad, node, it)
+                    touched[(*it)->node->id] = true;
+                if (applySPRMove(spr))
+                    numApplied++;
+                touched[node->id] = touched[dad->id] = true;
+                touched[spr.regraft_node->id] = touched[spr.regraft_dad->id] = true;
+            }
+        }
+#endif
+
+        totalSPRApplied += numApplied;
+        if (numApplied > 0)
+            curScore = optimizeAllBranches(1, params->loglh_epsilon, PLL_NEWZPERCYCLE);
+        if (verbose_mode >= VB_MED)
+            cout << "Lazy SPR round " << numRounds << ": " << numApplied << " moves, logL: " << curScore << endl;
+        if (numApplied == 0 || curScore - oldScore < params->loglh_epsilon)
+            break;
+
+        if (Params::getInstance().write_intermediate_trees && save_all_trees != 2) {
+            printIntermediateTree(WT_NEWLINE | WT_APPEND | WT_SORT_TAXA | WT_BR_LEN);
+        }
+    }
+    if (numRounds > MAXROUNDS)
+        numRounds = MAXROUNDS;
+    return make_pair(numRounds, totalSPRApplied);
+}
+
 void IQTree::filterNNIBranches(vector<NNIMove> &appliedNNIs, Branches &nniBranches) {
     for (vector<NNIMove>::iterator it = appliedNNIs.begin(); it != appliedNNIs.end(); it++) {
         Branch curBranch;
@@ -3248,7 +3613,7 @@ void IQTree::pllInitUFBootData(){
                 if(!pllUFBootDataPtr->boot_samples[i]) outError("Not enough dynamic memory!");
                 for(int j = 0; j < pllAlignment->sequenceLength; j++){
                     pllUFBootDataPtr->boot_samples[i][j] =
-                        boot_samples[i][pll2iqtree_pattern_index[j]];
+                        boot_samples.getWeight(i, pll2iqtree_pattern_index[j]);
                 }
             }
 
@@ -3399,6 +3764,15 @@ void IQTree::setDelete(int _delete) {
 }
 
 void IQTree::evaluateNNIs(Branches &nniBranches, vector<NNIMove>  &positiveNNIs) {
+#ifdef _OPENMP
+    // branch-level parallelism: only for single-model reversible trees whose
+    // NNI evaluation does not write back into shared state (UFBoot, -mem)
+    if (params->nni_parallel && num_threads > 1 && nniBranches.size() >= 2*num_threads &&
+        save_all_trees != 2 && isThreadTreeSupported()) {
+        evaluateNNIsParallel(nniBranches, positiveNNIs);
+        return;
+    }
+#endif
     for (Branches::iterator it = nniBranches.begin(); it != nniBranches.end(); it++) {
         NNIMove nni = getBestNNIForBran((PhyloNode*) it->second.first, (PhyloNode*) it->second.second, NULL);
         if (nni.newloglh > curScore) {
@@ -3413,6 +3787,204 @@ void IQTree::evaluateNNIs(Branches &nniBranches, vector<NNIMove>  &positiveNNIs)
     }
 }
 
+/**
+    copy the topology and branch lengths of src into dest, keeping the node IDs
+    and the order of neighbors, so that nodes and neighbor iterators of dest
+    can be mapped back to src by ID and position
+    @param dest empty destination tree
+    @param src source tree
+    @param[out] dest_nodes nodes of dest indexed by node ID
+*/
+static void copyTreeKeepIDs(PhyloTree *dest, PhyloTree *src, NodeVector &dest_nodes) {
+    NodeVector src_nodes;
+    src->getAllNodes(src_nodes);
+    dest_nodes.assign(src->nodeNum, NULL);
+    for (auto node : src_nodes) {
+        ASSERT(node->id >= 0 && node->id < src->nodeNum && !dest_nodes[node->id]);
+        dest_nodes[node->id] = dest->newNode(node->id, node->name.c_str());
+    }
+    for (auto node : src_nodes) {
+        for (auto nei : node->neighbors)
+            dest_nodes[node->id]->addNeighbor(dest_nodes[nei->node->id], nei->length, nei->id);
+    }
+    dest->root = dest_nodes[src->root->id];
+    dest->leafNum = src->leafNum;
+    dest->nodeNum = src->nodeNum;
+    dest->branchNum = src->branchNum;
+    dest->rooted = src->rooted;
+    if (dest->rooted)
+        dest->computeBranchDirection();
+}
+
+bool IQTree::isThreadTreeSupported() {
+    return !isSuperTree() && !isMixlen() && !params->pll && params->lh_mem_save != LM_MEM_SAVE &&
+        getModel()->useRevKernel() && !getModel()->isSiteSpecificModel();
+}
+
+PhyloTree *IQTree::newThreadTree(NodeVector &nodes) {
+    PhyloTree *tree = new PhyloTree(aln);
+    initThreadTree(tree, nodes);
+    return tree;
+}
+
+void IQTree::initThreadTree(PhyloTree *tree, NodeVector &nodes) {
+    copyTreeKeepIDs(tree, this, nodes);
+    tree->setAlignment(aln);
+    tree->setParams(params);
+    if (!constraintTree.empty())
+        tree->constraintTree.readConstraint(constraintTree);
+    tree->optimize_by_newton = optimize_by_newton;
+    tree->safe_numeric_fallback = safe_numeric_fallback;
+    tree->float_partial_lh_overflow = float_partial_lh_overflow;
+    tree->sse = sse;
+    tree->setModelFactory(getModelFactory());
+    tree->setNumThreads(1);
+    tree->initializeAllPartialLh();
+    if (ptn_freq_computed) {
+        // pattern frequencies may differ from the alignment (e.g. bootstrap)
+        tree->computePtnFreq();
+        memcpy(tree->ptn_freq, ptn_freq, sizeof(double)*aln->getNPattern());
+    }
+    tree->setCurScore(curScore);
+}
+
+void IQTree::mergeThreadTreeState(PhyloTree *tree) {
+    if (tree->safe_numeric_fallback && !safe_numeric)
+        switchToSafeNumeric();
+    // switched at the next computeLikelihood
+    if (tree->float_partial_lh_overflow)
+        float_partial_lh_overflow = true;
+}
+
+void IQTree::syncNNIThreadTrees(int num_workers) {
+    for (size_t t = 0; t < nni_thread_trees.size(); t++) {
+        PhyloTree *tree = nni_thread_trees[t];
+        if (tree->aln == aln && tree->getModelFactory() == getModelFactory() &&
+            tree->safe_numeric_fallback == safe_numeric_fallback &&
+            tree->float_partial_lh_overflow == float_partial_lh_overflow)
+            continue;
+        // alignment (bootstrap), model or kernel changed: start from scratch
+        deleteNNIThreadTrees();
+        break;
+    }
+    nni_thread_nodes.resize(num_workers);
+    for (int t = 0; t < num_workers; t++) {
+        if (t >= nni_thread_trees.size()) {
+            nni_thread_trees.push_back(newThreadTree(nni_thread_nodes[t]));
+            continue;
+        }
+        // replace the nodes only, initializeAllPartialLh reuses the buffers
+        PhyloTree *tree = nni_thread_trees[t];
+        tree->freeNode();
+        tree->root = NULL;
+        copyTreeKeepIDs(tree, this, nni_thread_nodes[t]);
+        tree->initializeAllPartialLh();
+        if (ptn_freq_computed)
+            memcpy(tree->ptn_freq, ptn_freq, sizeof(double)*aln->getNPattern());
+        tree->setCurScore(curScore);
+    }
+}
+
+void IQTree::deleteNNIThreadTrees() {
+    for (auto tree : nni_thread_trees) {
+        tree->setModelFactory(NULL);
+        delete tree;
+    }
+    nni_thread_trees.clear();
+    nni_thread_nodes.clear();
+}
+
+void IQTree::computeAllNNIPatternLh(double best_score, BranchVector &branches, double *lh, double *pattern_lh) {
+#ifdef _OPENMP
+    if (num_threads > 1 && branches.size() > 1 && !omp_in_parallel() && isThreadTreeSupported()) {
+        size_t nptn = getAlnNPattern();
+        int num_workers = min(num_threads, (int)branches.size());
+        vector<PhyloTree*> workers(num_workers, NULL);
+        vector<NodeVector> worker_nodes(num_workers);
+        for (int t = 0; t < num_workers; t++)
+            workers[t] = newThreadTree(worker_nodes[t]);
+
+        bool nni5 = params->nni5;
+        params->nni5 = true; // always optimize 5 branches for accurate SH-aLRT
+        #pragma omp parallel for schedule(static) num_threads(num_workers)
+        for (size_t i = 0; i < branches.size(); i++) {
+            int t = omp_get_thread_num();
+            NodeVector &wnodes = worker_nodes[t];
+            NNIMove nniMoves[2];
+            nniMoves[0].ptnlh = pattern_lh + 2*i*nptn;
+            nniMoves[1].ptnlh = pattern_lh + (2*i+1)*nptn;
+            nniMoves[0].node1 = nniMoves[1].node1 = NULL;
+            nniMoves[0].node2 = nniMoves[1].node2 = NULL;
+            workers[t]->getBestNNIForBran((PhyloNode*)wnodes[branches[i].second->id],
+                (PhyloNode*)wnodes[branches[i].first->id], nniMoves);
+            lh[2*i] = nniMoves[0].newloglh;
+            lh[2*i+1] = nniMoves[1].newloglh;
+        }
+        params->nni5 = nni5;
+
+        for (int t = 0; t < num_workers; t++) {
+            workers[t]->setModelFactory(NULL);
+            delete workers[t];
+        }
+        for (size_t i = 0; i < branches.size(); i++)
+            if (max(lh[2*i], lh[2*i+1]) > best_score + TOL_LIKELIHOOD)
+                cout << "Alternative NNI shows better log-likelihood " << max(lh[2*i], lh[2*i+1]) << " > " << best_score << endl;
+        return;
+    }
+#endif
+    PhyloTree::computeAllNNIPatternLh(best_score, branches, lh, pattern_lh);
+}
+
+void IQTree::evaluateNNIsParallel(Branches &nniBranches, vector<NNIMove> &positiveNNIs) {
+#ifdef _OPENMP
+    int num_workers = num_threads;
+    NodeVector nodes;
+    getAllNodes(nodes);
+    NodeVector node_by_id(nodeNum, NULL);
+    for (auto node : nodes)
+        node_by_id[node->id] = node;
+
+    // one tree copy per thread, sharing the model but with own buffers
+    syncNNIThreadTrees(num_workers);
+    vector<PhyloTree*> &workers = nni_thread_trees;
+    vector<NodeVector> &worker_nodes = nni_thread_nodes;
+
+    vector<Branch> branches;
+    branches.reserve(nniBranches.size());
+    for (auto it = nniBranches.begin(); it != nniBranches.end(); it++)
+        branches.push_back(it->second);
+    vector<NNIMove> nniMoves(branches.size());
+
+    // static schedule: neighboring branches go to the same thread to reuse partials
+    #pragma omp parallel for schedule(static) num_threads(num_workers)
+    for (size_t i = 0; i < branches.size(); i++) {
+        int t = omp_get_thread_num();
+        NodeVector &wnodes = worker_nodes[t];
+        nniMoves[i] = workers[t]->getBestNNIForBran((PhyloNode*)wnodes[branches[i].first->id],
+            (PhyloNode*)wnodes[branches[i].second->id], NULL);
+    }
+
+    // map moves back onto this tree
+    for (size_t i = 0; i < nniMoves.size(); i++) {
+        NNIMove &nni = nniMoves[i];
+        if (nni.newloglh <= curScore)
+            continue;
+        PhyloNode *node1 = (PhyloNode*)node_by_id[nni.node1->id];
+        PhyloNode *node2 = (PhyloNode*)node_by_id[nni.node2->id];
+        nni.node1Nei_it = node1->neighbors.begin() + (nni.node1Nei_it - nni.node1->neighbors.begin());
+        nni.node2Nei_it = node2->neighbors.begin() + (nni.node2Nei_it - nni.node2->neighbors.begin());
+        nni.node1 = node1;
+        nni.node2 = node2;
+        positiveNNIs.push_back(nni);
+    }
+
+    for (int t = 0; t < num_workers; t++)
+        mergeThreadTreeState(workers[t]);
+#else
+    ASSERT(0 && "evaluateNNIsParallel requires OpenMP");
+#endif
+}
+
 //Branches IQTree::getReducedListOfNNIBranches(Branches &previousNNIBranches) {
 //    Branches resBranches;
 //    for (Branches::iterator it = previousNNIBranches.begin(); it != previousNNIBranches.end(); it++) {
@@ -3539,77 +4111,43 @@ void IQTree::saveCurrentTree(double cur_logl) {
 
 #ifdef BOOT_VAL_FLOAT
     int maxnptn = get_safe_upper_limit_float(nptn);
-    BootValType *pattern_lh = aligned_alloc<BootValType>(maxnptn);
+#else
+    int maxnptn = get_safe_upper_limit(nptn);
+#endif
+    BootValType *pattern_lh;
+    if (boot_samples.empty()) {
+        // for runGuidedBootstrap
+        pattern_lh = aligned_alloc<BootValType>(maxnptn);
+    } else {
+        // online bootstrap: the tree is scored on the replicates later, in a batch
+        if (maxnptn != saved_trees_maxnptn) {
+            flushSavedTrees();
+            if (saved_trees_pattern_lh)
+                aligned_free(saved_trees_pattern_lh);
+            saved_trees_pattern_lh = aligned_alloc<BootValType>((size_t)SAVED_TREE_BATCH * maxnptn);
+            saved_trees_maxnptn = maxnptn;
+        }
+        pattern_lh = saved_trees_pattern_lh + saved_trees.size() * (size_t)maxnptn;
+    }
     memset(pattern_lh, 0, maxnptn*sizeof(BootValType));
+#ifdef BOOT_VAL_FLOAT
     double *pattern_lh_orig = aligned_alloc<double>(nptn);
     computePatternLikelihood(pattern_lh_orig, &cur_logl);
     for (int i = 0; i < nptn; i++)
         pattern_lh[i] = (float)pattern_lh_orig[i];
 #else
-    int maxnptn = get_safe_upper_limit(nptn);
-    BootValType *pattern_lh = aligned_alloc<BootValType>(maxnptn);
-    memset(pattern_lh, 0, maxnptn*sizeof(BootValType));
     computePatternLikelihood(pattern_lh, &cur_logl);
 #endif
 
-
-    if (boot_samples.empty()) {
-        // for runGuidedBootstrap
-    } else {
-        // online bootstrap
-//        int ptn;
-//        int updated = 0;
-//        int nsamples = boot_samples.size();
+    if (!boot_samples.empty()) {
         ostringstream ostr;
-        string tree_str;
         setRootNode(params->root);
         if (params->print_ufboot_trees == 2)
             printTree(ostr, WT_TAXON_ID + WT_SORT_TAXA + WT_BR_LEN + WT_BR_LEN_SHORT);
         else
             printTree(ostr, WT_TAXON_ID + WT_SORT_TAXA);
-        tree_str = ostr.str();
-
-    #ifdef _OPENMP
-        int rand_seed = random_int(1000);
-        #pragma omp parallel
-        {
-        int *rstream;
-        init_random(rand_seed + omp_get_thread_num(), false, &rstream);
-        #pragma omp for
-    #else
-        int *rstream = randstream;
-    #endif
-        for (int sample = sample_start; sample < sample_end; sample++) {
-            double rell = 0.0;
-
-            {
-                // SSE optimized version of the above loop
-                BootValType *boot_sample = boot_samples[sample];
-
-                BootValType res = (this->*dotProduct)(pattern_lh, boot_sample, nptn);
-
-                rell = res;
-            }
-
-            bool better = rell > boot_logl[sample] + params->ufboot_epsilon;
-            if (!better && rell > boot_logl[sample] - params->ufboot_epsilon) {
-                better = (random_double(rstream) <= 1.0 / (boot_counts[sample] + 1));
-            }
-            if (better) {
-                if (rell <= boot_logl[sample] + params->ufboot_epsilon) {
-                    boot_counts[sample]++;
-                } else {
-                    boot_counts[sample] = 1;
-                }
-                boot_logl[sample] = max(boot_logl[sample], rell);
-                boot_orig_logl[sample] = cur_logl;
-                boot_trees[sample] = tree_str;
-            }
-        }
-    #ifdef _OPENMP
-        finish_random(rstream);
-        }
-    #endif
+        saved_trees.push_back(ostr.str());
+        saved_trees_logl.push_back(cur_logl);
     }
     if (Params::getInstance().print_tree_lh) {
         out_treelh << cur_logl;
@@ -3629,17 +4167,76 @@ void IQTree::saveCurrentTree(double cur_logl) {
         out_sitelh << endl;
     }
 
-    if (!boot_samples.empty()) {
 #ifdef BOOT_VAL_FLOAT
-        aligned_free(pattern_lh_orig);
+    aligned_free(pattern_lh_orig);
 #endif
+    if (boot_samples.empty())
         aligned_free(pattern_lh);
-    } else {
-#ifdef BOOT_VAL_FLOAT
-        aligned_free(pattern_lh);
+    else if (saved_trees.size() == SAVED_TREE_BATCH)
+        flushSavedTrees();
+}
+
+void IQTree::flushSavedTrees() {
+    int ntrees = saved_trees.size();
+    if (ntrees == 0)
+        return;
+    int nsamples = sample_end - sample_start;
+
+    // RELL log-likelihoods of all saved trees on all replicates in one pass over the weight matrix
+    DoubleVector rell_logl((size_t)ntrees * nsamples);
+    boot_samples.computeRELL(saved_trees_pattern_lh, ntrees, saved_trees_maxnptn, sample_start, sample_end, rell_logl.data());
+    // last saved tree that won each replicate, assigned to boot_trees after the parallel loop
+    IntVector better_tree(nsamples, -1);
+
+#ifdef _OPENMP
+    int rand_seed = random_int(1000);
+    #pragma omp parallel
+    {
+    int *rstream;
+    init_random(rand_seed + omp_get_thread_num(), false, &rstream);
+    #pragma omp for
+#else
+    int *rstream = randstream;
+#endif
+    for (int sample = sample_start; sample < sample_end; sample++) {
+        // trees in the order they were saved, as if each had been scored right away
+        for (int tree = 0; tree < ntrees; tree++) {
+            double rell = rell_logl[(size_t)tree * nsamples + sample - sample_start];
+
+            bool better = rell > boot_logl[sample] + params->ufboot_epsilon;
+            if (!better && rell > boot_logl[sample] - params->ufboot_epsilon) {
+                better = (random_double(rstream) <= 1.0 / (boot_counts[sample] + 1));
+            }
+            if (better) {
+                if (rell <= boot_logl[sample] + params->ufboot_epsilon) {
+                    boot_counts[sample]++;
+                } else {
+                    boot_counts[sample] = 1;
+                }
+                boot_logl[sample] = max(boot_logl[sample], rell);
+                boot_orig_logl[sample] = saved_trees_logl[tree];
+                better_tree[sample - sample_start] = tree;
+            }
+        }
+    }
+#ifdef _OPENMP
+    finish_random(rstream);
+    }
 #endif
+
+    // store each tree that won a replicate, in the order the trees were saved;
+    // a tree is assigned right after adding it, as boot_trees drops unreferenced trees
+    for (int tree = 0; tree < ntrees; tree++) {
+        if (find(better_tree.begin(), better_tree.end(), tree) == better_tree.end())
+            continue;
+        int tree_id = boot_trees.addTree(saved_trees[tree]);
+        for (int sample = sample_start; sample < sample_end; sample++)
+            if (better_tree[sample - sample_start] == tree)
+                boot_trees.setTreeID(sample, tree_id);
     }
 
+    saved_trees.clear();
+    saved_trees_logl.clear();
 }
 
 void IQTree::saveNNITrees(PhyloNode *node, PhyloNode *dad) {
@@ -3766,7 +4363,9 @@ void IQTree::writeUFBootTrees(Params &params) {
     filename += ".ufboot";
     ofstream out(filename.c_str());
 
-    trees.init(boot_trees, rooted);
+    IntVector sample_trees;
+    initBootTreeSet(trees, &sample_trees);
+    StrVector tree_strings(trees.size());
     for (i = 0; i < trees.size(); i++) {
         NodeVector taxa;
         // change the taxa name from ID to real name
@@ -3777,28 +4376,41 @@ void IQTree::writeUFBootTrees(Params &params) {
             // reinsert removed seqs into each tree
             trees[i]->insertTaxa(removed_seqs, twin_seqs);
         }
-        // now print to file
-        for (j = 0; j < trees.tree_weights[i]; j++)
-            if (params.print_ufboot_trees == 1)
-                trees[i]->printTree(out, WT_NEWLINE);
-            else
-                trees[i]->printTree(out, WT_NEWLINE + WT_BR_LEN);
+        stringstream ss;
+        if (params.print_ufboot_trees == 1)
+            trees[i]->printTree(ss, WT_NEWLINE);
+        else
+            trees[i]->printTree(ss, WT_NEWLINE + WT_BR_LEN);
+        tree_strings[i] = ss.str();
     }
+    // now print to file in the order of replicates
+    for (i = 0; i < sample_trees.size(); i++)
+        if (sample_trees[i] >= 0)
+            out << tree_strings[sample_trees[i]];
     cout << "UFBoot trees printed to " << filename << endl;
     out.close();
 }
 
+void IQTree::initBootTreeSet(MTreeSet &trees, IntVector *sample_trees) {
+    flushSavedTrees();
+    StrVector distinct_trees;
+    IntVector counts;
+    boot_trees.getDistinctTrees(distinct_trees, counts, sample_trees);
+    trees.init(distinct_trees, rooted);
+    trees.tree_weights = counts;
+}
+
 void IQTree::summarizeBootstrap(Params &params) {
     setRootNode(params.root);
     MTreeSet trees;
-    trees.init(boot_trees, rooted);
+    initBootTreeSet(trees);
     summarizeBootstrap(params, trees);
 }
 
 void IQTree::summarizeBootstrap(SplitGraph &sg) {
     MTreeSet trees;
     //SplitGraph sg;
-    trees.init(boot_trees, rooted);
+    initBootTreeSet(trees);
     SplitIntMap hash_ss;
     // make the taxa name
     vector<string> taxname;
@@ -3823,8 +4435,9 @@ void IQTree::pllConvertUFBootData2IQTree(){
 
     //boot_trees
     boot_trees.clear();
+    boot_trees.resize(params->gbo_replicates);
     for(int i = 0; i < params->gbo_replicates; i++)
-        boot_trees.push_back(pllUFBootDataPtr->boot_trees[i]);
+        boot_trees.setTree(i, pllUFBootDataPtr->boot_trees[i]);
 
 }
 
@@ -32,12 +32,17 @@
 #include "mtreeset.h"
 #include "node.h"
 #include "candidateset.h"
+#include "ufbootweights.h"
+#include "boottreestore.h"
 #include "utils/pllnni.h"
 
 typedef std::map< string, double > mapString2Double;
 typedef std::multiset< double, std::less< double > > multiSetDB;
 typedef std::multiset< int, std::less< int > > MultiSetInt;
 
+/** number of trees saved by IQTree::saveCurrentTree() that are scored on the UFBoot replicates together */
+#define SAVED_TREE_BATCH 16
+
 class RepLeaf {
 public:
     Node *leaf;
@@ -317,6 +322,19 @@ public:
      */
     virtual double doTreeSearch();
 
+    /**
+            @return TRUE if params->num_climbers hill-climbers can run in parallel threads
+     */
+    bool isClimberSearchSupported();
+
+    /**
+            one iteration for each hill-climber: perturb a candidate tree on the main thread,
+            then optimize the perturbed trees by NNI in parallel, each on its own tree copy
+            sharing the model, and add them to the candidate set
+            @param climbers one tree copy per hill-climber (see initThreadTree)
+     */
+    void doClimberIterations(vector<IQTree*> &climbers);
+
     /**
      *  Wrapper function that uses either PLL or IQ-TREE to optimize the branch length
      *  @param maxTraversal
@@ -350,6 +368,29 @@ public:
      */
     virtual pair<int, int> optimizeNNI(bool speedNNI = true);
 
+    /**
+     *  Optimize current tree using lazy SPR moves within radius params->lazy_spr_radius
+     *  (see PhyloTree::getBestSPRForSubtree). With several threads, the prune points
+     *  are evaluated in parallel on copies of the tree.
+     *
+     *  @return
+     *      <number of SPR rounds, number of SPR moves> done
+     */
+    pair<int, int> optimizeLazySPR();
+
+    /**
+     *  Optimize current tree using NNI, followed by lazy SPR if switched on
+     *
+     *  @return
+     *      <number of steps, number of moves> done
+     */
+    pair<int, int> optimizeNNIAndLazySPR();
+
+    /**
+     *  @return TRUE if the lazy SPR search can be used for this tree
+     */
+    bool isLazySPRSupported();
+
     /**
      *  Return the current best score found
      */
@@ -449,6 +490,78 @@ public:
      */
     void evaluateNNIs(Branches &nniBranches, vector<NNIMove> &outNNIMoves);
 
+    /**
+     * @brief Evaluate NNIs on \a nniBranches in parallel over branches (--nni-parallel).
+     * Each thread works on its own copy of the tree, with its own partial likelihood
+     * and NNI scratch buffers; the moves found are mapped back onto this tree.
+     *
+     * @param nniBranches [IN] branches the branches on which NNIs will be evaluated
+     * @return list positive NNIs
+     */
+    void evaluateNNIsParallel(Branches &nniBranches, vector<NNIMove> &outNNIMoves);
+
+    /**
+     * @brief compute NNI pattern log-likelihoods for SH-aLRT, spreading the branches
+     * over per-thread copies of the tree, see PhyloTree::computeAllNNIPatternLh
+     */
+    virtual void computeAllNNIPatternLh(double best_score, BranchVector &branches, double *lh, double *pattern_lh);
+
+    /**
+     * @brief create a copy of the current tree for one thread, sharing the model
+     * but with its own partial likelihood buffers
+     *
+     * @param[out] nodes nodes of the copy indexed by node ID
+     * @return the copy, to be deleted after setModelFactory(NULL)
+     */
+    PhyloTree *newThreadTree(NodeVector &nodes);
+
+    /**
+     * @brief set up tree as a copy of the current tree for one thread, see newThreadTree
+     *
+     * @param tree a newly created tree
+     * @param[out] nodes nodes of the copy indexed by node ID
+     */
+    void initThreadTree(PhyloTree *tree, NodeVector &nodes);
+
+    /**
+     * @return TRUE if the log-likelihood can be computed on copies made by newThreadTree
+     */
+    bool isThreadTreeSupported();
+
+    /**
+     * @brief take over the numerical fallbacks (safe kernel, double-precision partial
+     * likelihoods) that a thread copy switched to
+     *
+     * @param tree a copy made by newThreadTree
+     */
+    void mergeThreadTreeState(PhyloTree *tree);
+
+    /**
+     * @brief make nni_thread_trees copies of the current tree again, creating missing ones;
+     * the partial likelihood buffers of existing copies are kept
+     *
+     * @param num_workers number of copies needed
+     */
+    void syncNNIThreadTrees(int num_workers);
+
+    /** delete nni_thread_trees, at the end of the tree search */
+    void deleteNNIThreadTrees();
+
+    /** per-thread copies of the tree for evaluateNNIsParallel, kept across NNI rounds */
+    vector<PhyloTree*> nni_thread_trees;
+
+    /** nodes of nni_thread_trees indexed by node ID */
+    vector<NodeVector> nni_thread_nodes;
+
+    /**
+     * @brief apply an SPR move and optimize the four branches around it,
+     * the move is undone if the log-likelihood does not improve
+     *
+     * @param spr the move
+     * @return TRUE if the move was kept
+     */
+    bool applySPRMove(SPRMove &spr);
+
     double optimizeNNIBranches(Branches &nniBranches);
 
     /**
@@ -717,6 +830,14 @@ public:
      */
     void initCandidateTreeSet(int nParTrees, int nNNITrees);
 
+    /**
+     *  Optimize branch lengths of the initial trees in parallel, each thread working on its
+     *  own copy of the tree, and add them to the candidate set
+     *  @param trees initial trees
+     *  @param init_size number of trees at the beginning of trees that only need their log-likelihood
+     */
+    void optimizeInitialTreesParallel(vector<string> &trees, int init_size);
+
     /**
      * Generate the initial tree (usually used for model parameter estimation)
      */
@@ -771,8 +892,8 @@ public:
     /** log-likelihood threshold (l_min) */
     double logl_cutoff;
 
-    /** vector of bootstrap alignments generated */
-    vector<BootValType* > boot_samples;
+    /** pattern weights of the bootstrap alignments generated */
+    UFBootWeights boot_samples;
 
     /** starting sample for UFBoot, used for MPI */
     int sample_start;
@@ -780,8 +901,8 @@ public:
     /** end sample for UFBoot, used for MPI */
     int sample_end;
 
-    /** newick string of corresponding bootstrap trees */
-    StrVector boot_trees;
+    /** newick string of corresponding bootstrap trees, each distinct tree stored once */
+    BootTreeStore boot_trees;
 
     /** bootstrap tree strings with branch lengths, for -wbtl option */
 //    StrVector boot_trees_brlen;
@@ -795,6 +916,18 @@ public:
     /** corresponding log-likelihood on original alignment */
     DoubleVector boot_orig_logl;
 
+    /** trees saved by saveCurrentTree(), not yet scored on the UFBoot replicates */
+    StrVector saved_trees;
+
+    /** log-likelihoods of saved_trees on the original alignment */
+    DoubleVector saved_trees_logl;
+
+    /** pattern log-likelihoods of saved_trees, saved_trees_maxnptn apart */
+    BootValType *saved_trees_pattern_lh;
+
+    /** number of patterns (padded) per tree in saved_trees_pattern_lh */
+    int saved_trees_maxnptn;
+
     /** Set of splits occurring in bootstrap trees */
     vector<SplitGraph*> boot_splits;
 
@@ -807,6 +940,13 @@ public:
     /** Corresponding map for set of splits occurring in bootstrap trees */
     //SplitIntMap boot_splits_map;
 
+    /**
+        convert the distinct bootstrap trees into a tree set, weighted by their number of replicates
+        @param[out] trees tree set
+        @param[out] sample_trees if not NULL, index into trees of each replicate (-1 if none)
+    */
+    void initBootTreeSet(MTreeSet &trees, IntVector *sample_trees = NULL);
+
     /** summarize all bootstrap trees */
     void summarizeBootstrap(Params &params, MTreeSet &trees);
 
@@ -855,6 +995,12 @@ protected:
 
     virtual void saveCurrentTree(double logl); // save current tree
 
+    /**
+        compute the RELL log-likelihoods of the trees saved by saveCurrentTree() since the
+        last call on all UFBoot replicates in one batch, and update the UFBoot trees
+    */
+    void flushSavedTrees();
+
 
     void saveNNITrees(PhyloNode *node = NULL, PhyloNode *dad = NULL);
 
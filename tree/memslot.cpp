@@ -30,8 +30,9 @@ void MemSlotVector::init(PhyloTree *tree, int num_slot) {
         return;
     reserve(num_slot+2);
     resize(num_slot);
-    size_t lh_size = tree->getPartialLhSize();
+    size_t lh_size = tree->getPartialLhBytes()/sizeof(double);
     size_t scale_size = tree->getScaleNumSize();
+    num_patterns = tree->aln->getNPattern();
     reset();
     for (iterator it = begin(); it != end(); it++) {
         it->partial_lh = tree->central_partial_lh + lh_size*(it-begin());
@@ -45,11 +46,55 @@ void MemSlotVector::reset() {
     for (iterator it = begin(); it != end(); it++) {
         it->status = 0;
         it->nei = NULL;
+        it->priority = 0.0;
     }
     nei_id_map.clear();
     free_count = 0;
+    inflation = 0.0;
+    evicted_neis.clear();
 }
 
+void MemSlotVector::resetStats() {
+    num_hits = num_misses = num_recomputes = num_evictions = 0;
+}
+
+void MemSlotVector::reportStats(ostream &out) {
+    if (Params::getInstance().lh_mem_save != LM_MEM_SAVE)
+        return;
+    int64_t num_access = num_hits + num_misses;
+    out << "Partial likelihood slots: " << size() << ", hits: " << num_hits
+        << " (" << ((num_access > 0) ? num_hits*100.0/num_access : 0.0) << "%)"
+        << ", misses: " << num_misses << ", recomputes: " << num_recomputes
+        << ", evictions: " << num_evictions << endl;
+}
+
+double MemSlotVector::getCost(PhyloNeighbor *nei) {
+    return (double)max(nei->size, 1) * num_patterns;
+}
+
+void MemSlotVector::touch(iterator it) {
+    it->priority = inflation + getCost(it->nei);
+}
+
+void MemSlotVector::hit(PhyloNeighbor *nei) {
+    if (Params::getInstance().lh_mem_save != LM_MEM_SAVE)
+        return;
+    if (nei->node->isLeaf())
+        return;
+    num_hits++;
+    iterator it = findNei(nei);
+    if ((it->status & MEM_SPECIAL) == 0)
+        touch(it);
+}
+
+
+void MemSlotVector::miss(PhyloNeighbor *nei) {
+    if (Params::getInstance().lh_mem_save != LM_MEM_SAVE)
+        return;
+    num_misses++;
+    if (!evicted_neis.empty() && evicted_neis.erase(nei))
+        num_recomputes++;
+}
 
 MemSlotVector::iterator MemSlotVector::findNei(PhyloNeighbor *nei) {
     auto it = nei_id_map.find(nei);
@@ -139,32 +184,37 @@ int MemSlotVector::allocate(PhyloNeighbor *nei) {
         iterator it = begin() + free_count;
         ASSERT(it->nei == NULL);
         addNei(nei, it);
+        touch(it);
         free_count++;
         return it-begin();
     }
 
-    int min_size = INT_MAX;
+    double min_priority = DBL_MAX;
     iterator best = end();
 
-
-    // no free slot found, find an unlocked slot with minimal size
+    // no free slot found, find an unlocked slot with minimal priority
     for (iterator it = begin(); it != end(); it++)
-        if ((it->status & MEM_LOCKED) == 0 && (it->status & MEM_SPECIAL) == 0 && min_size > it->nei->size) {
+        if ((it->status & MEM_LOCKED) == 0 && (it->status & MEM_SPECIAL) == 0 && min_priority > it->priority) {
             best = it;
-            min_size = it->nei->size;
-            // 2 is the minimum size
-            if (min_size == 2)
-                break;
+            min_priority = it->priority;
         }
 
     if (best == end())
         return -1;
 
+    // the remaining slots age relative to the evicted one
+    inflation = min_priority;
+
     // clear mem assigned to it->nei
+    if (best->nei->partial_lh_computed & 1) {
+        num_evictions++;
+        evicted_neis.insert(best->nei);
+    }
     best->nei->clearPartialLh();
 
     // assign mem to nei
     addNei(nei, best);
+    touch(best);
     return best-begin();
 
 }
@@ -183,6 +233,8 @@ void MemSlotVector::update(PhyloNeighbor *nei) {
         // assign mem to nei
         addNei(nei, it);
     }
+    if ((it->status & MEM_SPECIAL) == 0)
+        touch(it);
 }
 
 /*
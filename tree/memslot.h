@@ -36,14 +36,27 @@ struct MemSlot {
     UBYTE *scale_num; // scale_num assigned to this slot
 
     PhyloNeighbor *saved_nei;
+
+    double priority; // GreedyDual priority: inflation at last use + recompute cost
 };
 
 /**
-    all memory slots, used for memory saving technique
+    all memory slots, used for memory saving technique.
+    When no slot is free, the unlocked slot with the lowest GreedyDual priority is evicted,
+    where the priority of a slot is the recompute cost of its partial likelihood
+    (subtree size times number of patterns) plus the cost of the last eviction at the time it was used.
+    Thus cheap and long unused partial likelihoods are evicted first.
 */
 class MemSlotVector : public vector<MemSlot> {
 public:
 
+    MemSlotVector() {
+        free_count = 0;
+        num_patterns = 0;
+        inflation = 0.0;
+        resetStats();
+    }
+
     /** initialize with a specified number of slots */
     void init(PhyloTree *tree, int num_slot);
 
@@ -93,8 +106,38 @@ public:
     /** restore neighbor, after calling replace */
     void restore(PhyloNeighbor *new_nei, PhyloNeighbor *old_nei);
 
+    /** record a partial likelihood found already computed in its slot */
+    void hit(PhyloNeighbor *nei);
+
+    /** record a partial likelihood that has to be computed, before allocate() or update() */
+    void miss(PhyloNeighbor *nei);
+
+    /** reset hit/miss/recompute counters, they are kept across init(), called at the start of each search phase */
+    void resetStats();
+
+    /** print hit/miss/recompute counters */
+    void reportStats(ostream &out);
+
+    /** number of partial likelihoods found computed */
+    int64_t num_hits;
+
+    /** number of partial likelihoods that had to be computed */
+    int64_t num_misses;
+
+    /** number of misses of partial likelihoods that were computed before but evicted */
+    int64_t num_recomputes;
+
+    /** number of computed partial likelihoods evicted from their slot */
+    int64_t num_evictions;
+
 protected:
 
+    /** recompute cost of the partial likelihood of nei */
+    double getCost(PhyloNeighbor *nei);
+
+    /** set priority of a slot after its use */
+    void touch(iterator it);
+
 
     /** 
         map from neighbor to slot ID for fast lookup
@@ -105,6 +148,15 @@ protected:
     /** counter of free slot ID */
     int free_count;
 
+    /** number of patterns, for the recompute cost */
+    size_t num_patterns;
+
+    /** GreedyDual inflation value: priority of the last evicted slot */
+    double inflation;
+
+    /** neighbors whose partial likelihood was evicted, to count recomputations */
+    unordered_set<PhyloNeighbor*> evicted_neis;
+
 };
 
 
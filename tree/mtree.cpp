@@ -1031,6 +1031,15 @@ void MTree::getAllNodesInSubtree(Node *node, Node *dad, NodeVector &nodeList) {
     }
 }
 
+void MTree::getAllNodes(NodeVector &nodes) {
+    ASSERT(root);
+    nodes.push_back(root);
+    // the root is usually a leaf, descend into its neighbor
+    FOR_NEIGHBOR_IT(root, NULL, it) {
+        getAllNodesInSubtree((*it)->node, root, nodes);
+    }
+}
+
 int MTree::getNumTaxa(Node *node, Node *dad) {
     int numLeaf = 0;
     if (!node) {
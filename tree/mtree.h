@@ -391,6 +391,12 @@ public:
      */
     void getAllNodesInSubtree(Node *node, Node *dad, NodeVector &nodeList);
 
+    /**
+     * get all nodes of the tree, starting from the root (also when the root is a leaf)
+     * @param nodes (OUT) vector containing all nodes
+     */
+    void getAllNodes(NodeVector &nodes);
+
     /**
      * get number of taxa below the node
      * @param node the starting node, NULL to start from the root
@@ -106,6 +106,41 @@ void PhyloTree::setLikelihoodKernelAVX512() {
         return;        
     }
 
+    if (float_partial_lh) {
+        // partial likelihoods stored in single precision, see isFloatPartialLhSupported()
+        computeLikelihoodDervMixlenPointer = NULL;
+        switch (aln->num_states) {
+        case 4:
+            if (safe_numeric) {
+                computeLikelihoodBranchPointer  = &PhyloTree::computeLikelihoodBranchSIMD <Vec8d, SAFE_LH, 4, true, false, true>;
+                computeLikelihoodDervPointer    = &PhyloTree::computeLikelihoodDervSIMD   <Vec8d, SAFE_LH, 4, true, false, true>;
+                computePartialLikelihoodPointer = &PhyloTree::computePartialLikelihoodSIMD<Vec8d, SAFE_LH, 4, true, false, true>;
+            } else {
+                computeLikelihoodBranchPointer  = &PhyloTree::computeLikelihoodBranchSIMD <Vec8d, NORM_LH, 4, true, false, true>;
+                computeLikelihoodDervPointer    = &PhyloTree::computeLikelihoodDervSIMD   <Vec8d, NORM_LH, 4, true, false, true>;
+                computePartialLikelihoodPointer = &PhyloTree::computePartialLikelihoodSIMD<Vec8d, NORM_LH, 4, true, false, true>;
+            }
+            computeLikelihoodFromBufferPointer = &PhyloTree::computeLikelihoodFromBufferSIMD<Vec8d, 4, true, false, true>;
+            break;
+        case 20:
+            if (safe_numeric) {
+                computeLikelihoodBranchPointer  = &PhyloTree::computeLikelihoodBranchSIMD <Vec8d, SAFE_LH, 20, true, false, true>;
+                computeLikelihoodDervPointer    = &PhyloTree::computeLikelihoodDervSIMD   <Vec8d, SAFE_LH, 20, true, false, true>;
+                computePartialLikelihoodPointer = &PhyloTree::computePartialLikelihoodSIMD<Vec8d, SAFE_LH, 20, true, false, true>;
+            } else {
+                computeLikelihoodBranchPointer  = &PhyloTree::computeLikelihoodBranchSIMD <Vec8d, NORM_LH, 20, true, false, true>;
+                computeLikelihoodDervPointer    = &PhyloTree::computeLikelihoodDervSIMD   <Vec8d, NORM_LH, 20, true, false, true>;
+                computePartialLikelihoodPointer = &PhyloTree::computePartialLikelihoodSIMD<Vec8d, NORM_LH, 20, true, false, true>;
+            }
+            computeLikelihoodFromBufferPointer = &PhyloTree::computeLikelihoodFromBufferSIMD<Vec8d, 20, true, false, true>;
+            break;
+        default:
+            ASSERT(0);
+            break;
+        }
+        return;
+    }
+
     if (safe_numeric) {
         switch(aln->num_states) {
         case 4:
@@ -1136,6 +1136,119 @@ inline void computeBounds(int threads, int packets, size_t elements, vector<size
             outError("Too many threads may slow down analysis [-nt option]. Reduce threads or use -nt AUTO to automatically determine it");
     }
 }
+
+/**
+    copy partial likelihoods for a vector of patterns that all repeat an earlier pattern
+    of the same packet, i.e. have the same tip states in the subtree (subtree repeats)
+    @param ptn_repeat previous pattern with the same subtree repeat class, -1 if none
+    @param ptn first pattern of the vector
+    @param ptn_lower first pattern of the packet
+    @return true if copied, false if the vector has to be computed
+*/
+template<class VectorClass, const bool SAFE_NUMERIC, const bool FLOAT_LH>
+inline bool copySubtreeRepeat(int *ptn_repeat, size_t ptn, size_t ptn_lower, size_t block, size_t ncat_mix,
+                              double *partial_lh, UBYTE *scale_num)
+{
+    int src_ptn[VectorClass::size()];
+    for (size_t x = 0; x < VectorClass::size(); x++) {
+        // go back to a pattern before this vector
+        int src = ptn_repeat[ptn+x];
+        while (src >= (int)ptn)
+            src = ptn_repeat[src];
+        if (src < (int)ptn_lower)
+            return false;
+        src_ptn[x] = src;
+    }
+    for (size_t x = 0; x < VectorClass::size(); x++) {
+        size_t src = src_ptn[x];
+        size_t src_addr = (src - src%VectorClass::size())*block + src%VectorClass::size();
+        size_t dest_addr = ptn*block + x;
+        if (FLOAT_LH) {
+            float *src_lh = (float*)partial_lh + src_addr;
+            float *dest_lh = (float*)partial_lh + dest_addr;
+            for (size_t i = 0; i < block; i++)
+                dest_lh[i*VectorClass::size()] = src_lh[i*VectorClass::size()];
+        } else {
+            double *src_lh = partial_lh + src_addr;
+            double *dest_lh = partial_lh + dest_addr;
+            for (size_t i = 0; i < block; i++)
+                dest_lh[i*VectorClass::size()] = src_lh[i*VectorClass::size()];
+        }
+        if (SAFE_NUMERIC)
+            memcpy(scale_num + (ptn+x)*ncat_mix, scale_num + src*ncat_mix, sizeof(UBYTE)*ncat_mix);
+        else
+            scale_num[ptn+x] = scale_num[src];
+    }
+    return true;
+}
+
+/**
+    get a vector of patterns of a partial likelihood vector in double precision
+    @param partial_lh partial likelihood vector of a neighbor
+    @param ptn first pattern of the vector
+    @param buffer block*VectorClass::size() doubles to convert into if stored in single precision
+    @return pointer to the partial likelihoods of the vector
+*/
+template<class VectorClass, const bool FLOAT_LH>
+inline double *loadPartialLh(double *partial_lh, size_t ptn, size_t block, double *buffer)
+{
+    if (!FLOAT_LH)
+        return partial_lh + ptn*block;
+    float *src = (float*)partial_lh + ptn*block;
+    size_t size = block*VectorClass::size();
+    for (size_t i = 0; i < size; i++)
+        buffer[i] = src[i];
+    return buffer;
+}
+
+/**
+    store a vector of patterns computed in double precision into a single-precision
+    partial likelihood vector; does nothing for double-precision storage.
+    The kernel tests the scaling threshold only once per node, so patterns are
+    rescaled here until they cannot underflow in single precision.
+    @param lh computed partial likelihoods of the vector
+    @param partial_lh partial likelihood vector of the neighbor
+    @param scale_num scale_num vector of the neighbor
+    @param ptn first pattern of the vector
+    @param invar ptn_invar vector
+    @return false if a scale_num reached SCALE_NUM_FLOAT_LIMIT, i.e. storage has to fall back to double
+*/
+template<class VectorClass, const bool SAFE_NUMERIC, const bool FLOAT_LH>
+inline bool storePartialLh(double *lh, double *partial_lh, UBYTE *scale_num, size_t ptn,
+                           size_t nstates, size_t ncat_mix, double *invar)
+{
+    if (!FLOAT_LH)
+        return true;
+    bool scale_ok = true;
+    size_t block = nstates*ncat_mix;
+    size_t nscale = SAFE_NUMERIC ? ncat_mix : 1;
+    size_t nvalues = SAFE_NUMERIC ? nstates : block;
+    UBYTE *scale_ptn = scale_num + ptn*nscale;
+    for (size_t x = 0; x < VectorClass::size(); x++) {
+        // BQM 2016-05-03: only scale for non-constant sites
+        if (invar[ptn+x] != 0.0)
+            continue;
+        for (size_t c = 0; c < nscale; c++) {
+            double *this_lh = lh + c*nvalues*VectorClass::size() + x;
+            double lh_max = 0.0;
+            for (size_t i = 0; i < nvalues; i++)
+                lh_max = max(lh_max, fabs(this_lh[i*VectorClass::size()]));
+            while (lh_max < SCALING_THRESHOLD_FLOAT && lh_max != 0.0) {
+                for (size_t i = 0; i < nvalues; i++)
+                    this_lh[i*VectorClass::size()] = ldexp(this_lh[i*VectorClass::size()], SCALING_THRESHOLD_FLOAT_EXP);
+                lh_max = ldexp(lh_max, SCALING_THRESHOLD_FLOAT_EXP);
+                scale_ptn[x*nscale+c] += 1;
+            }
+            if (scale_ptn[x*nscale+c] >= SCALE_NUM_FLOAT_LIMIT)
+                scale_ok = false;
+        }
+    }
+    float *dest = (float*)partial_lh + ptn*block;
+    size_t size = block*VectorClass::size();
+    for (size_t i = 0; i < size; i++)
+        dest[i] = lh[i];
+    return scale_ok;
+}
 #endif
 
 #ifdef KERNEL_FIX_STATES
@@ -1149,6 +1262,8 @@ void PhyloTree::computeTraversalInfo(PhyloNode *node, PhyloNode *dad, bool compu
         computeTipPartialLikelihood();
 
     traversal_info.clear();
+    subtree_repeat_traversal++;
+    subtree_repeats_retired.clear();
 #ifndef KERNEL_FIX_STATES
     size_t nstates = aln->num_states;
 #endif
@@ -1283,11 +1398,11 @@ void PhyloTree::computeTraversalInfo(PhyloNode *node, PhyloNode *dad, bool compu
  ******************************************************/
 
 #ifdef KERNEL_FIX_STATES
-template <class VectorClass, const bool SAFE_NUMERIC, const int nstates, const bool FMA, const bool SITE_MODEL>
+template <class VectorClass, const bool SAFE_NUMERIC, const int nstates, const bool FMA, const bool SITE_MODEL, const bool FLOAT_LH>
 void PhyloTree::computePartialLikelihoodSIMD(TraversalInfo &info
                                              , size_t ptn_lower, size_t ptn_upper, int packet_id)
 #else
-template <class VectorClass, const bool SAFE_NUMERIC, const bool FMA, const bool SITE_MODEL>
+template <class VectorClass, const bool SAFE_NUMERIC, const bool FMA, const bool SITE_MODEL, const bool FLOAT_LH>
 void PhyloTree::computePartialLikelihoodGenericSIMD(TraversalInfo &info
                                                     , size_t ptn_lower, size_t ptn_upper, int packet_id)
 #endif
@@ -1327,6 +1442,10 @@ void PhyloTree::computePartialLikelihoodGenericSIMD(TraversalInfo &info
     size_t block = nstates * ncat_mix;
     size_t tip_mem_size = max_orig_nptn * nstates;
     size_t scale_size = SAFE_NUMERIC ? (ptn_upper-ptn_lower) * ncat_mix : (ptn_upper-ptn_lower);
+    int *ptn_repeat = SITE_MODEL ? NULL : info.ptn_repeat;
+    // one unit of scale_num is a smaller step if stored in single precision
+    const double scaling_threshold = FLOAT_LH ? SCALING_THRESHOLD_FLOAT : SCALING_THRESHOLD;
+    const int scaling_threshold_exp = FLOAT_LH ? SCALING_THRESHOLD_FLOAT_EXP : SCALING_THRESHOLD_EXP;
 
 	double *evec = model->getEigenvectors();
 	double *inv_evec = model->getInverseEigenvectors();
@@ -1347,7 +1466,15 @@ void PhyloTree::computePartialLikelihoodGenericSIMD(TraversalInfo &info
 
     // precomputed buffer to save times
     size_t thread_buf_size        = (2*block+nstates)*VectorClass::size();
-    double *buffer_partial_lh_ptr = buffer_partial_lh + (getBufferPartialLhSize() - thread_buf_size*num_packets);
+    size_t float_buf_size         = FLOAT_LH ? 3*block*VectorClass::size() : 0;
+    double *buffer_partial_lh_ptr = buffer_partial_lh + (getBufferPartialLhSize() - (thread_buf_size+float_buf_size)*num_packets);
+    // per-thread vectors to convert dad, left and right partial likelihoods from/to single precision
+    double *lh_dad_buf = NULL, *lh_left_buf = NULL, *lh_right_buf = NULL;
+    if (FLOAT_LH) {
+        lh_dad_buf   = buffer_partial_lh_ptr + thread_buf_size*num_packets + float_buf_size*packet_id;
+        lh_left_buf  = lh_dad_buf + block*VectorClass::size();
+        lh_right_buf = lh_left_buf + block*VectorClass::size();
+    }
     double *echildren = NULL;
     double *partial_lh_leaves = NULL;
 
@@ -1409,6 +1536,9 @@ void PhyloTree::computePartialLikelihoodGenericSIMD(TraversalInfo &info
         double *vec_tip = (double*)&partial_lh_all[block];
 
         for (size_t ptn = ptn_lower; ptn < ptn_upper; ptn+=VectorClass::size()) {
+            if (ptn_repeat && copySubtreeRepeat<VectorClass, SAFE_NUMERIC, FLOAT_LH>(ptn_repeat, ptn, ptn_lower, block, ncat_mix,
+                                                                                     dad_branch->partial_lh, dad_branch->scale_num))
+                continue;
             for (size_t i = 0; i < block; i++){
                 partial_lh_all[i] = 1.0;
             }
@@ -1456,7 +1586,7 @@ void PhyloTree::computePartialLikelihoodGenericSIMD(TraversalInfo &info
                     } else {
                         // internal node
                         VectorClass *partial_lh = partial_lh_all;
-                        VectorClass *partial_lh_child = (VectorClass*)(child->partial_lh + ptn*block);
+                        VectorClass *partial_lh_child = (VectorClass*)loadPartialLh<VectorClass, FLOAT_LH>(child->partial_lh, ptn, block, lh_left_buf);
                         if (!SAFE_NUMERIC) {
                             for (size_t i = 0; i < VectorClass::size(); i++)
                                 dad_branch->scale_num[ptn+i] += child->scale_num[ptn+i];
@@ -1523,7 +1653,7 @@ void PhyloTree::computePartialLikelihoodGenericSIMD(TraversalInfo &info
                     } else {
                         // internal node
                         VectorClass *partial_lh = partial_lh_all;
-                        VectorClass *partial_lh_child = (VectorClass*)(child->partial_lh + ptn*block);
+                        VectorClass *partial_lh_child = (VectorClass*)loadPartialLh<VectorClass, FLOAT_LH>(child->partial_lh, ptn, block, lh_left_buf);
                         if (!SAFE_NUMERIC) {
                             for (size_t i = 0; i < VectorClass::size(); i++)
                                 dad_branch->scale_num[ptn+i] += child->scale_num[ptn+i];
@@ -1560,7 +1690,7 @@ void PhyloTree::computePartialLikelihoodGenericSIMD(TraversalInfo &info
                         for (size_t x = 0; x < nstates; x++)
                             lh_max = max(lh_max,abs(partial_lh_tmp[x]));
                         // check if one should scale partial likelihoods
-                        auto underflown = ((lh_max < SCALING_THRESHOLD) & (VectorClass().load_a(&ptn_invar[ptn]) == 0.0));
+                        auto underflown = ((lh_max < scaling_threshold) & (VectorClass().load_a(&ptn_invar[ptn]) == 0.0));
                         if (horizontal_or(underflown)) { // at least one site has numerical underflown
                             for (size_t x = 0; x < VectorClass::size(); x++)
                             if (underflown[x]) {
@@ -1568,7 +1698,7 @@ void PhyloTree::computePartialLikelihoodGenericSIMD(TraversalInfo &info
                                 // now do the likelihood scaling
                                 double *partial_lh = (double*)partial_lh_tmp + (x);
                                 for (size_t i = 0; i < nstates; i++)
-                                    partial_lh[i*VectorClass::size()] = ldexp(partial_lh[i*VectorClass::size()], SCALING_THRESHOLD_EXP);
+                                    partial_lh[i*VectorClass::size()] = ldexp(partial_lh[i*VectorClass::size()], scaling_threshold_exp);
                                 dad_branch->scale_num[(ptn+x)*ncat_mix+c] += 1;
                             }
                         }
@@ -1579,14 +1709,14 @@ void PhyloTree::computePartialLikelihoodGenericSIMD(TraversalInfo &info
                     VectorClass lh_max = 0.0;
                     for (size_t x = 0; x < block; x++)
                         lh_max = max(lh_max,abs(partial_lh_all[x]));
-                    auto underflown = (lh_max < SCALING_THRESHOLD) & (VectorClass().load_a(&ptn_invar[ptn]) == 0.0);
+                    auto underflown = (lh_max < scaling_threshold) & (VectorClass().load_a(&ptn_invar[ptn]) == 0.0);
                     if (horizontal_or(underflown)) { // at least one site has numerical underflown
                         for (size_t x = 0; x < VectorClass::size(); x++) {
                             if (underflown[x]) {
                                 double *partial_lh = (double*)partial_lh_all + (x);
                                 // now do the likelihood scaling
                                 for (size_t i = 0; i < block; i++) {
-                                    partial_lh[i*VectorClass::size()] = ldexp(partial_lh[i*VectorClass::size()], SCALING_THRESHOLD_EXP);
+                                    partial_lh[i*VectorClass::size()] = ldexp(partial_lh[i*VectorClass::size()], scaling_threshold_exp);
                                 }
                                 //                        sum_scale += LOG_SCALING_THRESHOLD * ptn_freq[ptn+x];
                                 dad_branch->scale_num[ptn+x] += 1;
@@ -1600,7 +1730,8 @@ void PhyloTree::computePartialLikelihoodGenericSIMD(TraversalInfo &info
         
             // compute dot-product with inv_eigenvector
             VectorClass *partial_lh_tmp = partial_lh_all;
-            VectorClass *partial_lh = (VectorClass*)(dad_branch->partial_lh + ptn*block);
+            double *lh_dad = FLOAT_LH ? lh_dad_buf : dad_branch->partial_lh + ptn*block;
+            VectorClass *partial_lh = (VectorClass*)lh_dad;
             VectorClass lh_max = 0.0;
             double *inv_evec_ptr = SITE_MODEL ? &inv_evec[ptn*states_square] : NULL;
             for (size_t c = 0; c < ncat_mix; c++) {
@@ -1622,6 +1753,9 @@ void PhyloTree::computePartialLikelihoodGenericSIMD(TraversalInfo &info
                 partial_lh += nstates;
                 partial_lh_tmp += nstates;
             }
+            if (!storePartialLh<VectorClass, SAFE_NUMERIC, FLOAT_LH>(lh_dad, dad_branch->partial_lh, dad_branch->scale_num, ptn,
+                                                                     nstates, ncat_mix, ptn_invar))
+                float_partial_lh_overflow = true;
 
         } // for ptn
 
@@ -1645,7 +1779,11 @@ void PhyloTree::computePartialLikelihoodGenericSIMD(TraversalInfo &info
         auto unknown = aln->STATE_UNKNOWN;
 
         for (size_t ptn = ptn_lower; ptn < ptn_upper; ptn+=VectorClass::size()) {
-            VectorClass *partial_lh = (VectorClass*)(dad_branch->partial_lh + ptn*block);
+            if (ptn_repeat && copySubtreeRepeat<VectorClass, SAFE_NUMERIC, FLOAT_LH>(ptn_repeat, ptn, ptn_lower, block, ncat_mix,
+                                                                                     dad_branch->partial_lh, dad_branch->scale_num))
+                continue;
+            double *lh_dad = FLOAT_LH ? lh_dad_buf : dad_branch->partial_lh + ptn*block;
+            VectorClass *partial_lh = (VectorClass*)lh_dad;
 
             if (SITE_MODEL) {
                 VectorClass* expleft = (VectorClass*) vec_left;
@@ -1739,6 +1877,9 @@ void PhyloTree::computePartialLikelihoodGenericSIMD(TraversalInfo &info
                     partial_lh += nstates;
                 } // FOR category
             } // IF SITE_MODEL
+            if (!storePartialLh<VectorClass, SAFE_NUMERIC, FLOAT_LH>(lh_dad, dad_branch->partial_lh, dad_branch->scale_num, ptn,
+                                                                     nstates, ncat_mix, ptn_invar))
+                float_partial_lh_overflow = true;
 		} // FOR LOOP
 
 
@@ -1762,8 +1903,12 @@ void PhyloTree::computePartialLikelihoodGenericSIMD(TraversalInfo &info
         auto unknown = aln->STATE_UNKNOWN;
         
         for (size_t ptn = ptn_lower; ptn < ptn_upper; ptn+=VectorClass::size()) {
-            VectorClass *partial_lh = (VectorClass*)(dad_branch->partial_lh + ptn*block);
-            VectorClass *partial_lh_right = (VectorClass*)(right->partial_lh + ptn*block);
+            if (ptn_repeat && copySubtreeRepeat<VectorClass, SAFE_NUMERIC, FLOAT_LH>(ptn_repeat, ptn, ptn_lower, block, ncat_mix,
+                                                                                     dad_branch->partial_lh, dad_branch->scale_num))
+                continue;
+            double *lh_dad = FLOAT_LH ? lh_dad_buf : dad_branch->partial_lh + ptn*block;
+            VectorClass *partial_lh = (VectorClass*)lh_dad;
+            VectorClass *partial_lh_right = (VectorClass*)loadPartialLh<VectorClass, FLOAT_LH>(right->partial_lh, ptn, block, lh_right_buf);
             VectorClass lh_max = 0.0;
 
             if (SITE_MODEL) {
@@ -1795,15 +1940,15 @@ void PhyloTree::computePartialLikelihoodGenericSIMD(TraversalInfo &info
 #endif
                     // check if one should scale partial likelihoods
                     if (SAFE_NUMERIC) {
-                        auto underflown = ((lh_max < SCALING_THRESHOLD) & (VectorClass().load_a(&ptn_invar[ptn]) == 0.0));
+                        auto underflown = ((lh_max < scaling_threshold) & (VectorClass().load_a(&ptn_invar[ptn]) == 0.0));
                         if (horizontal_or(underflown)) { // at least one site has numerical underflown
                             for (size_t x = 0; x < VectorClass::size(); x++)
                             if (underflown[x]) {
                                 // BQM 2016-05-03: only scale for non-constant sites
                                 // now do the likelihood scaling
-                                double *partial_lh = dad_branch->partial_lh + (ptn*block + c*nstates*VectorClass::size() + x);
+                                double *partial_lh = lh_dad + (c*nstates*VectorClass::size() + x);
                                 for (size_t i = 0; i < nstates; i++)
-                                    partial_lh[i*VectorClass::size()] = ldexp(partial_lh[i*VectorClass::size()], SCALING_THRESHOLD_EXP);
+                                    partial_lh[i*VectorClass::size()] = ldexp(partial_lh[i*VectorClass::size()], scaling_threshold_exp);
                                 dad_branch->scale_num[(ptn+x)*ncat_mix+c] += 1;
                             }
                         }
@@ -1863,15 +2008,15 @@ void PhyloTree::computePartialLikelihoodGenericSIMD(TraversalInfo &info
     #endif
                     // check if one should scale partial likelihoods
                     if (SAFE_NUMERIC) {
-                        auto underflown = ((lh_max < SCALING_THRESHOLD) & (VectorClass().load_a(&ptn_invar[ptn]) == 0.0));
+                        auto underflown = ((lh_max < scaling_threshold) & (VectorClass().load_a(&ptn_invar[ptn]) == 0.0));
                         if (horizontal_or(underflown)) { // at least one site has numerical underflown
                             for (size_t x = 0; x < VectorClass::size(); x++) {
                                 if (underflown[x]) {
                                     // BQM 2016-05-03: only scale for non-constant sites
                                     // now do the likelihood scaling
-                                    double *partial_lh = dad_branch->partial_lh + (ptn*block + c*nstates*VectorClass::size() + x);
+                                    double *partial_lh = lh_dad + (c*nstates*VectorClass::size() + x);
                                     for (size_t i = 0; i < nstates; i++)
-                                        partial_lh[i*VectorClass::size()] = ldexp(partial_lh[i*VectorClass::size()], SCALING_THRESHOLD_EXP);
+                                        partial_lh[i*VectorClass::size()] = ldexp(partial_lh[i*VectorClass::size()], scaling_threshold_exp);
                                     dad_branch->scale_num[(ptn+x)*ncat_mix+c] += 1;
                                 }
                             }
@@ -1884,20 +2029,23 @@ void PhyloTree::computePartialLikelihoodGenericSIMD(TraversalInfo &info
             } // IF SITE_MODEL
 
             if (!SAFE_NUMERIC) {
-                auto underflown = (lh_max < SCALING_THRESHOLD) & (VectorClass().load_a(&ptn_invar[ptn]) == 0.0);
+                auto underflown = (lh_max < scaling_threshold) & (VectorClass().load_a(&ptn_invar[ptn]) == 0.0);
                 if (horizontal_or(underflown)) { // at least one site has numerical underflown
                     for (size_t x = 0; x < VectorClass::size(); x++)
                     if (underflown[x]) {
-                        double *partial_lh = dad_branch->partial_lh + (ptn*block + x);
+                        double *partial_lh = lh_dad + x;
                         // now do the likelihood scaling
                         for (size_t i = 0; i < block; i++) {
-                            partial_lh[i*VectorClass::size()] = ldexp(partial_lh[i*VectorClass::size()], SCALING_THRESHOLD_EXP);
+                            partial_lh[i*VectorClass::size()] = ldexp(partial_lh[i*VectorClass::size()], scaling_threshold_exp);
                         }
 //                        sum_scale += LOG_SCALING_THRESHOLD * ptn_freq[ptn+x];
                         dad_branch->scale_num[ptn+x] += 1;
                     }
                 }
             }
+            if (!storePartialLh<VectorClass, SAFE_NUMERIC, FLOAT_LH>(lh_dad, dad_branch->partial_lh, dad_branch->scale_num, ptn,
+                                                                     nstates, ncat_mix, ptn_invar))
+                float_partial_lh_overflow = true;
 
 		} // big for loop over ptn
 
@@ -1908,9 +2056,13 @@ void PhyloTree::computePartialLikelihoodGenericSIMD(TraversalInfo &info
         VectorClass *partial_lh_tmp
             = (VectorClass*)(buffer_partial_lh_ptr + thread_buf_size * packet_id);
 		for (size_t ptn = ptn_lower; ptn < ptn_upper; ptn+=VectorClass::size()) {
-			VectorClass *partial_lh = (VectorClass*)(dad_branch->partial_lh + ptn*block);
-			VectorClass *partial_lh_left = (VectorClass*)(left->partial_lh + ptn*block);
-			VectorClass *partial_lh_right = (VectorClass*)(right->partial_lh + ptn*block);
+            if (ptn_repeat && copySubtreeRepeat<VectorClass, SAFE_NUMERIC, FLOAT_LH>(ptn_repeat, ptn, ptn_lower, block, ncat_mix,
+                                                                                     dad_branch->partial_lh, dad_branch->scale_num))
+                continue;
+			double *lh_dad = FLOAT_LH ? lh_dad_buf : dad_branch->partial_lh + ptn*block;
+			VectorClass *partial_lh = (VectorClass*)lh_dad;
+			VectorClass *partial_lh_left = (VectorClass*)loadPartialLh<VectorClass, FLOAT_LH>(left->partial_lh, ptn, block, lh_left_buf);
+			VectorClass *partial_lh_right = (VectorClass*)loadPartialLh<VectorClass, FLOAT_LH>(right->partial_lh, ptn, block, lh_right_buf);
             VectorClass lh_max = 0.0;
             UBYTE *scale_dad, *scale_left, *scale_right;
 
@@ -1989,15 +2141,15 @@ void PhyloTree::computePartialLikelihoodGenericSIMD(TraversalInfo &info
 
                 // check if one should scale partial likelihoods
                 if (SAFE_NUMERIC) {
-                    auto underflown = ((lh_max < SCALING_THRESHOLD) & (VectorClass().load_a(&ptn_invar[ptn]) == 0.0));
+                    auto underflown = ((lh_max < scaling_threshold) & (VectorClass().load_a(&ptn_invar[ptn]) == 0.0));
                     if (horizontal_or(underflown))
                         for (size_t x = 0; x < VectorClass::size(); x++)
                         if (underflown[x]) {
                             // BQM 2016-05-03: only scale for non-constant sites
                             // now do the likelihood scaling
-                            double *partial_lh = dad_branch->partial_lh + (ptn*block + c*nstates*VectorClass::size() + x);
+                            double *partial_lh = lh_dad + (c*nstates*VectorClass::size() + x);
                             for (size_t i = 0; i < nstates; i++)
-                                partial_lh[i*VectorClass::size()] = ldexp(partial_lh[i*VectorClass::size()], SCALING_THRESHOLD_EXP);
+                                partial_lh[i*VectorClass::size()] = ldexp(partial_lh[i*VectorClass::size()], scaling_threshold_exp);
                             scale_dad[x*ncat_mix] += 1;
                         }
                     scale_dad++;
@@ -2011,20 +2163,23 @@ void PhyloTree::computePartialLikelihoodGenericSIMD(TraversalInfo &info
 
             if (!SAFE_NUMERIC) {
                 // check if one should scale partial likelihoods
-                auto underflown = (lh_max < SCALING_THRESHOLD) & (VectorClass().load_a(&ptn_invar[ptn]) == 0.0);
+                auto underflown = (lh_max < scaling_threshold) & (VectorClass().load_a(&ptn_invar[ptn]) == 0.0);
                 if (horizontal_or(underflown)) { // at least one site has numerical underflown
                     for (size_t x = 0; x < VectorClass::size(); x++)
                     if (underflown[x]) {
-                        double *partial_lh = dad_branch->partial_lh + (ptn*block + x);
+                        double *partial_lh = lh_dad + x;
                         // now do the likelihood scaling
                         for (size_t i = 0; i < block; i++) {
-                            partial_lh[i*VectorClass::size()] = ldexp(partial_lh[i*VectorClass::size()], SCALING_THRESHOLD_EXP);
+                            partial_lh[i*VectorClass::size()] = ldexp(partial_lh[i*VectorClass::size()], scaling_threshold_exp);
                         }
 //                        sum_scale += LOG_SCALING_THRESHOLD * ptn_freq[ptn+x];
                         dad_branch->scale_num[ptn+x] += 1;
                     }
                 }
             }
+            if (!storePartialLh<VectorClass, SAFE_NUMERIC, FLOAT_LH>(lh_dad, dad_branch->partial_lh, dad_branch->scale_num, ptn,
+                                                                     nstates, ncat_mix, ptn_invar))
+                float_partial_lh_overflow = true;
         } // big for loop over ptn
     }
     if (Params::getInstance().buffer_mem_save) {
@@ -2042,11 +2197,11 @@ void PhyloTree::computePartialLikelihoodGenericSIMD(TraversalInfo &info
 
 
 #ifdef KERNEL_FIX_STATES
-template <class VectorClass, const bool SAFE_NUMERIC, const int nstates, const bool FMA, const bool SITE_MODEL>
+template <class VectorClass, const bool SAFE_NUMERIC, const int nstates, const bool FMA, const bool SITE_MODEL, const bool FLOAT_LH>
 void PhyloTree::computeLikelihoodBufferSIMD(PhyloNeighbor *dad_branch, PhyloNode *dad
                                             , size_t ptn_lower, size_t ptn_upper, int packet_id)
 #else
-template <class VectorClass, const bool SAFE_NUMERIC, const bool FMA, const bool SITE_MODEL>
+template <class VectorClass, const bool SAFE_NUMERIC, const bool FMA, const bool SITE_MODEL, const bool FLOAT_LH>
 void PhyloTree::computeLikelihoodBufferGenericSIMD(PhyloNeighbor *dad_branch, PhyloNode *dad
                                                    , size_t ptn_lower, size_t ptn_upper, int packet_id)
 #endif
@@ -2079,6 +2234,17 @@ void PhyloTree::computeLikelihoodBufferGenericSIMD(PhyloNeighbor *dad_branch, Ph
         buffer_partial_lh_ptr += nmix*(nmix+1)*VectorClass::size() + (nmix+3)*nmix*VectorClass::size()*num_packets;
     }
 
+    // one unit of scale_num is a smaller step if stored in single precision
+    const double scaling_threshold = FLOAT_LH ? SCALING_THRESHOLD_FLOAT : SCALING_THRESHOLD;
+    const double log_scaling_threshold = FLOAT_LH ? LOG_SCALING_THRESHOLD_FLOAT : LOG_SCALING_THRESHOLD;
+
+    // per-thread vectors to convert single-precision partial likelihoods
+    double *lh_dad_buf = NULL, *lh_node_buf = NULL;
+    if (FLOAT_LH) {
+        lh_dad_buf  = buffer_partial_lh + (getBufferPartialLhSize() - 3*block*VectorClass::size()*(num_packets-packet_id));
+        lh_node_buf = lh_dad_buf + block*VectorClass::size();
+    }
+
     // first compute partial_lh
     for (auto it = traversal_info.begin(); it != traversal_info.end(); it++) {
         computePartialLikelihood(*it, ptn_lower, ptn_upper, packet_id);
@@ -2094,7 +2260,7 @@ void PhyloTree::computeLikelihoodBufferGenericSIMD(PhyloNeighbor *dad_branch, Ph
         size_t offset     = ptn_lower*block;
         size_t offsetStep = block*VectorClass::size();
         for (size_t ptn = ptn_lower; ptn < ptn_upper; ptn+=VectorClass::size(), offset+=offsetStep) {
-            VectorClass *partial_lh_dad = (VectorClass*)(dad_branch->partial_lh + offset);
+            VectorClass *partial_lh_dad = (VectorClass*)loadPartialLh<VectorClass, FLOAT_LH>(dad_branch->partial_lh, ptn, block, lh_dad_buf);
             VectorClass *theta = (VectorClass*)(theta_all + offset);
             //load tip vector
             if (!SITE_MODEL) {
@@ -2151,7 +2317,7 @@ void PhyloTree::computeLikelihoodBufferGenericSIMD(PhyloNeighbor *dad_branch, Ph
                         if (scale_dad[c] == min_scale+1) {
                             double *this_theta = &theta_all[ptn*block + c*nstates*VectorClass::size() + i];
                             for (size_t x = 0; x < nstates; x++) {
-                                this_theta[x*VectorClass::size()] *= SCALING_THRESHOLD;
+                                this_theta[x*VectorClass::size()] *= scaling_threshold;
                             }
                         } else if (scale_dad[c] > min_scale+1) {
                             double *this_theta = &theta_all[ptn*block + c*nstates*VectorClass::size() + i];
@@ -2168,7 +2334,7 @@ void PhyloTree::computeLikelihoodBufferGenericSIMD(PhyloNeighbor *dad_branch, Ph
                 }
             }
             VectorClass *buf = (VectorClass*)(buffer_scale_all+ptn);
-            *buf *= LOG_SCALING_THRESHOLD;
+            *buf *= log_scaling_threshold;
 
         } // FOR PTN LOOP
 //            aligned_free(vec_tip);
@@ -2178,8 +2344,8 @@ void PhyloTree::computeLikelihoodBufferGenericSIMD(PhyloNeighbor *dad_branch, Ph
         // now compute theta
         for (size_t ptn = ptn_lower; ptn < ptn_upper; ptn+=VectorClass::size()) {
             VectorClass *theta = (VectorClass*)(theta_all + ptn*block);
-            VectorClass *partial_lh_node = (VectorClass*)(node_branch->partial_lh + ptn*block);
-            VectorClass *partial_lh_dad = (VectorClass*)(dad_branch->partial_lh + ptn*block);
+            VectorClass *partial_lh_node = (VectorClass*)loadPartialLh<VectorClass, FLOAT_LH>(node_branch->partial_lh, ptn, block, lh_node_buf);
+            VectorClass *partial_lh_dad = (VectorClass*)loadPartialLh<VectorClass, FLOAT_LH>(dad_branch->partial_lh, ptn, block, lh_dad_buf);
             for (size_t i = 0; i < block; i++) {
                 theta[i] = partial_lh_node[i] * partial_lh_dad[i];
             }
@@ -2203,7 +2369,7 @@ void PhyloTree::computeLikelihoodBufferGenericSIMD(PhyloNeighbor *dad_branch, Ph
                         if (sum_scale[c] == min_scale+1) {
                             double *this_theta = &theta_all[ptn*block + c*nstates*VectorClass::size() + i];
                             for (size_t x = 0; x < nstates; x++) {
-                                this_theta[x*VectorClass::size()] *= SCALING_THRESHOLD;
+                                this_theta[x*VectorClass::size()] *= scaling_threshold;
                             }
                         } else if (sum_scale[c] > min_scale+1) {
                             double *this_theta = &theta_all[ptn*block + c*nstates*VectorClass::size() + i];
@@ -2221,16 +2387,16 @@ void PhyloTree::computeLikelihoodBufferGenericSIMD(PhyloNeighbor *dad_branch, Ph
                 }
             }
             VectorClass *buf = (VectorClass*)(buffer_scale_all+ptn);
-            *buf *= LOG_SCALING_THRESHOLD;
+            *buf *= log_scaling_threshold;
         } // FOR ptn
     } // internal node
 }
 
 #ifdef KERNEL_FIX_STATES
-template <class VectorClass, const bool SAFE_NUMERIC, const int nstates, const bool FMA, const bool SITE_MODEL>
+template <class VectorClass, const bool SAFE_NUMERIC, const int nstates, const bool FMA, const bool SITE_MODEL, const bool FLOAT_LH>
 void PhyloTree::computeLikelihoodDervSIMD(PhyloNeighbor *dad_branch, PhyloNode *dad, double *df, double *ddf)
 #else
-template <class VectorClass, const bool SAFE_NUMERIC, const bool FMA, const bool SITE_MODEL>
+template <class VectorClass, const bool SAFE_NUMERIC, const bool FMA, const bool SITE_MODEL, const bool FLOAT_LH>
 void PhyloTree::computeLikelihoodDervGenericSIMD(PhyloNeighbor *dad_branch, PhyloNode *dad, double *df, double *ddf)
 #endif
 {
@@ -2268,6 +2434,7 @@ void PhyloTree::computeLikelihoodDervGenericSIMD(PhyloNeighbor *dad_branch, Phyl
     bool ASC_Holder = (ASC_type == ASC_VARIANT_MISSING || ASC_type == ASC_INFORMATIVE_MISSING);
     bool ASC_Lewis = (ASC_type == ASC_VARIANT || ASC_type == ASC_INFORMATIVE);
 
+    const double scaling_threshold = FLOAT_LH ? SCALING_THRESHOLD_FLOAT : SCALING_THRESHOLD;
     double *const_df = NULL, *const_ddf = NULL;
 
     if (ASC_Holder) {
@@ -2379,9 +2546,9 @@ void PhyloTree::computeLikelihoodDervGenericSIMD(PhyloNeighbor *dad_branch, Phyl
 
         if (!theta_computed)
         #ifdef KERNEL_FIX_STATES
-            computeLikelihoodBufferSIMD<VectorClass, SAFE_NUMERIC, nstates, FMA, SITE_MODEL>(dad_branch, dad, ptn_lower, ptn_upper, packet_id);
+            computeLikelihoodBufferSIMD<VectorClass, SAFE_NUMERIC, nstates, FMA, SITE_MODEL, FLOAT_LH>(dad_branch, dad, ptn_lower, ptn_upper, packet_id);
         #else
-            computeLikelihoodBufferGenericSIMD<VectorClass, SAFE_NUMERIC, FMA, SITE_MODEL>(dad_branch, dad, ptn_lower, ptn_upper, packet_id);
+            computeLikelihoodBufferGenericSIMD<VectorClass, SAFE_NUMERIC, FMA, SITE_MODEL, FLOAT_LH>(dad_branch, dad, ptn_lower, ptn_upper, packet_id);
         #endif
 
         if (isMixlen()) {
@@ -2514,9 +2681,9 @@ void PhyloTree::computeLikelihoodDervGenericSIMD(PhyloNeighbor *dad_branch, Phyl
                         double *ddf_ptn_dbl = (double*)&ddf_ptn;
                         for (size_t i = 0; i < VectorClass::size(); i++)
                             if (buffer_scale_all[ptn+i] != 0.0) {
-                                lh_ptn_dbl[i] *= SCALING_THRESHOLD;
-                                df_ptn_dbl[i] *= SCALING_THRESHOLD;
-                                ddf_ptn_dbl[i] *= SCALING_THRESHOLD;
+                                lh_ptn_dbl[i] *= scaling_threshold;
+                                df_ptn_dbl[i] *= scaling_threshold;
+                                ddf_ptn_dbl[i] *= scaling_threshold;
                             }
                     }
                     if (ASC_Holder) {
@@ -2566,13 +2733,14 @@ void PhyloTree::computeLikelihoodDervGenericSIMD(PhyloNeighbor *dad_branch, Phyl
     // normal joint branch length model
     *df  = all_df;
     *ddf = all_ddf;
+    if (!SAFE_NUMERIC && !std::isfinite(*df)) {
+        // leave df non-finite, computeLikelihoodDerv() will switch to the safe kernel
+        return;
+    }
     if (!std::isfinite(*df)) {
         getModel()->writeInfo(cout);
         getRate()->writeInfo(cout);
     }
-    if (!SAFE_NUMERIC && !std::isfinite(*df)) {
-        outError("Numerical underflow (lh-derivative). Run again with the safe likelihood kernel via `-safe` option");
-    }
     if (ASC_Holder) {
         // Mark Holder's ascertainment bias correction for missing data
         double *const_lh = _pattern_lh + max_orig_nptn;
@@ -2635,10 +2803,10 @@ void PhyloTree::computeLikelihoodDervGenericSIMD(PhyloNeighbor *dad_branch, Phyl
  ******************************************************/
 
 #ifdef KERNEL_FIX_STATES
-template <class VectorClass, const bool SAFE_NUMERIC, const int nstates, const bool FMA, const bool SITE_MODEL>
+template <class VectorClass, const bool SAFE_NUMERIC, const int nstates, const bool FMA, const bool SITE_MODEL, const bool FLOAT_LH>
 double PhyloTree::computeLikelihoodBranchSIMD(PhyloNeighbor *dad_branch, PhyloNode *dad)
 #else
-template <class VectorClass, const bool SAFE_NUMERIC, const bool FMA, const bool SITE_MODEL>
+template <class VectorClass, const bool SAFE_NUMERIC, const bool FMA, const bool SITE_MODEL, const bool FLOAT_LH>
 double PhyloTree::computeLikelihoodBranchGenericSIMD(PhyloNeighbor *dad_branch, PhyloNode *dad)
 #endif
 {
@@ -2676,6 +2844,8 @@ double PhyloTree::computeLikelihoodBranchGenericSIMD(PhyloNeighbor *dad_branch,
     ASCType ASC_type = model_factory->getASC();
     bool ASC_Holder = (ASC_type == ASC_VARIANT_MISSING || ASC_type == ASC_INFORMATIVE_MISSING);
     bool ASC_Lewis = (ASC_type == ASC_VARIANT || ASC_type == ASC_INFORMATIVE);
+    const double scaling_threshold = FLOAT_LH ? SCALING_THRESHOLD_FLOAT : SCALING_THRESHOLD;
+    const double log_scaling_threshold = FLOAT_LH ? LOG_SCALING_THRESHOLD_FLOAT : LOG_SCALING_THRESHOLD;
 
     size_t mix_addr_nstates[ncat_mix], mix_addr[ncat_mix];
     size_t denom = (model_factory->fused_mix_rate) ? 1 : ncat;
@@ -2801,11 +2971,13 @@ double PhyloTree::computeLikelihoodBranchGenericSIMD(PhyloNeighbor *dad_branch,
                 computePartialLikelihood(*it, ptn_lower, ptn_upper, packet_id);
             }
             double *vec_tip = buffer_partial_lh_ptr + block*VectorClass::size() * packet_id;
+            // vector to convert single-precision partial likelihoods
+            double *lh_dad_buf = FLOAT_LH ? buffer_partial_lh + (getBufferPartialLhSize() - 3*block*VectorClass::size()*(num_packets-packet_id)) : NULL;
 
             for (size_t ptn = ptn_lower; ptn < ptn_upper; ptn+=VectorClass::size()) {
                 VectorClass lh_ptn(0.0);
                 VectorClass *lh_cat = (VectorClass*)(_pattern_lh_cat + ptn*ncat_mix);
-                VectorClass *partial_lh_dad = (VectorClass*)(dad_branch->partial_lh + ptn*block);
+                VectorClass *partial_lh_dad = (VectorClass*)loadPartialLh<VectorClass, FLOAT_LH>(dad_branch->partial_lh, ptn, block, lh_dad_buf);
                 VectorClass *lh_node = SITE_MODEL ? (VectorClass*)&partial_lh_node[ptn*nstates] : (VectorClass*)vec_tip;
 
                 if (SITE_MODEL) {
@@ -2882,7 +3054,7 @@ double PhyloTree::computeLikelihoodBranchGenericSIMD(PhyloNeighbor *dad_branch,
                         for (size_t c = 0; c < ncat_mix; c++) {
                             // rescale lh_cat if neccessary
                             if (scale_dad[c] == min_scale+1) {
-                                this_lh_cat[c*VectorClass::size()] *= SCALING_THRESHOLD;
+                                this_lh_cat[c*VectorClass::size()] *= scaling_threshold;
                             } else if (scale_dad[c] > min_scale+1) {
                                 this_lh_cat[c*VectorClass::size()] = 0.0;
                             }
@@ -2897,7 +3069,7 @@ double PhyloTree::computeLikelihoodBranchGenericSIMD(PhyloNeighbor *dad_branch,
                         vc_min_scale_ptr[i] = dad_branch->scale_num[ptn+i];
                     }
                 }
-                vc_min_scale *= LOG_SCALING_THRESHOLD;
+                vc_min_scale *= log_scaling_threshold;
 
                 // Sum later to avoid underflow of invariant sites
                 lh_ptn = abs(lh_ptn) + VectorClass().load_a(&ptn_invar[ptn]);
@@ -2917,7 +3089,7 @@ double PhyloTree::computeLikelihoodBranchGenericSIMD(PhyloNeighbor *dad_branch,
                         double *lh_ptn_dbl = (double*)&lh_ptn;
                         for (size_t i = 0; i < VectorClass::size(); i++)
                             if (vc_min_scale_ptr[i] != 0.0)
-                                lh_ptn_dbl[i] *= SCALING_THRESHOLD;
+                                lh_ptn_dbl[i] *= scaling_threshold;
                     }
                     if (ASC_Holder)
                         lh_ptn.store_a(&_pattern_lh[ptn]);
@@ -2953,13 +3125,20 @@ double PhyloTree::computeLikelihoodBranchGenericSIMD(PhyloNeighbor *dad_branch,
                 computePartialLikelihood(*it, ptn_lower, ptn_upper, packet_id);
             }
 
+            // vectors to convert single-precision partial likelihoods
+            double *lh_dad_buf = NULL, *lh_node_buf = NULL;
+            if (FLOAT_LH) {
+                lh_dad_buf  = buffer_partial_lh + (getBufferPartialLhSize() - 3*block*VectorClass::size()*(num_packets-packet_id));
+                lh_node_buf = lh_dad_buf + block*VectorClass::size();
+            }
+
             VectorClass vc_tree_lh(0.0);
             VectorClass vc_prob_const(0.0);
             for (size_t ptn = ptn_lower; ptn < ptn_upper; ptn+=VectorClass::size()) {
                 VectorClass lh_ptn(0.0);
                 VectorClass *lh_cat = (VectorClass*)(_pattern_lh_cat + ptn*ncat_mix);
-                VectorClass *partial_lh_dad = (VectorClass*)(dad_branch->partial_lh + ptn*block);
-                VectorClass *partial_lh_node = (VectorClass*)(node_branch->partial_lh + ptn*block);
+                VectorClass *partial_lh_dad = (VectorClass*)loadPartialLh<VectorClass, FLOAT_LH>(dad_branch->partial_lh, ptn, block, lh_dad_buf);
+                VectorClass *partial_lh_node = (VectorClass*)loadPartialLh<VectorClass, FLOAT_LH>(node_branch->partial_lh, ptn, block, lh_node_buf);
 
                 // compute likelihood per category
                 if (SITE_MODEL) {
@@ -3013,7 +3192,7 @@ double PhyloTree::computeLikelihoodBranchGenericSIMD(PhyloNeighbor *dad_branch,
                         double *this_lh_cat = &_pattern_lh_cat[ptn*ncat_mix + i];
                         for (size_t c = 0; c < ncat_mix; c++) {
                             if (sum_scale[c] == min_scale+1) {
-                                this_lh_cat[c*VectorClass::size()] *= SCALING_THRESHOLD;
+                                this_lh_cat[c*VectorClass::size()] *= scaling_threshold;
                             } else if (sum_scale[c] > min_scale+1) {
                                 // reset if category is scaled a lot
                                 this_lh_cat[c*VectorClass::size()] = 0.0;
@@ -3028,7 +3207,7 @@ double PhyloTree::computeLikelihoodBranchGenericSIMD(PhyloNeighbor *dad_branch,
                         vc_min_scale_ptr[i] = dad_branch->scale_num[ptn+i] + node_branch->scale_num[ptn+i];
                     }
                 } // if SAFE_NUMERIC
-                vc_min_scale *= LOG_SCALING_THRESHOLD;
+                vc_min_scale *= log_scaling_threshold;
 
                 // Sum later to avoid underflow of invariant sites
                 lh_ptn = abs(lh_ptn) + VectorClass().load_a(&ptn_invar[ptn]);
@@ -3049,7 +3228,7 @@ double PhyloTree::computeLikelihoodBranchGenericSIMD(PhyloNeighbor *dad_branch,
                         double *lh_ptn_dbl = (double*)&lh_ptn;
                         for (size_t i = 0; i < VectorClass::size(); i++)
                             if (vc_min_scale_ptr[i] != 0.0)
-                                lh_ptn_dbl[i] *= SCALING_THRESHOLD;
+                                lh_ptn_dbl[i] *= scaling_threshold;
                     }
                     if (ASC_Holder)
                         lh_ptn.store_a(&_pattern_lh[ptn]);
@@ -3070,12 +3249,12 @@ double PhyloTree::computeLikelihoodBranchGenericSIMD(PhyloNeighbor *dad_branch,
     } // else
 
     tree_lh += all_tree_lh;
+    if (!SAFE_NUMERIC && !std::isfinite(tree_lh)) {
+        // computeLikelihoodBranch() will switch to the safe kernel and recompute
+        return tree_lh;
+    }
     if (!std::isfinite(tree_lh)) {
-        if (SAFE_NUMERIC) {
-            outWarning("Numerical underflow for lh-branch");
-        } else {
-            outWarning("Numerical underflow for lh-branch, use `-safe` option to avoid this warning");
-        }
+        outWarning("Numerical underflow for lh-branch");
     }
 
     // arbitrarily fix tree_lh if underflown for some sites
@@ -3188,10 +3367,10 @@ double PhyloTree::computeLikelihoodBranchGenericSIMD(PhyloNeighbor *dad_branch,
  ******************************************************/
 
 #ifdef KERNEL_FIX_STATES
-template <class VectorClass, const int nstates, const bool FMA, const bool SITE_MODEL>
+template <class VectorClass, const int nstates, const bool FMA, const bool SITE_MODEL, const bool FLOAT_LH>
 double PhyloTree::computeLikelihoodFromBufferSIMD()
 #else
-template <class VectorClass, const bool FMA, const bool SITE_MODEL>
+template <class VectorClass, const bool FMA, const bool SITE_MODEL, const bool FLOAT_LH>
 double PhyloTree::computeLikelihoodFromBufferGenericSIMD()
 #endif
 {
@@ -3210,6 +3389,7 @@ double PhyloTree::computeLikelihoodFromBufferGenericSIMD()
     ASCType ASC_type = model_factory->getASC();
     bool ASC_Holder = (ASC_type == ASC_VARIANT_MISSING || ASC_type == ASC_INFORMATIVE_MISSING);
     bool ASC_Lewis = (ASC_type == ASC_VARIANT || ASC_type == ASC_INFORMATIVE);
+    const double scaling_threshold = FLOAT_LH ? SCALING_THRESHOLD_FLOAT : SCALING_THRESHOLD;
 
     size_t mix_addr_nstates[ncat_mix], mix_addr[ncat_mix];
     size_t denom = (model_factory->fused_mix_rate) ? 1 : ncat;
@@ -3306,7 +3486,7 @@ double PhyloTree::computeLikelihoodFromBufferGenericSIMD()
                 double *lh_ptn_dbl = (double*)&lh_ptn;
                 for (size_t i = 0; i < VectorClass::size(); i++)
                     if (buffer_scale_all[ptn+i] != 0.0)
-                        lh_ptn_dbl[i] *= SCALING_THRESHOLD;
+                        lh_ptn_dbl[i] *= scaling_threshold;
             }
             if (ASC_Holder) {
                 lh_ptn.store_a(&_pattern_lh[ptn]);
@@ -3326,8 +3506,10 @@ double PhyloTree::computeLikelihoodFromBufferGenericSIMD()
     }
 
     double tree_lh = all_tree_lh;
-    if (!safe_numeric && !std::isfinite(tree_lh))
-        outError("Numerical underflow (lh-from-buffer). Run again with the safe likelihood kernel via `-safe` option");
+    if (!safe_numeric && !std::isfinite(tree_lh)) {
+        // computeLikelihoodFromBuffer() will switch to the safe kernel and recompute
+        return tree_lh;
+    }
 
     ASSERT(std::isfinite(tree_lh) && "Numerical underflow for lh-from-buffer");
 
@@ -133,6 +133,41 @@ void PhyloTree::setLikelihoodKernelSSE() {
         return;        
     }
 
+    if (float_partial_lh) {
+        // partial likelihoods stored in single precision, see isFloatPartialLhSupported()
+        computeLikelihoodDervMixlenPointer = NULL;
+        switch (aln->num_states) {
+        case 4:
+            if (safe_numeric) {
+                computeLikelihoodBranchPointer  = &PhyloTree::computeLikelihoodBranchSIMD <Vec2d, SAFE_LH, 4, false, false, true>;
+                computeLikelihoodDervPointer    = &PhyloTree::computeLikelihoodDervSIMD   <Vec2d, SAFE_LH, 4, false, false, true>;
+                computePartialLikelihoodPointer = &PhyloTree::computePartialLikelihoodSIMD<Vec2d, SAFE_LH, 4, false, false, true>;
+            } else {
+                computeLikelihoodBranchPointer  = &PhyloTree::computeLikelihoodBranchSIMD <Vec2d, NORM_LH, 4, false, false, true>;
+                computeLikelihoodDervPointer    = &PhyloTree::computeLikelihoodDervSIMD   <Vec2d, NORM_LH, 4, false, false, true>;
+                computePartialLikelihoodPointer = &PhyloTree::computePartialLikelihoodSIMD<Vec2d, NORM_LH, 4, false, false, true>;
+            }
+            computeLikelihoodFromBufferPointer = &PhyloTree::computeLikelihoodFromBufferSIMD<Vec2d, 4, false, false, true>;
+            break;
+        case 20:
+            if (safe_numeric) {
+                computeLikelihoodBranchPointer  = &PhyloTree::computeLikelihoodBranchSIMD <Vec2d, SAFE_LH, 20, false, false, true>;
+                computeLikelihoodDervPointer    = &PhyloTree::computeLikelihoodDervSIMD   <Vec2d, SAFE_LH, 20, false, false, true>;
+                computePartialLikelihoodPointer = &PhyloTree::computePartialLikelihoodSIMD<Vec2d, SAFE_LH, 20, false, false, true>;
+            } else {
+                computeLikelihoodBranchPointer  = &PhyloTree::computeLikelihoodBranchSIMD <Vec2d, NORM_LH, 20, false, false, true>;
+                computeLikelihoodDervPointer    = &PhyloTree::computeLikelihoodDervSIMD   <Vec2d, NORM_LH, 20, false, false, true>;
+                computePartialLikelihoodPointer = &PhyloTree::computePartialLikelihoodSIMD<Vec2d, NORM_LH, 20, false, false, true>;
+            }
+            computeLikelihoodFromBufferPointer = &PhyloTree::computeLikelihoodFromBufferSIMD<Vec2d, 20, false, false, true>;
+            break;
+        default:
+            ASSERT(0);
+            break;
+        }
+        return;
+    }
+
     if (safe_numeric) {
 	switch(aln->num_states) {
         case 4:
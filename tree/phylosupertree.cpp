@@ -690,17 +690,21 @@ void PhyloSuperTree::computePartitionOrder() {
 double PhyloSuperTree::computeLikelihood(double *pattern_lh) {
 	double tree_lh = 0.0;
 	int ntrees = size();
+    if (part_order.empty()) computePartitionOrder();
 	if (pattern_lh) {
-		//#ifdef _OPENMP
-		//#pragma omp parallel for reduction(+: tree_lh)
-		//#endif
-		for (int i = 0; i < ntrees; i++) {
-			part_info[i].cur_score = at(i)->computeLikelihood(pattern_lh);
+        // output offset of each partition, so that partitions can be computed in any order
+        vector<size_t> offsets(ntrees, 0);
+        for (int i = 1; i < ntrees; i++)
+            offsets[i] = offsets[i-1] + at(i-1)->getAlnNPattern();
+		#ifdef _OPENMP
+		#pragma omp parallel for reduction(+: tree_lh) schedule(dynamic) if(num_threads > 1)
+		#endif
+		for (int j = 0; j < ntrees; j++) {
+            int i = part_order[j];
+			part_info[i].cur_score = at(i)->computeLikelihood(pattern_lh + offsets[i]);
 			tree_lh += part_info[i].cur_score;
-			pattern_lh += at(i)->getAlnNPattern();
 		}
 	} else {
-        if (part_order.empty()) computePartitionOrder();
 		#ifdef _OPENMP
 		#pragma omp parallel for reduction(+: tree_lh) schedule(dynamic) if(num_threads > 1)
 		#endif
@@ -723,19 +727,28 @@ int PhyloSuperTree::getNumLhCat(SiteLoglType wsl) {
 
 
 void PhyloSuperTree::computePatternLikelihood(double *pattern_lh, double *cur_logl, double *ptn_lh_cat, SiteLoglType wsl) {
-	size_t offset = 0, offset_lh_cat = 0;
+	size_t offset = 0;
 	iterator it;
-	for (it = begin(); it != end(); it++) {
+    int ntrees = size();
+    if (part_order.empty()) computePartitionOrder();
+    vector<size_t> offsets(ntrees, 0), offsets_lh_cat(ntrees, 0);
+    for (int i = 1; i < ntrees; i++) {
+        offsets[i] = offsets[i-1] + at(i-1)->aln->getNPattern();
+        if (ptn_lh_cat)
+            offsets_lh_cat[i] = offsets_lh_cat[i-1] + at(i-1)->aln->getNPattern() * at(i-1)->getNumLhCat(wsl);
+    }
+	#ifdef _OPENMP
+	#pragma omp parallel for schedule(dynamic) if(num_threads > 1)
+	#endif
+	for (int j = 0; j < ntrees; j++) {
+        int i = part_order[j];
 		if (ptn_lh_cat)
-			(*it)->computePatternLikelihood(pattern_lh + offset, NULL, ptn_lh_cat + offset_lh_cat, wsl);
+			at(i)->computePatternLikelihood(pattern_lh + offsets[i], NULL, ptn_lh_cat + offsets_lh_cat[i], wsl);
 		else
-			(*it)->computePatternLikelihood(pattern_lh + offset);
-		offset += (*it)->aln->getNPattern();
-        offset_lh_cat += (*it)->aln->getNPattern() * (*it)->getNumLhCat(wsl);
+			at(i)->computePatternLikelihood(pattern_lh + offsets[i]);
 	}
 	if (cur_logl) { // sanity check
 		double sum_logl = 0;
-		offset = 0;
 		for (it = begin(); it != end(); it++) {
 			int nptn = (*it)->aln->getNPattern();
 			for (int j = 0; j < nptn; j++)
@@ -751,10 +764,17 @@ void PhyloSuperTree::computePatternLikelihood(double *pattern_lh, double *cur_lo
 }
 
 void PhyloSuperTree::computePatternProbabilityCategory(double *ptn_prob_cat, SiteLoglType wsl) {
-	size_t offset = 0;
-	for (iterator it = begin(); it != end(); it++) {
-        (*it)->computePatternProbabilityCategory(ptn_prob_cat + offset, wsl);
-        offset += (*it)->aln->getNPattern() * (*it)->getNumLhCat(wsl);
+    int ntrees = size();
+    if (part_order.empty()) computePartitionOrder();
+    vector<size_t> offsets(ntrees, 0);
+    for (int i = 1; i < ntrees; i++)
+        offsets[i] = offsets[i-1] + at(i-1)->aln->getNPattern() * at(i-1)->getNumLhCat(wsl);
+	#ifdef _OPENMP
+	#pragma omp parallel for schedule(dynamic) if(num_threads > 1)
+	#endif
+	for (int j = 0; j < ntrees; j++) {
+        int i = part_order[j];
+        at(i)->computePatternProbabilityCategory(ptn_prob_cat + offsets[i], wsl);
 	}
 }
 
@@ -1332,7 +1352,7 @@ void PhyloSuperTree::initMarginalAncestralState(ostream &out, bool &orig_kernel_
     for (auto it = begin(); it != end(); it++) {
         size_t nptn = (*it)->aln->size();
         size_t nstates = (*it)->model->num_states;
-        (*it)->_pattern_lh_cat_state = (*it)->newPartialLh();
+        (*it)->_pattern_lh_cat_state = aligned_alloc<double>((*it)->getPartialLhSize());
         total_size += nptn*nstates;
         total_ptn += nptn;
         if (nstates != front()->model->num_states)
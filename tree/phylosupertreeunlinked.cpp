@@ -293,8 +293,9 @@ void PhyloSuperTreeUnlinked::writeUFBootTrees(Params &params) {
     
     for (auto tree = begin(); tree != end(); tree++) {
         MTreeSet trees;
-
-        trees.init(((IQTree*)*tree)->boot_trees, (*tree)->rooted);
+        IntVector sample_trees;
+        ((IQTree*)*tree)->initBootTreeSet(trees, &sample_trees);
+        StrVector tree_strings(trees.size());
         for (i = 0; i < trees.size(); i++) {
             NodeVector taxa;
             // change the taxa name from ID to real name
@@ -305,13 +306,17 @@ void PhyloSuperTreeUnlinked::writeUFBootTrees(Params &params) {
                 // reinsert removed seqs into each tree
                 trees[i]->insertTaxa(removed_seqs, twin_seqs);
             }
-            // now print to file
-            for (j = 0; j < trees.tree_weights[i]; j++)
-                if (params.print_ufboot_trees == 1)
-                    trees[i]->printTree(out, WT_NEWLINE);
-                else
-                    trees[i]->printTree(out, WT_NEWLINE + WT_BR_LEN);
+            stringstream ss;
+            if (params.print_ufboot_trees == 1)
+                trees[i]->printTree(ss, WT_NEWLINE);
+            else
+                trees[i]->printTree(ss, WT_NEWLINE + WT_BR_LEN);
+            tree_strings[i] = ss.str();
         }
+        // now print to file in the order of replicates
+        for (i = 0; i < sample_trees.size(); i++)
+            if (sample_trees[i] >= 0)
+                out << tree_strings[sample_trees[i]];
     }
     cout << "UFBoot trees printed to " << filename << endl;
     out.close();
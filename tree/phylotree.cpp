@@ -25,6 +25,7 @@
 //#include "rateheterogeneity.h"
 #include "alignment/alignmentpairwise.h"
 #include "alignment/alignmentsummary.h"
+#include "alignment/bitpackedalignment.h"
 #include <algorithm>
 #include <limits>
 #include "utils/timeutil.h"
@@ -37,6 +38,7 @@
 #include "model/modelmixture.h"
 #include "phylonodemixlen.h"
 #include "phylotreemixlen.h"
+#include "ufbootweights.h"
 
 
 const int LH_MIN_CONST = 1;
@@ -81,10 +83,14 @@ void PhyloTree::init() {
     optimize_by_newton = true;
     central_partial_lh = NULL;
     nni_partial_lh = NULL;
+    float_partial_lh = false;
+    float_partial_lh_overflow = false;
+    subtree_repeat_traversal = 0;
     tip_partial_lh = NULL;
     tip_partial_pars = NULL;
     tip_partial_lh_computed = 0;
     ptn_freq_computed = false;
+    aln_view = NULL;
     central_scale_num = NULL;
     nni_scale_num = NULL;
     central_partial_pars = NULL;
@@ -107,6 +113,7 @@ void PhyloTree::init() {
     dist_matrix = NULL;
     var_matrix = NULL;
     params = NULL;
+    safe_numeric_fallback = false;
     setLikelihoodKernel(LK_SSE2);  // FOR TUNG: you forgot to initialize this variable!
     setNumThreads(1);
     num_threads = 0;
@@ -138,6 +145,7 @@ void PhyloTree::init() {
     isSummaryBorrowed = false;
     progress = nullptr;
     progressStackDepth = 0;
+    progressDisabled = false;
 }
 
 PhyloTree::PhyloTree(Alignment *aln) : MTree(), CheckpointFactory() {
@@ -232,10 +240,10 @@ PhyloTree::~PhyloTree() {
     aligned_free(ptn_freq_pars);
     ptn_freq_computed = false;
     aligned_free(ptn_invar);
-    delete[] dist_matrix;
+    delete dist_matrix;
     dist_matrix = NULL;
 
-    delete[] var_matrix;
+    delete var_matrix;
     var_matrix = NULL;
 
     if (pllPartitions)
@@ -255,6 +263,7 @@ PhyloTree::~PhyloTree() {
     delete progress;
     progress = nullptr;
     progressStackDepth = 0;
+    progressDisabled = false;
 }
 
 void PhyloTree::readTree(const char *infile, bool &is_rooted) {
@@ -358,6 +367,11 @@ void PhyloTree::copyPhyloTreeMixlen(PhyloTree *tree, int mix, bool borrowSummary
 #define FAST_NAME_CHECK 1
 void PhyloTree::setAlignment(Alignment *alignment) {
     aln = alignment;
+    if (aln_view && aln_view->getAlignment() != aln) {
+        // the pattern weights belong to the previous alignment
+        aln_view = NULL;
+        ptn_freq_computed = false;
+    }
     //double checkStart = getRealTime();
     size_t nseq = aln->getNSeq();
     bool err = false;
@@ -437,6 +451,12 @@ void PhyloTree::setAlignment(Alignment *alignment) {
     */
 }
 
+void PhyloTree::setAlignmentView(WeightedAlignmentView *view) {
+    ASSERT(!view || view->getAlignment() == aln);
+    aln_view = view;
+    ptn_freq_computed = false;
+}
+
 void PhyloTree::setRootNode(const char *my_root, bool multi_taxa) {
     if (rooted) {
         computeBranchDirection();
@@ -649,6 +669,7 @@ void PhyloTree::clearAllPartialLH(bool make_null) {
     }
     ((PhyloNode*) root->neighbors[0]->node)->clearAllPartialLh(make_null, (PhyloNode*) root);
     tip_partial_lh_computed = 0;
+    subtree_repeats.clear();
     // 2015-10-14: has to reset this pointer when read in
     current_it = current_it_back = NULL;
 }
@@ -860,6 +881,10 @@ size_t PhyloTree::getBufferPartialLhSize() {
     buffer_size += block*2*VECTOR_SIZE*num_packets;
     buffer_size += get_safe_upper_limit(3*block*model->num_states);
 
+    // vectors to convert partial likelihoods stored in single precision
+    if (Params::getInstance().lk_float_storage)
+        buffer_size += block*3*VECTOR_SIZE*num_packets;
+
     if (isMixlen()) {
         size_t nmix = max(getMixlen(), getRate()->getNRate());
         buffer_size += nmix*(nmix+1)*VECTOR_SIZE + (nmix+3)*nmix*VECTOR_SIZE*num_packets;
@@ -934,6 +959,7 @@ void PhyloTree::deleteAllPartialLh() {
     ptn_freq_computed = false;
     tip_partial_lh    = nullptr;
     tip_partial_pars  = nullptr;
+    subtree_repeats.clear();
 
     clearAllPartialLH();
 }
@@ -960,15 +986,16 @@ uint64_t PhyloTree::getMemoryRequired(size_t ncategory, bool full_mem) {
     else
         mem_size = aln->num_states * (aln->STATE_UNKNOWN+1) * sizeof(double);
 
-    // memory for UFBoot
+    // memory for UFBoot, pattern counts mostly fit into one byte
     if (params->gbo_replicates)
-        mem_size += params->gbo_replicates*nptn*sizeof(BootValType);
+        mem_size += params->gbo_replicates*nptn*sizeof(uint8_t);
 
     // memory for model
     if (model)
         mem_size += model->getMemoryRequired();
 
-    int64_t lh_scale_size = block_size * sizeof(double) + scale_block_size * sizeof(UBYTE);
+    size_t lh_value_size = isFloatPartialLhSupported() ? sizeof(float) : sizeof(double);
+    int64_t lh_scale_size = block_size * lh_value_size + scale_block_size * sizeof(UBYTE);
 
     max_lh_slots = leafNum-2;
 
@@ -1037,6 +1064,8 @@ void PhyloTree::initializeAllPartialLh(int &index, int &indexlh, PhyloNode *node
     uint64_t block_size;
     uint64_t scale_block_size = nptn * site_rate->getNRate() * ((model_factory->fused_mix_rate)? 1 : model->getNMixtures());
     block_size = scale_block_size * model->num_states;
+    // number of doubles occupied by one partial likelihood vector
+    uint64_t lh_block_size = float_partial_lh ? block_size / 2 : block_size;
 
     if (!node) {
         node = (PhyloNode*) root;
@@ -1044,7 +1073,7 @@ void PhyloTree::initializeAllPartialLh(int &index, int &indexlh, PhyloNode *node
         size_t IT_NUM = 2;
         if (!nni_partial_lh) {
             // allocate memory only once!
-            nni_partial_lh = aligned_alloc<double>(IT_NUM*block_size);
+            nni_partial_lh = aligned_alloc<double>(IT_NUM*lh_block_size);
             nni_scale_num = aligned_alloc<UBYTE>(IT_NUM*scale_block_size);
         }
 
@@ -1056,7 +1085,7 @@ void PhyloTree::initializeAllPartialLh(int &index, int &indexlh, PhyloNode *node
             if (max_lh_slots == 0)
                 getMemoryRequired();
 
-            uint64_t mem_size = (uint64_t)max_lh_slots * block_size + 4 + tip_partial_lh_size;
+            uint64_t mem_size = (uint64_t)max_lh_slots * lh_block_size + 4 + tip_partial_lh_size;
 
             if (verbose_mode >= VB_MAX)
                 cout << "Allocating " << mem_size * sizeof(double) << " bytes for partial likelihood vectors" << endl;
@@ -1071,9 +1100,9 @@ void PhyloTree::initializeAllPartialLh(int &index, int &indexlh, PhyloNode *node
 
         // now always assign tip_partial_lh
         if (params->lh_mem_save == LM_PER_NODE) {
-            tip_partial_lh = central_partial_lh + ((nodeNum - leafNum)*block_size);
+            tip_partial_lh = central_partial_lh + ((nodeNum - leafNum)*lh_block_size);
         } else {
-            tip_partial_lh = central_partial_lh + (max_lh_slots*block_size);
+            tip_partial_lh = central_partial_lh + (max_lh_slots*lh_block_size);
         }
 
         if (!central_scale_num) {
@@ -1126,7 +1155,7 @@ void PhyloTree::initializeAllPartialLh(int &index, int &indexlh, PhyloNode *node
                 nei->partial_lh = NULL; // do not allocate memory for tip, use tip_partial_lh instead
                 nei->scale_num = NULL;
                 nei2->scale_num = central_scale_num + ((indexlh) * scale_block_size);
-                nei2->partial_lh = central_partial_lh + (indexlh * block_size);
+                nei2->partial_lh = central_partial_lh + (indexlh * lh_block_size);
                 indexlh++;
             } else {
                 nei->partial_lh = NULL; 
@@ -1161,7 +1190,7 @@ void PhyloTree::initializeAllPartialLh(int &index, int &indexlh, PhyloNode *node
 }
 
 double *PhyloTree::newPartialLh() {
-    return aligned_alloc<double>(getPartialLhSize());
+    return aligned_alloc<double>(getPartialLhBytes()/sizeof(double));
 }
 
 size_t PhyloTree::getPartialLhSize() {
@@ -1174,7 +1203,7 @@ size_t PhyloTree::getPartialLhSize() {
 
 size_t PhyloTree::getPartialLhBytes() {
     // +num_states for ascertainment bias correction
-    return getPartialLhSize() * sizeof(double);
+    return getPartialLhSize() * (float_partial_lh ? sizeof(float) : sizeof(double));
 }
 
 size_t PhyloTree::getScaleNumSize() {
@@ -1225,6 +1254,8 @@ double PhyloTree::computeLikelihood(double *pattern_lh) {
 //            cout << __func__ << " HIT ROOT STATE " << endl;
 //        score = computeLikelihoodRooted((PhyloNeighbor*) vroot->neighbors[0], (PhyloNode*) vroot);
 //    } else {
+        if (float_partial_lh_overflow)
+            switchToDoublePartialLh();
         score = computeLikelihoodBranch(current_it, (PhyloNode*) current_it_back->node);
 //    }
     if (pattern_lh)
@@ -1234,7 +1265,7 @@ double PhyloTree::computeLikelihood(double *pattern_lh) {
         int nptn = aln->getNPattern();
         //double check_score = 0.0;
         for (int i = 0; i < nptn; i++) {
-            pattern_lh[i] += max(current_it->scale_num[i], UBYTE(0)) * LOG_SCALING_THRESHOLD;
+            pattern_lh[i] += max(current_it->scale_num[i], UBYTE(0)) * getLogScalingThreshold();
             //check_score += (pattern_lh[i] * (aln->at(i).frequency));
         }
         /*       if (fabs(score - check_score) > 1e-6) {
@@ -1434,6 +1465,7 @@ void PhyloTree::computePatternLikelihood(double *ptn_lh, double *cur_logl, doubl
     int nptn = aln->getNPattern();
     int i;
     int ncat = getNumLhCat(wsl);
+    double log_scaling_threshold = getLogScalingThreshold();
     if (ptn_lh_cat) {
         // Right now only Naive version store _pattern_lh_cat!
         computePatternLhCat(wsl);
@@ -1444,16 +1476,16 @@ void PhyloTree::computePatternLikelihood(double *ptn_lh, double *cur_logl, doubl
     if (sum_scaling < 0.0) {
         if (current_it->lh_scale_factor == 0.0) {
             for (i = 0; i < nptn; i++) {
-                ptn_lh[i] = _pattern_lh[i] + (max(UBYTE(0), current_it_back->scale_num[i])) * LOG_SCALING_THRESHOLD;
+                ptn_lh[i] = _pattern_lh[i] + (max(UBYTE(0), current_it_back->scale_num[i])) * log_scaling_threshold;
             }
         } else if (current_it_back->lh_scale_factor == 0.0){
             for (i = 0; i < nptn; i++) {
-                ptn_lh[i] = _pattern_lh[i] + (max(UBYTE(0), current_it->scale_num[i])) * LOG_SCALING_THRESHOLD;
+                ptn_lh[i] = _pattern_lh[i] + (max(UBYTE(0), current_it->scale_num[i])) * log_scaling_threshold;
             }
         } else {
             for (i = 0; i < nptn; i++) {
                 ptn_lh[i] = _pattern_lh[i] + (max(UBYTE(0), current_it->scale_num[i]) +
-                    max(UBYTE(0), current_it_back->scale_num[i])) * LOG_SCALING_THRESHOLD;
+                    max(UBYTE(0), current_it_back->scale_num[i])) * log_scaling_threshold;
             }
         }
     } else {
@@ -1473,20 +1505,20 @@ void PhyloTree::computePatternLikelihood(double *ptn_lh, double *cur_logl, doubl
             }
         } else if (current_it->lh_scale_factor == 0.0) {
             for (i = 0; i < nptn; i++) {
-                double scale = (max(UBYTE(0), current_it_back->scale_num[i])) * LOG_SCALING_THRESHOLD;
+                double scale = (max(UBYTE(0), current_it_back->scale_num[i])) * log_scaling_threshold;
                 for (int j = 0; j < ncat; j++, offset++)
                     ptn_lh_cat[offset] = log(_pattern_lh_cat[offset]) + scale;
             }
         } else if (current_it_back->lh_scale_factor == 0.0) {
             for (i = 0; i < nptn; i++) {
-                double scale = (max(UBYTE(0), current_it->scale_num[i])) * LOG_SCALING_THRESHOLD;
+                double scale = (max(UBYTE(0), current_it->scale_num[i])) * log_scaling_threshold;
                 for (int j = 0; j < ncat; j++, offset++)
                     ptn_lh_cat[offset] = log(_pattern_lh_cat[offset]) + scale;
             }
         } else {
             for (i = 0; i < nptn; i++) {
                 double scale = (max(UBYTE(0), current_it->scale_num[i]) +
-                        max(UBYTE(0), current_it_back->scale_num[i])) * LOG_SCALING_THRESHOLD;
+                        max(UBYTE(0), current_it_back->scale_num[i])) * log_scaling_threshold;
                 for (int j = 0; j < ncat; j++, offset++)
                     ptn_lh_cat[offset] = log(_pattern_lh_cat[offset]) + scale;
             }
@@ -1514,7 +1546,7 @@ void PhyloTree::computePatternLikelihood(double *ptn_lh, double *cur_logl, doubl
             // per-category scaling
             for (ptn = 0; ptn < nptn; ptn++) {
                 for (i = 0; i < ncat; i++) {
-                    out_lh_cat[i] = log(lh_cat[i]) + nei2_scale[i] * LOG_SCALING_THRESHOLD;
+                    out_lh_cat[i] = log(lh_cat[i]) + nei2_scale[i] * log_scaling_threshold;
                 }
                 lh_cat += ncat;
                 out_lh_cat += ncat;
@@ -1523,7 +1555,7 @@ void PhyloTree::computePatternLikelihood(double *ptn_lh, double *cur_logl, doubl
         } else {
             // normal scaling
             for (ptn = 0; ptn < nptn; ptn++) {
-                double scale = nei2_scale[ptn] * LOG_SCALING_THRESHOLD;
+                double scale = nei2_scale[ptn] * log_scaling_threshold;
                 for (i = 0; i < ncat; i++)
                     out_lh_cat[i] = log(lh_cat[i]) + scale;
                 lh_cat += ncat;
@@ -1540,7 +1572,7 @@ void PhyloTree::computePatternLikelihood(double *ptn_lh, double *cur_logl, doubl
             // per-category scaling
             for (ptn = 0; ptn < nptn; ptn++) {
                 for (i = 0; i < ncat; i++) {
-                    out_lh_cat[i] = log(lh_cat[i]) + (nei1_scale[i]+nei2_scale[i]) * LOG_SCALING_THRESHOLD;
+                    out_lh_cat[i] = log(lh_cat[i]) + (nei1_scale[i]+nei2_scale[i]) * log_scaling_threshold;
                 }
                 lh_cat += ncat;
                 out_lh_cat += ncat;
@@ -1550,7 +1582,7 @@ void PhyloTree::computePatternLikelihood(double *ptn_lh, double *cur_logl, doubl
         } else {
             // normal scaling
             for (ptn = 0; ptn < nptn; ptn++) {
-                double scale = (nei1_scale[ptn] + nei2_scale[ptn]) * LOG_SCALING_THRESHOLD;
+                double scale = (nei1_scale[ptn] + nei2_scale[ptn]) * log_scaling_threshold;
                 for (i = 0; i < ncat; i++)
                     out_lh_cat[i] = log(lh_cat[i]) + scale;
                 lh_cat += ncat;
@@ -1769,9 +1801,11 @@ double PhyloTree::optimizeOneBranchLS(PhyloNode *node1, PhyloNode *node2) {
     if (!subTreeDistComputed) {
         if (params->ls_var_type == WLS_PAUPLIN) {
             computeNodeBranchDists();
+            if (!var_matrix)
+                var_matrix = new DistanceMatrix(leafNum, params->dist_float);
             for (int i = 0; i < leafNum; i++)
-                for (int j = 0; j < leafNum; j++)
-                    var_matrix[i*leafNum+j] = pow(2.0,nodeBranchDists[i*nodeNum+j]);
+                for (int j = 0; j < i; j++)
+                    var_matrix->set(i, j, pow(2.0,nodeBranchDists[i*nodeNum+j]));
         }
         computeSubtreeDists();
     }
@@ -2050,14 +2084,13 @@ void PhyloTree::computeAllSubtreeDistForOneNode(PhyloNode* source, PhyloNode* so
         return;
     } else if (source->isLeaf() && dad->isLeaf()) {
         ASSERT(dist_matrix);
-        size_t nseq = aln->getNSeq();
         if (params->ls_var_type == OLS) {
-            dist = dist_matrix[dad->id * nseq + source->id];
+            dist = dist_matrix->get(dad->id, source->id);
             weight = 1.0;
         } else {
             // this will take into account variances, also work for OLS since var = 1
-            weight = 1.0/var_matrix[dad->id * nseq + source->id];
-            dist = dist_matrix[dad->id * nseq + source->id] * weight;
+            weight = 1.0/getDistVariance(dad->id, source->id);
+            dist = dist_matrix->get(dad->id, source->id) * weight;
         }
         subTreeDists.insert(StringDoubleMap::value_type(key, dist));
         subTreeWeights.insert(StringDoubleMap::value_type(key, weight));
@@ -3129,27 +3162,46 @@ double PhyloTree::computeDist(int seq1, int seq2, double initial_dist) {
     return computeDist(seq1, seq2, initial_dist, var);
 }
 
-double PhyloTree::correctDist(double *dist_mat) {
+double PhyloTree::correctDist(DistanceMatrix *dist_mat) {
     size_t n = aln->getNSeq();
-    size_t nsqr = n * n;
     // use Floyd algorithm to find shortest path between all pairs of taxa
     for (size_t k = 0; k < n; ++k) {
-        for (size_t i = 0, pos = 0; i < n; ++i) {
-            for (size_t j = 0; j < n; ++j, ++pos) {
-                double tmp = dist_mat[i * n + k] + dist_mat[k * n + j];
-                if (dist_mat[pos] > tmp) {
-                    dist_mat[pos] = tmp;
+        for (size_t i = 1; i < n; ++i) {
+            for (size_t j = 0; j < i; ++j) {
+                double tmp = dist_mat->get(i, k) + dist_mat->get(k, j);
+                if (dist_mat->get(i, j) > tmp) {
+                    dist_mat->set(i, j, tmp);
                 }
             }
         }
     }
-    double longest_dist = 0.0;
-    for (size_t i = 0; i < nsqr; ++i) {
-        if (dist_mat[i] > longest_dist) {
-            longest_dist = dist_mat[i];
-        }
+    return dist_mat->getLongestDist();
+}
+
+bool PhyloTree::needsDistVariance() {
+    return params->ls_var_type == WLS_SECOND_TAYLOR || params->ls_var_type == WLS_PAUPLIN;
+}
+
+/**
+    @param vartype type of least-square variance
+    @param dist distance between two sequences
+    @param d2l second derivative of the likelihood at dist, or the previous variance without a model
+    @return variance of dist
+*/
+static inline double computeDistVariance(LEAST_SQUARE_VAR vartype, double dist, double d2l) {
+    switch (vartype) {
+        case WLS_PAUPLIN:          return 0.0;
+        case WLS_FIRST_TAYLOR:     return dist;
+        case WLS_FITCH_MARGOLIASH: return dist * dist;
+        case WLS_SECOND_TAYLOR:    return -1.0 / d2l;
+        default:                   return 1.0;
     }
-    return longest_dist;
+}
+
+double PhyloTree::getDistVariance(int seq1, int seq2) {
+    if (var_matrix)
+        return var_matrix->get(seq1, seq2);
+    return computeDistVariance(params->ls_var_type, dist_matrix->get(seq1, seq2), 1.0);
 }
 
 template <class L, class F> double computeDistanceMatrix
@@ -3157,12 +3209,12 @@ template <class L, class F> double computeDistanceMatrix
     , L unknown, const L* sequenceMatrix, int nseqs, int seqLen
     , double denominator, const F* frequencyVector
     , bool uncorrected, double num_states
-    , double *dist_mat, double *var_mat)
+    , DistanceMatrix *dist_mat, DistanceMatrix *var_mat)
 {
     //
     //L is the character type
     //sequenceMatrix is nseqs rows of seqLen characters
-    //dist_mat and var_mat are as in computeDist
+    //dist_mat and var_mat are as in computeDist (var_mat may be null)
     //F is the frequency count type
     //
     
@@ -3182,15 +3234,12 @@ template <class L, class F> double computeDistanceMatrix
         //results in the last few rows being allocated to some worker thread
         //just before the others finish... it won't be running
         //"all by itsef" for as long.
-        int      rowOffset     = nseqs * seq1;
-        double*  distRow       = dist_mat       + rowOffset;
-        double*  varRow        = var_mat        + rowOffset;
         const L* thisSequence  = sequenceMatrix + seq1 * seqLen;
         const L* otherSequence = thisSequence   + seqLen;
         double maxDistanceInRow = 0.0;
         for (int seq2 = seq1 + 1; seq2 < nseqs; ++seq2) {
-            double d2l      = varRow[seq2];
-            double distance = distRow[seq2];
+            double d2l      = (var_mat) ? var_mat->get(seq1, seq2) : 1.0;
+            double distance = dist_mat->get(seq1, seq2);
             if ( 0.0 == distance ) {
                 double unknownFreq = 0;
                 double hamming =
@@ -3203,13 +3252,11 @@ template <class L, class F> double computeDistanceMatrix
                         distance      = (x<=0) ? MAX_GENETIC_DIST : ( -log(x) / z );
                     }
                 }
-                distRow[seq2] = distance;
+                dist_mat->set(seq1, seq2, distance);
+            }
+            if (var_mat) {
+                var_mat->set(seq1, seq2, computeDistVariance(vartype, distance, d2l));
             }
-            if      (vartype == OLS)                  varRow[seq2] = 1.0;
-            else if (vartype == WLS_PAUPLIN)          varRow[seq2] = 0.0;
-            else if (vartype == WLS_FIRST_TAYLOR)     varRow[seq2] = distance;
-            else if (vartype == WLS_FITCH_MARGOLIASH) varRow[seq2] = distance * distance;
-            else if (vartype == WLS_SECOND_TAYLOR)    varRow[seq2] = -1.0 / d2l;
             if ( maxDistanceInRow < distance )
             {
                 maxDistanceInRow = distance;
@@ -3236,27 +3283,6 @@ template <class L, class F> double computeDistanceMatrix
             longest_dist = rowMaxDistance[seq1];
         }
     }
-
-    //
-    //Copy upper-triangle into lower-triangle and write
-    //zeroes to the diagonal.
-    //
-    #ifdef _OPENMP
-    #pragma omp parallel for schedule(dynamic)
-    #endif
-    for ( int seq1 = nseqs-1; 0 <= seq1; --seq1 ) {
-        int     rowOffset = nseqs * seq1;
-        double* distRow   = dist_mat + rowOffset;
-        double* varRow    = var_mat  + rowOffset;
-        double* distCol   = dist_mat + seq1; //current entries in the columns
-        double* varCol    = var_mat  + seq1; //...that we are reading down.
-        for ( int seq2 = 0; seq2 < seq1; ++seq2, distCol+=nseqs, varCol+=nseqs ) {
-            distRow [ seq2 ] = *distCol;
-            varRow  [ seq2 ] = *varCol;
-        }
-        distRow [ seq1 ] = 0.0;
-        varRow  [ seq1 ] = 0.0;
-    }
     return longest_dist;
 }
 
@@ -3264,7 +3290,7 @@ template <class L, class F> double computeDistanceMatrix
 #define EX_TRACE(x) if (verbose_mode < VB_MED) {} \
                     else cout << (getRealTime()-baseTime) << "s " << x << endl
 
-double PhyloTree::computeDist_Experimental(double *dist_mat, double *var_mat) {
+double PhyloTree::computeDist_Experimental(DistanceMatrix *dist_mat, DistanceMatrix *var_mat) {
     EX_START;
     //Experimental: Are there any other checks that are needed here?
     if (model_factory && site_rate) {
@@ -3286,10 +3312,9 @@ double PhyloTree::computeDist_Experimental(double *dist_mat, double *var_mat) {
         #pragma omp parallel for
         for (int seq1=0; seq1<seqCount; ++seq1) {
             if (!workToDo) {
-                const double* distRow   = dist_mat + seq1 * seqCount;
                 double maxDistanceInRow = 0;
                 for (int seq2=0; seq2<seqCount; ++seq2) {
-                    double distance = distRow[seq2];
+                    double distance = dist_mat->get(seq1, seq2);
                     if (0.0 == distance && ( seq1 != seq2 ) ) {
                         workToDo = true;
                         break;
@@ -3313,6 +3338,9 @@ double PhyloTree::computeDist_Experimental(double *dist_mat, double *var_mat) {
             return longest_dist;
         }
     }
+    if (params->packed_dist && BitPackedAlignment::isSupported(aln)) {
+        return computeDist(dist_mat, var_mat);
+    }
     EX_TRACE("Summarizing...");
     AlignmentSummary s(aln, false, false);
     int maxDistance = 0;
@@ -3351,12 +3379,31 @@ double PhyloTree::computeDist_Experimental(double *dist_mat, double *var_mat) {
     return longest;
 }
 
-double PhyloTree::computeDist(double *dist_mat, double *var_mat) {
-    prepareToComputeDistances();
+double PhyloTree::computeDist(DistanceMatrix *dist_mat, DistanceMatrix *var_mat) {
     size_t nseqs = aln->getNSeq();
-    double longest_dist = 0.0;
+    bool model_free = !model_factory || !site_rate;
+    // with a model, observed distances are only initial values for the optimization
+    if (params->packed_dist && BitPackedAlignment::isSupported(aln) && (model_free || !params->compute_obs_dist)) {
+        BitPackedAlignment packed_aln(aln);
+        PackedDistanceType dist_type = PACKED_JC_DIST;
+        if (params->compute_obs_dist)
+            dist_type = PACKED_OBS_DIST;
+        else if (params->compute_k2p_dist)
+            dist_type = PACKED_K2P_DIST;
+        double longest_packed = packed_aln.computeDistMatrix(dist_type, *dist_mat);
+        if (model_free) {
+            // as below, d2l is the previous variance since no model optimizes the distances
+            if (var_mat) {
+                for (size_t seq1 = 1; seq1 < nseqs; ++seq1)
+                    for (size_t seq2 = 0; seq2 < seq1; ++seq2)
+                        var_mat->set(seq1, seq2, computeDistVariance(params->ls_var_type,
+                            dist_mat->get(seq1, seq2), var_mat->get(seq1, seq2)));
+            }
+            return longest_packed;
+        }
+    }
+    prepareToComputeDistances();
     cout.precision(6);
-    double baseTime = getRealTime();
     progress_display progress(nseqs*(nseqs-1)/2, "Calculating distance matrix"); //zork
     //compute the upper-triangle of distance matrix
     #ifdef _OPENMP
@@ -3365,41 +3412,16 @@ double PhyloTree::computeDist(double *dist_mat, double *var_mat) {
     for (size_t seq1 = 0; seq1 < nseqs; ++seq1) {
         int threadNum = omp_get_thread_num();
         AlignmentPairwise* processor = distanceProcessors[threadNum];
-        int rowStartPos = seq1 * nseqs;
         for (size_t seq2=seq1+1; seq2 < nseqs; ++seq2) {
-            size_t sym_pos = rowStartPos + seq2;
-            double d2l = var_mat[sym_pos]; // moved here for thread-safe (OpenMP)
-            dist_mat[sym_pos] = processor->recomputeDist(seq1, seq2, dist_mat[sym_pos], d2l);
-            if (params->ls_var_type == OLS)
-                var_mat[sym_pos] = 1.0;
-            else if (params->ls_var_type == WLS_PAUPLIN)
-                var_mat[sym_pos] = 0.0;
-            else if (params->ls_var_type == WLS_FIRST_TAYLOR)
-                var_mat[sym_pos] = dist_mat[sym_pos];
-            else if (params->ls_var_type == WLS_FITCH_MARGOLIASH)
-                var_mat[sym_pos] = dist_mat[sym_pos] * dist_mat[sym_pos];
-            else if (params->ls_var_type == WLS_SECOND_TAYLOR)
-                var_mat[sym_pos] = -1.0 / d2l;
+            double d2l = (var_mat) ? var_mat->get(seq1, seq2) : 1.0; // moved here for thread-safe (OpenMP)
+            double dist = processor->recomputeDist(seq1, seq2, dist_mat->get(seq1, seq2), d2l);
+            dist_mat->set(seq1, seq2, dist);
+            if (var_mat)
+                var_mat->set(seq1, seq2, computeDistVariance(params->ls_var_type, dist, d2l));
         }
         progress += (nseqs - seq1 - 1);
     }
-    //cout << (getRealTime()-baseTime) << "s Copying to lower triangle" << endl;
-    //copy upper-triangle into lower-triangle and set diagonal = 0
-    for (size_t seq1 = 1; seq1 < nseqs; ++seq1) {
-        size_t rowStartPos = seq1 * nseqs;
-        size_t rowStopPos  = rowStartPos + seq1;
-        size_t colPos = seq1;
-        for (size_t rowPos = rowStartPos; rowPos<rowStopPos; ++rowPos, colPos+=nseqs) {
-            auto d = dist_mat[colPos];
-            dist_mat [ rowPos ] = d;
-            var_mat  [ rowPos ] = var_mat [ colPos ];
-            if (d > longest_dist) {
-                longest_dist = d;
-            }
-        }
-        dist_mat [ rowStopPos] = 0.0;
-        var_mat  [ rowStopPos] = 0.0;
-    }
+    double longest_dist = dist_mat->getLongestDist();
     doneComputingDistances();
 
     /*
@@ -3407,7 +3429,6 @@ double PhyloTree::computeDist(double *dist_mat, double *var_mat) {
      outWarning("Some distances are saturated. Please check your alignment again");*/
     // NOTE: Bionj does handle long distances already (thanks Manuel)
     //return correctDist(dist_mat);
-    EX_TRACE("Longest distance was " << longest_dist);
     return longest_dist;
 }
 
@@ -3422,23 +3443,17 @@ void PhyloTree::decideDistanceFilePath(Params& params) {
         dist_file += ".mldist";
 }
 
-double PhyloTree::computeDist(Params &params, Alignment *alignment, double* &dist_mat, double* &var_mat) {
+double PhyloTree::computeDist(Params &params, Alignment *alignment, DistanceMatrix* &dist_mat, DistanceMatrix* &var_mat) {
     this->params = &params;
     double longest_dist = 0.0;
     aln = alignment;
 
     if (!dist_mat) {
-        size_t n        = alignment->getNSeq();
-        size_t nSquared = n*n;
-        dist_mat        = new double[nSquared];
-        memset(dist_mat, 0, sizeof(double) * nSquared);
-        var_mat         = new double[nSquared];
-        #ifdef _OPENMP
-        #pragma omp parallel for
-        #endif
-        for (size_t i = 0; i < nSquared; i++) {
-            var_mat[i] = 1.0;
-        }
+        size_t n = alignment->getNSeq();
+        dist_mat = new DistanceMatrix(n, params.dist_float);
+        // variances derived from the distances are not stored
+        if (needsDistVariance())
+            var_mat = new DistanceMatrix(n, params.dist_float, 1.0);
     }
     if (!params.dist_file) {
         double begin_time = getRealTime();
@@ -3450,51 +3465,38 @@ double PhyloTree::computeDist(Params &params, Alignment *alignment, double* &dis
             << getRealTime() - begin_time << " seconds" << endl;
         }
     } else {
-        longest_dist = alignment->readDist(params.dist_file, dist_mat);
+        longest_dist = alignment->readDist(params.dist_file, *dist_mat);
         dist_file = params.dist_file;
     }
     return longest_dist;
 }
 
 void PhyloTree::printDistanceFile() {
-    aln->printDist(dist_file.c_str(), dist_matrix);
+    aln->printDist(dist_file.c_str(), *dist_matrix);
     distanceFileWritten = dist_file.c_str();
 }
 
-double PhyloTree::computeObsDist(double *dist_mat) {
+double PhyloTree::computeObsDist(DistanceMatrix *dist_mat) {
     size_t nseqs = aln->getNSeq();
-    double longest_dist = 0.0;
     #ifdef _OPENMP
     #pragma omp parallel for schedule(dynamic)
     #endif
-    for (size_t seq1 = 0; seq1 < nseqs; ++seq1) {
-        size_t pos = seq1*nseqs;
-        for (size_t seq2 = 0; seq2 < nseqs; ++seq2, ++pos) {
-            if (seq1 == seq2)
-                dist_mat[pos] = 0.0;
-            else if (seq2 > seq1) {
-                dist_mat[pos] = aln->computeObsDist(seq1, seq2);
-            } else
-                dist_mat[pos] = dist_mat[seq2 * nseqs + seq1];
-            if (dist_mat[pos] > longest_dist) {
-                longest_dist = dist_mat[pos];
-            }
+    for (size_t seq1 = 1; seq1 < nseqs; ++seq1) {
+        for (size_t seq2 = 0; seq2 < seq1; ++seq2) {
+            dist_mat->set(seq1, seq2, aln->computeObsDist(seq2, seq1));
         }
     }
-    return longest_dist;
+    return dist_mat->getLongestDist();
 }
 
-double PhyloTree::computeObsDist(Params &params, Alignment *alignment, double* &dist_mat) {
+double PhyloTree::computeObsDist(Params &params, Alignment *alignment, DistanceMatrix* &dist_mat) {
     double longest_dist = 0.0;
     aln = alignment;
     dist_file = params.out_prefix;
     dist_file += ".obsdist";
 
     if (!dist_mat) {
-        size_t n = alignment->getNSeq();
-        size_t nSquared = n * n;
-        dist_mat = new double[nSquared];
-        memset(dist_mat, 0, sizeof(double) * nSquared);
+        dist_mat = new DistanceMatrix(alignment->getNSeq(), params.dist_float);
     }
     longest_dist = computeObsDist(dist_mat);
     return longest_dist;
@@ -3536,7 +3538,7 @@ void PhyloTree::computeBioNJ(Params &params) {
         } else if (this->dist_matrix!=nullptr) {
             double start_time = getRealTime();
             wasDoneInMemory = treeBuilder->constructTreeInMemory
-            ( this->aln->getSeqNames(), dist_matrix, bionj_file);
+            ( this->aln->getSeqNames(), *dist_matrix, bionj_file);
             if (wasDoneInMemory) {
                 if (verbose_mode >= VB_MED) {
                     #ifdef _OPENMP
@@ -4640,9 +4642,14 @@ double PhyloTree::optimizeSPRBranches() {
 
 void PhyloTree::pruneSubtree(PhyloNode *node, PhyloNode *dad, PruningInfo &info) {
 
+    ASSERT(!dad->isLeaf() && dad->degree() == 3);
+    // node->dad takes over partial_lh of dad, the two Neighbors detached below keep none
+    reorientPartialLh((PhyloNeighbor*) node->findNeighbor(dad), node);
+
     bool first = true;
     info.node = node;
     info.dad = dad;
+    info.in_node = info.in_dad = NULL;
 
     FOR_NEIGHBOR_IT(dad, node, it){
         if (first) {
@@ -4665,19 +4672,173 @@ void PhyloTree::pruneSubtree(PhyloNode *node, PhyloNode *dad, PruningInfo &info)
     info.left_nei = (*info.left_it);
     info.right_nei = (*info.right_it);
 
-    info.left_node->updateNeighbor(info.left_it, info.dad_nei_right);
-    info.right_node->updateNeighbor(info.right_it, info.dad_nei_left);
-    ((PhyloNeighbor*) info.dad_nei_right)->partial_lh = newPartialLh();
-    ((PhyloNeighbor*) info.dad_nei_left)->partial_lh = newPartialLh();
+    // join left and right, dad->right still holds the subtree of right seen from left
+    double joined_len = info.left_len + info.right_len;
+    info.left_node->updateNeighbor(info.left_it, info.dad_nei_right, joined_len);
+    info.right_node->updateNeighbor(info.right_it, info.dad_nei_left, joined_len);
+
+    ((PhyloNode*) info.left_node)->clearReversePartialLh((PhyloNode*) info.right_node);
+    ((PhyloNode*) info.right_node)->clearReversePartialLh((PhyloNode*) info.left_node);
 }
 
 void PhyloTree::regraftSubtree(PruningInfo &info, PhyloNode *in_node, PhyloNode *in_dad) {
-    NeighborVec::iterator in_node_it = in_node->findNeighborIt(in_dad);
-    NeighborVec::iterator in_dad_it = in_dad->findNeighborIt(in_node);
-    Neighbor *in_dad_nei = (*in_dad_it);
-    Neighbor *in_node_nei = (*in_node_it);
-    info.dad->updateNeighbor(info.dad_it_right, in_dad_nei);
-    info.dad->updateNeighbor(info.dad_it_left, in_node_nei);
+    info.in_node = in_node;
+    info.in_dad = in_dad;
+    info.in_node_it = in_node->findNeighborIt(in_dad);
+    info.in_dad_it = in_dad->findNeighborIt(in_node);
+    info.in_node_nei = (*info.in_node_it);
+    info.in_dad_nei = (*info.in_dad_it);
+    info.in_len = info.in_node_nei->length;
+
+    // Neighbors of the regraft branch move to dad together with their partial_lh,
+    // the Neighbors toward dad detached by pruneSubtree are reused for in_node and in_dad
+    double half_len = info.in_len / 2;
+    info.dad->updateNeighbor(info.dad_it_left, info.in_node_nei, half_len);
+    info.dad->updateNeighbor(info.dad_it_right, info.in_dad_nei, half_len);
+    in_node->updateNeighbor(info.in_node_it, info.left_nei, half_len);
+    in_dad->updateNeighbor(info.in_dad_it, info.right_nei, half_len);
+}
+
+void PhyloTree::unregraftSubtree(PruningInfo &info) {
+    info.in_node->updateNeighbor(info.in_node_it, info.in_node_nei, info.in_len);
+    info.in_dad->updateNeighbor(info.in_dad_it, info.in_dad_nei, info.in_len);
+    info.in_node = info.in_dad = NULL;
+}
+
+void PhyloTree::unpruneSubtree(PruningInfo &info) {
+    ASSERT(!info.in_node);
+    info.dad->updateNeighbor(info.dad_it_left, info.dad_nei_left, info.left_len);
+    info.dad->updateNeighbor(info.dad_it_right, info.dad_nei_right, info.right_len);
+    info.left_node->updateNeighbor(info.left_it, info.left_nei, info.left_len);
+    info.right_node->updateNeighbor(info.right_it, info.right_nei, info.right_len);
+
+    // partial likelihoods toward dad were computed for the pruned tree
+    ((PhyloNode*) info.left_node)->clearReversePartialLh((PhyloNode*) info.dad);
+    ((PhyloNode*) info.right_node)->clearReversePartialLh((PhyloNode*) info.dad);
+    ((PhyloNeighbor*) info.left_nei)->clearPartialLh();
+    ((PhyloNeighbor*) info.right_nei)->clearPartialLh();
+    ((PhyloNeighbor*) info.node->findNeighbor(info.dad))->clearPartialLh();
+}
+
+SPRMove PhyloTree::getBestSPRForSubtree(PhyloNode *node, PhyloNode *dad, int radius) {
+    ASSERT(params->lh_mem_save == LM_PER_NODE && !rooted && !isSuperTree());
+
+    SPRMove best;
+    best.prune_node = node;
+    best.prune_dad = dad;
+    best.regraft_node = best.regraft_dad = NULL;
+    best.score = -DBL_MAX;
+    if (dad->isLeaf() || dad->degree() != 3 || leafNum < 5)
+        return best;
+
+    spr_radius = radius;
+    double backupScore = curScore;
+    size_t partial_lh_size = getPartialLhBytes()/sizeof(double);
+    size_t scale_num_size = getScaleNumBytes()/sizeof(UBYTE);
+
+    // every trial re-optimizes node-dad, the tree has to come back with the scored length
+    double prune_len = node->findNeighbor(dad)->length;
+    PruningInfo info;
+    pruneSubtree(node, dad, info);
+
+    // in_node->dad and in_dad->dad of every regraft position use the NNI buffers
+    PhyloNeighbor *left_nei = (PhyloNeighbor*) info.left_nei;
+    PhyloNeighbor *right_nei = (PhyloNeighbor*) info.right_nei;
+    double *saved_partial_lh[2] = {left_nei->partial_lh, right_nei->partial_lh};
+    UBYTE *saved_scale_num[2] = {left_nei->scale_num, right_nei->scale_num};
+    left_nei->partial_lh = nni_partial_lh;
+    left_nei->scale_num = nni_scale_num;
+    right_nei->partial_lh = nni_partial_lh + partial_lh_size;
+    right_nei->scale_num = nni_scale_num + scale_num_size;
+
+    PhyloNode *left = (PhyloNode*) info.left_node;
+    PhyloNode *right = (PhyloNode*) info.right_node;
+    FOR_NEIGHBOR_IT(left, right, it)
+        evaluateSPRRegrafts(info, (PhyloNode*) (*it)->node, left, 1, best);
+    FOR_NEIGHBOR_IT(right, left, it)
+        evaluateSPRRegrafts(info, (PhyloNode*) (*it)->node, right, 1, best);
+
+    left_nei->partial_lh = saved_partial_lh[0];
+    left_nei->scale_num = saved_scale_num[0];
+    right_nei->partial_lh = saved_partial_lh[1];
+    right_nei->scale_num = saved_scale_num[1];
+    unpruneSubtree(info);
+
+    current_it = (PhyloNeighbor*) dad->findNeighbor(node);
+    current_it_back = (PhyloNeighbor*) node->findNeighbor(dad);
+    current_it->length = current_it_back->length = prune_len;
+    theta_computed = false;
+    curScore = backupScore;
+    return best;
+}
+
+void PhyloTree::evaluateSPRRegrafts(PruningInfo &info, PhyloNode *in_node, PhyloNode *in_dad,
+    int depth, SPRMove &best)
+{
+    PhyloNode *node = (PhyloNode*) info.node;
+    PhyloNode *dad = (PhyloNode*) info.dad;
+
+    regraftSubtree(info, in_node, in_dad);
+    PhyloNeighbor *node_dad_nei = (PhyloNeighbor*) node->findNeighbor(dad);
+    PhyloNeighbor *in_node_dad_nei = (PhyloNeighbor*) info.left_nei;
+    PhyloNeighbor *in_dad_dad_nei = (PhyloNeighbor*) info.right_nei;
+    node_dad_nei->clearPartialLh();
+    in_node_dad_nei->clearPartialLh();
+    in_dad_dad_nei->clearPartialLh();
+
+    // only the three branches around dad are optimized, all other partial_lh
+    // come from the pruned tree
+    optimizeOneBranch(dad, node, false, NNI_MAX_NR_STEP);
+    in_node_dad_nei->clearPartialLh();
+    in_dad_dad_nei->clearPartialLh();
+    optimizeOneBranch(dad, in_node, false, NNI_MAX_NR_STEP);
+    node_dad_nei->clearPartialLh();
+    in_dad_dad_nei->clearPartialLh();
+    optimizeOneBranch(dad, in_dad, false, NNI_MAX_NR_STEP);
+    double score = computeLikelihoodFromBuffer();
+    if (verbose_mode >= VB_DEBUG)
+        cout << "SPR " << node->id << " - " << dad->id << " to " << in_node->id << " - " << in_dad->id << ": " << score << endl;
+    if (save_all_trees == 2) {
+        saveCurrentTree(score); // BQM: for new bootstrap
+    }
+    if (score > best.score) {
+        best.score = score;
+        best.regraft_node = in_node;
+        best.regraft_dad = in_dad;
+    }
+
+    unregraftSubtree(info);
+    node_dad_nei->clearPartialLh();
+    in_node_dad_nei->clearPartialLh();
+    in_dad_dad_nei->clearPartialLh();
+
+    if (depth >= spr_radius)
+        return;
+    FOR_NEIGHBOR_IT(in_node, in_dad, it)
+        evaluateSPRRegrafts(info, (PhyloNode*) (*it)->node, in_node, depth+1, best);
+}
+
+void PhyloTree::doSPR(SPRMove &spr, PruningInfo &info) {
+    PhyloNode *node = spr.prune_node;
+    PhyloNode *dad = spr.prune_dad;
+    pruneSubtree(node, dad, info);
+    regraftSubtree(info, spr.regraft_node, spr.regraft_dad);
+
+    // keep branch IDs pairwise consistent: the joined branch takes the ID of dad-left,
+    // dad-in_node the ID of the regraft branch and dad-in_dad the ID of dad-right
+    int left_id = info.dad_nei_left->id;
+    int right_id = info.dad_nei_right->id;
+    int in_id = info.in_node_nei->id;
+    info.dad_nei_right->id = left_id;
+    info.left_nei->id = in_id;
+    info.in_node_nei->id = right_id;
+
+    // pruneSubtree already cleared partial_lh toward the old position, now the new one
+    dad->clearReversePartialLh(NULL);
+
+    current_it = (PhyloNeighbor*) dad->findNeighbor(node);
+    current_it_back = (PhyloNeighbor*) node->findNeighbor(dad);
+    theta_computed = false;
 }
 
 /****************************************************************************
@@ -5121,6 +5282,52 @@ double PhyloTree::testOneBranch(double best_score, double *pattern_lh, int reps,
         return 0.0;
 }
 
+void PhyloTree::computeAllNNIPatternLh(double best_score, BranchVector &branches, double *lh, double *pattern_lh) {
+    size_t nptn = getAlnNPattern();
+    for (size_t i = 0; i < branches.size(); i++)
+        computeNNIPatternLh(best_score, lh[2*i], pattern_lh + 2*i*nptn, lh[2*i+1], pattern_lh + (2*i+1)*nptn,
+            (PhyloNode*) branches[i].second, (PhyloNode*) branches[i].first);
+}
+
+/**
+    SH-aLRT and local bootstrap support of one branch from the RELL log-likelihoods
+    of the current tree and of its two NNI neighbors
+    @param lh log-likelihoods of the current tree and the two NNIs
+    @param rell rell[k][i] is the log-likelihood of tree k on resampling i
+    @param times number of resamplings
+    @param[out] lbp_support local bootstrap support
+    @return SH-aLRT support
+*/
+static double computeRELLSupport(double *lh, double **rell, int times, double &lbp_support) {
+    const int NUM_NNI = 3;
+    double aLRT = lh[0] - max(lh[1], lh[2]);
+    int SH_aLRT_support = 0;
+    int lbp_support_int = 0;
+    for (int i = 0; i < times; i++) {
+        double lh_new[NUM_NNI] = {rell[0][i], rell[1][i], rell[2][i]};
+        if (lh_new[0] > lh_new[1] && lh_new[0] > lh_new[2])
+            lbp_support_int++;
+        double cs[NUM_NNI], cs_best, cs_2nd_best;
+        cs[0] = lh_new[0] - lh[0];
+        cs[1] = lh_new[1] - lh[1];
+        cs[2] = lh_new[2] - lh[2];
+        if (cs[0] >= cs[1] && cs[0] >= cs[2]) {
+            cs_best = cs[0];
+            cs_2nd_best = max(cs[1], cs[2]);
+        } else if (cs[1] >= cs[2]) {
+            cs_best = cs[1];
+            cs_2nd_best = max(cs[0], cs[2]);
+        } else {
+            cs_best = cs[2];
+            cs_2nd_best = max(cs[0], cs[1]);
+        }
+        if (aLRT > (cs_best - cs_2nd_best) + 0.05)
+            SH_aLRT_support++;
+    }
+    lbp_support = ((double)lbp_support_int) / times;
+    return ((double) SH_aLRT_support) / times;
+}
+
 int PhyloTree::testAllBranches(int threshold, double best_score, double *pattern_lh, int reps, int lbp_reps, bool aLRT_test, bool aBayes_test,
         PhyloNode *node, PhyloNode *dad) {
     int num_low_support = 0;
@@ -5137,33 +5344,98 @@ int PhyloTree::testAllBranches(int threshold, double best_score, double *pattern
             save_all_trees = tmp;
         }
     }
-    if (dad && !node->isLeaf() && !dad->isLeaf()) {
-        double lbp_support, aLRT_support, aBayes_support;
-        double SH_aLRT_support = (testOneBranch(best_score, pattern_lh, reps, lbp_reps,
-            node, dad, lbp_support, aLRT_support, aBayes_support) * 100);
-        ostringstream ss;
-        ss.precision(3);
-        ss << node->name;
-        if (!node->name.empty())
-            ss << "/";
-        if (reps)
-            ss << SH_aLRT_support;
-        if (lbp_reps)
-            ss << "/" << lbp_support * 100;
-        if (aLRT_test)
-            ss << "/" << aLRT_support;
-        if (aBayes_test)
-            ss << "/" << aBayes_support;
-        node->name = ss.str();
-        if (SH_aLRT_support < threshold)
-            num_low_support = 1;
-        if (((PhyloNeighbor*) node->findNeighbor(dad))->partial_pars) {
-            ((PhyloNeighbor*) node->findNeighbor(dad))->partial_pars[0] = round(SH_aLRT_support);
-            ((PhyloNeighbor*) dad->findNeighbor(node))->partial_pars[0] = round(SH_aLRT_support);
-        }
-    }
-    FOR_NEIGHBOR_IT(node, dad, it)
-        num_low_support += testAllBranches(threshold, best_score, pattern_lh, reps, lbp_reps, aLRT_test, aBayes_test, (PhyloNode*) (*it)->node, node);
+    // inner branches in pre-order, first: dad, second: node
+    BranchVector branches;
+    if (dad && !node->isLeaf() && !dad->isLeaf())
+        branches.push_back(Branch(dad, node));
+    getInnerBranches(branches, node, dad);
+    if (branches.empty())
+        return 0;
+
+    size_t nptn = getAlnNPattern();
+    int times = max(reps, lbp_reps);
+
+    // one set of RELL resamplings shared by all branches
+    UFBootWeights rell_weights;
+    DoubleVector best_rell;
+    if (times > 0) {
+        rell_weights.init(times, nptn);
+        IntVector boot_freq(nptn);
+        int *rstream;
+        init_random(params->ran_seed, false, &rstream);
+        for (int i = 0; i < times; i++) {
+            aln->createBootstrapAlignment(boot_freq.data(), params->bootstrap_spec, rstream);
+            rell_weights.setWeights(i, boot_freq);
+        }
+        finish_random(rstream);
+        best_rell.resize(times);
+        rell_weights.computeRELL(pattern_lh, 1, nptn, 0, times, best_rell.data());
+    }
+
+    // NNI pattern and RELL log-likelihoods are kept for one block of branches at a time
+    const size_t BLOCK_MEM = ((size_t)1) << 28;
+    size_t block = max((size_t)num_threads, BLOCK_MEM / (2*(nptn + times)*sizeof(double)));
+    block = max((size_t)1, min(block, branches.size()));
+    double *nni_pattern_lh = aligned_alloc<double>(2*block*nptn);
+    DoubleVector nni_lh(2*block);
+    DoubleVector nni_rell(2*block*times);
+
+    int tmp = save_all_trees;
+    save_all_trees = 0;
+    for (size_t start = 0; start < branches.size(); start += block) {
+        BranchVector block_branches(branches.begin() + start, branches.begin() + min(start + block, branches.size()));
+        int nbranch = block_branches.size();
+        computeAllNNIPatternLh(best_score, block_branches, nni_lh.data(), nni_pattern_lh);
+        if (times > 0)
+            rell_weights.computeRELL(nni_pattern_lh, 2*nbranch, nptn, 0, times, nni_rell.data());
+
+        for (int i = 0; i < nbranch; i++) {
+            node = (PhyloNode*) block_branches[i].second;
+            dad = (PhyloNode*) block_branches[i].first;
+            double lh[3] = {best_score, nni_lh[2*i], nni_lh[2*i+1]};
+            double *rell[3] = {best_rell.data(), &nni_rell[2*i*times], &nni_rell[(2*i+1)*times]};
+
+            // compute parametric aLRT test support
+            double aLRT_stat = 2*(lh[0] - max(lh[1], lh[2]));
+            double aLRT_support = 0.0;
+            if (aLRT_stat >= 0) {
+                aLRT_support = Statistics_To_Probabilities(aLRT_stat);
+            }
+            double aBayes_support = 1.0 / (1.0 + exp(lh[1]-lh[0]) + exp(lh[2]-lh[0]));
+
+            double lbp_support = 0.0;
+            double SH_aLRT_support = 0.0;
+            if (times > 0) {
+                if (max(lh[1],lh[2]) == -DBL_MAX) {
+                    SH_aLRT_support = 100.0;
+                    outWarning("Branch where both NNIs violate constraint tree will show 100% SH-aLRT support");
+                } else
+                    SH_aLRT_support = computeRELLSupport(lh, rell, times, lbp_support) * 100;
+            }
+            ostringstream ss;
+            ss.precision(3);
+            ss << node->name;
+            if (!node->name.empty())
+                ss << "/";
+            if (reps)
+                ss << SH_aLRT_support;
+            if (lbp_reps)
+                ss << "/" << lbp_support * 100;
+            if (aLRT_test)
+                ss << "/" << aLRT_support;
+            if (aBayes_test)
+                ss << "/" << aBayes_support;
+            node->name = ss.str();
+            if (SH_aLRT_support < threshold)
+                num_low_support++;
+            if (((PhyloNeighbor*) node->findNeighbor(dad))->partial_pars) {
+                ((PhyloNeighbor*) node->findNeighbor(dad))->partial_pars[0] = round(SH_aLRT_support);
+                ((PhyloNeighbor*) dad->findNeighbor(node))->partial_pars[0] = round(SH_aLRT_support);
+            }
+        }
+    }
+    save_all_trees = tmp;
+    aligned_free(nni_pattern_lh);
 
     return num_low_support;
 }
@@ -5228,7 +5500,7 @@ bool PhyloTree::isSupportedNode(PhyloNode* node, int min_support) {
 }
 
 int PhyloTree::collapseStableClade(int min_support, NodeVector &pruned_taxa, StrVector &linked_name,
-        double* &dist_mat) {
+        DistanceMatrix* &dist_mat) {
     NodeVector taxa;
     NodeVector::iterator tax_it;
     StrVector::iterator linked_it;
@@ -5262,7 +5534,7 @@ int PhyloTree::collapseStableClade(int min_support, NodeVector &pruned_taxa, Str
                 ASSERT(near_nei);
                 // continue if the cherry is not stable, or distance between two taxa is near ZERO
                 if (!isSupportedNode((PhyloNode*) near_nei->node, min_support)
-                        && dist_mat[taxon->id * ntaxa + adj_taxon->id] > 2e-6)
+                        && dist_mat->get(taxon->id, adj_taxon->id) > 2e-6)
                     continue;
                 // now do the taxon pruning
                 Node * pruned_taxon = taxon, *stayed_taxon = adj_taxon;
@@ -5298,7 +5570,7 @@ int PhyloTree::collapseStableClade(int min_support, NodeVector &pruned_taxa, Str
         }
     // extract the sub alignment
     IntVector stayed_id;
-    int i, j;
+    int i;
     for (i = 0; i < taxa.size(); i++)
         if (linked_taxid[i] < 0)
             stayed_id.push_back(i);
@@ -5309,10 +5581,8 @@ int PhyloTree::collapseStableClade(int min_support, NodeVector &pruned_taxa, Str
     initializeTree();
     setAlignment(pruned_aln);
 
-    double *pruned_dist = new double[leafNum * leafNum];
-    for (i = 0; i < leafNum; i++)
-        for (j = 0; j < leafNum; j++)
-            pruned_dist[i * leafNum + j] = dist_mat[stayed_id[i] * ntaxa + stayed_id[j]];
+    DistanceMatrix *pruned_dist = new DistanceMatrix;
+    pruned_dist->extractSubMatrix(*dist_mat, stayed_id);
     dist_mat = pruned_dist;
 
     return pruned_taxa.size();
@@ -5699,6 +5969,7 @@ bool PhyloTree::computeTraversalInfo(PhyloNeighbor *dad_branch, PhyloNode *dad,
     PhyloNode *node = (PhyloNode*)dad_branch->node;
 
     if ((dad_branch->partial_lh_computed & 1) || node->isLeaf()) {
+        mem_slots.hit(dad_branch);
         return mem_slots.lock(dad_branch);
     }
 
@@ -5736,6 +6007,7 @@ bool PhyloTree::computeTraversalInfo(PhyloNeighbor *dad_branch, PhyloNode *dad,
 
     // re-orient partial_lh
     reorientPartialLh(dad_branch, dad);
+    mem_slots.miss(dad_branch);
 
     if (!dad_branch->partial_lh || mem_slots.locked(dad_branch)) {
         // still no free entry found, memory saving technique
@@ -5789,6 +6061,13 @@ bool PhyloTree::computeTraversalInfo(PhyloNeighbor *dad_branch, PhyloNode *dad,
         }
     }
 
+    if (params->lk_subtree_repeat && model->useRevKernel() && !model->isSiteSpecificModel()) {
+        info.ptn_repeat = computeSubtreeRepeat(dad_branch, dad);
+    } else if (!subtree_repeats.empty()) {
+        // the vector is recomputed without classes
+        retireSubtreeRepeat(dad_branch->partial_lh);
+    }
+
     if (!model->isSiteSpecificModel() && !Params::getInstance().buffer_mem_save) {
         //------- normal model -----
         info.echildren = buffer;
@@ -5803,6 +6082,107 @@ bool PhyloTree::computeTraversalInfo(PhyloNeighbor *dad_branch, PhyloNode *dad,
     return mem_slots.lock(dad_branch);
 }
 
+void PhyloTree::retireSubtreeRepeat(double *partial_lh) {
+    auto it = subtree_repeats.find(partial_lh);
+    if (it == subtree_repeats.end())
+        return;
+    if (it->second.traversal == subtree_repeat_traversal && !it->second.ptn_repeat.empty()) {
+        // an earlier branch of this traversal still points to ptn_repeat
+        subtree_repeats_retired.emplace_back();
+        subtree_repeats_retired.back().swap(it->second.ptn_repeat);
+    }
+    subtree_repeats.erase(it);
+}
+
+int *PhyloTree::computeSubtreeRepeat(PhyloNeighbor *dad_branch, PhyloNode *dad) {
+    PhyloNode *node = (PhyloNode*)dad_branch->node;
+    retireSubtreeRepeat(dad_branch->partial_lh);
+    SubtreeRepeat &repeat = subtree_repeats[dad_branch->partial_lh];
+    repeat.nei = dad_branch;
+    repeat.traversal = subtree_repeat_traversal;
+    size_t orig_nptn = aln->size();
+    size_t nptn = get_safe_upper_limit(orig_nptn) + max(get_safe_upper_limit(aln->num_states),
+        get_safe_upper_limit(model_factory->unobserved_ptns.size()));
+    // stop tracking once less than half of the patterns are repeats,
+    // ancestors cannot have more repeats than their descendants
+    int max_classes = orig_nptn/2;
+
+    vector<int> &ptn_class = repeat.ptn_class;
+    vector<int> child_class;
+    int num_classes = 0;
+    bool first = true;
+    FOR_NEIGHBOR_IT(node, dad, it) {
+        PhyloNeighbor *child = (PhyloNeighbor*)*it;
+        int child_num_classes;
+        if (child->node->isLeaf()) {
+            // tip: the class is the observed state
+            child_num_classes = aln->STATE_UNKNOWN+1;
+            child_class.resize(orig_nptn);
+            auto stateRow = getConvertedSequenceByNumber(child->node->id);
+            for (size_t ptn = 0; ptn < orig_nptn; ptn++)
+                child_class[ptn] = (stateRow != nullptr) ? stateRow[ptn] : aln->at(ptn)[child->node->id];
+        } else {
+            auto child_it = subtree_repeats.find(child->partial_lh);
+            if (child_it == subtree_repeats.end() || child_it->second.nei != child ||
+                child_it->second.ptn_class.size() != nptn) {
+                num_classes = max_classes+1;
+                break;
+            }
+            child_num_classes = child_it->second.num_classes;
+            child_class.assign(child_it->second.ptn_class.begin(), child_it->second.ptn_class.begin() + orig_nptn);
+        }
+        if (first) {
+            ptn_class.swap(child_class);
+            num_classes = child_num_classes;
+            first = false;
+            continue;
+        }
+        // combine the classes so far with the classes of this child
+        int new_classes = 0;
+        if ((uint64_t)num_classes*child_num_classes <= max((uint64_t)4*orig_nptn, (uint64_t)4096)) {
+            vector<int> class_map(num_classes*child_num_classes, -1);
+            for (size_t ptn = 0; ptn < orig_nptn; ptn++) {
+                int &id = class_map[ptn_class[ptn]*child_num_classes + child_class[ptn]];
+                if (id < 0)
+                    id = new_classes++;
+                ptn_class[ptn] = id;
+            }
+        } else {
+            unordered_map<uint64_t, int> class_map;
+            for (size_t ptn = 0; ptn < orig_nptn && new_classes <= max_classes; ptn++) {
+                auto ins = class_map.insert({(uint64_t)ptn_class[ptn]*child_num_classes + child_class[ptn], new_classes});
+                if (ins.second)
+                    new_classes++;
+                ptn_class[ptn] = ins.first->second;
+            }
+        }
+        num_classes = new_classes;
+        if (num_classes > max_classes)
+            break;
+    }
+
+    if (num_classes > max_classes) {
+        // too few repeats, ancestors will not be tracked either
+        vector<int>().swap(repeat.ptn_class);
+        vector<int>().swap(repeat.ptn_repeat);
+        repeat.num_classes = 0;
+        return NULL;
+    }
+
+    // patterns beyond the alignment (vector padding, unobserved patterns for +ASC) never repeat
+    ptn_class.resize(nptn, -1);
+    repeat.num_classes = num_classes;
+    repeat.ptn_repeat.assign(nptn, -1);
+    // link patterns of the same class, scaling is only done for non-invariant patterns
+    vector<int> last_ptn(2*num_classes, -1);
+    for (size_t ptn = 0; ptn < orig_nptn; ptn++) {
+        int key = ptn_class[ptn]*2 + (ptn_invar[ptn] != 0.0);
+        repeat.ptn_repeat[ptn] = last_ptn[key];
+        last_ptn[key] = ptn;
+    }
+    return repeat.ptn_repeat.data();
+}
+
 void PhyloTree::writeSiteLh(ostream &out, SiteLoglType wsl, int partid) {
     // error checking
     if (!getModel()->isMixture()) {
@@ -5901,26 +6281,26 @@ const string& PhyloTree::getDistanceFileWritten() const {
 void PhyloTree::initProgress(double size, std::string name, const char* verb, const char* noun) {
     {
         ++progressStackDepth;
-        if (progressStackDepth==1) {
+        if (progressStackDepth==1 && !progressDisabled) {
             progress = new progress_display(size, name.c_str(), verb, noun);
         }
     }
 }
     
 void PhyloTree::trackProgress(double amount) {
-    if (progressStackDepth==1) {
+    if (progressStackDepth==1 && progress) {
         (*progress) += amount;
     }
 }
 
 void PhyloTree::hideProgress() {
-    if (progressStackDepth>0) {
+    if (progressStackDepth>0 && progress) {
         progress->hide();
     }
 }
 
 void PhyloTree::showProgress() {
-    if (progressStackDepth>0) {
+    if (progressStackDepth>0 && progress) {
         progress->show();
     }
 }
@@ -5928,7 +6308,7 @@ void PhyloTree::showProgress() {
 void PhyloTree::doneProgress() {
     {
         --progressStackDepth;
-        if (progressStackDepth==0) {
+        if (progressStackDepth==0 && progress) {
             progress->done();
             delete progress;
             progress = nullptr;
@@ -36,6 +36,7 @@
 #include "mtree.h"
 #include "alignment/alignment.h"
 #include "alignment/alignmentsummary.h"
+#include "alignment/weightedalignmentview.h"
 #include "model/modelsubst.h"
 #include "model/modelfactory.h"
 #include "phylonode.h"
@@ -47,6 +48,7 @@
 #include "constrainttree.h"
 #include "memslot.h"
 #include "utils/progress.h"
+#include "utils/distancematrix.h"
 
 class AlignmentPairwise;
 
@@ -79,6 +81,17 @@ const double TOL_LIKELIHOOD_PARAMOPT = 0.001; // BQM: newly introduced for Model
 //#define LOG_SCALING_THRESHOLD log(SCALING_THRESHOLD)
 #define LOG_SCALING_THRESHOLD -177.4456782233459932741
 
+// scaling step for partial likelihoods stored in single precision (--lh-float),
+// chosen so that scaled values stay well inside the float range
+#define SCALING_THRESHOLD_FLOAT_EXP 112
+// 2^{-112}
+#define SCALING_THRESHOLD_FLOAT 1.925929944387235853055977942584927318538e-34
+#define LOG_SCALING_THRESHOLD_FLOAT -77.63248422271387465472999760331577562446
+// scale_num of a single-precision partial likelihood that makes the tree fall back to double storage:
+// scale_num is a UBYTE and float scaling units are 2.3 times smaller than double ones, so stop early
+// enough that adding up the scale_num of the children cannot wrap around before the switch
+#define SCALE_NUM_FLOAT_LIMIT 80
+
 const int SPR_DEPTH = 2;
 
 //using namespace Eigen;
@@ -228,6 +241,11 @@ struct PruningInfo {
     double left_len, right_len;
     double *dad_lh_left, *dad_lh_right;
 
+    // regraft branch (in_node, in_dad), set by regraftSubtree
+    NeighborVec::iterator in_node_it, in_dad_it;
+    Neighbor *in_node_nei, *in_dad_nei;
+    Node *in_node, *in_dad;
+    double in_len;
 };
 
 /**
@@ -323,13 +341,38 @@ public:
     PhyloNode *dad;
     double *echildren;
     double *partial_lh_leaves;
+    /** previous pattern with the same subtree repeat class, -1 if none; NULL if not used */
+    int *ptn_repeat;
 
     TraversalInfo(PhyloNeighbor *dad_branch, PhyloNode *dad) {
         this->dad = dad;
         this->dad_branch = dad_branch;
+        ptn_repeat = NULL;
     }
 };
 
+/**
+    subtree repeats of a partial likelihood vector: patterns with the same class
+    have the same combination of tip states in the subtree, thus the same partial likelihoods
+ */
+struct SubtreeRepeat {
+    /** branch whose partial likelihood the classes were computed for; the vector may be
+        swapped to, or taken over by, another branch later, the classes are stale then */
+    PhyloNeighbor *nei;
+
+    /** PhyloTree::subtree_repeat_traversal when the classes were computed */
+    int traversal;
+
+    /** class ID per pattern, empty if the subtree has too few repeats to be worth it */
+    vector<int> ptn_class;
+
+    /** number of distinct classes */
+    int num_classes;
+
+    /** previous pattern with the same class and the same ptn_invar status, -1 if none */
+    vector<int> ptn_repeat;
+};
+
 // ********************************************
 // END traversal information
 // ********************************************
@@ -456,6 +499,13 @@ public:
      */
     virtual void setAlignment(Alignment *alignment);
 
+    /**
+            use pattern weights of a view in place of the pattern frequencies of aln
+            for likelihood computation; partial likelihoods must be cleared afterwards
+            @param view view of aln, or NULL to use aln itself
+     */
+    void setAlignmentView(WeightedAlignmentView *view);
+
     /** set the root by name
         @param my_root root node name
         @param multi_taxa TRUE if my_root is a comma-separated list of nodes
@@ -810,6 +860,43 @@ public:
     /** true if using safe numeric for likelihood kernel */
     bool safe_numeric;
 
+    /** true if the safe kernel was switched on after a numerical underflow */
+    bool safe_numeric_fallback;
+
+    /**
+        switch to the safe likelihood kernel after a numerical underflow of the normal kernel
+        and invalidate all partial likelihoods computed so far
+        @return true if switched, false if the safe kernel is already in use
+    */
+    bool switchToSafeNumeric();
+
+    /** true if partial likelihood vectors in central_partial_lh are stored in single precision */
+    bool float_partial_lh;
+
+    /** true if a scale_num of single-precision partial likelihoods reached SCALE_NUM_FLOAT_LIMIT */
+    bool float_partial_lh_overflow;
+
+    /**
+        reallocate partial likelihoods in double precision after float_partial_lh_overflow was set
+        and invalidate all partial likelihoods computed so far.
+        Must not be called while partial_lh pointers are swapped (e.g. during NNI evaluation).
+        @return true if switched, false if partial likelihoods are already stored in double precision
+    */
+    bool switchToDoublePartialLh();
+
+    /** free central_partial_lh and nni_partial_lh and allocate them again in double precision */
+    void reallocDoublePartialLh();
+
+    /**
+        @return true if the current model and kernel can store partial likelihoods in single precision
+    */
+    bool isFloatPartialLhSupported();
+
+    /** @return log of the scaling factor represented by one unit of scale_num */
+    double getLogScalingThreshold() {
+        return float_partial_lh ? LOG_SCALING_THRESHOLD_FLOAT : LOG_SCALING_THRESHOLD;
+    }
+
     /** number of threads used for likelihood kernel */
     int num_threads;
 
@@ -826,6 +913,29 @@ public:
     */
     bool computeTraversalInfo(PhyloNeighbor *dad_branch, PhyloNode *dad, double* &buffer);
 
+    /**
+        compute subtree repeat classes for the partial likelihood of dad_branch
+        from the classes of its children (Params::lk_subtree_repeat)
+        @return previous-repeat index per pattern, NULL if the subtree has too few repeats
+    */
+    int *computeSubtreeRepeat(PhyloNeighbor *dad_branch, PhyloNode *dad);
+
+    /** subtree repeats, keyed by the partial likelihood vector they describe */
+    unordered_map<double*, SubtreeRepeat> subtree_repeats;
+
+    /** number of traversals computed so far, to find entries that the current traversal_info points to */
+    int subtree_repeat_traversal;
+
+    /** ptn_repeat of entries replaced while the current traversal_info may still point to them
+        (with LM_MEM_SAVE a vector can be reused within a traversal), freed at the next traversal */
+    vector<vector<int> > subtree_repeats_retired;
+
+    /**
+        drop the subtree repeats of a partial likelihood vector
+        @param partial_lh the vector
+    */
+    void retireSubtreeRepeat(double *partial_lh);
+
 
     /**
         compute traversal_info of both subtrees
@@ -891,10 +1001,10 @@ public:
     template <class VectorClass, const bool SAFE_NUMERIC, const int nstates, const bool FMA = false>
     void computeNonrevPartialLikelihoodSIMD(TraversalInfo &info, size_t ptn_lower, size_t ptn_upper, int thread_id);
 
-    template <class VectorClass, const bool SAFE_NUMERIC, const int nstates, const bool FMA = false, const bool SITE_MODEL = false>
+    template <class VectorClass, const bool SAFE_NUMERIC, const int nstates, const bool FMA = false, const bool SITE_MODEL = false, const bool FLOAT_LH = false>
     void computePartialLikelihoodSIMD(TraversalInfo &info, size_t ptn_lower, size_t ptn_upper, int thread_id);
 
-    template <class VectorClass, const bool SAFE_NUMERIC, const bool FMA = false, const bool SITE_MODEL = false>
+    template <class VectorClass, const bool SAFE_NUMERIC, const bool FMA = false, const bool SITE_MODEL = false, const bool FLOAT_LH = false>
     void computePartialLikelihoodGenericSIMD(TraversalInfo &info, size_t ptn_lower, size_t ptn_upper, int thread_id);
 
     /*
@@ -944,10 +1054,10 @@ public:
     template<class VectorClass, const bool SAFE_NUMERIC, const int nstates, const bool FMA = false>
     double computeNonrevLikelihoodBranchSIMD(PhyloNeighbor *dad_branch, PhyloNode *dad);
 
-    template <class VectorClass, const bool SAFE_NUMERIC, const int nstates, const bool FMA = false, const bool SITE_MODEL = false>
+    template <class VectorClass, const bool SAFE_NUMERIC, const int nstates, const bool FMA = false, const bool SITE_MODEL = false, const bool FLOAT_LH = false>
     double computeLikelihoodBranchSIMD(PhyloNeighbor *dad_branch, PhyloNode *dad);
 
-    template <class VectorClass, const bool SAFE_NUMERIC, const bool FMA = false, const bool SITE_MODEL = false>
+    template <class VectorClass, const bool SAFE_NUMERIC, const bool FMA = false, const bool SITE_MODEL = false, const bool FLOAT_LH = false>
     double computeLikelihoodBranchGenericSIMD(PhyloNeighbor *dad_branch, PhyloNode *dad);
 
     /*
@@ -979,10 +1089,10 @@ public:
 //    template <class VectorClass, const int VCSIZE, const int nstates>
 //    double computeLikelihoodFromBufferEigenSIMD();
 
-    template <class VectorClass, const int nstates, const bool FMA = false, const bool SITE_MODEL = false>
+    template <class VectorClass, const int nstates, const bool FMA = false, const bool SITE_MODEL = false, const bool FLOAT_LH = false>
     double computeLikelihoodFromBufferSIMD();
 
-    template <class VectorClass, const bool FMA = false, const bool SITE_MODEL = false>
+    template <class VectorClass, const bool FMA = false, const bool SITE_MODEL = false, const bool FLOAT_LH = false>
     double computeLikelihoodFromBufferGenericSIMD();
 
     /*
@@ -1260,17 +1370,17 @@ public:
     template<class VectorClass, const bool SAFE_NUMERIC, const int nstates, const bool FMA = false>
     void computeNonrevLikelihoodDervSIMD(PhyloNeighbor *dad_branch, PhyloNode *dad, double *df, double *ddf);
 
-    template <class VectorClass, const bool SAFE_NUMERIC, const int nstates, const bool FMA = false, const bool SITE_MODEL = false>
+    template <class VectorClass, const bool SAFE_NUMERIC, const int nstates, const bool FMA = false, const bool SITE_MODEL = false, const bool FLOAT_LH = false>
     void computeLikelihoodBufferSIMD(PhyloNeighbor *dad_branch, PhyloNode *dad, size_t ptn_lower, size_t ptn_upper, int thread_id);
 
-    template <class VectorClass, const bool SAFE_NUMERIC, const bool FMA = false, const bool SITE_MODEL = false>
+    template <class VectorClass, const bool SAFE_NUMERIC, const bool FMA = false, const bool SITE_MODEL = false, const bool FLOAT_LH = false>
     void computeLikelihoodBufferGenericSIMD(PhyloNeighbor *dad_branch, PhyloNode *dad, size_t ptn_lower, size_t ptn_upper, int thread_id);
 
 
-    template <class VectorClass, const bool SAFE_NUMERIC, const int nstates, const bool FMA = false, const bool SITE_MODEL = false>
+    template <class VectorClass, const bool SAFE_NUMERIC, const int nstates, const bool FMA = false, const bool SITE_MODEL = false, const bool FLOAT_LH = false>
     void computeLikelihoodDervSIMD(PhyloNeighbor *dad_branch, PhyloNode *dad, double *df, double *ddf);
 
-    template <class VectorClass, const bool SAFE_NUMERIC, const bool FMA = false, const bool SITE_MODEL = false>
+    template <class VectorClass, const bool SAFE_NUMERIC, const bool FMA = false, const bool SITE_MODEL = false, const bool FLOAT_LH = false>
     void computeLikelihoodDervGenericSIMD(PhyloNeighbor *dad_branch, PhyloNode *dad, double *df, double *ddf);
 
     /** For Mixlen stuffs */
@@ -1360,6 +1470,30 @@ public:
      * @return parsimony score
      */
     virtual int computeParsimonyTree(const char *out_prefix, Alignment *alignment, int *rand_stream);
+
+    /**
+     * FAST VERSION: improve a bifurcating tree by parsimony SPR moves. Each regraft position
+     * within the radius is scored by computing one partial parsimony vector from the
+     * cached vectors of the target branch
+     * @param radius maximal number of branches between pruning and regraft point
+     * @return parsimony score
+     */
+    int optimizeParsimonySPR(int radius);
+
+    /**
+     * prune the subtree below node (seen from dad) and regraft it at the best position
+     * within the radius, if this reduces the parsimony score
+     * @param cur_score parsimony score of the current tree
+     * @return parsimony score after the move
+     */
+    int optimizeParsimonySubtree(PhyloNode *node, PhyloNode *dad, int radius, int cur_score);
+
+    /**
+     * score regrafting the pruned subtree onto branch (in_node, in_dad) and recursively the
+     * branches behind in_node, in_dad is the node closer to the pruning point
+     */
+    void evaluateParsimonyRegrafts(PruningInfo &info, PhyloNode *in_node, PhyloNode *in_dad,
+        int depth, int radius, SPRMove &best);
         
     /****************************************************************************
             Branch length optimization by maximum likelihood
@@ -1507,6 +1641,12 @@ public:
      * frequencies of alignment patterns, used as buffer for likelihood computation
      */
     double *ptn_freq;
+
+    /**
+     * if not NULL: pattern weights over aln used in place of its pattern frequencies,
+     * e.g. for a bootstrap replicate sharing the original alignment (not owned)
+     */
+    WeightedAlignmentView *aln_view;
     
     /**
      * frequencies of aln->ordered_pattern, used as buffer for parsimony computation
@@ -1654,30 +1794,31 @@ public:
     void printDistanceFile();
     
     /**
-            compute distance and variance matrix, assume dist_mat and var_mat are allocated by memory of size num_seqs * num_seqs.
+            compute distance and variance matrix, assume dist_mat and var_mat are sized for num_seqs sequences.
             @param dist_mat (OUT) distance matrix between all pairs of sequences in the alignment
-            @param var_mat (OUT) variance matrix for distance matrix
+            @param var_mat (OUT) variance matrix for distance matrix, NULL if not needed
             @return the longest distance
      */
-    double computeDist(double *dist_mat, double *var_mat);
+    double computeDist(DistanceMatrix *dist_mat, DistanceMatrix *var_mat);
 
-    double computeDist_Experimental(double *dist_mat, double *var_mat);
+    double computeDist_Experimental(DistanceMatrix *dist_mat, DistanceMatrix *var_mat);
     
     /**
-            compute observed distance matrix, assume dist_mat is allocated by memory of size num_seqs * num_seqs.
+            compute observed distance matrix, assume dist_mat is sized for num_seqs sequences.
             @param dist_mat (OUT) distance matrix between all pairs of sequences in the alignment
             @return the longest distance
      */
-    double computeObsDist(double *dist_mat);
+    double computeObsDist(DistanceMatrix *dist_mat);
 
     /**
             compute distance matrix, allocating memory if necessary
             @param params program parameters
             @param alignment input alignment
             @param dist_mat (OUT) distance matrix between all pairs of sequences in the alignment
+            @param var_mat (OUT) variance matrix, only allocated if needsDistVariance()
             @return the longest distance
      */
-    double computeDist(Params &params, Alignment *alignment, double* &dist_mat, double* &var_mat);
+    double computeDist(Params &params, Alignment *alignment, DistanceMatrix* &dist_mat, DistanceMatrix* &var_mat);
 
     /**
             compute observed distance matrix, allocating memory if necessary
@@ -1686,7 +1827,7 @@ public:
             @param dist_mat (OUT) distance matrix between all pairs of sequences in the alignment
             @return the longest distance
      */
-    double computeObsDist(Params &params, Alignment *alignment, double* &dist_mat);
+    double computeObsDist(Params &params, Alignment *alignment, DistanceMatrix* &dist_mat);
 
     /**
             correct the distances to follow metric property of triangle inequalities.
@@ -1694,7 +1835,18 @@ public:
             @param dist_mat (IN/OUT) the shortest path between all pairs of taxa
     @return the longest distance
      */
-    double correctDist(double *dist_mat);
+    double correctDist(DistanceMatrix *dist_mat);
+
+    /**
+            @return TRUE if the variances of distances cannot be derived from the distances
+            (WLS_SECOND_TAYLOR and WLS_PAUPLIN), so that var_matrix must be stored
+     */
+    bool needsDistVariance();
+
+    /**
+            @return variance of the distance between two sequences, for least-square branch lengths
+     */
+    double getDistVariance(int seq1, int seq2);
 
     /****************************************************************************
             compute BioNJ tree, a more accurate extension of Neighbor-Joining
@@ -1818,11 +1970,59 @@ public:
 
     double assessSPRMove(double cur_score, const SPRMove &spr);
 
+    /**
+            prune the subtree below node (seen from dad) and join the two other branches of dad.
+            Neighbor objects are moved rather than re-created, so that partial likelihoods
+            pointing away from the pruning point remain valid
+            @param node root of the pruned subtree
+            @param dad the node where the subtree is attached, must have degree 3
+            @param[out] info pruning information for regraftSubtree and unpruneSubtree
+     */
     void pruneSubtree(PhyloNode *node, PhyloNode *dad, PruningInfo &info);
 
+    /**
+            regraft the subtree pruned by pruneSubtree onto the branch (in_node, in_dad)
+            @param info pruning information
+            @param in_node, in_dad the regraft branch, in_dad is the node closer to the pruning point
+     */
     void regraftSubtree(PruningInfo &info,
             PhyloNode *in_node, PhyloNode *in_dad);
 
+    /**
+            undo regraftSubtree, going back to the pruned tree
+     */
+    void unregraftSubtree(PruningInfo &info);
+
+    /**
+            undo pruneSubtree, re-attaching the subtree at its original position
+     */
+    void unpruneSubtree(PruningInfo &info);
+
+    /**
+            lazy SPR: find the best position to regraft the subtree below node (seen from dad)
+            within a radius of the pruning point. Each position is scored by only optimizing the
+            three branches around dad, with the partial likelihoods of the pruned tree
+            reused from one position to the next. The tree is unchanged on return.
+            @param node root of the pruned subtree
+            @param dad the node where the subtree is attached
+            @param radius maximal number of branches between pruning and regraft point
+            @return the best SPR move, its score is -DBL_MAX if no regraft position exists
+     */
+    SPRMove getBestSPRForSubtree(PhyloNode *node, PhyloNode *dad, int radius);
+
+    /**
+            score the regraft branch (in_node, in_dad) and recursively the branches behind in_node
+     */
+    void evaluateSPRRegrafts(PruningInfo &info, PhyloNode *in_node, PhyloNode *in_dad,
+            int depth, SPRMove &best);
+
+    /**
+            apply an SPR move to the tree, clearing partial likelihoods that became invalid
+            @param spr the move
+            @param[out] info pruning information, e.g. to undo the move
+     */
+    void doSPR(SPRMove &spr, PruningInfo &info);
+
     /****************************************************************************
             Approximate Likelihood Ratio Test with SH-like interpretation
      ****************************************************************************/
@@ -1837,6 +2037,15 @@ public:
      */
     void resampleLh(double **pat_lh, double *lh_new, int *rstream);
 
+    /**
+            compute the pattern log-likelihoods of both NNIs around each of a batch of inner branches
+            @param best_score log-likelihood of the current tree
+            @param branches inner branches, first: dad, second: node
+            @param[out] lh lh[2*i] and lh[2*i+1] are the log-likelihoods of the NNIs of branch i
+            @param[out] pattern_lh pattern log-likelihoods of NNI j start at pattern_lh + j*nptn
+     */
+    virtual void computeAllNNIPatternLh(double best_score, BranchVector &branches, double *lh, double *pattern_lh);
+
     /**
             Test one branch of the tree with aLRT SH-like interpretation
      */
@@ -1846,7 +2055,9 @@ public:
             double &lbp_support, double &aLRT_support, double &aBayes_support);
 
     /**
-            Test all branches of the tree with aLRT SH-like interpretation
+            Test all branches of the tree with aLRT SH-like interpretation.
+            All branches share one set of RELL resamplings, their NNI pattern
+            log-likelihoods are computed in blocks by computeAllNNIPatternLh
      */
     virtual int testAllBranches(int threshold, double best_score, double *pattern_lh,
             int reps, int lbp_reps, bool aLRT_test, bool aBayes_test,
@@ -1946,7 +2157,7 @@ public:
             Collapse stable (highly supported) clades by one representative
             @return the number of taxa prunned
      */
-    int collapseStableClade(int min_support, NodeVector &pruned_taxa, StrVector &linked_name, double* &dist_mat);
+    int collapseStableClade(int min_support, NodeVector &pruned_taxa, StrVector &linked_name, DistanceMatrix* &dist_mat);
 
     int restoreStableClade(Alignment *original_aln, NodeVector &pruned_taxa, StrVector &linked_name);
 
@@ -1983,12 +2194,12 @@ public:
     /**
      * Distance matrix
      */
-    double *dist_matrix;
+    DistanceMatrix *dist_matrix;
 
     /**
-     * Variance matrix
+     * Variance matrix, NULL unless needsDistVariance()
      */
-    double *var_matrix;
+    DistanceMatrix *var_matrix;
 
     /** distance matrix file */
     string dist_file;
@@ -2400,6 +2611,8 @@ protected:
     /** stack of tasks in progress (top of stack is innermost task) */
     progress_display* progress;
     int  progressStackDepth;
+    /** true to show no progress of this tree, e.g. for hill-climbers running in parallel */
+    bool progressDisabled;
     void initProgress(double size, std::string name, const char*, const char*);
     void trackProgress(double amount);
     void hideProgress();
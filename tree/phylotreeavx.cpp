@@ -144,6 +144,41 @@ void PhyloTree::setLikelihoodKernelAVX() {
         return;        
     }
 
+    if (float_partial_lh) {
+        // partial likelihoods stored in single precision, see isFloatPartialLhSupported()
+        computeLikelihoodDervMixlenPointer = NULL;
+        switch (aln->num_states) {
+        case 4:
+            if (safe_numeric) {
+                computeLikelihoodBranchPointer  = &PhyloTree::computeLikelihoodBranchSIMD <Vec4d, SAFE_LH, 4, false, false, true>;
+                computeLikelihoodDervPointer    = &PhyloTree::computeLikelihoodDervSIMD   <Vec4d, SAFE_LH, 4, false, false, true>;
+                computePartialLikelihoodPointer = &PhyloTree::computePartialLikelihoodSIMD<Vec4d, SAFE_LH, 4, false, false, true>;
+            } else {
+                computeLikelihoodBranchPointer  = &PhyloTree::computeLikelihoodBranchSIMD <Vec4d, NORM_LH, 4, false, false, true>;
+                computeLikelihoodDervPointer    = &PhyloTree::computeLikelihoodDervSIMD   <Vec4d, NORM_LH, 4, false, false, true>;
+                computePartialLikelihoodPointer = &PhyloTree::computePartialLikelihoodSIMD<Vec4d, NORM_LH, 4, false, false, true>;
+            }
+            computeLikelihoodFromBufferPointer = &PhyloTree::computeLikelihoodFromBufferSIMD<Vec4d, 4, false, false, true>;
+            break;
+        case 20:
+            if (safe_numeric) {
+                computeLikelihoodBranchPointer  = &PhyloTree::computeLikelihoodBranchSIMD <Vec4d, SAFE_LH, 20, false, false, true>;
+                computeLikelihoodDervPointer    = &PhyloTree::computeLikelihoodDervSIMD   <Vec4d, SAFE_LH, 20, false, false, true>;
+                computePartialLikelihoodPointer = &PhyloTree::computePartialLikelihoodSIMD<Vec4d, SAFE_LH, 20, false, false, true>;
+            } else {
+                computeLikelihoodBranchPointer  = &PhyloTree::computeLikelihoodBranchSIMD <Vec4d, NORM_LH, 20, false, false, true>;
+                computeLikelihoodDervPointer    = &PhyloTree::computeLikelihoodDervSIMD   <Vec4d, NORM_LH, 20, false, false, true>;
+                computePartialLikelihoodPointer = &PhyloTree::computePartialLikelihoodSIMD<Vec4d, NORM_LH, 20, false, false, true>;
+            }
+            computeLikelihoodFromBufferPointer = &PhyloTree::computeLikelihoodFromBufferSIMD<Vec4d, 20, false, false, true>;
+            break;
+        default:
+            ASSERT(0);
+            break;
+        }
+        return;
+    }
+
     if (safe_numeric) {
 	switch(aln->num_states) {
         case 4:
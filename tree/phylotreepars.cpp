@@ -1149,6 +1149,10 @@ int PhyloTree::computeParsimonyTree(const char *out_prefix, Alignment *alignment
     
     ASSERT(index == 4*leafNum-6);
 
+    // SPR moves may violate the constraint tree
+    if (params && params->pars_spr && constraintTree.empty())
+        best_pars_score = optimizeParsimonySPR(params->sprDist);
+
     nodeNum = 2 * leafNum - 2;
     initializeTree();
     // parsimony tree is always unrooted
@@ -1199,6 +1203,185 @@ int PhyloTree::addTaxonMPFast(Node *added_taxon, Node* added_node, Node* node, N
 
 }
 
+/****************************************************************************
+ Parsimony SPR
+ ****************************************************************************/
+
+int PhyloTree::optimizeParsimonySPR(int radius) {
+    int cur_score = computeParsimony();
+    int num_moves = 0;
+    for (int step = 1; ; step++) {
+        int old_score = cur_score;
+
+        // prune points collected first, as moves change the neighbor lists
+        NodeVector nodes, prune_nodes, prune_dads;
+        getAllNodes(nodes);
+        for (NodeVector::iterator it = nodes.begin(); it != nodes.end(); it++) {
+            if ((*it)->isLeaf())
+                continue;
+            FOR_NEIGHBOR_DECLARE(*it, NULL, nit) {
+                prune_nodes.push_back((*nit)->node);
+                prune_dads.push_back(*it);
+            }
+        }
+        for (int i = 0; i < prune_nodes.size(); i++) {
+            // an earlier move may have changed the prune point
+            if (!prune_nodes[i]->isNeighbor(prune_dads[i]))
+                continue;
+            int score = optimizeParsimonySubtree((PhyloNode*) prune_nodes[i], (PhyloNode*) prune_dads[i], radius, cur_score);
+            if (score < cur_score)
+                num_moves++;
+            cur_score = score;
+        }
+        if (verbose_mode >= VB_MAX)
+            cout << "Parsimony SPR round " << step << ": " << num_moves << " moves, score = " << cur_score << endl;
+        if (cur_score >= old_score)
+            break;
+    }
+    return cur_score;
+}
+
+int PhyloTree::optimizeParsimonySubtree(PhyloNode *node, PhyloNode *dad, int radius, int cur_score) {
+    if (dad->isLeaf() || dad->degree() != 3)
+        return cur_score;
+
+    PruningInfo info;
+    info.node = node;
+    info.dad = dad;
+    info.in_node = info.in_dad = NULL;
+    PhyloNeighbor *subtree_nei = (PhyloNeighbor*) dad->findNeighbor(node);
+    if ((subtree_nei->partial_lh_computed & 2) == 0)
+        computePartialParsimony(subtree_nei, dad);
+    bool first = true;
+    FOR_NEIGHBOR_IT(dad, node, it) {
+        PhyloNeighbor *nei = (PhyloNeighbor*) (*it);
+        if ((nei->partial_lh_computed & 2) == 0)
+            computePartialParsimony(nei, dad);
+        if (first) {
+            info.dad_it_left = it;
+            info.dad_nei_left = nei;
+            info.left_node = nei->node;
+            first = false;
+        } else {
+            info.dad_it_right = it;
+            info.dad_nei_right = nei;
+            info.right_node = nei->node;
+        }
+    }
+    info.left_it = info.left_node->findNeighborIt(dad);
+    info.right_it = info.right_node->findNeighborIt(dad);
+    info.left_nei = (*info.left_it);
+    info.right_nei = (*info.right_it);
+
+    PhyloNeighbor *dad_nei_left = (PhyloNeighbor*) info.dad_nei_left;
+    PhyloNeighbor *dad_nei_right = (PhyloNeighbor*) info.dad_nei_right;
+    PhyloNeighbor *left_nei = (PhyloNeighbor*) info.left_nei;
+    PhyloNeighbor *right_nei = (PhyloNeighbor*) info.right_nei;
+    UINT *dad_left_pars = dad_nei_left->partial_pars, *dad_right_pars = dad_nei_right->partial_pars;
+    UINT *left_pars = left_nei->partial_pars, *right_pars = right_nei->partial_pars;
+    int left_computed = left_nei->partial_lh_computed, right_computed = right_nei->partial_lh_computed;
+
+    // prune: left and right see each other through the vectors of dad
+    left_nei->node = info.right_node;
+    left_nei->partial_pars = dad_right_pars;
+    left_nei->partial_lh_computed = dad_nei_right->partial_lh_computed;
+    right_nei->node = info.left_node;
+    right_nei->partial_pars = dad_left_pars;
+    right_nei->partial_lh_computed = dad_nei_left->partial_lh_computed;
+
+    SPRMove best;
+    best.prune_node = node;
+    best.prune_dad = dad;
+    best.regraft_node = best.regraft_dad = NULL;
+    best.score = cur_score;
+    PhyloNode *left = (PhyloNode*) info.left_node;
+    PhyloNode *right = (PhyloNode*) info.right_node;
+    FOR_NEIGHBOR_IT(left, right, it)
+        evaluateParsimonyRegrafts(info, (PhyloNode*) (*it)->node, left, 1, radius, best);
+    FOR_NEIGHBOR_IT(right, left, it)
+        evaluateParsimonyRegrafts(info, (PhyloNode*) (*it)->node, right, 1, radius, best);
+
+    // unprune
+    left_nei->node = dad;
+    left_nei->partial_pars = left_pars;
+    left_nei->partial_lh_computed = left_computed;
+    right_nei->node = dad;
+    right_nei->partial_pars = right_pars;
+    right_nei->partial_lh_computed = right_computed;
+    dad_nei_left->node = left;
+    dad_nei_left->partial_pars = dad_left_pars;
+    dad_nei_left->partial_lh_computed |= 2;
+    dad_nei_right->node = right;
+    dad_nei_right->partial_pars = dad_right_pars;
+    dad_nei_right->partial_lh_computed |= 2;
+    ((PhyloNeighbor*) node->findNeighbor(dad))->partial_lh_computed &= ~2;
+
+    if (!best.regraft_node)
+        return cur_score;
+
+    // apply the move
+    PhyloNode *in_node = best.regraft_node;
+    PhyloNode *in_dad = best.regraft_dad;
+    left->updateNeighbor(dad, right);
+    right->updateNeighbor(dad, left);
+    in_node->updateNeighbor(in_dad, dad);
+    in_dad->updateNeighbor(in_node, dad);
+    dad->updateNeighbor(left, in_node);
+    dad->updateNeighbor(right, in_dad);
+
+    // invalidate vectors whose subtree contains the old or the new position
+    ((PhyloNeighbor*) left->findNeighbor(right))->partial_lh_computed = 0;
+    ((PhyloNeighbor*) right->findNeighbor(left))->partial_lh_computed = 0;
+    ((PhyloNeighbor*) dad->findNeighbor(in_node))->partial_lh_computed = 0;
+    ((PhyloNeighbor*) dad->findNeighbor(in_dad))->partial_lh_computed = 0;
+    left->clearReversePartialLh(right);
+    right->clearReversePartialLh(left);
+    dad->clearReversePartialLh(NULL);
+
+    if (verbose_mode >= VB_MAX)
+        ASSERT(computeParsimony() == (int) best.score);
+    return (int) best.score;
+}
+
+void PhyloTree::evaluateParsimonyRegrafts(PruningInfo &info, PhyloNode *in_node, PhyloNode *in_dad,
+    int depth, int radius, SPRMove &best)
+{
+    // vector of the in_dad side is computed for the pruned tree from the previous branch
+    PhyloNeighbor *in_dad_nei = (PhyloNeighbor*) in_node->findNeighbor(in_dad);
+    PhyloNeighbor *in_node_nei = (PhyloNeighbor*) in_dad->findNeighbor(in_node);
+    in_dad_nei->partial_lh_computed &= ~2;
+    computePartialParsimony(in_dad_nei, in_node);
+    if ((in_node_nei->partial_lh_computed & 2) == 0)
+        computePartialParsimony(in_node_nei, in_dad);
+
+    // attach dad to the branch by sharing its two vectors
+    PhyloNeighbor *dad_nei_left = (PhyloNeighbor*) info.dad_nei_left;
+    PhyloNeighbor *dad_nei_right = (PhyloNeighbor*) info.dad_nei_right;
+    dad_nei_left->node = in_node;
+    dad_nei_left->partial_pars = in_node_nei->partial_pars;
+    dad_nei_left->partial_lh_computed = in_node_nei->partial_lh_computed;
+    dad_nei_right->node = in_dad;
+    dad_nei_right->partial_pars = in_dad_nei->partial_pars;
+    dad_nei_right->partial_lh_computed = in_dad_nei->partial_lh_computed;
+
+    PhyloNeighbor *node_dad_nei = (PhyloNeighbor*) info.node->findNeighbor(info.dad);
+    node_dad_nei->partial_lh_computed &= ~2;
+    int score = computeParsimonyBranch(node_dad_nei, (PhyloNode*) info.node);
+    if (score < best.score) {
+        best.score = score;
+        best.regraft_node = in_node;
+        best.regraft_dad = in_dad;
+    }
+
+    if (depth < radius) {
+        FOR_NEIGHBOR_IT(in_node, in_dad, it)
+            evaluateParsimonyRegrafts(info, (PhyloNode*) (*it)->node, in_node, depth+1, radius, best);
+    }
+
+    // only valid for the pruned tree
+    in_dad_nei->partial_lh_computed &= ~2;
+}
+
 void PhyloTree::extractBifurcatingSubTree(NeighborVec &removed_nei, NodeVector &attached_node, int *rand_stream) {
     NodeVector nodes;
     getMultifurcatingNodes(nodes);
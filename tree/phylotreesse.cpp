@@ -92,9 +92,18 @@ void PhyloTree::setLikelihoodKernel(LikelihoodKernel lk) {
 
 	sse = lk;
     vector_size = 1;
-    safe_numeric = (params && (params->lk_safe_scaling || leafNum >= params->numseq_safe_scaling)) ||
+    safe_numeric = safe_numeric_fallback ||
+        (params && (params->lk_safe_scaling || leafNum >= params->numseq_safe_scaling)) ||
         (aln && aln->num_states != 4 && aln->num_states != 20);
 
+    //--- precision of partial likelihood storage ---
+    if (!central_partial_lh) {
+        float_partial_lh = !float_partial_lh_overflow && isFloatPartialLhSupported();
+    } else if (float_partial_lh && !isFloatPartialLhSupported()) {
+        // e.g. nonrev kernel for ancestral reconstruction: reallocate vectors in double precision
+        reallocDoublePartialLh();
+    }
+
     //--- parsimony kernel ---
     setParsimonyKernel(lk);
 
@@ -203,6 +212,58 @@ void PhyloTree::changeLikelihoodKernel(LikelihoodKernel lk) {
     setLikelihoodKernel(lk);
 }
 
+bool PhyloTree::switchToSafeNumeric() {
+    if (safe_numeric)
+        return false;
+    outWarning("Numerical underflow for normal likelihood kernel, switching to the safe kernel (`-safe` option)");
+    safe_numeric_fallback = true;
+    setLikelihoodKernel(sse);
+    // partial likelihoods were scaled per pattern, recompute them with per-category scaling
+    PhyloNeighbor *saved_it = current_it, *saved_it_back = current_it_back;
+    clearAllPartialLH();
+    current_it = saved_it;
+    current_it_back = saved_it_back;
+    theta_computed = false;
+    return true;
+}
+
+bool PhyloTree::switchToDoublePartialLh() {
+    if (!float_partial_lh)
+        return false;
+    outWarning("Too many scalings of single-precision partial likelihoods, switching to double precision");
+    float_partial_lh_overflow = true;
+    PhyloNeighbor *saved_it = current_it, *saved_it_back = current_it_back;
+    reallocDoublePartialLh();
+    // dispatch to the double-precision kernels and recompute all partial likelihoods
+    setLikelihoodKernel(sse);
+    clearAllPartialLH();
+    current_it = saved_it;
+    current_it_back = saved_it_back;
+    theta_computed = false;
+    return true;
+}
+
+void PhyloTree::reallocDoublePartialLh() {
+    aligned_free(central_partial_lh);
+    aligned_free(nni_partial_lh);
+    tip_partial_lh = nullptr;
+    float_partial_lh = false;
+    initializeAllPartialLh();
+}
+
+bool PhyloTree::isFloatPartialLhSupported() {
+    if (!params || !params->lk_float_storage || !aln || !model_factory || !model || !site_rate)
+        return false;
+    // single-precision storage is instantiated only for the reversible SIMD kernels of DNA and protein
+    if (sse < LK_SSE2 || (aln->num_states != 4 && aln->num_states != 20))
+        return false;
+    if (!model->isReversible() || params->kernel_nonrev || model->isSiteSpecificModel() || isMixlen())
+        return false;
+    // partitioned trees share memory laid out by the super tree,
+    // upper bounds and Bayesian branch lengths read partial_lh outside the kernels
+    return !isSuperTree() && !params->partition_file && !params->upper_bound && !params->bayes_branch_length;
+}
+
 /*******************************************************
  *
  * master function: wrapper for other optimized functions
@@ -214,12 +275,16 @@ void PhyloTree::computePartialLikelihood(TraversalInfo &info, size_t ptn_left, s
 }
 
 double PhyloTree::computeLikelihoodBranch(PhyloNeighbor *dad_branch, PhyloNode *dad) {
-	return (this->*computeLikelihoodBranchPointer)(dad_branch, dad);
-
+	double tree_lh = (this->*computeLikelihoodBranchPointer)(dad_branch, dad);
+    if (!std::isfinite(tree_lh) && switchToSafeNumeric())
+        tree_lh = (this->*computeLikelihoodBranchPointer)(dad_branch, dad);
+    return tree_lh;
 }
 
 void PhyloTree::computeLikelihoodDerv(PhyloNeighbor *dad_branch, PhyloNode *dad, double *df, double *ddf) {
 	(this->*computeLikelihoodDervPointer)(dad_branch, dad, df, ddf);
+    if (!std::isfinite(*df) && switchToSafeNumeric())
+        (this->*computeLikelihoodDervPointer)(dad_branch, dad, df, ddf);
 }
 
 
@@ -227,11 +292,13 @@ double PhyloTree::computeLikelihoodFromBuffer() {
 	ASSERT(current_it && current_it_back);
 
     // TODO: buffer stuff for mixlen model
-	if (computeLikelihoodFromBufferPointer && optimize_by_newton)
-		return (this->*computeLikelihoodFromBufferPointer)();
-	else {
-		return (this->*computeLikelihoodBranchPointer)(current_it, (PhyloNode*)current_it_back->node);
+	if (computeLikelihoodFromBufferPointer && optimize_by_newton) {
+		double tree_lh = (this->*computeLikelihoodFromBufferPointer)();
+        if (std::isfinite(tree_lh) || !switchToSafeNumeric())
+            return tree_lh;
+        // buffer is invalid after switching kernel, recompute along the branch
     }
+    return PhyloTree::computeLikelihoodBranch(current_it, (PhyloNode*)current_it_back->node);
 
 }
 
@@ -540,8 +607,15 @@ void PhyloTree::computePtnFreq() {
 	size_t nptn = aln->getNPattern();
 	size_t maxptn = get_safe_upper_limit(nptn)+get_safe_upper_limit(model_factory->unobserved_ptns.size());
 	int ptn;
-	for (ptn = 0; ptn < nptn; ptn++)
-		ptn_freq[ptn] = (*aln)[ptn].frequency;
+	if (aln_view) {
+		ASSERT(aln_view->getAlignment() == aln);
+		const IntVector &weights = aln_view->getWeights();
+		for (ptn = 0; ptn < nptn; ptn++)
+			ptn_freq[ptn] = weights[ptn];
+	} else {
+		for (ptn = 0; ptn < nptn; ptn++)
+			ptn_freq[ptn] = (*aln)[ptn].frequency;
+	}
 	for (ptn = nptn; ptn < maxptn; ptn++)
 		ptn_freq[ptn] = 0.0;
 }
@@ -1446,7 +1520,7 @@ void PhyloTree::initMarginalAncestralState(ostream &out, bool &orig_kernel_nonre
         setLikelihoodKernel(sse);
         clearAllPartialLH();
     }
-    _pattern_lh_cat_state = newPartialLh();
+    _pattern_lh_cat_state = aligned_alloc<double>(getPartialLhSize());
 
     size_t nptn = getAlnNPattern();
     size_t nstates = model->num_states;
@@ -0,0 +1,143 @@
+/*
+ * ufbootweights.cpp
+ *
+ * Compact pattern weight matrix of UFBoot replicates and blocked RELL kernels
+ */
+
+#include "ufbootweights.h"
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+// std::min binds PTN_BLOCK by reference
+constexpr int UFBootWeights::PTN_BLOCK;
+
+UFBootWeights::UFBootWeights() : nrep(0), nptn(0), width(1) {
+}
+
+void UFBootWeights::init(int num_rep, int num_ptn) {
+    nrep = num_rep;
+    nptn = num_ptn;
+    width = 1;
+    data.assign((size_t)nrep*nptn, 0);
+}
+
+void UFBootWeights::clear() {
+    nrep = nptn = 0;
+    width = 1;
+    vector<uint8_t>().swap(data);
+}
+
+template <class T>
+static void setWeight(vector<uint8_t> &data, size_t index, int weight) {
+    ((T*)data.data())[index] = (T)weight;
+}
+
+template <class T>
+static int getWeightAt(const vector<uint8_t> &data, size_t index) {
+    return ((const T*)data.data())[index];
+}
+
+void UFBootWeights::widen(int new_width) {
+    vector<uint8_t> new_data((size_t)nrep*nptn*new_width, 0);
+    size_t n = (size_t)nrep*nptn;
+    for (size_t i = 0; i < n; i++) {
+        int weight = (width == 1) ? getWeightAt<uint8_t>(data, i) : getWeightAt<uint16_t>(data, i);
+        if (new_width == 2)
+            setWeight<uint16_t>(new_data, i, weight);
+        else
+            setWeight<uint32_t>(new_data, i, weight);
+    }
+    data.swap(new_data);
+    width = new_width;
+}
+
+void UFBootWeights::setWeights(int rep, const IntVector &weights) {
+    ASSERT(rep >= 0 && rep < nrep && weights.size() >= nptn);
+    int max_weight = *max_element(weights.begin(), weights.begin() + nptn);
+    if (max_weight > UINT16_MAX && width < 4)
+        widen(4);
+    else if (max_weight > UINT8_MAX && width < 2)
+        widen(2);
+    for (int ptn = 0; ptn < nptn; ptn++) {
+        switch (width) {
+        case 1: setWeight<uint8_t>(data, offset(rep, ptn), weights[ptn]); break;
+        case 2: setWeight<uint16_t>(data, offset(rep, ptn), weights[ptn]); break;
+        default: setWeight<uint32_t>(data, offset(rep, ptn), weights[ptn]); break;
+        }
+    }
+}
+
+int UFBootWeights::getWeight(int rep, int ptn) const {
+    switch (width) {
+    case 1: return getWeightAt<uint8_t>(data, offset(rep, ptn));
+    case 2: return getWeightAt<uint16_t>(data, offset(rep, ptn));
+    default: return getWeightAt<uint32_t>(data, offset(rep, ptn));
+    }
+}
+
+void UFBootWeights::getWeights(int rep, IntVector &weights) const {
+    weights.resize(nptn);
+    for (int ptn = 0; ptn < nptn; ptn++)
+        weights[ptn] = getWeight(rep, ptn);
+}
+
+/**
+    one pattern block of the RELL product: rows [rep_begin, rep_end) of the block
+    times the matching slice of every tree's pattern log-likelihoods
+*/
+template <class T, class V>
+static void computeRELLBlock(const T *block, size_t block_width, int rep_begin, int rep_end,
+                             const V *lh, int ntrees, size_t lh_stride, double *rell, int rell_stride, int rep_start) {
+    for (int rep = rep_begin; rep < rep_end; rep++) {
+        const T *row = block + rep*block_width;
+        for (int tree = 0; tree < ntrees; tree++) {
+            const V *x = lh + tree*lh_stride;
+            V sum = 0;
+#ifdef _OPENMP
+#pragma omp simd reduction(+:sum)
+#endif
+            for (size_t ptn = 0; ptn < block_width; ptn++)
+                sum += x[ptn] * row[ptn];
+            rell[tree*rell_stride + rep - rep_start] += sum;
+        }
+    }
+}
+
+template <class V>
+void UFBootWeights::computeRELL(const V *pattern_lh, int ntrees, size_t lh_stride, int rep_start, int rep_end, double *rell) const {
+    int nsel = rep_end - rep_start;
+    memset(rell, 0, sizeof(double)*nsel*ntrees);
+    // replicates are split into chunks, every chunk walks through all pattern blocks
+    const int REP_CHUNK = 64;
+    int nchunks = (nsel + REP_CHUNK - 1) / REP_CHUNK;
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic) if (nchunks > 1 && !omp_in_parallel())
+#endif
+    for (int chunk = 0; chunk < nchunks; chunk++) {
+        int rep_begin = rep_start + chunk*REP_CHUNK;
+        int rep_stop = min(rep_end, rep_begin + REP_CHUNK);
+        for (int ptn = 0; ptn < nptn; ptn += PTN_BLOCK) {
+            size_t block_width = min(PTN_BLOCK, nptn - ptn);
+            size_t block_start = (size_t)ptn*nrep;
+            const V *lh = pattern_lh + ptn;
+            switch (width) {
+            case 1:
+                computeRELLBlock((const uint8_t*)data.data() + block_start, block_width, rep_begin, rep_stop,
+                                 lh, ntrees, lh_stride, rell, nsel, rep_start);
+                break;
+            case 2:
+                computeRELLBlock((const uint16_t*)data.data() + block_start, block_width, rep_begin, rep_stop,
+                                 lh, ntrees, lh_stride, rell, nsel, rep_start);
+                break;
+            default:
+                computeRELLBlock((const uint32_t*)data.data() + block_start, block_width, rep_begin, rep_stop,
+                                 lh, ntrees, lh_stride, rell, nsel, rep_start);
+                break;
+            }
+        }
+    }
+}
+
+template void UFBootWeights::computeRELL<float>(const float*, int, size_t, int, int, double*) const;
+template void UFBootWeights::computeRELL<double>(const double*, int, size_t, int, int, double*) const;
@@ -0,0 +1,114 @@
+/***************************************************************************
+ *   Copyright (C) 2009-2024 by                                            *
+ *   BUI Quang Minh <minh.bui@univie.ac.at>                                *
+ *   Lam-Tung Nguyen <nltung@gmail.com>                                    *
+ *                                                                         *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+#ifndef UFBOOTWEIGHTS_H_
+#define UFBOOTWEIGHTS_H_
+
+#include "utils/tools.h"
+#include <stdint.h>
+
+/**
+    Pattern weights (resampled pattern counts) of all UFBoot replicates, held in
+    one contiguous matrix of narrow integers. Counts are stored in 1 byte and the
+    whole matrix is widened to 2 or 4 bytes only when a count does not fit.
+    The matrix is blocked over patterns: a block of PTN_BLOCK pattern log-likelihoods
+    stays in cache while it is multiplied with the rows of all replicates.
+*/
+class UFBootWeights {
+public:
+    /** number of patterns per block */
+    static constexpr int PTN_BLOCK = 2048;
+
+    UFBootWeights();
+
+    /**
+        allocate zero weights
+        @param num_rep number of replicates
+        @param num_ptn number of patterns
+    */
+    void init(int num_rep, int num_ptn);
+
+    /** release the matrix */
+    void clear();
+
+    /** @return number of replicates */
+    int size() const { return nrep; }
+
+    /** @return true if there are no replicates */
+    bool empty() const { return nrep == 0; }
+
+    /**
+        set the weights of one replicate
+        @param rep replicate ID
+        @param weights count of every pattern
+    */
+    void setWeights(int rep, const IntVector &weights);
+
+    /** @return weight of pattern ptn in replicate rep */
+    int getWeight(int rep, int ptn) const;
+
+    /**
+        @param rep replicate ID
+        @param[out] weights count of every pattern
+    */
+    void getWeights(int rep, IntVector &weights) const;
+
+    /** @return bytes held by the matrix */
+    size_t getMemory() const { return data.size(); }
+
+    /**
+        RELL log-likelihoods of a batch of trees on replicates [rep_start, rep_end)
+        @param pattern_lh per-pattern log-likelihoods of tree t start at pattern_lh + t*lh_stride
+        @param ntrees number of trees
+        @param lh_stride distance between the pattern log-likelihoods of two trees
+        @param rep_start first replicate
+        @param rep_end last replicate (exclusive)
+        @param[out] rell rell[t*(rep_end-rep_start) + rep-rep_start] is the log-likelihood of tree t on replicate rep
+    */
+    template <class V>
+    void computeRELL(const V *pattern_lh, int ntrees, size_t lh_stride, int rep_start, int rep_end, double *rell) const;
+
+protected:
+    /** number of replicates */
+    int nrep;
+
+    /** number of patterns */
+    int nptn;
+
+    /** bytes per weight: 1, 2 or 4 */
+    int width;
+
+    /** weight matrix, see offset() for the layout */
+    vector<uint8_t> data;
+
+    /** @return index (in weights, not bytes) of pattern ptn of replicate rep */
+    size_t offset(int rep, int ptn) const {
+        int block = ptn / PTN_BLOCK;
+        size_t block_width = min(PTN_BLOCK, nptn - block*PTN_BLOCK);
+        return (size_t)block*PTN_BLOCK*nrep + rep*block_width + (ptn - block*PTN_BLOCK);
+    }
+
+    /** re-encode the matrix with new_width bytes per weight */
+    void widen(int new_width);
+};
+
+#endif /* UFBOOTWEIGHTS_H_ */
@@ -855,7 +855,7 @@ public:
     }
     virtual bool constructTreeInMemory
         ( const std::vector<std::string> &sequenceNames
-         , double *distanceMatrix
+         , const DistanceMatrix &distanceMatrix
          , const std::string & newickTreeFilePath) {
             return false;
     }
@@ -44,8 +44,8 @@
 //               Springer Verlag, 2011.
 //        Tag:  [SMP2011].
 //        (but, optionally, using a variance matrix, as in BIONJ, and
-//        keeping the distance and variance matrices square -
-//        they're not triangular because
+//        keeping the distance matrix square - it's not triangular
+//        because
 //                  (i) *read* memory access patterns are more favourable
 //                 (ii) *writes* don't require conditional transposition
 //                      of the row and column coordinates (but their
@@ -86,6 +86,17 @@
 #include <iostream>                  //for std::istream
 #include <vectorclass/vectorclass.h> //for Vec4d and Vec4db vector classes
 #include "progress.h"                //for progress_display
+#include "mappedfile.h"              //for MappedFile (binary distance files)
+#include <list>                      //for std::list (row cache, LRU order)
+#include <unordered_map>             //for std::unordered_map (row cache)
+#include <algorithm>                 //for std::nth_element, std::sort
+#include <cstdio>                    //for std::remove
+#include <cstring>                   //for memcmp, memcpy
+#include <stdint.h>                  //for uint32_t, uint64_t
+#include <atomic>                    //for std::atomic (shared bound on min Q)
+#ifdef _OPENMP
+#include <omp.h>                     //for omp_get_max_threads
+#endif
 
 typedef float   NJFloat;
 typedef Vec8f   FloatVector;
@@ -307,9 +318,9 @@ template <class P> inline P* matrixAlign(P* p) {
 template <class T=NJFloat> class Matrix
 {
     //Note 1: This is a separate class so that it can be
-    //        used for square variance (V) and rectangular
-    //        sorted distance (S) and index (I) matrices,
-    //        not just square distance (D) matrices.
+    //        used for rectangular sorted distance (S) and
+    //        index (I) matrices, not just square distance
+    //        (D) matrices.
     //        Lines that access the upper-right triangle
     //        of the matrix are tagged with U-R.
     //Note 2: I resorted to declaring the data, rows, and
@@ -475,11 +486,15 @@ public:
             //Move the data in the array closer to the front.
             //This also helps (but: only very slightly. 5%ish?).
             size_t   w = widthNeededFor(n);
-            T* destRow = data;
+            //Note: rows[0] (not data) is where row 0 starts, as data
+            //      is not necessarily MATRIX_ALIGNMENT-byte aligned.
+            T* destRow = rows[0];
             for (size_t r=1; r<n; ++r) {
                 destRow += w;
                 const T* sourceRow = rows[r];
-                #pragma omp parallel for
+                //Note: destRow may overlap sourceRow (it is never
+                //      later in memory), so the copy must go forwards,
+                //      in one thread.
                 for (size_t c=0; c<n; ++c) {
                     destRow[c] = sourceRow[c];
                 }
@@ -500,6 +515,42 @@ public:
     }
 };
 
+template <class T=NJFloat> class TriangularMatrix
+{
+    //A symmetric matrix with a zero diagonal, of which only
+    //the strict lower triangle is stored, row by row
+    //(n*(n-1)/2 entries rather than n*n). Used for the
+    //variance (V) matrix in BIONJ, which (unlike the D
+    //matrix) is only read one entry at a time, and needs
+    //neither row totals nor aligned rows.
+public:
+    size_t         n;
+    std::vector<T> data;
+    TriangularMatrix(): n(0) {
+    }
+    void setSize(size_t rank) {
+        n = rank;
+        std::vector<T>().swap(data);
+        data.resize((rank < 2) ? 0 : rank*(rank-1)/2, 0);
+    }
+    inline T& at(size_t r, size_t c) {
+        //Assumed r!=c
+        return (r<c) ? data[c*(c-1)/2 + r] : data[r*(r-1)/2 + c];
+    }
+    void removeRowAndColumn(size_t rowNum) {
+        //As Matrix::removeRowAndColumn: the last row (and
+        //column) is moved into the place of rowNum. Since the
+        //last row is stored last, it is then cut off.
+        --n;
+        for (size_t c=0; c<n; ++c) {
+            if (c!=rowNum) {
+                at(rowNum, c) = at(n, c);
+            }
+        }
+        data.resize((n < 2) ? 0 : n*(n-1)/2);
+    }
+};
+
 template <class T=NJFloat> class UPGMA_Matrix: public Matrix<T> {
     //UPGMA_Matrix is a D matrix (a matrix of distances).
 public:
@@ -562,10 +613,10 @@ public:
         //      if the matrix was not symmetric.  This code doesn't.
         return true;
     }
-    virtual bool loadMatrix(const std::vector<std::string>& names, double* matrix) {
+    virtual bool loadMatrix(const std::vector<std::string>& names, const DistanceMatrix& matrix) {
         //Assumptions: 2 < names.size(), all names distinct
-        //  matrix is symmetric, with matrix[row*names.size()+col]
-        //  containing the distance between taxon row and taxon col.
+        //  matrix.get(row,col) is the distance between taxon row
+        //  and taxon col (only one triangle of it is stored).
         setSize(names.size());
         clusters.clear();
         for (auto it = names.begin(); it != names.end(); ++it) {
@@ -577,11 +628,9 @@ public:
         }
         #pragma omp parallel for
         for (size_t row=0; row<n; ++row) {
-            double* sourceStart = matrix + row * n;
-            double* sourceStop  = sourceStart + n;
-            T*      dest        = rows[row];
-            for (double* source=sourceStart; source<sourceStop; ++source, ++dest ) {
-                *dest = (T) *source;
+            T* dest = rows[row];
+            for (size_t col=0; col<n; ++col) {
+                dest[col] = (T) matrix.get(row, col);
             }
         }
         calculateRowTotals();
@@ -641,7 +690,7 @@ protected:
             rowMinima[row] = Position<T>(row, bestColumn, bestVrc, getImbalance(row, bestColumn));
         }
     }
-    void finishClustering() {
+    virtual void finishClustering() {
         //Assumes: n is always exactly 3
         //But:  The formula is probably wrong. Felsenstein [2004] chapter 11 only
         //      covers UPGMA for rooted trees, and I don't know what
@@ -789,7 +838,6 @@ protected:
             }
         }
         recalculateTotalForOneRow(a,b);
-        rowTotals[a] -= rows[a][b];
         clusters.addCluster ( rowToCluster[a], aLength,
                               rowToCluster[b], bLength);
         rowToCluster[a] = clusters.size()-1;
@@ -820,7 +868,13 @@ public:
     using super::recalculateTotalForOneRow;
     using super::removeRowAndColumn;
 protected:
-    Matrix<T>  variance;       //The V matrix
+    TriangularMatrix<T> variance; //The V matrix
+    //Note: The D matrix is kept square (see the top of this file),
+    //      but V is only packed: at peak, while loading from a
+    //      DistanceMatrix, BIONJ holds the n*(n-1)/2 input entries,
+    //      n*w (w is n rounded up to whole cache lines) entries of D,
+    //      and n*(n-1)/2 entries of V (about 2*n*n entries in all,
+    //      rather than 2.5*n*n with a square V).
 public:
     virtual std::string getAlgorithmName() const {
         return "BIONJ";
@@ -828,12 +882,24 @@ public:
     virtual bool loadMatrixFromFile(const std::string &distanceMatrixFilePath)
     {
         bool rc = super::loadMatrixFromFile(distanceMatrixFilePath);
-        variance = *this;
+        variance.setSize(n);
+        #pragma omp parallel for
+        for (size_t r=1; r<n; ++r) {
+            for (size_t c=0; c<r; ++c) {
+                variance.at(r, c) = rows[r][c];
+            }
+        }
         return rc;
     }
-    virtual bool loadMatrix(const std::vector<std::string>& names, double* matrix) {
+    virtual bool loadMatrix(const std::vector<std::string>& names, const DistanceMatrix& matrix) {
         bool rc = super::loadMatrix(names, matrix);
-        variance = *this;
+        variance.setSize(n);
+        #pragma omp parallel for
+        for (size_t r=1; r<n; ++r) {
+            for (size_t c=0; c<r; ++c) {
+                variance.at(r, c) = (T) matrix.get(r, c);
+            }
+        }
         return rc;
     }
     inline T chooseLambda(size_t a, size_t b, T Vab) {
@@ -843,13 +909,13 @@ public:
             return 0.5;
         }
         for (size_t i=0; i<a; ++i) {
-            lambda += variance.rows[b][i] - variance.rows[a][i];
+            lambda += variance.at(b, i) - variance.at(a, i);
         }
         for (size_t i=a+1; i<b; ++i) {
-            lambda += variance.rows[b][i] - variance.rows[a][i];
+            lambda += variance.at(b, i) - variance.at(a, i);
         }
         for (size_t i=b+1; i<n; ++i) {
-            lambda += variance.rows[b][i] - variance.rows[a][i];
+            lambda += variance.at(b, i) - variance.at(a, i);
         }
         lambda = 0.5 + lambda / (2.0*((T)n-2)*Vab);
         if (1.0<lambda) lambda=1.0;
@@ -865,7 +931,7 @@ public:
         T fudge         = (rowTotals[a] - rowTotals[b]) * tMultiplier;
         T aLength       = medianLength + fudge;
         T bLength       = medianLength - fudge;
-        T Vab           = variance.rows[b][a];     //BIO
+        T Vab           = variance.at(b, a);       //BIO
         T lambda        = chooseLambda(a, b, Vab); //BIO
         T mu            = 1.0 - lambda;
         T dCorrection   = - lambda * aLength - mu * bLength;
@@ -882,11 +948,10 @@ public:
                 rowTotals[i] += Dci - Dai - Dbi; //JB2020-06-18 Adjust row totals
                 
                 //BIO begin (Reduction 10 on variance estimates)
-                T Vci   = lambda * variance.rows[a][i]
-                        + mu * variance.rows[b][i]
+                T Vci   = lambda * variance.at(a, i)
+                        + mu * variance.at(b, i)
                         + vCorrection;
-                variance.rows[a][i] = Vci;
-                variance.rows[i][a] = Vci;
+                variance.at(a, i) = Vci;
                 //BIO finish
             }
         }
@@ -902,6 +967,7 @@ public:
 template <class T=NJFloat, class super=BIONJMatrix<T>>
 class BoundingMatrix: public super
 {
+public:
     using super::n;
     using super::rows;
     using super::rowMinima;
@@ -1008,7 +1074,7 @@ public:
         }
         return true;
     }
-    void sortRow(size_t r /*row index*/, size_t c /*upper bound on cluster index*/) {
+    virtual void sortRow(size_t r /*row index*/, size_t c /*upper bound on cluster index*/) {
         //1. copy data from a row of the D matrix into the S matrix
         //   (and write the cluster identifiers that correspond to
         //    the values in the D row into the same-numbered
@@ -1085,8 +1151,11 @@ public:
         //onto the S and I matrices.
         entriesSorted.removeRowOnly(b);
         entryToCluster.removeRowOnly(b);
-        
-        //Recalculate cluster totals.
+        //Recalculate cluster totals, and sort the new row.
+        recalculateClusterTotals(clusterC);
+        sortRow(a, clusterC);
+    }
+    virtual void recalculateClusterTotals(size_t clusterC /*cluster # of new cluster*/) {
         for (size_t wipe = 0; wipe<clusterC; ++wipe) {
             clusterTotals[wipe] = -infiniteDistance;
             //A trick.  This way we don't need to check if clusters
@@ -1102,7 +1171,6 @@ public:
             size_t cluster = rowToCluster[r];
             clusterTotals[cluster] = rowTotals[r];
         }
-        sortRow(a, clusterC);
     }
     void decideOnRowScanningOrder() const {
         //
@@ -1161,7 +1229,7 @@ public:
             w += ( rowOrderChosen[r] ? 0 : 1 );
         }
     }
-    virtual void getRowMinima() const {
+    void calculateScaledClusterTotals() const {
         //
         //Note: Rather than multiplying distances by (n-2)
         //      repeatedly, it is cheaper to work with cluster
@@ -1183,6 +1251,9 @@ public:
                 }
             }
         }
+    }
+    virtual void getRowMinima() const {
+        calculateScaledClusterTotals();
         T qBest = infiniteDistance;
             //upper bound on minimum Q[row,col]
             //  = D[row,col] - R[row]*tMultipler - R[col]*tMultiplier
@@ -1198,7 +1269,7 @@ public:
             //Note: Older versions of RapidNJ used maxTot rather than
             //      maxEarlierTotal here...
             rowMinima[r]          = getRowMinimum(row, maxEarlierTotal, qBest);
-            T      v              = rowMinima[row].value;
+            T      v              = rowMinima[r].value;
             {
                 if ( v < qBest ) {
                     #pragma omp critical(checkmin)
@@ -1245,6 +1316,183 @@ public:
     }
 };
 
+template <class T=NJFloat, class super=BIONJMatrix<T>>
+class ParallelBoundingMatrix: public BoundingMatrix<T, super>
+{
+    //
+    //ParallelBoundingMatrix is a BoundingMatrix that does more of
+    //its work with a team of (OpenMP) threads.
+    //
+    //Note 1: Rows are divided between the threads, when searching
+    //        for the minimum Q.  Each thread keeps the best Q value
+    //        it has found (thread-local), and publishes it to the
+    //        shared bound only when it improves on it, so the bound
+    //        used to cut row scans short is tight, without a critical
+    //        section for every row.  The row minima the threads found
+    //        are merged after the scan (in getMinimumEntry).
+    //Note 2: After each join, the D (and V) matrix and row totals are
+    //        updated in parallel (by super::cluster), then the cluster
+    //        totals are recalculated, and the new row of the S and I
+    //        matrices is sorted, in parallel (bounding::cluster calls
+    //        the overrides of recalculateClusterTotals and sortRow).
+    //        The new row is sorted as one run per thread, and the runs
+    //        are then merged, in pairs, in parallel.
+    //
+public:
+    typedef BoundingMatrix<T, super> bounding;
+    using bounding::n;
+    using bounding::rows;
+    using bounding::rowMinima;
+    using bounding::rowTotals;
+    using bounding::rowToCluster;
+    using bounding::clusterTotals;
+    using bounding::scaledMaxEarlierClusterTotal;
+    using bounding::rowScanOrder;
+    using bounding::entriesSorted;
+    using bounding::entryToCluster;
+protected:
+    std::vector<T>   mergedValues;   //Scratch space, used when merging
+    std::vector<int> mergedClusters; //runs of a row of the S and I matrices
+    const size_t     minimumParallelSortLength;
+public:
+    ParallelBoundingMatrix() : bounding(), minimumParallelSortLength(8192) {
+    }
+    virtual std::string getAlgorithmName() const {
+        return "Parallel-" + bounding::getAlgorithmName();
+    }
+    virtual void getRowMinima() const {
+        bounding::calculateScaledClusterTotals();
+        bounding::decideOnRowScanningOrder();
+        rowMinima.resize(n);
+        std::atomic<T> qBest(infiniteDistance);
+            //upper bound on minimum Q[row,col], shared between threads
+        #pragma omp parallel
+        {
+            T localBest = infiniteDistance; //best Q found by this thread
+            #pragma omp for schedule(dynamic)
+            for (size_t r=0; r<n; ++r) {
+                T bound = qBest.load(std::memory_order_relaxed);
+                if (localBest < bound) {
+                    bound = localBest;
+                }
+                size_t row     = rowScanOrder[r];
+                size_t cluster = rowToCluster[row];
+                rowMinima[r]   = bounding::getRowMinimum(row, scaledMaxEarlierClusterTotal[cluster], bound);
+                T v            = rowMinima[r].value;
+                if (v < localBest) {
+                    localBest = v;
+                    T shared  = qBest.load(std::memory_order_relaxed);
+                    while (v < shared && !qBest.compare_exchange_weak(shared, v, std::memory_order_relaxed)) {
+                    }
+                }
+            }
+        }
+    }
+    virtual void recalculateClusterTotals(size_t clusterC) {
+        #pragma omp parallel for
+        for (size_t wipe = 0; wipe<clusterC; ++wipe) {
+            clusterTotals[wipe] = -infiniteDistance;
+        }
+        #pragma omp parallel for
+        for (size_t r = 0; r<n; ++r) {
+            size_t cluster = rowToCluster[r];
+            clusterTotals[cluster] = rowTotals[r];
+        }
+    }
+    virtual void sortRow(size_t r /*row index*/, size_t c /*upper bound on cluster index*/) {
+        //Rows sorted during setup are already spread over the threads
+        //(and share mergedValues and mergedClusters), so only the
+        //new row sorted after a join is sorted in parallel.
+        size_t threadCount = 1;
+        #ifdef _OPENMP
+            if (!omp_in_parallel()) {
+                threadCount = omp_get_max_threads();
+            }
+        #endif
+        if (threadCount<2 || n<minimumParallelSortLength) {
+            bounding::sortRow(r, c);
+            return;
+        }
+        //1. copy data from row r of the D matrix into the S and I
+        //   matrices (as in bounding::sortRow).
+        T*     sourceRow      = rows[r];
+        T*     values         = entriesSorted.rows[r];
+        int*   clusterIndices = entryToCluster.rows[r];
+        size_t w = 0;
+        for (size_t i=0; i<n; ++i) {
+            values[w]         = sourceRow[i];
+            clusterIndices[w] = static_cast<int>(rowToCluster[i]);
+            if ( i != r && clusterIndices[w] < c ) {
+                ++w;
+            }
+        }
+        values[w]         = infiniteDistance; //sentinel value, to stop row search
+        clusterIndices[w] = static_cast<int>(rowToCluster[r]);
+
+        //2. Sort one run for each thread
+        size_t runLength = (w + threadCount - 1) / threadCount;
+        #pragma omp parallel for
+        for (size_t t=0; t<threadCount; ++t) {
+            size_t start = t * runLength;
+            size_t stop  = std::min(w, start + runLength);
+            if (start<stop) {
+                mirroredHeapsort(values, start, stop, clusterIndices);
+            }
+        }
+
+        //3. Merge runs, in pairs, until there is only one
+        mergedValues.resize(w);
+        mergedClusters.resize(w);
+        T*   fromValues   = values;
+        int* fromClusters = clusterIndices;
+        T*   toValues     = mergedValues.data();
+        int* toClusters   = mergedClusters.data();
+        for (; runLength<w; runLength+=runLength) {
+            size_t pairCount = (w + runLength + runLength - 1) / (runLength + runLength);
+            #pragma omp parallel for
+            for (size_t p=0; p<pairCount; ++p) {
+                size_t start  = p * ( runLength + runLength );
+                size_t middle = std::min(w, start  + runLength);
+                size_t stop   = std::min(w, middle + runLength);
+                mergeRuns(fromValues, fromClusters, start, middle, stop
+                          , toValues, toClusters);
+            }
+            std::swap(fromValues,   toValues);
+            std::swap(fromClusters, toClusters);
+        }
+        if (fromValues != values) {
+            std::copy(fromValues,   fromValues   + w, values);
+            std::copy(fromClusters, fromClusters + w, clusterIndices);
+        }
+    }
+    static void mergeRuns(const T* values, const int* clusterIndices
+                          , size_t start, size_t middle, size_t stop
+                          , T* mergedValues, int* mergedIndices) {
+        //Merge the sorted runs [start, middle) and [middle, stop)
+        //of values (mirroring the merge on clusterIndices)
+        size_t i = start;
+        size_t j = middle;
+        size_t w = start;
+        while (i<middle && j<stop) {
+            bool right         = values[j] < values[i];
+            size_t from        = right ? j : i;
+            mergedValues[w]    = values[from];
+            mergedIndices[w]   = clusterIndices[from];
+            i += right ? 0 : 1;
+            j += right ? 1 : 0;
+            ++w;
+        }
+        for (; i<middle; ++i, ++w) {
+            mergedValues[w]  = values[i];
+            mergedIndices[w] = clusterIndices[i];
+        }
+        for (; j<stop; ++j, ++w) {
+            mergedValues[w]  = values[j];
+            mergedIndices[w] = clusterIndices[j];
+        }
+    }
+};
+
 template <class T=NJFloat, class super=BIONJMatrix<T>, class V=FloatVector, class VB=FloatBoolVector>
     class VectorizedMatrix: public super
 {
@@ -1395,10 +1643,590 @@ public:
     }
 };
 
+//Binary distance files, as read (via a memory map) by StreamedMatrix:
+//  8 bytes   streamedMatrixMagic
+//  8 bytes   n, the number of taxa (native byte order)
+//  n names   each a 4-byte length (native byte order) followed
+//            by that many characters
+//  padding   zero bytes, up to the next multiple of 4 bytes
+//  n*n       single precision distances, row by row
+const char   streamedMatrixMagic[8] = { 'N', 'J', 'D', 'I', 'S', 'T', '0', '1' };
+const size_t notJoined = static_cast<size_t>(-1); //see StreamedMatrix::joinedBy
+
+template <class T=NJFloat, bool useVariance=false> class StreamedMatrix
+{
+    //StreamedMatrix is an out-of-core D matrix (and, for BIONJ, V
+    //matrix) for inputs too large to hold in memory.  What is kept
+    //in memory is O(n): the row totals (the U vector), a short,
+    //sorted list of candidate entries for each row (cf. the S and I
+    //matrices of [SMP2011]), a log of the joins made so far, and a
+    //bounded cache of rows.  Rows are kept in a spill file (rows for
+    //taxa can instead be read, via a memory map, from a binary
+    //distance file; see streamedMatrixMagic).
+    //
+    //Note 1: Cluster indices are those of the ClusterTree: taxa are
+    //        0..n-1, and the cluster formed by the j-th join is n+j.
+    //Note 2: Each row is written exactly once, when its cluster is
+    //        formed (or, for a taxon, when the input is read).  It
+    //        holds the distances to all the clusters that were live
+    //        at the time, in ascending order of cluster index.  No
+    //        row is ever updated.  Since Dci = lambda * Dai
+    //        + mu * Dbi + dCorrection (and Vci, likewise) is linear,
+    //        reading a row replays the joins made since it was
+    //        written (see readRow), which takes O(n) time but no
+    //        I/O.  So each join reads two rows (four, for BIONJ) and
+    //        writes one (two, for BIONJ).
+    //Note 3: The candidate list for row x holds (only) the smallest
+    //        entries D(x,y), for live y<x, and cutoff[x] is a lower
+    //        bound on the entries that were left out.  Entries don't
+    //        change while both clusters are live (and new clusters
+    //        have higher indices), so the lists don't go stale,
+    //        except that entries for joined clusters are skipped.
+    //        If a list runs out before the bound of [SMP2011] says
+    //        the scan of the row can stop, the row is read, and
+    //        searched, in full (and its candidate list is rebuilt,
+    //        twice as long as before).
+    //Note 4: The distance matrix is assumed to be symmetric.
+    //        Entries in the upper-right triangle are used as read.
+    //Note 5: The spill file is written next to the input file (its
+    //        name is the input file's, with ".spill" appended), and
+    //        is removed once the tree has been constructed.
+public:
+    typedef float StoredT; //Type of entries in spill and binary files
+protected:
+    struct JoinRecord {
+        size_t a;
+        size_t b;
+        double lambda;
+        double mu;
+        double dCorrection;
+        double vCorrection;
+    };
+    struct RowRecord {
+        bool   isMapped;  //true if the row is in the memory-mapped input
+        size_t offset;    //offset of the row (in entries)
+        size_t length;    //number of entries
+        size_t joinCount; //number of joins made before the row was written
+        RowRecord(): isMapped(false), offset(0), length(0), joinCount(0) {}
+    };
+    struct Candidate {
+        T      value;
+        size_t cluster;
+        bool operator< (const Candidate& rhs) const {
+            return value < rhs.value;
+        }
+    };
+    struct CachedRow {
+        std::vector<StoredT>       entries;
+        std::list<size_t>::iterator where; //in cacheOrder
+    };
+    size_t                  n;               //number of taxa
+    ClusterTree<T>          clusters;
+    std::vector<size_t>     liveClusters;
+    std::vector<size_t>     joinedBy;        //for each cluster, the join that
+                                             //consumed it (or notJoined)
+    std::vector<JoinRecord> joins;
+    std::vector<double>     rowTotals;       //indexed by cluster (the U vector)
+    std::vector<double>     scaledTotals;    //used in findBestJoin
+    std::vector<double>     maxEarlierTotal; //used in findBestJoin
+    std::vector<RowRecord>  distanceRows;    //indexed by cluster
+    std::vector<RowRecord>  varianceRows;    //indexed by cluster-n (for
+                                             //taxa, V rows are D rows)
+    std::vector<std::vector<Candidate>> candidates; //indexed by cluster
+    std::vector<T>          cutoff;          //indexed by cluster
+    std::vector<size_t>     candidateLimits; //indexed by cluster (list lengths)
+    size_t                  candidateLimit;  //initial length of candidate lists
+
+    MappedFile              mappedInput;
+    const StoredT*          mappedEntries;
+    std::string             spillFilePath;
+    std::fstream            spill;
+    size_t                  spillLength;     //in entries
+
+    std::unordered_map<size_t, CachedRow> cache; //keyed by cluster*2
+                                                 //(+1 for V rows)
+    std::list<size_t>       cacheOrder;      //most recently used first
+    size_t                  cacheBytes;
+    size_t                  cacheLimit;
+
+    std::vector<double>     rowA, rowB, rowC; //scratch rows, indexed by cluster
+    std::vector<double>     varA, varB, varC;
+    bool                    isTreeComplete;
+    bool                    isOutputToBeZipped;
+public:
+    StreamedMatrix(): n(0), candidateLimit(32), mappedEntries(nullptr)
+        , spillLength(0), cacheBytes(0), cacheLimit(256 << 20)
+        , isTreeComplete(false), isOutputToBeZipped(false) {
+    }
+    ~StreamedMatrix() {
+        removeSpillFile();
+    }
+    virtual std::string getAlgorithmName() const {
+        return useVariance ? "Streamed-BIONJ" : "Streamed-NJ";
+    }
+    bool loadMatrixFromFile(const std::string &distanceMatrixFilePath) {
+        try {
+            if (isBinaryDistanceFile(distanceMatrixFilePath)) {
+                loadBinaryMatrix(distanceMatrixFilePath);
+            } else {
+                loadTextMatrix(distanceMatrixFilePath);
+            }
+        } catch (std::ios::failure &) {
+            std::cerr << "Load matrix failed: IO error"
+                << " reading file: " << distanceMatrixFilePath << std::endl;
+            removeSpillFile();
+            return false;
+        } catch (const char *str) {
+            std::cerr << "Load matrix failed: " << str << std::endl;
+            removeSpillFile();
+            return false;
+        } catch (std::string &str) {
+            std::cerr << "Load matrix failed: " << str << std::endl;
+            removeSpillFile();
+            return false;
+        }
+        return true;
+    }
+    virtual bool loadMatrix(const std::vector<std::string>& names, const DistanceMatrix& matrix) {
+        //If the matrix is already in memory, an in-memory
+        //builder will do better.  Returning false makes the
+        //caller fall back to reading the distance file.
+        return false;
+    }
+    virtual bool constructTree() {
+        std::string taskName = "Constructing " + getAlgorithmName() + " tree";
+        progress_display show_progress(n*(n+1)/2, taskName.c_str(), "", "");
+        try {
+            while (3<liveClusters.size()) {
+                size_t a, b;
+                findBestJoin(a, b);
+                cluster(a, b);
+                show_progress+=liveClusters.size();
+            }
+            finishClustering();
+        } catch (std::ios::failure &) {
+            std::cerr << "Constructing " << getAlgorithmName() << " tree failed: IO error"
+                << " reading/writing file: " << spillFilePath << std::endl;
+            removeSpillFile();
+            return false;
+        }
+        show_progress.done();
+        removeSpillFile();
+        return true;
+    }
+    virtual void setZippedOutput(bool zipIt) {
+        isOutputToBeZipped = zipIt;
+    }
+    bool writeTreeFile(const std::string &treeFilePath) const {
+        if (!isTreeComplete) {
+            return false;
+        }
+        return clusters.writeTreeFile(isOutputToBeZipped, treeFilePath);
+    }
+protected:
+    void setSize(size_t rank) {
+        n = rank;
+        size_t clusterCount = n + n - 2; //n taxa, and n-2 joins
+        clusters.clear();
+        liveClusters.resize(n);
+        for (size_t x=0; x<n; ++x) {
+            liveClusters[x] = x;
+        }
+        joinedBy.assign(clusterCount, notJoined);
+        joins.clear();
+        rowTotals.assign(clusterCount, 0.0);
+        scaledTotals.assign(clusterCount, 0.0);
+        maxEarlierTotal.assign(clusterCount, 0.0);
+        distanceRows.assign(clusterCount, RowRecord());
+        varianceRows.assign(useVariance ? n : 0, RowRecord());
+        candidates.clear();
+        candidates.resize(clusterCount);
+        cutoff.assign(clusterCount, infiniteDistance);
+        candidateLimits.assign(clusterCount, candidateLimit);
+        rowA.assign(clusterCount, 0.0);
+        rowB.assign(clusterCount, 0.0);
+        rowC.assign(clusterCount, 0.0);
+        if (useVariance) {
+            varA.assign(clusterCount, 0.0);
+            varB.assign(clusterCount, 0.0);
+            varC.assign(clusterCount, 0.0);
+        }
+        isTreeComplete = false;
+    }
+    static bool isBinaryDistanceFile(const std::string &distanceMatrixFilePath) {
+        std::ifstream in(distanceMatrixFilePath.c_str(), std::ios::in | std::ios::binary);
+        char magic[sizeof(streamedMatrixMagic)];
+        if (!in.read(magic, sizeof(magic))) {
+            return false;
+        }
+        return memcmp(magic, streamedMatrixMagic, sizeof(magic))==0;
+    }
+    void loadTextMatrix(const std::string &distanceMatrixFilePath) {
+        igzstream in;
+        in.exceptions(std::ios::failbit | std::ios::badbit);
+        in.open(distanceMatrixFilePath.c_str(), std::ios_base::in);
+        size_t rank;
+        in >> rank;
+        if (rank<3) {
+            throw "Distance matrix must have at least three rows";
+        }
+        setSize(rank);
+        openSpillFile(distanceMatrixFilePath);
+        std::vector<StoredT> row(n);
+        progress_display progress(rank, "Loading distance matrix", "loaded", "row");
+        for (size_t r=0; r<n; ++r) {
+            std::string name;
+            in >> name;
+            clusters.addCluster(name);
+            double total = 0;
+            for (size_t c=0; c<n; ++c) {
+                in >> row[c];
+                if (c!=r) {
+                    total += row[c];
+                }
+            }
+            rowTotals[r]    = total;
+            distanceRows[r] = writeRow(row.data(), n, 0);
+            buildCandidates(r, row.data());
+            ++progress;
+        }
+        in.close();
+    }
+    void loadBinaryMatrix(const std::string &distanceMatrixFilePath) {
+        if (!mappedInput.open(distanceMatrixFilePath.c_str())) {
+            throw "Could not map binary distance file " + distanceMatrixFilePath;
+        }
+        const char* start = mappedInput.data();
+        size_t      size  = mappedInput.size();
+        size_t      pos   = sizeof(streamedMatrixMagic);
+        uint64_t    rank  = 0;
+        if (size < pos + sizeof(rank)) {
+            throw "Binary distance file " + distanceMatrixFilePath + " is truncated";
+        }
+        memcpy(&rank, start + pos, sizeof(rank));
+        pos += sizeof(rank);
+        if (rank<3) {
+            throw "Distance matrix must have at least three rows";
+        }
+        setSize(rank);
+        for (size_t r=0; r<n; ++r) {
+            uint32_t nameLength = 0;
+            if (size < pos + sizeof(nameLength)) {
+                throw "Binary distance file " + distanceMatrixFilePath + " is truncated";
+            }
+            memcpy(&nameLength, start + pos, sizeof(nameLength));
+            pos += sizeof(nameLength);
+            if (size < pos + nameLength) {
+                throw "Binary distance file " + distanceMatrixFilePath + " is truncated";
+            }
+            clusters.addCluster(std::string(start + pos, nameLength));
+            pos += nameLength;
+        }
+        pos = (pos + sizeof(StoredT) - 1) / sizeof(StoredT) * sizeof(StoredT);
+        if ((size - pos) / sizeof(StoredT) / n < n) {
+            throw "Binary distance file " + distanceMatrixFilePath + " is truncated";
+        }
+        mappedEntries = reinterpret_cast<const StoredT*>(start + pos);
+        openSpillFile(distanceMatrixFilePath);
+        progress_display progress(rank, "Loading distance matrix", "loaded", "row");
+        for (size_t r=0; r<n; ++r) {
+            const StoredT* row = mappedEntries + r * n;
+            double total = 0;
+            for (size_t c=0; c<n; ++c) {
+                if (c!=r) {
+                    total += row[c];
+                }
+            }
+            rowTotals[r] = total;
+            RowRecord& rec = distanceRows[r];
+            rec.isMapped   = true;
+            rec.offset     = r * n;
+            rec.length     = n;
+            buildCandidates(r, row);
+            ++progress;
+        }
+    }
+    void openSpillFile(const std::string &distanceMatrixFilePath) {
+        spillFilePath = distanceMatrixFilePath + ".spill";
+        spill.exceptions(std::ios::failbit | std::ios::badbit);
+        spill.open(spillFilePath.c_str(), std::ios::in | std::ios::out
+                                        | std::ios::trunc | std::ios::binary);
+        spillLength = 0;
+    }
+    void removeSpillFile() {
+        if (spill.is_open()) {
+            spill.close();
+        }
+        if (!spillFilePath.empty()) {
+            std::remove(spillFilePath.c_str());
+            spillFilePath.clear();
+        }
+        cache.clear();
+        cacheOrder.clear();
+        cacheBytes = 0;
+        mappedInput.close();
+        mappedEntries = nullptr;
+    }
+    RowRecord writeRow(const StoredT* entries, size_t length, size_t joinCount) {
+        RowRecord rec;
+        rec.offset    = spillLength;
+        rec.length    = length;
+        rec.joinCount = joinCount;
+        spill.seekp(spillLength * sizeof(StoredT));
+        spill.write(reinterpret_cast<const char*>(entries), length * sizeof(StoredT));
+        spillLength += length;
+        return rec;
+    }
+    RowRecord writeLiveRow(size_t c, const std::vector<double>& values) {
+        //Writes the row for a cluster just formed, c (which
+        //has the highest index of all the live clusters).
+        std::vector<StoredT> entries;
+        entries.reserve(liveClusters.size());
+        for (size_t x=0; x<=c; ++x) {
+            if (joinedBy[x]==notJoined) {
+                entries.push_back( (x==c) ? 0 : (StoredT)values[x] );
+            }
+        }
+        return writeRow(entries.data(), entries.size(), joins.size());
+    }
+    const StoredT* fetchRow(const RowRecord& rec, size_t key) {
+        if (rec.isMapped) {
+            return mappedEntries + rec.offset;
+        }
+        auto found = cache.find(key);
+        if (found != cache.end()) {
+            cacheOrder.splice(cacheOrder.begin(), cacheOrder, found->second.where);
+            return found->second.entries.data();
+        }
+        cacheOrder.push_front(key);
+        CachedRow& cached = cache[key];
+        cached.where = cacheOrder.begin();
+        cached.entries.resize(rec.length);
+        spill.seekg(rec.offset * sizeof(StoredT));
+        spill.read(reinterpret_cast<char*>(cached.entries.data()), rec.length * sizeof(StoredT));
+        cacheBytes += rec.length * sizeof(StoredT);
+        while (cacheLimit < cacheBytes && 1 < cacheOrder.size()) {
+            forgetRow(cacheOrder.back());
+        }
+        return cached.entries.data();
+    }
+    void forgetRow(size_t key) {
+        auto found = cache.find(key);
+        if (found != cache.end()) {
+            cacheBytes -= found->second.entries.size() * sizeof(StoredT);
+            cacheOrder.erase(found->second.where);
+            cache.erase(found);
+        }
+    }
+    void readRow(size_t x, bool isVariance, std::vector<double>& values) {
+        //Sets values[y] to D(x,y) (or to V(x,y)) for every live
+        //cluster, y (entries for other clusters are left as junk).
+        bool isVarianceRow    = isVariance && n <= x;
+        const RowRecord& rec  = isVarianceRow ? varianceRows[x-n] : distanceRows[x];
+        const StoredT* entries = fetchRow(rec, x * 2 + (isVarianceRow ? 1 : 0));
+        size_t width = n + rec.joinCount; //clusters formed before the row was written
+        size_t w     = 0;
+        for (size_t y=0; y<width; ++y) {
+            if (rec.joinCount <= joinedBy[y]) {
+                values[y] = entries[w];
+                ++w;
+            }
+        }
+        for (size_t j=rec.joinCount; j<joins.size(); ++j) {
+            const JoinRecord& join = joins[j];
+            values[n+j] = join.lambda * values[join.a] + join.mu * values[join.b]
+                        + ( isVariance ? join.vCorrection : join.dCorrection );
+        }
+    }
+    template <class V> void buildCandidates(size_t x, const V* values) {
+        //values[y] is D(x,y)
+        std::vector<Candidate> list;
+        for (size_t y=0; y<x; ++y) {
+            if (joinedBy[y]==notJoined) {
+                list.push_back(Candidate{ (T)values[y], y});
+            }
+        }
+        T      limit  = infiniteDistance;
+        size_t length = candidateLimits[x];
+        if (length < list.size()) {
+            std::nth_element(list.begin(), list.begin() + length, list.end());
+            limit = list[length].value;
+            list.resize(length);
+        }
+        std::sort(list.begin(), list.end());
+        candidates[x].assign(list.begin(), list.end());
+        cutoff[x] = limit;
+    }
+    void findBestJoin(size_t& bestA, size_t& bestB) {
+        //Finds the live clusters, bestA<bestB, with the lowest
+        //Q value: D(a,b) - (U(a) + U(b)) / (m-2), where m is the
+        //number of live clusters.
+        size_t m            = liveClusters.size();
+        double tMultiplier  = ( m <= 2 ) ? 0 : (1.0 / (double)(m-2));
+        size_t clusterCount = clusters.size();
+        double maxSoFar     = -infiniteDistance;
+        for (size_t x=0; x<clusterCount; ++x) {
+            maxEarlierTotal[x] = maxSoFar;
+            if (joinedBy[x]==notJoined) {
+                scaledTotals[x] = rowTotals[x] * tMultiplier;
+                maxSoFar = std::max(maxSoFar, scaledTotals[x]);
+            }
+        }
+        double qBest = infiniteDistance;
+        bestA = bestB = 0;
+        //First pass: the first live candidate of each row
+        //(dropping candidates for clusters that were joined).
+        for (size_t x : liveClusters) {
+            std::vector<Candidate>& list = candidates[x];
+            size_t dead = 0;
+            while (dead<list.size() && joinedBy[list[dead].cluster]!=notJoined) {
+                ++dead;
+            }
+            list.erase(list.begin(), list.begin() + dead);
+            if (!list.empty()) {
+                double q = list[0].value - scaledTotals[list[0].cluster] - scaledTotals[x];
+                if (q < qBest) {
+                    qBest = q;
+                    bestA = list[0].cluster;
+                    bestB = x;
+                }
+            }
+        }
+        //Second pass: scan each row until the bound of [SMP2011]
+        //says nothing further along it can beat qBest.
+        for (size_t x : liveClusters) {
+            double rowBound = qBest + maxEarlierTotal[x] + scaledTotals[x];
+            bool   scanned  = false;
+            for (const Candidate& here : candidates[x]) {
+                if (rowBound <= here.value) {
+                    scanned = true;
+                    break;
+                }
+                if (joinedBy[here.cluster]!=notJoined) {
+                    continue;
+                }
+                double q = here.value - scaledTotals[here.cluster] - scaledTotals[x];
+                if (q < qBest) {
+                    qBest    = q;
+                    bestA    = here.cluster;
+                    bestB    = x;
+                    rowBound = qBest + maxEarlierTotal[x] + scaledTotals[x];
+                }
+            }
+            if (!scanned && cutoff[x] < rowBound) {
+                //Entries left out of the candidate list might do better
+                readRow(x, false, rowA);
+                for (size_t y=0; y<x; ++y) {
+                    if (joinedBy[y]==notJoined) {
+                        double q = rowA[y] - scaledTotals[y] - scaledTotals[x];
+                        if (q < qBest) {
+                            qBest = q;
+                            bestA = y;
+                            bestB = x;
+                        }
+                    }
+                }
+                candidateLimits[x] *= 2;
+                buildCandidates(x, rowA.data());
+            }
+        }
+    }
+    double chooseLambda(size_t a, size_t b, double Vab) {
+        if (Vab==0.0) {
+            return 0.5;
+        }
+        double lambda = 0;
+        for (size_t i : liveClusters) {
+            if (i!=a && i!=b) {
+                lambda += varB[i] - varA[i];
+            }
+        }
+        lambda = 0.5 + lambda / (2.0*((double)liveClusters.size()-2)*Vab);
+        if (1.0<lambda) lambda=1.0;
+        if (lambda<0.0) lambda=0.0;
+        return lambda;
+    }
+    void cluster(size_t a, size_t b) {
+        //Cluster two live clusters, a and b
+        readRow(a, false, rowA);
+        readRow(b, false, rowB);
+        size_t m            = liveClusters.size();
+        double tMultiplier  = ( m < 3 ) ? 0 : ( 0.5 / (double)(m-2) );
+        double medianLength = 0.5 * rowA[b];
+        double fudge        = (rowTotals[a] - rowTotals[b]) * tMultiplier;
+        double aLength      = medianLength + fudge;
+        double bLength      = medianLength - fudge;
+        double lambda       = 0.5;
+        double Vab          = 0;
+        if (useVariance) {
+            readRow(a, true, varA);
+            readRow(b, true, varB);
+            Vab    = varA[b];
+            lambda = chooseLambda(a, b, Vab);
+        }
+        double mu           = 1.0 - lambda;
+        double dCorrection  = - lambda * aLength - mu * bLength;
+        double vCorrection  = - lambda * mu * Vab;
+        double cTotal       = 0;
+        for (size_t i : liveClusters) {
+            if (i!=a && i!=b) {
+                double Dci    = lambda * rowA[i] + mu * rowB[i] + dCorrection;
+                rowC[i]       = Dci;
+                rowTotals[i] += Dci - rowA[i] - rowB[i];
+                cTotal       += Dci;
+                if (useVariance) {
+                    varC[i] = lambda * varA[i] + mu * varB[i] + vCorrection;
+                }
+            }
+        }
+        size_t c = clusters.size();
+        joinedBy[a] = joins.size();
+        joinedBy[b] = joins.size();
+        joins.push_back(JoinRecord{a, b, lambda, mu, dCorrection, vCorrection});
+        clusters.addCluster(a, (T)aLength, b, (T)bLength);
+        rowTotals[c] = cTotal;
+        liveClusters.erase(std::remove_if(liveClusters.begin(), liveClusters.end(),
+                           [a,b](size_t x) { return x==a || x==b; }), liveClusters.end());
+        liveClusters.push_back(c);
+
+        distanceRows[c] = writeLiveRow(c, rowC);
+        if (useVariance) {
+            varianceRows[c-n] = writeLiveRow(c, varC);
+        }
+        buildCandidates(c, rowC.data());
+        for (size_t x : {a, b}) {
+            forgetRow(x * 2);
+            forgetRow(x * 2 + 1);
+            std::vector<Candidate>().swap(candidates[x]);
+        }
+    }
+    void finishClustering() {
+        //Assumes that there are 3 live clusters
+        size_t x = liveClusters[0];
+        size_t y = liveClusters[1];
+        size_t z = liveClusters[2];
+        readRow(x, false, rowA);
+        readRow(y, false, rowB);
+        double halfDxy = 0.5 * rowA[y];
+        double halfDxz = 0.5 * rowA[z];
+        double halfDyz = 0.5 * rowB[z];
+        clusters.addCluster
+            ( x, (T)(halfDxy + halfDxz - halfDyz)
+            , y, (T)(halfDxy + halfDyz - halfDxz)
+            , z, (T)(halfDxz + halfDyz - halfDxy));
+        liveClusters.clear();
+        isTreeComplete = true;
+    }
+};
+
 typedef BoundingMatrix<NJFloat, NJMatrix<NJFloat>>      RapidNJ;
 typedef BoundingMatrix<NJFloat, BIONJMatrix<NJFloat>>   RapidBIONJ;
+typedef ParallelBoundingMatrix<NJFloat, NJMatrix<NJFloat>>    ParallelRapidNJ;
+typedef ParallelBoundingMatrix<NJFloat, BIONJMatrix<NJFloat>> ParallelRapidBIONJ;
 typedef VectorizedMatrix<NJFloat, NJMatrix<NJFloat>>    VectorNJ;
 typedef VectorizedMatrix<NJFloat, BIONJMatrix<NJFloat>> VectorBIONJ;
+typedef StreamedMatrix<NJFloat, false>                  StreamedNJ;
+typedef StreamedMatrix<NJFloat, true>                   StreamedBIONJ;
 
 void addBioNJ2020TreeBuilders(Factory& f) {
     f.advertiseTreeBuilder( new Builder<NJMatrix<NJFloat>>    ("NJ",      "Neighbour Joining (Saitou, Nei [1987])"));
@@ -1410,6 +2238,10 @@ void addBioNJ2020TreeBuilders(Factory& f) {
     f.advertiseTreeBuilder( new Builder<UPGMA_Matrix<NJFloat>>("UPGMA",    "UPGMA (Sokal, Michener [1958])"));
     f.advertiseTreeBuilder( new Builder<VectorizedUPGMA_Matrix<NJFloat>>("UPGMA-V", "Vectorized UPGMA (Sokal, Michener [1958])"));
     f.advertiseTreeBuilder( new Builder<BoundingMatrix<double>> ("NJ-R-D", "Double precision Rapid Neighbour Joining"));
+    f.advertiseTreeBuilder( new Builder<ParallelRapidNJ>    ("NJ-R-P",    "Parallel Rapid Neighbour Joining (Simonsen, Mailund, Pedersen [2011])"));
+    f.advertiseTreeBuilder( new Builder<ParallelRapidBIONJ> ("BIONJ-R-P", "Parallel Rapid BIONJ (Gascuel [2009], Simonsen, Mailund, Pedersen [2011])"));
+    f.advertiseTreeBuilder( new Builder<StreamedNJ>    ("NJ-S",    "Out-of-core (streamed) Neighbour Joining, for matrices too large for memory"));
+    f.advertiseTreeBuilder( new Builder<StreamedBIONJ> ("BIONJ-S", "Out-of-core (streamed) BIONJ, for matrices too large for memory"));
     const char* defaultName = "RapidNJ";
     f.advertiseTreeBuilder( new Builder<RapidNJ>                (defaultName, "Rapid Neighbour Joining (Simonsen, Mailund, Pedersen [2011]) (default)"));  //Default.
     f.setNameOfDefaultTreeBuilder(defaultName);
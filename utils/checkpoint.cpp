@@ -10,10 +10,78 @@
 #include "timeutil.h"
 #include "gzstream.h"
 #include <cstdio>
+#include <functional>
+#include <stdint.h>
 
 const char* CKP_HEADER =     "--- # IQ-TREE Checkpoint ver >= 1.6";
 const char* CKP_HEADER_OLD = "--- # IQ-TREE Checkpoint";
 
+/**
+    Binary checkpoint file: the magic string, the header line (uint32 length and characters),
+    then a log of records, in native byte order:
+    'P', key (uint32 length and characters), value (uint64 length and bytes): put a key
+    'E', key: erase a key
+    'C', uint64 number of preceding P and E records in this dump: commit the dump
+    The first dump holds all keys, every later dump appends the keys changed since.
+    Records after the last commit were cut off by a crash while dumping and are ignored.
+*/
+const char CKP_BINARY_MAGIC[] = "IQCKPBIN";
+const size_t CKP_BINARY_MAGIC_LEN = 8;
+
+/** rewrite the binary file once it exceeds this many times the size of all current keys */
+const size_t CKP_BINARY_COMPACT_RATIO = 2;
+
+/** @return number of bytes of an erase record */
+static size_t binaryRecordSize(const string &key) {
+    return 1 + sizeof(uint32_t) + key.length();
+}
+
+/** @return number of bytes of a put record */
+static size_t binaryRecordSize(const string &key, size_t value_len) {
+    return binaryRecordSize(key) + sizeof(uint64_t) + value_len;
+}
+
+static void writeBinaryRecord(ostream &out, const string &key, const string *value) {
+    uint32_t key_len = key.length();
+    out.put(value ? 'P' : 'E');
+    out.write((char*)&key_len, sizeof(key_len));
+    out.write(key.data(), key_len);
+    if (value) {
+        uint64_t value_len = value->length();
+        out.write((char*)&value_len, sizeof(value_len));
+        out.write(value->data(), value_len);
+    }
+}
+
+static void writeBinaryCommit(ostream &out, uint64_t num_records) {
+    out.put('C');
+    out.write((char*)&num_records, sizeof(num_records));
+}
+
+/** @return false if the stream ended before the whole string was read */
+template<class L>
+static bool readBinaryString(istream &in, string &str) {
+    L len;
+    if (!in.read((char*)&len, sizeof(len)))
+        return false;
+    str.resize(len);
+    return len == 0 || in.read(&str[0], len);
+}
+
+template<class E>
+static string binaryElementsToText(const string &value) {
+    CkpStream ss;
+    ss.precision(10);
+    size_t num = (value.length() - 2) / sizeof(E);
+    for (size_t i = 0; i < num; i++) {
+        E elem;
+        memcpy(&elem, value.data() + 2 + i*sizeof(E), sizeof(E));
+        if (i > 0) ss << ", ";
+        ss << elem;
+    }
+    return ss.str();
+}
+
 Checkpoint::Checkpoint() {
 	filename = "";
     prev_dump_time = 0;
@@ -21,6 +89,8 @@ Checkpoint::Checkpoint() {
     struct_name = "";
     compression = true;
     header = CKP_HEADER;
+    binary = false;
+    resetBinaryDump();
 }
 
 
@@ -30,6 +100,7 @@ Checkpoint::~Checkpoint() {
 
 void Checkpoint::setFileName(string filename) {
 	this->filename = filename;
+    resetBinaryDump();
 }
 
 
@@ -76,6 +147,16 @@ bool Checkpoint::load() {
 	ASSERT(filename != "");
     if (!fileExists(filename)) return false;
     try {
+        ifstream bin;
+        bin.exceptions(ios::badbit);
+        bin.open(filename.c_str(), ios::in | ios::binary);
+        char magic[CKP_BINARY_MAGIC_LEN];
+        if (bin.read(magic, CKP_BINARY_MAGIC_LEN) && memcmp(magic, CKP_BINARY_MAGIC, CKP_BINARY_MAGIC_LEN) == 0) {
+            loadBinary(bin);
+            bin.close();
+            return true;
+        }
+        bin.close();
         igzstream in;
         // set the failbit and badbit
         in.exceptions(ios::failbit | ios::badbit);
@@ -108,16 +189,103 @@ bool Checkpoint::load() {
     return false;
 }
 
+void Checkpoint::loadBinary(istream &in) {
+    string line;
+    if (!readBinaryString<uint32_t>(in, line) || line != header)
+        throw ("Invalid checkpoint file " + filename);
+    size_t valid_size = in.tellg();
+    // records are only applied once their dump is committed
+    vector<pair<string, string> > records;
+    vector<bool> record_put;
+    int kind;
+    while ((kind = in.get()) != EOF) {
+        string key, value;
+        if (kind == 'C') {
+            uint64_t num_records;
+            if (!in.read((char*)&num_records, sizeof(num_records)) || num_records != records.size())
+                break;
+            for (size_t i = 0; i < records.size(); i++)
+                if (record_put[i])
+                    (*this)[records[i].first].swap(records[i].second);
+                else
+                    erase(records[i].first);
+            records.clear();
+            record_put.clear();
+            valid_size = in.tellg();
+        } else if (kind == 'P' || kind == 'E') {
+            if (!readBinaryString<uint32_t>(in, key))
+                break;
+            if (kind == 'P' && !readBinaryString<uint64_t>(in, value))
+                break;
+            records.push_back(make_pair(key, string()));
+            records.back().second.swap(value);
+            record_put.push_back(kind == 'P');
+        } else
+            break;
+    }
+    if (in.eof())
+        in.clear();
+    resetBinaryDump();
+    if (!records.empty() || kind != EOF) {
+        outWarning("Discard incomplete last dump of checkpoint file " + filename);
+        // the file will be rewritten at the next dump
+        return;
+    }
+    if (!binary)
+        return;
+    // the keys loaded are those in the file, later dumps append to it
+    std::hash<string> hash_value;
+    for (iterator i = begin(); i != end(); i++) {
+        binary_dumped.insert(binary_dumped.end(),
+            make_pair(i->first, make_pair(i->second.length(), hash_value(i->second))));
+        binary_live_size += binaryRecordSize(i->first, i->second.length());
+    }
+    binary_file_size = valid_size;
+    binary_scan = false;
+}
+
 void Checkpoint::setCompression(bool compression) {
     this->compression = compression;
 }
 
+void Checkpoint::setBinary(bool binary) {
+    this->binary = binary;
+    // the next dump rewrites the whole file
+    resetBinaryDump();
+}
+
+void Checkpoint::resetBinaryDump() {
+    binary_file_size = 0;
+    binary_live_size = CKP_BINARY_MAGIC_LEN + sizeof(uint32_t) + header.length() + 1 + sizeof(uint64_t);
+    binary_dumped.clear();
+    binary_changed.clear();
+    binary_scan = true;
+}
+
+string Checkpoint::textValue(const string &value) {
+    if (!isBinaryValue(value))
+        return value;
+    switch (value[1]) {
+    case 'i': return binaryElementsToText<int>(value);
+    case 'I': return binaryElementsToText<unsigned int>(value);
+    case 'l': return binaryElementsToText<long>(value);
+    case 'L': return binaryElementsToText<unsigned long>(value);
+    case 'q': return binaryElementsToText<long long>(value);
+    case 'Q': return binaryElementsToText<unsigned long long>(value);
+    case 'f': return binaryElementsToText<float>(value);
+    case 'd': return binaryElementsToText<double>(value);
+    default: outError("Invalid binary value in checkpoint");
+    }
+    return "";
+}
+
 /**
     set the header line to overwrite the default header
     @param header header line
 */
 void Checkpoint::setHeader(string header) {
     this->header = "--- # " + header;
+    resetBinaryDump();
 }
 
 void Checkpoint::setDumpInterval(double interval) {
@@ -136,9 +304,9 @@ void Checkpoint::dump(ostream &out) {
                 listid = 0;
             }
             // check if key is a collection
-            out << ' ' << i->first.substr(pos+1) << ": " << i->second << endl;
+            out << ' ' << i->first.substr(pos+1) << ": " << textValue(i->second) << endl;
         } else
-            out << i->first << ": " << i->second << endl;
+            out << i->first << ": " << textValue(i->second) << endl;
     }
 }
 
@@ -150,6 +318,20 @@ void Checkpoint::dump(bool force) {
         return;
     }
     prev_dump_time = getRealTime();
+    if (binary)
+        dumpBinary();
+    else
+        dumpText();
+    // check that the dumping time is too long and increase dump_interval if necessary
+    double dump_time = getRealTime() - prev_dump_time;
+    if (dump_time*20 > dump_interval) {
+        dump_interval = ceil(dump_time*20);
+        cout << "NOTE: " << dump_time << " seconds to dump checkpoint file, increase to "
+        << dump_interval << endl;
+    }
+}
+
+void Checkpoint::dumpText() {
     string filename_tmp = filename + ".tmp";
     if (fileExists(filename_tmp)) {
         outWarning("IQ-TREE was killed while writing temporary checkpoint file " + filename_tmp);
@@ -181,12 +363,88 @@ void Checkpoint::dump(bool force) {
     } catch (ios::failure &) {
         outError(ERR_WRITE_OUTPUT, filename.c_str());
     }
-    // check that the dumping time is too long and increase dump_interval if necessary
-    double dump_time = getRealTime() - prev_dump_time;
-    if (dump_time*20 > dump_interval) {
-        dump_interval = ceil(dump_time*20);
-        cout << "NOTE: " << dump_time << " seconds to dump checkpoint file, increase to "
-        << dump_interval << endl;
+}
+
+void Checkpoint::dumpBinary() {
+    // find the keys changed or erased since the previous dump
+    vector<const value_type*> changed;
+    vector<string> erased;
+    size_t delta_size = 1 + sizeof(uint64_t);
+    std::hash<string> hash_value;
+    if (binary_scan) {
+        // compare all keys with the previous dump
+        binary_changed.clear();
+        for (iterator i = begin(); i != end(); i++)
+            binary_changed.insert(binary_changed.end(), i->first);
+        for (auto dumped = binary_dumped.begin(); dumped != binary_dumped.end(); dumped++)
+            binary_changed.insert(dumped->first);
+        binary_scan = false;
+    }
+    // only the length and hash are compared: a key put with the same value is not dumped again
+    for (auto &key : binary_changed) {
+        iterator i = find(key);
+        auto dumped = binary_dumped.find(key);
+        if (dumped != binary_dumped.end()) {
+            if (i != end() && dumped->second == make_pair(i->second.length(), hash_value(i->second)))
+                continue;
+            binary_live_size -= binaryRecordSize(key, dumped->second.first);
+        }
+        if (i == end()) {
+            if (dumped == binary_dumped.end())
+                continue;
+            binary_dumped.erase(dumped);
+            delta_size += binaryRecordSize(key);
+            erased.push_back(key);
+            continue;
+        }
+        binary_dumped[key] = make_pair(i->second.length(), hash_value(i->second));
+        size_t record_size = binaryRecordSize(key, i->second.length());
+        binary_live_size += record_size;
+        delta_size += record_size;
+        changed.push_back(&(*i));
+    }
+    binary_changed.clear();
+
+    try {
+        if (binary_file_size > 0 && binary_file_size + delta_size <= CKP_BINARY_COMPACT_RATIO * binary_live_size) {
+            if (changed.empty() && erased.empty())
+                return;
+            // append the changes, a crash before the commit record leaves the previous dump intact
+            ofstream out;
+            out.exceptions(ios::failbit | ios::badbit);
+            out.open(filename.c_str(), ios::out | ios::binary | ios::app);
+            for (auto &key : erased)
+                writeBinaryRecord(out, key, NULL);
+            for (auto entry : changed)
+                writeBinaryRecord(out, entry->first, &entry->second);
+            writeBinaryCommit(out, erased.size() + changed.size());
+            out.close();
+            binary_file_size += delta_size;
+            return;
+        }
+        // compact: write all keys into a new file and replace the old one
+        string filename_tmp = filename + ".tmp";
+        ofstream out;
+        out.exceptions(ios::failbit | ios::badbit);
+        out.open(filename_tmp.c_str(), ios::out | ios::binary | ios::trunc);
+        uint32_t header_len = header.length();
+        out.write(CKP_BINARY_MAGIC, CKP_BINARY_MAGIC_LEN);
+        out.write((char*)&header_len, sizeof(header_len));
+        out.write(header.data(), header_len);
+        for (iterator i = begin(); i != end(); i++)
+            writeBinaryRecord(out, i->first, &i->second);
+        writeBinaryCommit(out, size());
+        out.close();
+#if defined WIN32 || defined _WIN32 || defined __WIN32__ || defined WIN64
+        // rename does not replace an existing file on Windows
+        if (fileExists(filename) && std::remove(filename.c_str()) != 0)
+            outError("Cannot remove file ", filename);
+#endif
+        if (std::rename(filename_tmp.c_str(), filename.c_str()) != 0)
+            outError("Cannot rename file ", filename_tmp);
+        binary_file_size = binary_live_size;
+    } catch (ios::failure &) {
+        outError(ERR_WRITE_OUTPUT, filename.c_str());
     }
 }
 
@@ -10,11 +10,14 @@
 
 #include <stdio.h>
 #include <map>
+#include <set>
 #include <string>
 #include <sstream>
 #include <cassert>
 #include <vector>
 #include <typeinfo>
+#include <cstring>
+#include <type_traits>
 #include "tools.h"
 
 using namespace std;
@@ -50,6 +53,20 @@ public:
 
 };
 
+/**
+    type code of numbers that putArray() and putVector() store natively in a binary checkpoint,
+    0 for other types, which are always stored as text
+*/
+template<class T> struct CkpBinaryType : std::integral_constant<char, 0> {};
+template<> struct CkpBinaryType<int> : std::integral_constant<char, 'i'> {};
+template<> struct CkpBinaryType<unsigned int> : std::integral_constant<char, 'I'> {};
+template<> struct CkpBinaryType<long> : std::integral_constant<char, 'l'> {};
+template<> struct CkpBinaryType<unsigned long> : std::integral_constant<char, 'L'> {};
+template<> struct CkpBinaryType<long long> : std::integral_constant<char, 'q'> {};
+template<> struct CkpBinaryType<unsigned long long> : std::integral_constant<char, 'Q'> {};
+template<> struct CkpBinaryType<float> : std::integral_constant<char, 'f'> {};
+template<> struct CkpBinaryType<double> : std::integral_constant<char, 'd'> {};
+
 /* overload operators */
 //ostream& operator<<(ostream& os, const T& obj) {
 //        return os;
@@ -84,6 +101,13 @@ public:
     */
     void setCompression(bool compression);
 
+    /**
+        set binary format for checkpoint file: arrays of numbers are stored natively
+        and dump() only appends the keys changed since the previous dump, see dumpBinary()
+        @param binary true for binary format, or false (default): text format
+    */
+    void setBinary(bool binary);
+
     /**
         set the header line to overwrite the default header
         @param header header line
@@ -97,19 +121,19 @@ public:
 	void load(istream &in);
 
 	/**
-	 * load checkpoint information from file
+	 * load checkpoint information from file, in text or binary format
      * @return TRUE if loaded successfully, otherwise FALSE
 	 */
 	bool load();
 
 	/**
-	 * dump checkpoint information into an output stream
+	 * dump checkpoint information into an output stream, always in text format
      * @param out output stream
 	 */
 	void dump(ostream &out);
 
 	/**
-	 * dump checkpoint information into file
+	 * dump checkpoint information into file, in text or binary format
 	 * @param force TRUE to dump no matter if time interval exceeded or not
 	 */
 	void dump(bool force = false);
@@ -120,6 +144,20 @@ public:
     */
     void setDumpInterval(double interval);
 
+    /**
+        @param value value of a key
+        @return true if value is an array of numbers stored natively
+    */
+    static bool isBinaryValue(const string &value) {
+        return !value.empty() && value[0] == 0;
+    }
+
+    /**
+        @param value value of a key
+        @return value in text format, as putArray() would write it without binary format
+    */
+    static string textValue(const string &value);
+
 	/**
 	 * @return true if checkpoint contains the key
 	 * @param key key to search for
@@ -146,6 +184,58 @@ public:
      */
     int keepKeyPrefix(string key_prefix);
 
+    /*-------------------------------------------------------------
+     * map functions that modify keys, recorded for the next binary dump
+     *-------------------------------------------------------------*/
+
+    /**
+        @param key key name
+        @return value of the key, created if it does not exist; the key is dumped again
+    */
+    string &operator[](const string &key) {
+        changeKey(key);
+        return map<string, string>::operator[](key);
+    }
+
+    /**
+        erase a key
+        @param key key name
+        @return number of entries removed
+    */
+    size_type erase(const string &key) {
+        changeKey(key);
+        return map<string, string>::erase(key);
+    }
+
+    /**
+        erase an entry
+        @param pos entry
+        @return entry following the erased one
+    */
+    iterator erase(iterator pos) {
+        changeKey(pos->first);
+        return map<string, string>::erase(pos);
+    }
+
+    /**
+        erase a range of entries
+        @param first first entry
+        @param last entry following the last one
+        @return last
+    */
+    iterator erase(iterator first, iterator last) {
+        for (iterator i = first; i != last; i++)
+            changeKey(i->first);
+        return map<string, string>::erase(first, last);
+    }
+
+    /** erase all entries */
+    void clear() {
+        map<string, string>::clear();
+        binary_scan = true;
+        binary_changed.clear();
+    }
+
     /*-------------------------------------------------------------
      * series of get function to get value of a key
      *-------------------------------------------------------------*/
@@ -164,7 +254,7 @@ public:
         iterator it = find(key);
         if (it == end())
             return false;
-        CkpStream ss(it->second);
+        CkpStream ss(isBinaryValue(it->second) ? textValue(it->second) : it->second);
         ss >> value;
         return true;
     }
@@ -182,7 +272,7 @@ public:
         iterator it = find(key);
         if (it == end())
             return false;
-        value = it->second;
+        value = isBinaryValue(it->second) ? textValue(it->second) : it->second;
         return true;
     }
 
@@ -201,10 +291,22 @@ public:
         iterator it = find(key);
         if (it == end())
             return false;
+        const string *str = &it->second;
+        string text;
+        if (isBinaryValue(it->second)) {
+            vector<T> elems;
+            if (getBinaryValue(it->second, elems, std::integral_constant<bool, CkpBinaryType<T>::value != 0>())) {
+                ASSERT(elems.size() <= maxnum);
+                copy(elems.begin(), elems.end(), value);
+                return true;
+            }
+            text = textValue(it->second);
+            str = &text;
+        }
         size_t pos = 0, next_pos;
         for (int i = 0; i < maxnum; i++) {
-        	next_pos = it->second.find(", ", pos);
-            CkpStream ss(it->second.substr(pos, next_pos-pos));
+        	next_pos = str->find(", ", pos);
+            CkpStream ss(str->substr(pos, next_pos-pos));
         	if (!(ss >> value[i]))
                 break;
             if (next_pos == string::npos) {
@@ -232,11 +334,19 @@ public:
         iterator it = find(key);
         if (it == end())
             return false;
+        const string *str = &it->second;
+        string text;
+        if (isBinaryValue(it->second)) {
+            if (getBinaryValue(it->second, value, std::integral_constant<bool, CkpBinaryType<T>::value != 0>()))
+                return true;
+            text = textValue(it->second);
+            str = &text;
+        }
         size_t pos = 0, next_pos;
         value.clear();
         for (int i = 0; ; i++) {
-        	next_pos = it->second.find(", ", pos);
-            CkpStream ss(it->second.substr(pos, next_pos-pos));
+        	next_pos = str->find(", ", pos);
+            CkpStream ss(str->substr(pos, next_pos-pos));
             T val;
             if (ss >> val) {
                 value.push_back(val);
@@ -344,6 +454,10 @@ public:
             key = struct_name.substr(0, struct_name.length()-1);
         else
             key = struct_name + key;
+        if (binary && CkpBinaryType<T>::value) {
+            putBinaryValue<T>((*this)[key], num, value, std::integral_constant<bool, CkpBinaryType<T>::value != 0>());
+            return;
+        }
         CkpStream ss;
         ss.precision(10);
         for (int i = 0; i < num; i++) {
@@ -365,6 +479,10 @@ public:
             key = struct_name.substr(0, struct_name.length()-1);
         else
             key = struct_name + key;
+        if (binary && CkpBinaryType<T>::value) {
+            putBinaryValue<T>((*this)[key], value.size(), value, std::integral_constant<bool, CkpBinaryType<T>::value != 0>());
+            return;
+        }
         CkpStream ss;
         ss.precision(10);
         for (int i = 0; i < value.size(); i++) {
@@ -453,7 +571,114 @@ protected:
     
     /** header line of checkpoint file */
     string header;
-    
+
+    /** true to store arrays natively and dump checkpoint file in binary format, false (default): text */
+    bool binary;
+
+    /** size of binary checkpoint file, 0 if the file has to be rewritten at the next dump */
+    size_t binary_file_size;
+
+    /** length and hash of the values in binary checkpoint file, to skip keys put again with the same value */
+    map<string, pair<size_t, size_t> > binary_dumped;
+
+    /** size of binary checkpoint file after rewriting it with all current keys */
+    size_t binary_live_size;
+
+    /** keys put or erased since the previous binary dump */
+    set<string> binary_changed;
+
+    /**
+        true if the next binary dump has to compare all keys with binary_dumped, because
+        the keys changed are unknown (file not written yet, or all keys erased)
+    */
+    bool binary_scan;
+
+    /**
+        record a key put or erased, only its length and hash are compared at the next binary dump
+        @param key key name
+    */
+    void changeKey(const string &key) {
+        if (binary && !binary_scan)
+            binary_changed.insert(key);
+    }
+
+    /** compare all keys at the next binary dump, and rewrite the whole file */
+    void resetBinaryDump();
+
+    /**
+        load checkpoint information from a binary file
+        @param in input stream positioned after the magic string
+    */
+    void loadBinary(istream &in);
+
+    /**
+        dump checkpoint information into text file, compressed if compression is set
+    */
+    void dumpText();
+
+    /**
+        dump checkpoint information into binary file: append the keys changed or erased
+        since the previous dump, or rewrite the whole file when it became too large
+    */
+    void dumpBinary();
+
+    /**
+        store an array of numbers natively: a 0 byte, the type code, then the raw elements
+        @param[out] str value of the key
+        @param num number of elements
+        @param value array or vector of elements
+    */
+    template<class T, class V>
+    static void putBinaryValue(string &str, size_t num, const V &value, std::true_type) {
+        str.assign(2 + num*sizeof(T), 0);
+        str[1] = CkpBinaryType<T>::value;
+        if (num)
+            memcpy(&str[2], &value[0], num*sizeof(T));
+    }
+
+    template<class T, class V>
+    static void putBinaryValue(string &str, size_t num, const V &value, std::false_type) {
+        ASSERT(0 && "not a number type");
+    }
+
+    /**
+        convert an array stored natively into numbers of type T
+        @param str value of the key, see isBinaryValue()
+        @param[out] value elements
+        @return false if T is not a number type
+    */
+    template<class T>
+    static bool getBinaryValue(const string &str, vector<T> &value, std::true_type) {
+        switch (str[1]) {
+        case 'i': getBinaryElements<T, int>(str, value); break;
+        case 'I': getBinaryElements<T, unsigned int>(str, value); break;
+        case 'l': getBinaryElements<T, long>(str, value); break;
+        case 'L': getBinaryElements<T, unsigned long>(str, value); break;
+        case 'q': getBinaryElements<T, long long>(str, value); break;
+        case 'Q': getBinaryElements<T, unsigned long long>(str, value); break;
+        case 'f': getBinaryElements<T, float>(str, value); break;
+        case 'd': getBinaryElements<T, double>(str, value); break;
+        default: outError("Invalid binary value in checkpoint");
+        }
+        return true;
+    }
+
+    template<class T>
+    static bool getBinaryValue(const string &str, vector<T> &value, std::false_type) {
+        return false;
+    }
+
+    template<class T, class E>
+    static void getBinaryElements(const string &str, vector<T> &value) {
+        size_t num = (str.length() - 2) / sizeof(E);
+        value.resize(num);
+        for (size_t i = 0; i < num; i++) {
+            E elem;
+            memcpy(&elem, str.data() + 2 + i*sizeof(E), sizeof(E));
+            value[i] = (T)elem;
+        }
+    }
+
 private:
 
     /** name of the current nested key */
@@ -0,0 +1,141 @@
+//
+//  distancematrix.h
+//  utils
+//
+//  Symmetric matrix of pairwise distances, stored as a packed lower triangle.
+//
+
+#ifndef distancematrix_h
+#define distancematrix_h
+
+#include <vector>
+#include <cstddef>
+#include <algorithm>
+
+/**
+ * Symmetric matrix of pairwise distances (or their variances) with a zero diagonal.
+ * Only the strict lower triangle is stored, row by row: n*(n-1)/2 entries instead of n*n,
+ * either in double or in single precision.
+ * Entries of different pairs can be set concurrently.
+ */
+class DistanceMatrix {
+public:
+    DistanceMatrix() : n(0), single_precision(false) {}
+
+    /**
+     * @param nseq number of sequences
+     * @param single TRUE to store the entries as float
+     * @param init_value initial value of all off-diagonal entries
+     */
+    DistanceMatrix(size_t nseq, bool single = false, double init_value = 0.0) {
+        setSize(nseq, single, init_value);
+    }
+
+    /**
+     * resize the matrix, discarding all entries
+     * @param nseq number of sequences
+     * @param single TRUE to store the entries as float
+     * @param init_value initial value of all off-diagonal entries
+     */
+    void setSize(size_t nseq, bool single, double init_value = 0.0) {
+        n = nseq;
+        single_precision = single;
+        std::vector<float>().swap(float_data);
+        std::vector<double>().swap(double_data);
+        if (single_precision)
+            float_data.resize(getNEntry(), (float)init_value);
+        else
+            double_data.resize(getNEntry(), init_value);
+    }
+
+    /** @return number of sequences */
+    size_t getNSeq() const { return n; }
+
+    /** @return TRUE if entries are stored as float */
+    bool isSinglePrecision() const { return single_precision; }
+
+    /** @return number of stored entries, n*(n-1)/2 */
+    size_t getNEntry() const { return (n < 2) ? 0 : n * (n-1) / 2; }
+
+    /** @return number of bytes of the stored entries */
+    size_t getMemoryBytes() const {
+        return getNEntry() * (single_precision ? sizeof(float) : sizeof(double));
+    }
+
+    /**
+     * @return entry between seq1 and seq2, zero if seq1 == seq2
+     */
+    inline double get(size_t seq1, size_t seq2) const {
+        if (seq1 == seq2)
+            return 0.0;
+        size_t pos = index(seq1, seq2);
+        return single_precision ? (double)float_data[pos] : double_data[pos];
+    }
+
+    inline double operator()(size_t seq1, size_t seq2) const {
+        return get(seq1, seq2);
+    }
+
+    /**
+     * set entry between seq1 and seq2 (and seq2 and seq1), seq1 != seq2
+     */
+    inline void set(size_t seq1, size_t seq2, double value) {
+        size_t pos = index(seq1, seq2);
+        if (single_precision)
+            float_data[pos] = (float)value;
+        else
+            double_data[pos] = value;
+    }
+
+    /** @return the largest entry */
+    double getLongestDist() const {
+        double longest_dist = 0.0;
+        if (single_precision) {
+            for (size_t pos = 0; pos < float_data.size(); pos++)
+                longest_dist = std::max(longest_dist, (double)float_data[pos]);
+        } else {
+            for (size_t pos = 0; pos < double_data.size(); pos++)
+                longest_dist = std::max(longest_dist, double_data[pos]);
+        }
+        return longest_dist;
+    }
+
+    /**
+     * copy the entries between a subset of sequences of another matrix
+     * @param mat the other matrix
+     * @param ids IDs in mat of the sequences kept, in their new order
+     */
+    void extractSubMatrix(const DistanceMatrix &mat, const std::vector<int> &ids) {
+        setSize(ids.size(), mat.single_precision);
+        for (size_t seq1 = 1; seq1 < n; seq1++)
+            for (size_t seq2 = 0; seq2 < seq1; seq2++)
+                set(seq1, seq2, mat.get(ids[seq1], ids[seq2]));
+    }
+
+    void swap(DistanceMatrix &other) {
+        std::swap(n, other.n);
+        std::swap(single_precision, other.single_precision);
+        float_data.swap(other.float_data);
+        double_data.swap(other.double_data);
+    }
+
+protected:
+    /** position of the entry between seq1 and seq2 in the packed lower triangle */
+    static inline size_t index(size_t seq1, size_t seq2) {
+        if (seq1 < seq2)
+            std::swap(seq1, seq2);
+        return seq1 * (seq1-1) / 2 + seq2;
+    }
+
+    /** number of sequences */
+    size_t n;
+
+    /** TRUE if entries are stored in float_data, otherwise in double_data */
+    bool single_precision;
+
+    std::vector<float> float_data;
+
+    std::vector<double> double_data;
+};
+
+#endif /* distancematrix_h */
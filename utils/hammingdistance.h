@@ -24,6 +24,7 @@
 #define HAMMING_VECTOR (1)
 #define VECTOR_MAD     (0)
 #include <vectorclass/vectorclass.h> //For Vec32c and Vec32cb classes
+#include <stdint.h>                  //For uint64_t
 
 //
 //Note 1: L is a template parameter so that, when the state range
@@ -112,5 +113,64 @@ inline double hammingDistance
 }
 #endif
 
+//
+//Bit-packed sequences: every word covers 64 patterns and holds, in this
+//order, a mask of the patterns where the state is known, followed by
+//NBITS bit planes of the state.  Pattern frequencies are split into
+//bit planes as well, so that a weighted count of the set bits of a mask
+//is a sum of popcounts shifted by the plane index.
+//
+#if defined (__GNUC__) || defined(__clang__)
+inline int popcount64(uint64_t x) {
+    return __builtin_popcountll(x);
+}
+#else
+inline int popcount64(uint64_t x) {
+    x = x - ((x >> 1) & 0x5555555555555555ULL);
+    x = (x & 0x3333333333333333ULL) + ((x >> 2) & 0x3333333333333333ULL);
+    x = (x + (x >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+    return (int)((x * 0x0101010101010101ULL) >> 56);
+}
+#endif
+
+inline uint64_t weightedPopcount(uint64_t x, const uint64_t* weightPlanes, int planeCount) {
+    uint64_t count = popcount64(x & weightPlanes[0]);
+    for (int plane = 1; plane < planeCount; ++plane) {
+        count += (uint64_t)popcount64(x & weightPlanes[plane]) << plane;
+    }
+    return count;
+}
+
+//
+//Note: with TRANSITIONS, NBITS must be 2 and states coded A=0, C=1, G=2,
+//      T=3, so that a transition (A<->G, C<->T) differs only in bit 1.
+//
+template <int NBITS, bool TRANSITIONS> inline void countPackedDifferences
+        ( const uint64_t* sequenceA, const uint64_t* sequenceB
+         , size_t wordCount, const uint64_t* weightPlanes, const int* planeOffset
+         , uint64_t& known, uint64_t& differences, uint64_t& transitions ) {
+    const int stride = NBITS + 1;
+    for (size_t w = 0; w < wordCount; ++w) {
+        const uint64_t* a = sequenceA + w * stride;
+        const uint64_t* b = sequenceB + w * stride;
+        uint64_t both = a[0] & b[0];
+        uint64_t diff = 0;
+        for (int bit = 1; bit <= NBITS; ++bit) {
+            diff |= a[bit] ^ b[bit];
+        }
+        diff &= both;
+        const uint64_t* weights = weightPlanes + planeOffset[w];
+        int planeCount = planeOffset[w+1] - planeOffset[w];
+        known += weightedPopcount(both, weights, planeCount);
+        if (diff == 0) {
+            continue;
+        }
+        differences += weightedPopcount(diff, weights, planeCount);
+        if (TRANSITIONS) {
+            uint64_t ts = diff & ~(a[1] ^ b[1]);
+            transitions += weightedPopcount(ts, weights, planeCount);
+        }
+    }
+}
 
 #endif /* hammingdistance_h */
@@ -0,0 +1,66 @@
+//
+//  mappedfile.cpp
+//  iqtree
+//
+
+#include "mappedfile.h"
+#if !defined(_WIN32) && !defined(WIN32) && !defined(WIN64)
+    #define USE_MMAP
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+MappedFile::MappedFile() : begin(nullptr), length(0), fd(-1) {
+}
+
+MappedFile::~MappedFile() {
+    close();
+}
+
+bool MappedFile::open(const char *filename) {
+    close();
+#ifdef USE_MMAP
+    fd = ::open(filename, O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size < 2) {
+        close();
+        return false;
+    }
+    void *addr = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (addr == MAP_FAILED) {
+        close();
+        return false;
+    }
+    begin  = static_cast<const char*>(addr);
+    length = st.st_size;
+    madvise(addr, length, MADV_SEQUENTIAL);
+    // gzip magic number: leave compressed files to igzstream
+    if ((unsigned char)begin[0] == 0x1f && (unsigned char)begin[1] == 0x8b) {
+        close();
+        return false;
+    }
+    return true;
+#else
+    (void)filename;
+    return false;
+#endif
+}
+
+void MappedFile::close() {
+#ifdef USE_MMAP
+    if (begin) {
+        munmap(const_cast<char*>(begin), length);
+    }
+    if (fd >= 0) {
+        ::close(fd);
+    }
+#endif
+    begin  = nullptr;
+    length = 0;
+    fd     = -1;
+}
@@ -0,0 +1,46 @@
+//
+//  mappedfile.h
+//  iqtree
+//
+//  Read-only memory mapping of (uncompressed) input files.
+//
+
+#ifndef mappedfile_h
+#define mappedfile_h
+
+#include <string>
+
+/**
+ * Read-only memory map of a whole file. Pages are backed by the file itself,
+ * so large inputs can be scanned without copying them onto the heap.
+ * Mapping is refused for gzip-compressed files and on platforms without mmap();
+ * callers then fall back to stream reading.
+ */
+class MappedFile {
+public:
+    MappedFile();
+    ~MappedFile();
+
+    /**
+     * map a file into memory
+     * @param filename file name
+     * @return true on success, false if the file cannot be mapped
+     */
+    bool open(const char *filename);
+
+    /** unmap the file */
+    void close();
+
+    /** @return pointer to the first byte of the file */
+    const char *data() const { return begin; }
+
+    /** @return file size in bytes */
+    size_t size() const { return length; }
+
+private:
+    const char *begin;
+    size_t length;
+    int fd;
+};
+
+#endif /* mappedfile_h */
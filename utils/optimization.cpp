@@ -922,11 +922,14 @@ double Optimization::derivativeFunk(double x[], double dfx[]) {
 	double *h = new double[ndim+1];
     double temp;
     int dim;
+	// single-precision partial likelihoods make the target noisy in the last digits,
+	// so do not let the step shrink with x near the lower bounds
+	double min_h = Params::getInstance().lk_float_storage ? ERROR_X : 0.0;
 	double fx = targetFunk(x);
 	for (dim = 1; dim <= ndim; dim++ ){
 		temp = x[dim];
 		h[dim] = ERROR_X * fabs(temp);
-		if (h[dim] == 0.0) h[dim] = ERROR_X;
+		if (h[dim] == 0.0 || h[dim] < min_h) h[dim] = ERROR_X;
 		x[dim] = temp + h[dim];
 		h[dim] = x[dim] - temp;
 		dfx[dim] = (targetFunk(x));
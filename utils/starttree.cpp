@@ -128,7 +128,7 @@ void BenchmarkingTreeBuilder::setZippedOutput(bool zipIt) {
 
 bool BenchmarkingTreeBuilder::constructTreeInMemory
     ( const std::vector<std::string> &sequenceNames
-    , double *distanceMatrix
+    , const DistanceMatrix &distanceMatrix
     , const std::string & newickTreeFilePath) {
         bool ok = false;
         #ifdef _OPENMP
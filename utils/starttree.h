@@ -26,6 +26,7 @@
 #include <iostream>
 #include <vector>
 #include "timeutil.h"       //for getRealTime()
+#include "distancematrix.h" //for DistanceMatrix
 
 namespace StartTree
 {
@@ -40,7 +41,7 @@ namespace StartTree
              , const std::string & newickTreeFilePath) = 0;
         virtual bool constructTreeInMemory
             ( const std::vector<std::string> &sequenceNames
-             , double *distanceMatrix
+             , const DistanceMatrix &distanceMatrix
              , const std::string & newickTreeFilePath) = 0;
         virtual const std::string& getName() = 0;
         virtual const std::string& getDescription() = 0;
@@ -133,7 +134,7 @@ namespace StartTree
             }
         virtual bool constructTreeInMemory
             ( const std::vector<std::string> &sequenceNames
-            , double *distanceMatrix
+            , const DistanceMatrix &distanceMatrix
             , const std::string & newickTreeFilePath) {
                 B builder;
                 
@@ -162,7 +163,7 @@ namespace StartTree
              , const std::string & newickTreeFilePath);
         virtual bool constructTreeInMemory
             ( const std::vector<std::string> &sequenceNames
-            , double *distanceMatrix
+            , const DistanceMatrix &distanceMatrix
              , const std::string & newickTreeFilePath);
         virtual void setZippedOutput(bool zipIt);
     };
@@ -738,6 +738,9 @@ void parseArg(int argc, char *argv[], Params &params) {
     params.dist_file = NULL;
     params.compute_obs_dist = false;
     params.compute_jc_dist = true;
+    params.compute_k2p_dist = false;
+    params.packed_dist = true;
+    params.dist_float = false;
     params.experimental = true;
     params.compute_ml_dist = true;
     params.compute_ml_tree = true;
@@ -797,10 +800,12 @@ void parseArg(int argc, char *argv[], Params &params) {
     params.gurobi_threads = 1;
     params.num_bootstrap_samples = 0;
     params.bootstrap_spec = NULL;
+    params.num_parallel_boot = 1;
     params.transfer_bootstrap = 0;
 
     params.aln_file = NULL;
     params.phylip_sequential_format = false;
+    params.mmap_alignment = false;
     params.symtest = SYMTEST_NONE;
     params.symtest_only = false;
     params.symtest_remove = 0;
@@ -814,6 +819,7 @@ void parseArg(int argc, char *argv[], Params &params) {
     params.topotest_optimize_model = false;
     params.do_weighted_test = false;
     params.do_au_test = false;
+    params.topotest_batch = false;
     params.siteLL_file = NULL; //added by MA
     params.partition_file = NULL;
     params.partition_type = BRLEN_OPTIMIZE;
@@ -930,6 +936,13 @@ void parseArg(int argc, char *argv[], Params &params) {
     params.lk_safe_scaling = false;
     params.numseq_safe_scaling = 2000;
     params.kernel_nonrev = false;
+    params.lk_subtree_repeat = false;
+    params.lk_float_storage = false;
+    params.nni_parallel = false;
+    params.lazy_spr_radius = 0;
+    params.lazy_spr_only = false;
+    params.pars_spr = false;
+    params.num_climbers = 1;
     params.print_site_lh = WSL_NONE;
     params.print_partition_lh = false;
     params.print_site_prob = WSL_NONE;
@@ -1077,6 +1090,7 @@ void parseArg(int argc, char *argv[], Params &params) {
     params.model_joint = NULL;
     params.ignore_checkpoint = false;
     params.checkpoint_dump_interval = 60;
+    params.checkpoint_binary = false;
     params.force_unfinished = false;
     params.suppress_output_flags = 0;
     params.ufboot2corr = false;
@@ -1361,6 +1375,18 @@ void parseArg(int argc, char *argv[], Params &params) {
 				params.compute_obs_dist = true;
 				continue;
 			}
+			if (strcmp(argv[cnt], "-dk2p") == 0) {
+				params.compute_k2p_dist = true;
+				continue;
+			}
+			if (strcmp(argv[cnt], "--no-packed-dist") == 0) {
+				params.packed_dist = false;
+				continue;
+			}
+			if (strcmp(argv[cnt], "--dist-float") == 0) {
+				params.dist_float = true;
+				continue;
+			}
             if (strcmp(argv[cnt], "-experimental") == 0 || strcmp(argv[cnt], "--experimental") == 0) {
                 params.experimental = true;
                 continue;
@@ -1797,6 +1823,10 @@ void parseArg(int argc, char *argv[], Params &params) {
                 params.phylip_sequential_format = true;
                 continue;
             }
+            if (strcmp(argv[cnt], "--mmap") == 0) {
+                params.mmap_alignment = true;
+                continue;
+            }
             if (strcmp(argv[cnt], "--symtest") == 0) {
                 params.symtest = SYMTEST_MAXDIV;
                 continue;
@@ -1909,6 +1939,10 @@ void parseArg(int argc, char *argv[], Params &params) {
 				params.do_au_test = true;
 				continue;
 			}
+			if (strcmp(argv[cnt], "--test-batch") == 0) {
+				params.topotest_batch = true;
+				continue;
+			}
 			if (strcmp(argv[cnt], "-sp") == 0 || strcmp(argv[cnt], "-Q") == 0) {
 				cnt++;
 				if (cnt >= argc)
@@ -2479,6 +2513,53 @@ void parseArg(int argc, char *argv[], Params &params) {
                 continue;
             }
 
+            if (strcmp(argv[cnt], "--subtree-repeat") == 0) {
+                params.lk_subtree_repeat = true;
+                continue;
+            }
+
+            if (strcmp(argv[cnt], "--lh-float") == 0) {
+                params.lk_float_storage = true;
+                continue;
+            }
+
+            if (strcmp(argv[cnt], "--nni-parallel") == 0) {
+                params.nni_parallel = true;
+                continue;
+            }
+
+            if (strcmp(argv[cnt], "--lazy-spr") == 0) {
+                cnt++;
+                if (cnt >= argc)
+                    throw "Use --lazy-spr <SPR radius>";
+                params.lazy_spr_radius = convert_int(argv[cnt]);
+                if (params.lazy_spr_radius < 1)
+                    throw "SPR radius must be positive";
+                continue;
+            }
+
+            if (strcmp(argv[cnt], "--lazy-spr-only") == 0) {
+                params.lazy_spr_only = true;
+                if (params.lazy_spr_radius == 0)
+                    params.lazy_spr_radius = 5;
+                continue;
+            }
+
+            if (strcmp(argv[cnt], "--pars-spr") == 0) {
+                params.pars_spr = true;
+                continue;
+            }
+
+            if (strcmp(argv[cnt], "--climbers") == 0) {
+                cnt++;
+                if (cnt >= argc)
+                    throw "Use --climbers <number of parallel hill-climbers>";
+                params.num_climbers = convert_int(argv[cnt]);
+                if (params.num_climbers < 1)
+                    throw "Number of hill-climbers must be positive";
+                continue;
+            }
+
 			if (strcmp(argv[cnt], "-f") == 0) {
 				cnt++;
 				if (cnt >= argc)
@@ -2773,6 +2854,16 @@ void parseArg(int argc, char *argv[], Params &params) {
 				continue;
 			}
             
+            if (strcmp(argv[cnt], "--boot-parallel") == 0) {
+                cnt++;
+                if (cnt >= argc)
+                    throw "Use --boot-parallel <number of concurrent bootstrap replicates>";
+                params.num_parallel_boot = convert_int(argv[cnt]);
+                if (params.num_parallel_boot < 1)
+                    throw "Number of concurrent bootstrap replicates must be positive";
+                continue;
+            }
+
             if (strcmp(argv[cnt], "--subsample") == 0) {
                 cnt++;
                 if (cnt >= argc)
@@ -4028,6 +4119,11 @@ void parseArg(int argc, char *argv[], Params &params) {
 				params.checkpoint_dump_interval = convert_int(argv[cnt]);
 				continue;
 			}
+
+            if (strcmp(argv[cnt], "--ckp-binary") == 0) {
+                params.checkpoint_binary = true;
+                continue;
+            }
             
 			if (strcmp(argv[cnt], "--no-log") == 0) {
 				params.suppress_output_flags |= OUT_LOG;
@@ -4396,12 +4492,15 @@ void usage_iqtree(char* argv[], bool full_command) {
     << "  -s FILE[,...,FILE]   PHYLIP/FASTA/NEXUS/CLUSTAL/MSF alignment file(s)" << endl
     << "  -s DIR               Directory of alignment files" << endl
     << "  --seqtype STRING     BIN, DNA, AA, NT2AA, CODON, MORPH (default: auto-detect)" << endl
+    << "  --mmap               Read FASTA/PHYLIP alignment through a memory map" << endl
     << "  -t FILE|PARS|RAND    Starting tree (default: 99 parsimony and BIONJ)" << endl
     << "  -o TAX[,...,TAX]     Outgroup taxon (list) for writing .treefile" << endl
     << "  --prefix STRING      Prefix for all output files (default: aln/partition)" << endl
     << "  --seed NUM           Random seed number, normally used for debugging purpose" << endl
     << "  --safe               Safe likelihood kernel to avoid numerical underflow" << endl
+    << "  --lh-float           Store partial likelihoods in single precision" << endl
     << "  --mem NUM[G|M|%]     Maximal RAM usage in GB | MB | %" << endl
+    << "  --dist-float         Store pairwise distances in single precision" << endl
     << "  --runs NUM           Number of indepedent runs (default: 1)" << endl
     << "  -v, --verbose        Verbose mode, printing more messages to screen" << endl
     << "  -V, --version        Display version number" << endl
@@ -4417,6 +4516,7 @@ void usage_iqtree(char* argv[], bool full_command) {
     << "  --redo-tree          Restore ModelFinder and only redo tree search" << endl
     << "  --undo               Revoke finished run, used when changing some options" << endl
     << "  --cptime NUM         Minimum checkpoint interval (default: 60 sec and adapt)" << endl
+    << "  --ckp-binary         Binary checkpoint file (.ckp.bin), only changes are appended" << endl
     << endl << "PARTITION MODEL:" << endl
     << "  -p FILE|DIR          NEXUS/RAxML partition file or directory with alignments" << endl
     << "                       Edge-linked proportional partition model" << endl
@@ -4438,7 +4538,11 @@ void usage_iqtree(char* argv[], bool full_command) {
     << "  --nstop NUM          Number of unsuccessful iterations to stop (default: 100)" << endl
     << "  --perturb NUM        Perturbation strength for randomized NNI (default: 0.5)" << endl
     << "  --radius NUM         Radius for parsimony SPR search (default: 6)" << endl
+    << "  --pars-spr           Refine parsimony starting trees by SPR (default: OFF)" << endl
     << "  --allnni             Perform more thorough NNI search (default: OFF)" << endl
+    << "  --lazy-spr NUM       Lazy SPR search with radius NUM after each NNI search (default: OFF)" << endl
+    << "  --lazy-spr-only      Use lazy SPR instead of NNI hill-climbing (radius: 5)" << endl
+    << "  --climbers NUM       Number of hill-climbers run in parallel threads (default: 1)" << endl
     << "  -g FILE              (Multifurcating) topological constraint tree file" << endl
     << "  --fast               Fast search to resemble FastTree" << endl
     << "  --polytomy           Collapse near-zero branches into polytomy" << endl
@@ -4469,6 +4573,7 @@ void usage_iqtree(char* argv[], bool full_command) {
     << "  --jack-prop NUM      Subsampling proportion for jackknife (default: 0.5)" << endl
     << "  --bcon NUM           Replicates for bootstrap + consensus tree" << endl
     << "  --bonly NUM          Replicates for bootstrap only" << endl
+    << "  --boot-parallel NUM  Bootstrap replicates run concurrently (default: 1)" << endl
 #ifdef USE_BOOSTER
     << "  --tbe                Transfer bootstrap expectation" << endl
 #endif
@@ -4598,6 +4703,7 @@ void usage_iqtree(char* argv[], bool full_command) {
     << "  --test NUM           Replicates for topology test" << endl
     << "  --test-weight        Perform weighted KH and SH tests" << endl
     << "  --test-au            Approximately unbiased (AU) test (Shimodaira 2002)" << endl
+    << "  --test-batch         Evaluate trees in RF order, warm-starting branch lengths" << endl
     << "  --sitelh             Write site log-likelihoods to .sitelh file" << endl
 
     << endl << "ANCESTRAL STATE RECONSTRUCTION:" << endl
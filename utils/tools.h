@@ -831,6 +831,9 @@ public:
     /** true if sequential phylip format is used, default: false (interleaved format) */
     bool phylip_sequential_format;
 
+    /** true to read uncompressed FASTA/PHYLIP alignments through a memory map, default: false */
+    bool mmap_alignment;
+
     /**
      SYMTEST_NONE to not perform test of symmetry of Jermiin et al. (default)
      SYMTEST_MAXDIV to perform symmetry test on the pair with maximum divergence
@@ -885,6 +888,10 @@ public:
     /** true to do the approximately unbiased (AU) test */
     bool do_au_test;
 
+    /** true to evaluate user trees in order of RF similarity, each warm-starting from the
+        branch lengths of the previous tree, in parallel on thread copies */
+    bool topotest_batch;
+
     /**
             file specifying partition model
      */
@@ -1116,6 +1123,22 @@ public:
             TRUE to compute the Juke-Cantor distances, default: FALSE
      */
     bool compute_jc_dist;
+
+    /**
+            TRUE to compute Kimura 2-parameter instead of Juke-Cantor distances for DNA, default: FALSE
+     */
+    bool compute_k2p_dist;
+
+    /**
+            TRUE to compute model-free distances from bit-packed sequences (BitPackedAlignment),
+            FALSE to compute them pattern by pattern as Alignment::computeObsDist, default: TRUE
+     */
+    bool packed_dist;
+
+    /**
+            TRUE to store pairwise distances and their variances in single precision, default: FALSE
+     */
+    bool dist_float;
     
     
     /**
@@ -1603,6 +1626,11 @@ public:
     */
     char *bootstrap_spec;
 
+    /**
+            number of standard bootstrap replicates run concurrently within the process, default: 1
+     */
+    int num_parallel_boot;
+
     /** 1 or 2 to perform transfer boostrap expectation (TBE) */
     int transfer_bootstrap;
     
@@ -1708,6 +1736,44 @@ public:
     /** TRUE to force using non-reversible likelihood kernel */
     bool kernel_nonrev;
 
+    /**
+        TRUE to compute partial likelihoods only once per subtree repeat,
+        i.e. per unique combination of tip states below a node, default: FALSE
+     */
+    bool lk_subtree_repeat;
+
+    /**
+        TRUE to store partial likelihood vectors in single precision (computation stays
+        in double precision), default: FALSE
+     */
+    bool lk_float_storage;
+
+    /**
+        TRUE to evaluate NNI branches in parallel, one tree copy per thread,
+        instead of parallelizing over patterns, default: FALSE
+     */
+    bool nni_parallel;
+
+    /**
+        radius of the lazy SPR search done after each NNI search, 0 to switch it off (default)
+     */
+    int lazy_spr_radius;
+
+    /**
+        TRUE to replace the NNI hill-climbing by the lazy SPR search, default: FALSE
+     */
+    bool lazy_spr_only;
+
+    /**
+        TRUE to refine parsimony trees by parsimony SPR moves within radius sprDist, default: FALSE
+     */
+    bool pars_spr;
+
+    /**
+        number of hill-climbers run in parallel within the process during tree search, default: 1
+     */
+    int num_climbers;
+
     /**
      	 	WSL_NONE: do not print anything
             WSL_SITE: print site log-likelihood
@@ -2162,6 +2228,9 @@ public:
 
     /** time (in seconds) between checkpoint dump */
     int checkpoint_dump_interval;
+
+    /** true to write binary checkpoint file that only appends changed keys at every dump */
+    bool checkpoint_binary;
     /** TRUE to print quartet log-likelihoods to .quartetlh file */
     bool print_lmap_quartet_lh;
 